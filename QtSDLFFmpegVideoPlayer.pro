@@ -10,6 +10,8 @@ CONFIG += c++20
 DEFINES += HAVE_PORTAUDIO HAVE_RTAUDIO
 DEFINES += USE_QT_MULTIMEDIA_WIDGET # USE_SDL_WIDGET # USE_QT_MULTIMEDIA_WIDGET
 DEFINES += # USE_STD_FORMAT
+# 发布版本关闭调试检查（assert与RealtimeSafety）
+CONFIG(release, debug|release): DEFINES += NDEBUG
 
 # You can make your code fail to compile if it uses deprecated APIs.
 # In order to do so, uncomment the following line.
@@ -24,7 +26,8 @@ INCLUDEPATH += \
     ./QtSDLFFmpegVideoPlayer/SDLUtils \
     ./QtSDLFFmpegVideoPlayer/QtUtils \
     ./QtSDLFFmpegVideoPlayer/QtUIs \
-    ./QtSDLFFmpegVideoPlayer/Logger
+    ./QtSDLFFmpegVideoPlayer/Logger \
+    ./QtSDLFFmpegVideoPlayer/Tools
 
 
 SOURCES += \
@@ -45,14 +48,19 @@ SOURCES += \
     QtSDLFFmpegVideoPlayer/Players/AudioPlayer.cpp \
     QtSDLFFmpegVideoPlayer/Players/VideoPlayer.cpp \
     QtSDLFFmpegVideoPlayer/Players/MediaPlayer.cpp \
+    QtSDLFFmpegVideoPlayer/Players/SubtitlePlayer.cpp \
     QtSDLFFmpegVideoPlayer/Audio/AudioAdapter/AudioAdapter.cpp \
-    QtSDLFFmpegVideoPlayer/Audio/VolumeController/SystemVolumeController.cpp
+    QtSDLFFmpegVideoPlayer/Audio/VolumeController/SystemVolumeController.cpp \
+    QtSDLFFmpegVideoPlayer/Utils/RealtimeSafety.cpp
 
 HEADERS += \
     QtSDLFFmpegVideoPlayer/Utils/AtomicWaitObject.h \
     QtSDLFFmpegVideoPlayer/Utils/COMUtils.h \
+    QtSDLFFmpegVideoPlayer/Utils/ControlExecutor.h \
     QtSDLFFmpegVideoPlayer/Utils/EnumDefine.h \
     QtSDLFFmpegVideoPlayer/Utils/MultiEnumTypeDefine.h \
+    QtSDLFFmpegVideoPlayer/Utils/RealtimeSafety.h \
+    QtSDLFFmpegVideoPlayer/Utils/SimdFloat4.h \
     QtSDLFFmpegVideoPlayer/Utils/ThreadUtils.h \
     QtSDLFFmpegVideoPlayer/SDLUtils/SDLApp.h \
     QtSDLFFmpegVideoPlayer/SDLUtils/SDLMediaPlayer.h \
@@ -70,8 +78,29 @@ HEADERS += \
     QtSDLFFmpegVideoPlayer/Players/AudioPlayer.h \
     QtSDLFFmpegVideoPlayer/Players/VideoPlayer.h \
     QtSDLFFmpegVideoPlayer/Players/MediaPlayer.h \
+    QtSDLFFmpegVideoPlayer/Players/SubtitlePlayer.h \
     QtSDLFFmpegVideoPlayer/Logger/LoggerPredefine.h \
+    QtSDLFFmpegVideoPlayer/Tools/AudioDspBenchmark.h \
+    QtSDLFFmpegVideoPlayer/Tools/AudioDspChain.h \
+    QtSDLFFmpegVideoPlayer/Tools/AudioTimeStretcher.h \
+    QtSDLFFmpegVideoPlayer/Tools/AudioRingBuffer.h \
+    QtSDLFFmpegVideoPlayer/Tools/AudioOutputConverter.h \
+    QtSDLFFmpegVideoPlayer/Tools/AudioChannelMixer.h \
+    QtSDLFFmpegVideoPlayer/Tools/AudioBufferController.h \
+    QtSDLFFmpegVideoPlayer/Tools/RealtimeMessageQueue.h \
+    QtSDLFFmpegVideoPlayer/Tools/LoudnessMeter.h \
+    QtSDLFFmpegVideoPlayer/Tools/LoudnessScanner.h \
+    QtSDLFFmpegVideoPlayer/Tools/AudioAnalyzer.h \
+    QtSDLFFmpegVideoPlayer/Tools/AudioCrossfader.h \
+    QtSDLFFmpegVideoPlayer/Tools/AudioSyncAdjustment.h \
+    QtSDLFFmpegVideoPlayer/Tools/AudioTrackPreloader.h \
+    QtSDLFFmpegVideoPlayer/Tools/HdrToneMapper.h \
+    QtSDLFFmpegVideoPlayer/Tools/SwsContextCache.h \
+    QtSDLFFmpegVideoPlayer/Tools/SwsScaleBenchmark.h \
+    QtSDLFFmpegVideoPlayer/Tools/VideoDeinterlacer.h \
     QtSDLFFmpegVideoPlayer/Audio/AudioAdapter/AudioAdapter.h \
+    QtSDLFFmpegVideoPlayer/Audio/AudioAdapter/NullAudioAdapter.h \
+    QtSDLFFmpegVideoPlayer/Audio/AudioAdapter/MixerAudioAdapter.h \
     QtSDLFFmpegVideoPlayer/Audio/VolumeController/SystemVolumeController.h
 
 RESOURCES += QtSDLFFmpegVideoPlayer/resources/QtSDLFFmpegVideoPlayer.qrc
@@ -120,6 +149,15 @@ else:unix: LIBS += -L$$PWD/../Libraries/portaudio-19.7.0/build/cmake/ -lportaudi
 INCLUDEPATH += $$PWD/../Libraries/portaudio-19.7.0/include
 DEPENDPATH += $$PWD/../Libraries/portaudio-19.7.0/include
 
+# libass，渲染文本字幕（SRT/ASS），可选：qmake CONFIG+=libass，不启用时只支持位图字幕
+libass {
+    DEFINES += SUBTITLE_PLAYER_USE_LIBASS
+    win32: LIBS += -L$$PWD/../Libraries/libass/lib/ -lass
+    else:unix: LIBS += -lass
+    INCLUDEPATH += $$PWD/../Libraries/libass/include
+    DEPENDPATH += $$PWD/../Libraries/libass/include
+}
+
 LIBS += -lpthread
 
 win32:CONFIG(release, debug|release): LIBS += -L$$PWD/../Libraries/Logger/build/MinGWx64/ -llibLogger
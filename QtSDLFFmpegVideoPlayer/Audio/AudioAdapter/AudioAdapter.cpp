@@ -1,6 +1,7 @@
 #include "AudioAdapter.h"
 #include <unordered_map>
 #define AUDIO_ADAPTER_LISTITEM(type, creator) { type, creator },
+#include "NullAudioAdapter.h"
 #ifdef HAVE_RTAUDIO
 #include "RtAudioAdapter.h"
 
@@ -16,11 +17,14 @@ std::unordered_map<AudioAdapterFactory::AudioAdapterAdapter, AudioAdapter::Creat
 #ifdef HAVE_PORTAUDIO
     AUDIO_ADAPTER_LISTITEM(AudioAdapterFactory::PortAudioAdapter, PortAudioAdapter::create)
 #endif
+    AUDIO_ADAPTER_LISTITEM(AudioAdapterFactory::NullAudioAdapter, NullAudioAdapter::create)
 };
 
 
 AudioAdapter* AudioAdapterFactory::create(AudioAdapterAdapter adapter, AudioAdapter::AudioApi api, AudioAdapter::AudioErrorCallback errorCallback)
 {
+    if (api == AudioAdapter::Dummy) // 各后端的Dummy接口没有设备，统一使用内置的空设备
+        adapter = AudioAdapterFactory::NullAudioAdapter;
     if (compiledAudioAdapterAdapters.count(adapter) == 0)
         return nullptr;
     // 创建新的实例
@@ -164,7 +164,7 @@ public:
             audioFmt = AFSignedInt16;
             break;
         case AV_SAMPLE_FMT_S32:
-            audioFmt = AFSignedInt16;
+            audioFmt = AFSignedInt32;
             break;
         case AV_SAMPLE_FMT_FLT:
             audioFmt = AFFloat32;
@@ -351,6 +351,13 @@ public:
     */
     virtual unsigned int getStreamSampleRate() = 0;
 
+    //! Returns the output stream latency in seconds, or zero if the stream is not open or the API does not report latency.
+    double getOutputStreamLatencySeconds() {
+        const unsigned int rate = getStreamSampleRate();
+        const long frames = getOutputStreamLatency();
+        return (rate > 0 && frames > 0) ? static_cast<double>(frames) / rate : 0.0;
+    }
+
     //! Set a client-defined function that will be invoked when an error or warning occurs.
     virtual void setErrorCallback(AudioErrorCallback errorCallback) = 0;
 
@@ -370,12 +377,14 @@ class AudioAdapterFactory
 public:
     enum AudioAdapterAdapter {
         RtAudioAdapter,
-        PortAudioAdapter
+        PortAudioAdapter,
+        NullAudioAdapter // 内置的空设备，总是可用
     };
 private:
     //friend class AudioAdapter;
     static std::unordered_map<AudioAdapterAdapter, AudioAdapter::CreateFunction> compiledAudioAdapterAdapters;
 public:
+    // audioApi为Dummy时总是创建内置的空设备（NullAudioAdapter）
     static AudioAdapter* create(AudioAdapterAdapter adapter, AudioAdapter::AudioApi audioApi = AudioAdapter::Unspecified, AudioAdapter::AudioErrorCallback errorCallback = nullptr);
 
 };
\ No newline at end of file
@@ -0,0 +1,720 @@
+#pragma once
+#include "AudioAdapter.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <thread>
+
+// 软件混音器：独占一个设备输出流，把多路输入混合后输出，供不能同时打开多个流的设备（如ALSA hw设备）使用
+// 每路输入有独立的增益与单生产者单消费者环形缓冲区：
+// 推送型输入由外部线程写入（界面音效、预览试听），拉取型输入在设备回调中按其自己的回调帧数调用回调填充（见MixerAudioAdapter）
+// 设备回调中不加锁、不分配内存，逐路累加到设备缓冲区，开销与输入数成正比，最后经过软限幅
+class AudioMixer
+{
+public:
+    static constexpr int MAX_SOURCES = 16;
+    static constexpr unsigned int DEFAULT_DEVICE = std::numeric_limits<unsigned int>::max(); // 使用后端的默认输出设备
+    static constexpr unsigned int DEFAULT_BUFFER_FRAMES = 512;
+    static constexpr unsigned int SOURCE_RING_BLOCKS = 4; // 拉取型输入的环形缓冲区容量，为回调帧数的倍数
+    static constexpr float DEFAULT_LIMITER_KNEE = 0.8f; // 软限幅的起点，约-1.9 dBFS，之上平滑压向满幅
+
+    struct Options {
+        unsigned int deviceId{ DEFAULT_DEVICE };
+        unsigned int sampleRate{ 0 }; // 0表示使用设备的首选采样率
+        unsigned int numberOfChannels{ 2 }; // 超过设备通道数时截断，0表示使用设备的全部通道
+        unsigned int bufferFrames{ DEFAULT_BUFFER_FRAMES };
+        AudioAdapter::AudioStreamOptions streamOptions;
+    };
+
+    // 拉取型输入的回调，output为交错float，需写满nFrames帧，返回Complete时本次数据仍会播放，返回Abort时丢弃已缓冲的数据
+    using PullCallback = std::function<AudioAdapter::AudioCallbackResult(float* output, unsigned int nFrames, AudioAdapter::AudioStreamStatuses status)>;
+
+    struct Statistics {
+        uint64_t callbacks{ 0 };
+        uint64_t limitedSamples{ 0 }; // 经过软限幅的样本数
+        int activeSources{ 0 };
+    };
+    struct SourceStatistics {
+        bool active{ false };
+        bool pulling{ false };
+        float gain{ 0.0f };
+        uint64_t framesMixed{ 0 };
+        uint64_t underruns{ 0 }; // 拉取型输入在回调中未能提供足够数据的次数
+        uint64_t bufferedFrames{ 0 };
+    };
+
+private:
+    enum SlotState : int {
+        Free,
+        Reserved, // 正在配置，回调不访问
+        Active
+    };
+    struct Source {
+        std::atomic<int> state{ Free };
+        std::atomic<bool> busy{ false }; // 设备回调正在处理该输入，移除与停止时等待其清除
+        std::atomic<float> gain{ 1.0f };
+        std::atomic<bool> pulling{ false };
+        std::atomic<bool> flushRequested{ false };
+        std::atomic<uint64_t> framesMixed{ 0 };
+        std::atomic<uint64_t> underruns{ 0 };
+        unsigned int channels{ 0 };
+        // 环形缓冲区，读写位置为单调递增的帧计数
+        std::vector<float> ring;
+        uint64_t capacity{ 0 }; // 2的幂，单位：帧
+        uint64_t mask{ 0 };
+        alignas(64) std::atomic<uint64_t> writePos{ 0 };
+        alignas(64) std::atomic<uint64_t> readPos{ 0 };
+        // 拉取型
+        PullCallback pull{ nullptr };
+        unsigned int pullFrames{ 0 };
+        std::vector<float> pullBuffer;
+        // 只在设备回调中访问
+        float currentGain{ 1.0f };
+        bool underflowPending{ false };
+
+        uint64_t readableFrames() const { return writePos.load(std::memory_order_acquire) - readPos.load(std::memory_order_acquire); }
+        uint64_t writableFrames() const { return capacity - readableFrames(); }
+    };
+
+    mutable std::mutex mtx; // 保护设备的打开/关闭与输入的分配/移除，设备回调不加锁
+    std::unique_ptr<AudioAdapter> device;
+    bool streamOpen{ false };
+    // 打开设备流时写入，之后只读
+    unsigned int sampleRate{ 0 };
+    unsigned int channels{ 0 };
+    unsigned int bufferFrames{ 0 };
+    std::string deviceName;
+
+    std::array<Source, MAX_SOURCES> sources;
+    std::atomic<bool> limiterEnabled{ true };
+    std::atomic<float> limiterKnee{ DEFAULT_LIMITER_KNEE };
+    std::atomic<uint64_t> callbacks{ 0 };
+    std::atomic<uint64_t> limitedSamples{ 0 };
+
+public:
+    AudioMixer() = default;
+    AudioMixer(const AudioMixer&) = delete;
+    AudioMixer& operator=(const AudioMixer&) = delete;
+    ~AudioMixer() {
+        close();
+    }
+
+    // 取得outputDevice的所有权，以float格式打开并启动设备流
+    // 已有输入时：采样率必须与之前打开时相同，通道数不能少于各输入的通道数（第一次打开前添加的输入只检查通道数）
+    AudioAdapter::AudioErrorType open(AudioAdapter* outputDevice, const Options& options) {
+        std::unique_ptr<AudioAdapter> newDevice(outputDevice);
+        std::unique_lock lock(mtx);
+        if (streamOpen)
+            return AudioAdapter::InvalidUse;
+        if (!newDevice || newDevice->getDeviceCount() == 0)
+            return AudioAdapter::NoDevicesFound;
+        AudioAdapter::AudioStreamParameters params;
+        params.deviceId = options.deviceId == DEFAULT_DEVICE ? newDevice->getDefaultOutputDevice() : options.deviceId;
+        const AudioAdapter::AudioDeviceInfo info = newDevice->getDeviceInfo(params.deviceId);
+        if (info.outputChannels == 0)
+            return AudioAdapter::InvalidDevice;
+        params.nChannels = options.numberOfChannels ? std::min(options.numberOfChannels, info.outputChannels) : info.outputChannels;
+        unsigned int rate = options.sampleRate;
+        if (rate == 0)
+            rate = info.preferredSampleRate ? info.preferredSampleRate : (info.currentSampleRate ? info.currentSampleRate : 48000);
+        if (hasSources() && ((sampleRate && rate != sampleRate) || params.nChannels < maxSourceChannels()))
+            return AudioAdapter::InvalidParameter;
+        unsigned int frames = options.bufferFrames;
+        AudioAdapter::AudioStreamOptions streamOptions = options.streamOptions;
+        AudioAdapter::AudioErrorType result = newDevice->openStream(&params, nullptr, AudioAdapter::AFFloat32, rate, &frames,
+            [this](void* outputBuffer, void* inputBuffer, unsigned int nFrames, double streamTime, AudioAdapter::AudioStreamStatuses status, AudioAdapter::RawArgsType rawArgs, AudioAdapter::UserDataType userData) -> AudioAdapter::AudioCallbackResult {
+                return render(static_cast<float*>(outputBuffer), nFrames, status);
+            },
+            0, &streamOptions);
+        if (result != AudioAdapter::NoError)
+            return result;
+        sampleRate = newDevice->getStreamSampleRate() ? newDevice->getStreamSampleRate() : rate;
+        channels = params.nChannels;
+        bufferFrames = frames ? frames : DEFAULT_BUFFER_FRAMES;
+        deviceName = info.name;
+        result = newDevice->startStream();
+        if (result != AudioAdapter::NoError)
+        {
+            newDevice->closeStream();
+            return result;
+        }
+        device = std::move(newDevice);
+        streamOpen = true;
+        return AudioAdapter::NoError;
+    }
+    // 停止并关闭设备流，输入保持注册，重新打开后继续混音
+    void close() {
+        std::unique_lock lock(mtx);
+        if (!device)
+            return;
+        if (device->isStreamRunning())
+            device->abortStream();
+        if (device->isStreamOpen())
+            device->closeStream();
+        device.reset();
+        streamOpen = false;
+    }
+
+    bool isOpen() const {
+        std::unique_lock lock(mtx);
+        return streamOpen;
+    }
+    unsigned int getSampleRate() const { return sampleRate; }
+    unsigned int getNumberOfChannels() const { return channels; }
+    unsigned int getBufferFrames() const { return bufferFrames; }
+    // 设备报告的输出延迟，单位：帧
+    long getOutputLatency() const {
+        std::unique_lock lock(mtx);
+        return streamOpen ? std::max(device->getOutputStreamLatency(), 0L) : 0;
+    }
+    std::string getDeviceName() const {
+        std::unique_lock lock(mtx);
+        return streamOpen ? deviceName : std::string{};
+    }
+
+    void setLimiterEnabled(bool enabled) { limiterEnabled.store(enabled); }
+    bool getLimiterEnabled() const { return limiterEnabled.load(); }
+    // 软限幅起点，范围0.1 ~ 1.0，1.0时为硬截断
+    void setLimiterKnee(float knee) { limiterKnee.store(std::clamp(knee, 0.1f, 1.0f)); }
+    float getLimiterKnee() const { return limiterKnee.load(); }
+
+    // 添加推送型输入，容量向上取整到2的幂，返回输入编号，没有空闲位置或参数无效时返回-1
+    int addSource(unsigned int numberOfChannels, unsigned int capacityFrames) {
+        return addSource(numberOfChannels, capacityFrames, nullptr, 0);
+    }
+    // 添加拉取型输入，由设备回调按pullFrames帧调用pull，需在停止状态下添加，之后调用setSourcePulling开始
+    int addPullSource(unsigned int numberOfChannels, unsigned int pullFrames, PullCallback pull) {
+        if (!pull || pullFrames == 0)
+            return -1;
+        const unsigned int capacityFrames = std::max(pullFrames, bufferFrames) * SOURCE_RING_BLOCKS;
+        return addSource(numberOfChannels, capacityFrames, std::move(pull), pullFrames);
+    }
+    // 移除输入，返回后设备回调不再访问该输入，不能在设备回调中调用
+    void removeSource(int id) {
+        std::unique_lock lock(mtx);
+        if (!isValidSource(id))
+            return;
+        Source& s = sources[id];
+        s.state.store(Free);
+        waitSourceIdle(s);
+        s.pulling.store(false);
+        s.pull = nullptr;
+    }
+
+    // 推送型输入的生产者：写入最多frames帧交错float数据，返回实际写入的帧数
+    uint64_t write(int id, const float* samples, uint64_t frames) {
+        if (!isValidSource(id) || sources[id].state.load(std::memory_order_acquire) != Active)
+            return 0;
+        return writeRing(sources[id], samples, frames);
+    }
+    uint64_t writableFrames(int id) const {
+        if (!isValidSource(id) || sources[id].state.load(std::memory_order_acquire) != Active)
+            return 0;
+        return sources[id].writableFrames();
+    }
+    // 丢弃输入中尚未播放的数据，由设备回调在下一次处理时完成
+    void flushSource(int id) {
+        if (isValidSource(id))
+            sources[id].flushRequested.store(true);
+    }
+    // 拉取型输入开始或停止调用回调，停止时等待正在进行的回调返回，已缓冲的数据继续播放，不能在设备回调中调用
+    void setSourcePulling(int id, bool pulling) {
+        if (!isValidSource(id))
+            return;
+        Source& s = sources[id];
+        s.pulling.store(pulling && s.pull);
+        if (!pulling)
+            waitSourceIdle(s);
+    }
+    bool isSourcePulling(int id) const {
+        return isValidSource(id) && sources[id].pulling.load();
+    }
+    // 增益在下一次设备回调内线性过渡到新值
+    void setGain(int id, float gain) {
+        if (isValidSource(id))
+            sources[id].gain.store(std::max(gain, 0.0f));
+    }
+    float getGain(int id) const {
+        return isValidSource(id) ? sources[id].gain.load() : 0.0f;
+    }
+
+    Statistics getStatistics() const {
+        Statistics stats;
+        stats.callbacks = callbacks.load();
+        stats.limitedSamples = limitedSamples.load();
+        for (const auto& s : sources)
+            if (s.state.load() == Active)
+                ++stats.activeSources;
+        return stats;
+    }
+    SourceStatistics getSourceStatistics(int id) const {
+        SourceStatistics stats;
+        if (!isValidSource(id))
+            return stats;
+        const Source& s = sources[id];
+        stats.active = s.state.load() == Active;
+        stats.pulling = s.pulling.load();
+        stats.gain = s.gain.load();
+        stats.framesMixed = s.framesMixed.load();
+        stats.underruns = s.underruns.load();
+        stats.bufferedFrames = stats.active ? s.readableFrames() : 0;
+        return stats;
+    }
+
+private:
+    static bool isValidSource(int id) { return id >= 0 && id < MAX_SOURCES; }
+    // 需持有mtx
+    bool hasSources() const {
+        return std::any_of(sources.begin(), sources.end(), [](const Source& s) { return s.state.load() != Free; });
+    }
+    // 已注册输入的最大通道数，需持有mtx
+    unsigned int maxSourceChannels() const {
+        unsigned int result = 0;
+        for (const auto& s : sources)
+            if (s.state.load() != Free)
+                result = std::max(result, s.channels);
+        return result;
+    }
+    static void waitSourceIdle(const Source& s) {
+        while (s.busy.load())
+            std::this_thread::yield();
+    }
+
+    int addSource(unsigned int numberOfChannels, unsigned int capacityFrames, PullCallback pull, unsigned int pullFrames) {
+        std::unique_lock lock(mtx);
+        // 多于混音通道数的输入需由调用者先下混；第一次打开前不限制，由open检查设备能否容纳
+        if (numberOfChannels == 0 || (channels && numberOfChannels > channels) || capacityFrames == 0)
+            return -1;
+        for (int id = 0; id < MAX_SOURCES; ++id)
+        {
+            Source& s = sources[id];
+            int expected = Free;
+            if (!s.state.compare_exchange_strong(expected, Reserved))
+                continue;
+            s.channels = numberOfChannels;
+            s.capacity = std::bit_ceil(static_cast<uint64_t>(capacityFrames));
+            s.mask = s.capacity - 1;
+            s.ring.assign(static_cast<size_t>(s.capacity) * numberOfChannels, 0.0f);
+            s.writePos.store(0);
+            s.readPos.store(0);
+            s.pull = std::move(pull);
+            s.pullFrames = pullFrames;
+            s.pullBuffer.assign(static_cast<size_t>(pullFrames) * numberOfChannels, 0.0f);
+            s.gain.store(1.0f);
+            s.currentGain = 1.0f;
+            s.underflowPending = false;
+            s.pulling.store(false);
+            s.flushRequested.store(false);
+            s.framesMixed.store(0);
+            s.underruns.store(0);
+            s.state.store(Active, std::memory_order_release);
+            return id;
+        }
+        return -1;
+    }
+
+    static uint64_t writeRing(Source& s, const float* samples, uint64_t frames) {
+        if (!samples)
+            return 0;
+        const uint64_t w = s.writePos.load(std::memory_order_relaxed);
+        const uint64_t r = s.readPos.load(std::memory_order_acquire);
+        const uint64_t count = std::min(frames, s.capacity - (w - r));
+        if (count == 0)
+            return 0;
+        const unsigned int ch = s.channels;
+        const uint64_t index = w & s.mask;
+        const uint64_t first = std::min(count, s.capacity - index);
+        std::copy_n(samples, first * ch, s.ring.data() + index * ch);
+        std::copy_n(samples + first * ch, (count - first) * ch, s.ring.data());
+        s.writePos.store(w + count, std::memory_order_release);
+        return count;
+    }
+
+    // 设备回调：清零输出后逐路累加，最后软限幅
+    AudioAdapter::AudioCallbackResult render(float* out, unsigned int nFrames, AudioAdapter::AudioStreamStatuses status) {
+        if (!out || nFrames == 0)
+            return AudioAdapter::Continue;
+        const size_t count = static_cast<size_t>(nFrames) * channels;
+        std::fill_n(out, count, 0.0f);
+        const bool deviceUnderflow = status.testFlag(AudioAdapter::OutputUnderflow);
+        for (auto& s : sources)
+        {
+            s.busy.store(true);
+            if (s.state.load() == Active)
+                mixSource(s, out, nFrames, deviceUnderflow);
+            s.busy.store(false);
+        }
+        if (limiterEnabled.load(std::memory_order_relaxed))
+        {
+            const uint64_t limited = softLimit(out, count, limiterKnee.load(std::memory_order_relaxed));
+            if (limited)
+                limitedSamples.fetch_add(limited, std::memory_order_relaxed);
+        }
+        callbacks.fetch_add(1, std::memory_order_relaxed);
+        return AudioAdapter::Continue;
+    }
+
+    // 缓冲的数据不足时先调用拉取回调，再按环形缓冲区的连续段直接累加，不经过中间缓冲区
+    void mixSource(Source& s, float* out, unsigned int nFrames, bool deviceUnderflow) {
+        if (s.flushRequested.exchange(false))
+            s.readPos.store(s.writePos.load(std::memory_order_acquire), std::memory_order_release);
+        const float target = s.gain.load(std::memory_order_relaxed);
+        const float step = (target - s.currentGain) / nFrames;
+        float g = s.currentGain;
+        const unsigned int ch = s.channels;
+        unsigned int mixed = 0;
+        while (mixed < nFrames)
+        {
+            const uint64_t available = s.readableFrames();
+            if (available < nFrames - mixed && s.pull && s.pulling.load(std::memory_order_acquire) && s.writableFrames() >= s.pullFrames)
+            {
+                pullSource(s, deviceUnderflow);
+                deviceUnderflow = false;
+                continue;
+            }
+            const uint64_t n = std::min<uint64_t>(available, nFrames - mixed);
+            if (n == 0)
+                break;
+            const uint64_t r = s.readPos.load(std::memory_order_relaxed);
+            const uint64_t index = r & s.mask;
+            const uint64_t first = std::min(n, s.capacity - index);
+            accumulate(out + static_cast<size_t>(mixed) * channels, s.ring.data() + index * ch, static_cast<unsigned int>(first), channels, ch, g, step);
+            g += step * first;
+            if (n > first)
+            {
+                accumulate(out + static_cast<size_t>(mixed + first) * channels, s.ring.data(), static_cast<unsigned int>(n - first), channels, ch, g, step);
+                g += step * (n - first);
+            }
+            s.readPos.store(r + n, std::memory_order_release);
+            mixed += static_cast<unsigned int>(n);
+        }
+        s.currentGain = target;
+        if (mixed < nFrames && s.pull && s.pulling.load(std::memory_order_relaxed))
+        {
+            s.underruns.fetch_add(1, std::memory_order_relaxed);
+            s.underflowPending = true;
+        }
+        s.framesMixed.fetch_add(mixed, std::memory_order_relaxed);
+    }
+
+    void pullSource(Source& s, bool deviceUnderflow) {
+        AudioAdapter::AudioStreamStatuses status{ AudioAdapter::AudioStreamStatus{ 0 } };
+        if (deviceUnderflow || s.underflowPending)
+            status = AudioAdapter::OutputUnderflow;
+        s.underflowPending = false;
+        const AudioAdapter::AudioCallbackResult result = s.pull(s.pullBuffer.data(), s.pullFrames, status);
+        if (result == AudioAdapter::Abort)
+        {
+            s.pulling.store(false);
+            s.readPos.store(s.writePos.load(std::memory_order_relaxed), std::memory_order_release);
+            return;
+        }
+        writeRing(s, s.pullBuffer.data(), s.pullFrames);
+        if (result != AudioAdapter::Continue)
+            s.pulling.store(false);
+    }
+
+    // 按帧线性过渡增益并累加，单声道输入复制到所有通道，其余按通道顺序对应
+    // 增益不变且声道数相同时是一个连续的乘加循环；增益过渡时先按块算出每帧的增益，单声道与立体声输入到立体声的情况单独展开，
+    // 使按帧的循环不含变长的内层循环。GCC 12在-O3下能向量化这些按帧的循环，而qmake默认的-O2只启用最保守的向量化，这些循环在-O2下仍是标量代码；
+    // 其他声道组合仍在每帧内按通道累加，只有内层的通道循环可能被向量化，声道数少时基本是标量运算
+    static void accumulate(float* __restrict dst, const float* __restrict src, unsigned int frames, unsigned int dstChannels, unsigned int srcChannels, float gain, float step) {
+        constexpr unsigned int RAMP_BLOCK_FRAMES = 256;
+        float gains[RAMP_BLOCK_FRAMES];
+        for (unsigned int begin = 0; begin < frames; begin += RAMP_BLOCK_FRAMES)
+        {
+            const unsigned int n = std::min(frames - begin, RAMP_BLOCK_FRAMES);
+            float* __restrict d = dst + static_cast<size_t>(begin) * dstChannels;
+            const float* __restrict x = src + static_cast<size_t>(begin) * srcChannels;
+            const float g0 = gain + step * begin;
+            if (step == 0.0f && srcChannels == dstChannels)
+            {
+                const size_t count = static_cast<size_t>(n) * dstChannels;
+                for (size_t i = 0; i < count; ++i)
+                    d[i] += x[i] * g0;
+                continue;
+            }
+            for (unsigned int f = 0; f < n; ++f)
+                gains[f] = g0 + step * f;
+            if (srcChannels == 1 && dstChannels == 2)
+                for (unsigned int f = 0; f < n; ++f)
+                {
+                    const float v = x[f] * gains[f];
+                    d[2 * f] += v;
+                    d[2 * f + 1] += v;
+                }
+            else if (srcChannels == 2 && dstChannels == 2)
+                for (unsigned int f = 0; f < n; ++f)
+                {
+                    d[2 * f] += x[2 * f] * gains[f];
+                    d[2 * f + 1] += x[2 * f + 1] * gains[f];
+                }
+            else if (srcChannels == 1)
+                for (unsigned int f = 0; f < n; ++f)
+                    for (unsigned int c = 0; c < dstChannels; ++c)
+                        d[static_cast<size_t>(f) * dstChannels + c] += x[f] * gains[f];
+            else
+                for (unsigned int f = 0; f < n; ++f)
+                    for (unsigned int c = 0; c < srcChannels; ++c)
+                        d[static_cast<size_t>(f) * dstChannels + c] += x[static_cast<size_t>(f) * srcChannels + c] * gains[f];
+        }
+    }
+
+    // 无状态的软限幅：绝对值超过knee的部分按tanh曲线压缩，输出不超过满幅，返回被压缩的样本数
+    static uint64_t softLimit(float* __restrict buffer, size_t count, float knee) {
+        const float range = 1.0f - knee;
+        uint64_t limited = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            const float a = std::abs(buffer[i]);
+            if (a <= knee)
+                continue;
+            buffer[i] = std::copysign(range > 0.0f ? knee + range * std::tanh((a - knee) / range) : knee, buffer[i]);
+            ++limited;
+        }
+        return limited;
+    }
+};
+
+
+// 混音器中一路拉取型输入的适配器，AudioPlayer等使用者按普通设备打开，回调由混音器的设备回调驱动
+// 只有一个设备，采样率与通道上限跟随混音器，样本格式只支持float
+// 设备错误由混音器的所有者处理，不转发到此适配器的错误回调
+class MixerAudioAdapter : public AudioAdapter
+{
+public:
+    struct MixerCallbackArgs {
+        float* outputBuffer;
+        unsigned int nFrames;
+        double streamTime;
+        int sourceId;
+    };
+
+    static constexpr unsigned int DEVICE_ID = 0;
+
+private:
+    std::shared_ptr<AudioMixer> mixer;
+    mutable std::mutex mtx; // 保护流的打开/关闭，回调中不加锁
+    AudioErrorCallback errorCallback{ nullptr };
+    bool showWarnings{ true };
+    std::string lastErrorText;
+
+    int sourceId{ -1 };
+    unsigned int streamSampleRate{ 0 };
+    unsigned int streamBufferFrames{ 0 };
+    AudioCallbackFunction callback{ nullptr };
+    std::any userData;
+    std::atomic<uint64_t> framesProcessed{ 0 };
+    std::atomic<double> streamTimeOffset{ 0.0 };
+
+public:
+    explicit MixerAudioAdapter(std::shared_ptr<AudioMixer> mixer, AudioErrorCallback errorCallback = 0)
+        : mixer(std::move(mixer)), errorCallback(errorCallback) {}
+    ~MixerAudioAdapter() {
+        closeStream();
+    }
+
+    // 混音器中的输入编号，未打开流时为-1
+    int getSourceId() const {
+        std::unique_lock lock(mtx);
+        return sourceId;
+    }
+    void setGain(float gain) {
+        std::unique_lock lock(mtx);
+        if (mixer)
+            mixer->setGain(sourceId, gain);
+    }
+
+
+    // 重写 AudioAdapter 的纯虚函数
+    virtual unsigned int getDeviceCount() override {
+        return (mixer && mixer->isOpen()) ? 1 : 0;
+    }
+
+    virtual AudioDeviceInfo getDeviceInfo(unsigned int deviceId) override {
+        AudioDeviceInfo info;
+        if (deviceId != DEVICE_ID || !mixer || !mixer->isOpen())
+            return info;
+        info.ID = DEVICE_ID;
+        info.name = "Software Mixer (" + mixer->getDeviceName() + ")";
+        info.outputChannels = mixer->getNumberOfChannels();
+        info.isDefaultOutput = true;
+        info.sampleRates = { mixer->getSampleRate() };
+        info.currentSampleRate = mixer->getSampleRate();
+        info.preferredSampleRate = mixer->getSampleRate();
+        info.nativeFormats = AFFloat32;
+        return info;
+    }
+
+    virtual unsigned int getDefaultOutputDevice() override {
+        return DEVICE_ID;
+    }
+
+    virtual AudioErrorType openStream(AudioStreamParameters* outputParameters,
+        AudioStreamParameters* inputParameters,
+        AudioFormats format, unsigned int sampleRate,
+        unsigned int* bufferFrames, AudioCallbackFunction callback,
+        std::any userData = 0, AudioStreamOptions* options = 0) override {
+        std::unique_lock lock(mtx);
+        if (sourceId >= 0)
+            return error(InvalidUse, "A stream is already open.");
+        if (!mixer || !mixer->isOpen())
+            return error(NoDevicesFound, "The mixer is not open.");
+        if (inputParameters)
+            return error(InvalidParameter, "The mixer has no input.");
+        if (!outputParameters || outputParameters->deviceId != DEVICE_ID)
+            return error(InvalidDevice, "Invalid output device.");
+        if (outputParameters->nChannels == 0 || outputParameters->firstChannel != 0 || outputParameters->nChannels > mixer->getNumberOfChannels())
+            return error(InvalidParameter, "Invalid number of output channels.");
+        if (format != AFFloat32 || sampleRate != mixer->getSampleRate() || !callback)
+            return error(InvalidParameter, "The mixer only accepts float samples at its own sample rate.");
+        // 回调帧数与混音器无关，由环形缓冲区衔接
+        const unsigned int frames = (bufferFrames && *bufferFrames) ? *bufferFrames : mixer->getBufferFrames();
+        this->callback = callback;
+        this->userData = userData;
+        streamSampleRate = sampleRate;
+        streamBufferFrames = frames;
+        framesProcessed.store(0);
+        streamTimeOffset.store(0.0);
+        const int id = mixer->addPullSource(outputParameters->nChannels, frames,
+            [this](float* output, unsigned int nFrames, AudioStreamStatuses status) -> AudioCallbackResult {
+                return pull(output, nFrames, status);
+            });
+        if (id < 0)
+        {
+            this->callback = nullptr;
+            this->userData.reset();
+            return error(MemoryError, "No free mixer source.");
+        }
+        sourceId = id;
+        if (bufferFrames)
+            *bufferFrames = frames;
+        return NoError;
+    }
+
+
+    virtual void closeStream() override {
+        std::unique_lock lock(mtx);
+        if (sourceId < 0)
+            return;
+        mixer->removeSource(sourceId);
+        sourceId = -1;
+        callback = nullptr;
+        userData.reset();
+    }
+
+
+    virtual AudioErrorType startStream() override {
+        std::unique_lock lock(mtx);
+        if (sourceId < 0)
+            return error(Warning, "No stream is open.");
+        mixer->setSourcePulling(sourceId, true);
+        return NoError;
+    }
+
+
+    // 已缓冲的数据继续由混音器播放
+    virtual AudioErrorType stopStream() override {
+        std::unique_lock lock(mtx);
+        if (sourceId < 0)
+            return error(Warning, "No stream is open.");
+        mixer->setSourcePulling(sourceId, false);
+        return NoError;
+    }
+
+
+    virtual AudioErrorType abortStream() override {
+        std::unique_lock lock(mtx);
+        if (sourceId < 0)
+            return error(Warning, "No stream is open.");
+        mixer->setSourcePulling(sourceId, false);
+        mixer->flushSource(sourceId);
+        return NoError;
+    }
+
+
+    virtual const std::string getLastErrorText() override {
+        std::unique_lock lock(mtx);
+        return lastErrorText;
+    }
+
+
+    virtual bool isStreamOpen() const override {
+        std::unique_lock lock(mtx);
+        return sourceId >= 0;
+    }
+
+
+    virtual bool isStreamRunning() const override {
+        std::unique_lock lock(mtx);
+        return sourceId >= 0 && mixer->isSourcePulling(sourceId);
+    }
+
+
+    virtual double getStreamTime() override {
+        const unsigned int rate = streamSampleRate;
+        if (rate == 0)
+            return 0.0;
+        return streamTimeOffset.load() + static_cast<double>(framesProcessed.load()) / rate;
+    }
+
+
+    virtual void setStreamTime(double time) override {
+        const unsigned int rate = streamSampleRate;
+        if (time < 0.0 || rate == 0)
+            return;
+        streamTimeOffset.store(time - static_cast<double>(framesProcessed.load()) / rate);
+    }
+
+
+    // 设备延迟加上输入环形缓冲区平均缓冲的一次回调
+    virtual long getOutputStreamLatency() override {
+        std::unique_lock lock(mtx);
+        if (sourceId < 0)
+            return 0;
+        return mixer->getOutputLatency() + static_cast<long>(streamBufferFrames);
+    }
+
+    virtual long getInputStreamLatency() override {
+        return 0;
+    }
+
+
+    virtual unsigned int getStreamSampleRate() override {
+        std::unique_lock lock(mtx);
+        return sourceId >= 0 ? streamSampleRate : 0;
+    }
+
+
+    virtual void setErrorCallback(AudioErrorCallback errorCallback) override {
+        std::unique_lock lock(mtx);
+        this->errorCallback = errorCallback;
+    }
+
+
+    virtual void setShouldShowWarnings(bool value = true) override {
+        std::unique_lock lock(mtx);
+        showWarnings = value;
+    }
+
+private:
+    // 需持有mtx
+    AudioErrorType error(AudioErrorType type, const std::string& text) {
+        lastErrorText = text;
+        if (errorCallback && (type != Warning || showWarnings))
+            errorCallback(type, text);
+        return type;
+    }
+
+    // 混音器的设备回调中调用，callback与userData在输入移除前不会改变
+    AudioCallbackResult pull(float* output, unsigned int nFrames, AudioStreamStatuses status) {
+        MixerCallbackArgs args{ output, nFrames, getStreamTime(), sourceId };
+        const AudioCallbackResult result = callback(output, nullptr, nFrames, args.streamTime, status, &args, userData);
+        framesProcessed.fetch_add(nFrames, std::memory_order_relaxed);
+        return result;
+    }
+};
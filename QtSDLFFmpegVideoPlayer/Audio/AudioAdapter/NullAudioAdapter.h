@@ -0,0 +1,402 @@
+#pragma once
+#include "AudioAdapter.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+// 内置的空输出设备，不依赖声卡：由自身的定时线程驱动音频回调，模拟设备时钟
+// 输出数据丢弃或原样写入WAV文件，用于无声卡的CI、性能测试以及逐位比对输出
+// 可配置回调帧数、报告的延迟、时钟倍速以及周期性的下溢
+class NullAudioAdapter : public AudioAdapter
+{
+public:
+    struct Options {
+        std::string wavFilePath; // 为空时丢弃数据，否则每次打开流时覆盖写入该文件
+        double clockSpeed{ 1.0 }; // 模拟时钟相对实时的倍数，<=0表示不等待，尽快驱动回调
+        unsigned int sampleRate{ 48000 }; // 设备的首选采样率
+        unsigned int maxOutputChannels{ 8 };
+        AudioFormats nativeFormats{ AudioFormat{ AFSignedInt8 | AFSignedInt16 | AFSignedInt32 | AFFloat32 | AFFloat64 } };
+        unsigned int bufferFrames{ 0 }; // 设备的回调帧数，0表示使用打开流时请求的大小
+        long latencyFrames{ -1 }; // 报告的输出延迟，-1表示回调帧数乘以缓冲区个数
+        // 下溢模拟：每隔underrunIntervalCallbacks次回调，设备空转underrunFrames帧（WAV中为静音），下一次回调带OutputUnderflow标志，0表示不模拟
+        unsigned int underrunIntervalCallbacks{ 0 };
+        unsigned int underrunFrames{ 0 };
+    };
+
+    struct NullAudioCallbackArgs {
+        void* outputBuffer;
+        unsigned int nFrames;
+        double streamTime;
+        uint64_t callbackIndex; // 从0开始的回调序号
+    };
+
+    static constexpr unsigned int DEFAULT_BUFFER_FRAMES = 512;
+    static constexpr unsigned int DEFAULT_NUMBER_OF_BUFFERS = 2;
+    static constexpr unsigned int DEVICE_ID = 0;
+
+private:
+    mutable std::mutex mtx; // 保护options与流的打开/关闭，回调线程不加锁
+    Options options;
+    AudioErrorCallback errorCallback{ nullptr };
+    bool showWarnings{ true };
+    std::string lastErrorText;
+
+    // 流参数
+    bool streamOpen{ false };
+    unsigned int streamSampleRate{ 0 };
+    unsigned int streamChannels{ 0 };
+    unsigned int streamBufferFrames{ 0 };
+    unsigned int streamNumberOfBuffers{ DEFAULT_NUMBER_OF_BUFFERS };
+    AudioFormat streamFormat{ AFFloat32 };
+    unsigned int bytesPerSample{ 4 };
+    AudioCallbackFunction callback{ nullptr };
+    std::any userData;
+    std::vector<uint8_t> buffer;
+    std::vector<uint8_t> silence;
+
+    // 回调线程
+    std::thread worker;
+    std::atomic<bool> running{ false };
+    std::atomic<bool> stopRequested{ false };
+    std::atomic<uint64_t> framesProcessed{ 0 };
+    std::atomic<double> streamTimeOffset{ 0.0 };
+
+    // WAV输出
+    std::FILE* wavFile{ nullptr };
+    uint64_t wavDataBytes{ 0 };
+    std::vector<uint8_t> wavConvertBuffer; // 有符号8位样本转为WAV的无符号8位
+
+public:
+    NullAudioAdapter(AudioApi api = AudioApi::Dummy, AudioErrorCallback errorCallback = 0)
+        : errorCallback(errorCallback) {}
+    ~NullAudioAdapter() {
+        closeStream();
+    }
+
+    static NullAudioAdapter* create(AudioApi api, AudioErrorCallback errorCallback)
+    {
+        return new NullAudioAdapter(api, errorCallback);
+    }
+
+    // 设置设备参数，下次打开流时生效
+    void setOptions(const Options& options) {
+        std::unique_lock lock(mtx);
+        this->options = options;
+    }
+    Options getOptions() const {
+        std::unique_lock lock(mtx);
+        return options;
+    }
+    // 已回调的帧数（不含模拟下溢的空转），即写入WAV的有效数据长度
+    uint64_t getFramesProcessed() const {
+        return framesProcessed.load();
+    }
+
+    static constexpr unsigned int audioFormatBytes(AudioFormat format) {
+        switch (format)
+        {
+        case AFSignedInt8:
+            return 1;
+        case AFSignedInt16:
+            return 2;
+        case AFSignedInt24:
+            return 3;
+        case AFSignedInt32:
+        case AFFloat32:
+            return 4;
+        case AFFloat64:
+            return 8;
+        default:
+            return 0;
+        }
+    }
+
+
+    // 重写 AudioAdapter 的纯虚函数
+    virtual unsigned int getDeviceCount() override {
+        return 1;
+    }
+
+    virtual AudioDeviceInfo getDeviceInfo(unsigned int deviceId) override {
+        AudioDeviceInfo info;
+        if (deviceId != DEVICE_ID)
+            return info;
+        std::unique_lock lock(mtx);
+        info.ID = DEVICE_ID;
+        info.name = options.wavFilePath.empty() ? "Null Audio Output" : "WAV File Output (" + options.wavFilePath + ")";
+        info.outputChannels = options.maxOutputChannels;
+        info.isDefaultOutput = true;
+        info.sampleRates = { 8000, 11025, 16000, 22050, 32000, 44100, 48000, 88200, 96000, 176400, 192000 };
+        info.currentSampleRate = options.sampleRate;
+        info.preferredSampleRate = options.sampleRate;
+        info.nativeFormats = options.nativeFormats;
+        return info;
+    }
+
+    virtual unsigned int getDefaultOutputDevice() override {
+        return DEVICE_ID;
+    }
+
+    virtual AudioErrorType openStream(AudioStreamParameters* outputParameters,
+        AudioStreamParameters* inputParameters,
+        AudioFormats format, unsigned int sampleRate,
+        unsigned int* bufferFrames, AudioCallbackFunction callback,
+        std::any userData = 0, AudioStreamOptions* options = 0) override {
+        std::unique_lock lock(mtx);
+        if (streamOpen)
+            return error(InvalidUse, "A stream is already open.");
+        if (inputParameters)
+            return error(InvalidParameter, "The null audio device has no input.");
+        if (!outputParameters || outputParameters->deviceId != DEVICE_ID)
+            return error(InvalidDevice, "Invalid output device.");
+        if (outputParameters->nChannels == 0 || outputParameters->firstChannel + outputParameters->nChannels > this->options.maxOutputChannels)
+            return error(InvalidParameter, "Invalid number of output channels.");
+        const unsigned int sampleBytes = audioFormatBytes(format);
+        if (sampleRate == 0 || sampleBytes == 0 || !callback)
+            return error(InvalidParameter, "Invalid sample rate, format or callback.");
+        // 回调帧数由设备决定，通过bufferFrames返回
+        unsigned int frames = this->options.bufferFrames;
+        if (frames == 0)
+            frames = (bufferFrames && *bufferFrames) ? *bufferFrames : DEFAULT_BUFFER_FRAMES;
+        if (bufferFrames)
+            *bufferFrames = frames;
+        streamNumberOfBuffers = (options && options->numberOfBuffers) ? options->numberOfBuffers : DEFAULT_NUMBER_OF_BUFFERS;
+        if (options)
+            options->numberOfBuffers = streamNumberOfBuffers;
+        streamSampleRate = sampleRate;
+        streamChannels = outputParameters->nChannels;
+        streamBufferFrames = frames;
+        streamFormat = format;
+        bytesPerSample = sampleBytes;
+        this->callback = callback;
+        this->userData = userData;
+        buffer.assign(static_cast<size_t>(frames) * streamChannels * bytesPerSample, 0);
+        silence.assign(static_cast<size_t>(std::max(frames, this->options.underrunFrames)) * streamChannels * bytesPerSample, 0); // 设备格式均为有符号或浮点，静音为0
+        wavConvertBuffer.assign(streamFormat == AFSignedInt8 ? silence.size() : 0, 0);
+        framesProcessed.store(0);
+        streamTimeOffset.store(0.0);
+        if (!this->options.wavFilePath.empty() && !openWavFile(this->options.wavFilePath))
+            return error(SystemError, "Cannot open WAV file: " + this->options.wavFilePath);
+        streamOpen = true;
+        return NoError;
+    }
+
+
+    virtual void closeStream() override {
+        abortStream();
+        std::unique_lock lock(mtx);
+        if (!streamOpen)
+            return;
+        closeWavFile();
+        callback = nullptr;
+        userData.reset();
+        streamOpen = false;
+    }
+
+
+    virtual AudioErrorType startStream() override {
+        std::unique_lock lock(mtx);
+        if (!streamOpen)
+            return error(Warning, "No stream is open.");
+        if (running.load())
+            return error(Warning, "The stream is already running.");
+        if (worker.joinable()) // 回调返回Complete/Abort后线程已自行结束
+            worker.join();
+        stopRequested.store(false);
+        running.store(true);
+        worker = std::thread(&NullAudioAdapter::run, this, options);
+        return NoError;
+    }
+
+
+    // 模拟设备没有排队的数据，停止与中止相同
+    virtual AudioErrorType stopStream() override {
+        return abortStream();
+    }
+
+
+    virtual AudioErrorType abortStream() override {
+        stopRequested.store(true);
+        if (worker.joinable())
+        {
+            if (worker.get_id() == std::this_thread::get_id()) // 在回调中调用，线程随后自行结束
+                return NoError;
+            worker.join();
+        }
+        running.store(false);
+        return NoError;
+    }
+
+
+    virtual const std::string getLastErrorText() override {
+        std::unique_lock lock(mtx);
+        return lastErrorText;
+    }
+
+
+    virtual bool isStreamOpen() const override {
+        std::unique_lock lock(mtx);
+        return streamOpen;
+    }
+
+
+    virtual bool isStreamRunning() const override {
+        return running.load();
+    }
+
+
+    virtual double getStreamTime() override {
+        const unsigned int rate = streamSampleRate;
+        if (rate == 0)
+            return 0.0;
+        return streamTimeOffset.load() + static_cast<double>(framesProcessed.load()) / rate;
+    }
+
+
+    virtual void setStreamTime(double time) override {
+        const unsigned int rate = streamSampleRate;
+        if (time < 0.0 || rate == 0)
+            return;
+        streamTimeOffset.store(time - static_cast<double>(framesProcessed.load()) / rate);
+    }
+
+
+    virtual long getOutputStreamLatency() override {
+        std::unique_lock lock(mtx);
+        if (!streamOpen)
+            return 0;
+        if (options.latencyFrames >= 0)
+            return options.latencyFrames;
+        return static_cast<long>(streamBufferFrames) * streamNumberOfBuffers;
+    }
+
+    virtual long getInputStreamLatency() override {
+        return 0;
+    }
+
+
+    virtual unsigned int getStreamSampleRate() override {
+        std::unique_lock lock(mtx);
+        return streamOpen ? streamSampleRate : 0;
+    }
+
+
+    virtual void setErrorCallback(AudioErrorCallback errorCallback) override {
+        std::unique_lock lock(mtx);
+        this->errorCallback = errorCallback;
+    }
+
+
+    virtual void setShouldShowWarnings(bool value = true) override {
+        std::unique_lock lock(mtx);
+        showWarnings = value;
+    }
+
+private:
+    // 需持有mtx
+    AudioErrorType error(AudioErrorType type, const std::string& text) {
+        lastErrorText = text;
+        if (errorCallback && (type != Warning || showWarnings))
+            errorCallback(type, text);
+        return type;
+    }
+
+    // 模拟设备的回调线程，按模拟时钟的期限依次调用回调
+    void run(Options opts) {
+        using Clock = std::chrono::steady_clock;
+        const Clock::time_point start = Clock::now();
+        const double speed = opts.clockSpeed;
+        uint64_t deviceFrames = 0; // 设备时钟经过的帧数，包含下溢空转
+        uint64_t callbackIndex = 0;
+        AudioStreamStatuses status{ AudioStreamStatus{ 0 } };
+        AudioCallbackResult result = Continue;
+        while (!stopRequested.load() && result == Continue)
+        {
+            NullAudioCallbackArgs args{ buffer.data(), streamBufferFrames, getStreamTime(), callbackIndex };
+            result = callback(buffer.data(), nullptr, streamBufferFrames, args.streamTime, status, args, userData);
+            if (result == Abort)
+                break;
+            status = AudioStreamStatus{ 0 };
+            writeWavData(buffer.data(), streamBufferFrames);
+            framesProcessed.fetch_add(streamBufferFrames);
+            deviceFrames += streamBufferFrames;
+            ++callbackIndex;
+            if (result == Continue && opts.underrunIntervalCallbacks && opts.underrunFrames && callbackIndex % opts.underrunIntervalCallbacks == 0)
+            {
+                writeWavData(silence.data(), opts.underrunFrames);
+                deviceFrames += opts.underrunFrames;
+                status = AudioStreamStatus::OutputUnderflow;
+            }
+            // 按模拟时钟等待下一次回调的期限
+            if (speed > 0.0)
+            {
+                const auto deadline = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(deviceFrames / (streamSampleRate * speed)));
+                std::this_thread::sleep_until(deadline);
+            }
+        }
+        running.store(false);
+    }
+
+    bool openWavFile(const std::string& filePath) {
+        closeWavFile();
+        wavFile = std::fopen(filePath.c_str(), "wb");
+        if (!wavFile)
+            return false;
+        wavDataBytes = 0;
+        writeWavHeader();
+        return true;
+    }
+    void closeWavFile() {
+        if (!wavFile)
+            return;
+        // 回填RIFF与data块的长度
+        std::fseek(wavFile, 0, SEEK_SET);
+        writeWavHeader();
+        std::fclose(wavFile);
+        wavFile = nullptr;
+    }
+    void writeWavData(const uint8_t* data, unsigned int frames) {
+        if (!wavFile)
+            return;
+        const size_t bytes = static_cast<size_t>(frames) * streamChannels * bytesPerSample;
+        if (streamFormat == AFSignedInt8)
+        {
+            // WAV的8位PCM为无符号（静音为0x80），翻转符号位
+            for (size_t i = 0; i < bytes; ++i)
+                wavConvertBuffer[i] = data[i] ^ 0x80;
+            data = wavConvertBuffer.data();
+        }
+        wavDataBytes += std::fwrite(data, 1, bytes, wavFile);
+    }
+    // WAVE_FORMAT_EXTENSIBLE头，整数为PCM，浮点为IEEE float，样本按设备格式原样写入，只有8位转为WAV规定的无符号
+    void writeWavHeader() {
+        auto u16 = [this](uint16_t v) { uint8_t b[2]{ uint8_t(v), uint8_t(v >> 8) }; std::fwrite(b, 1, 2, wavFile); };
+        auto u32 = [this](uint32_t v) { uint8_t b[4]{ uint8_t(v), uint8_t(v >> 8), uint8_t(v >> 16), uint8_t(v >> 24) }; std::fwrite(b, 1, 4, wavFile); };
+        const bool isFloat = streamFormat == AFFloat32 || streamFormat == AFFloat64;
+        const uint32_t dataBytes = static_cast<uint32_t>(std::min<uint64_t>(wavDataBytes, UINT32_MAX - 60));
+        const uint16_t blockAlign = static_cast<uint16_t>(streamChannels * bytesPerSample);
+        std::fwrite("RIFF", 1, 4, wavFile);
+        u32(60 + dataBytes); // 文件长度减8，头部共68字节
+        std::fwrite("WAVE", 1, 4, wavFile);
+        std::fwrite("fmt ", 1, 4, wavFile);
+        u32(40);
+        u16(0xFFFE); // WAVE_FORMAT_EXTENSIBLE
+        u16(static_cast<uint16_t>(streamChannels));
+        u32(streamSampleRate);
+        u32(streamSampleRate * blockAlign);
+        u16(blockAlign);
+        u16(static_cast<uint16_t>(bytesPerSample * 8));
+        u16(22); // cbSize
+        u16(static_cast<uint16_t>(bytesPerSample * 8)); // wValidBitsPerSample
+        u32(0); // dwChannelMask，未指定
+        // SubFormat GUID: xxxxxxxx-0000-0010-8000-00aa00389b71
+        static constexpr uint8_t guidTail[14]{ 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71 };
+        u16(isFloat ? 3 : 1);
+        std::fwrite(guidTail, 1, sizeof(guidTail), wavFile);
+        std::fwrite("data", 1, 4, wavFile);
+        u32(dataBytes);
+    }
+};
@@ -2,12 +2,16 @@
 #include "AudioAdapter.h"
 
 #include <portaudio.h>
+#include <algorithm>
+#include <cmath>
 #include <string>
 
 class PortAudioAdapter : public AudioAdapter
 {
 private:
     std::unique_ptr<PaStream, decltype(&Pa_CloseStream)> audioStream{ nullptr, &Pa_CloseStream };
+    // Pa_GetStreamTime是与流启动无关的时钟，减去该偏移后才是自启动以来的时间
+    std::atomic<double> streamTimeOffset{ 0.0 };
 public:
     struct PaStreamCallbackArgs{
         const void* input;
@@ -165,7 +169,7 @@ public:
             PaStreamParameters p{};
             p.device = dId;
             p.channelCount = paInfo->maxOutputChannels;
-            p.sampleFormat = AudioFormatList[i];
+            p.sampleFormat = audioFormatToPaSampleFormat(AudioFormatList[i]);
             p.suggestedLatency = paInfo->defaultLowOutputLatency;
             PaError err = Pa_IsFormatSupported(0, &p, paInfo->defaultSampleRate);
             if (err == paFormatIsSupported)
@@ -224,7 +228,7 @@ public:
                     statusFlags,
                     userData
                 };
-                auto rst = p->callback(output, const_cast<void*>(input), frameCount, timeInfo->currentTime, paStreamCallbackFlagsToAudioStreamStatuses(statusFlags), args, userData);
+                auto rst = p->callback(output, const_cast<void*>(input), frameCount, std::max(timeInfo->currentTime - p->self->streamTimeOffset.load(), 0.0), paStreamCallbackFlagsToAudioStreamStatuses(statusFlags), args, userData);
                 if (rst != Continue)
                     delete userData;
                 return audioCallbackResultToPaStreamCallbackResult(rst);
@@ -249,6 +253,7 @@ public:
     virtual AudioErrorType startStream() override {
         if (!audioStream)
             return AudioErrorType::MemoryError;
+        streamTimeOffset.store(Pa_GetStreamTime(audioStream.get())); // 先于回调设置
         return paErrorToAudioErrorType(Pa_StartStream(audioStream.get()));
     }
 
@@ -290,33 +295,37 @@ public:
     virtual double getStreamTime() override {
         if (!audioStream)
             return 0.0;
-        return Pa_GetStreamTime(audioStream.get());
+        return std::max(Pa_GetStreamTime(audioStream.get()) - streamTimeOffset.load(), 0.0);
     }
 
 
     virtual void setStreamTime(double time) override {
-        if (!audioStream)
+        if (!audioStream || time < 0.0)
             return;
-        throw std::runtime_error("PortAudioAdapter::setStreamTime not implemented.");
+        streamTimeOffset.store(Pa_GetStreamTime(audioStream.get()) - time);
     }
 
 
+    // PortAudio报告的延迟单位为秒，按流的实际采样率换算为帧
     virtual long getOutputStreamLatency() override {
         if (!audioStream)
             return 0;
-        return Pa_GetStreamInfo(audioStream.get())->outputLatency;
+        auto info = Pa_GetStreamInfo(audioStream.get());
+        return info ? std::lround(info->outputLatency * info->sampleRate) : 0;
     }
     virtual long getInputStreamLatency() override {
         if (!audioStream)
             return 0;
-        return Pa_GetStreamInfo(audioStream.get())->inputLatency;
+        auto info = Pa_GetStreamInfo(audioStream.get());
+        return info ? std::lround(info->inputLatency * info->sampleRate) : 0;
     }
 
 
     virtual unsigned int getStreamSampleRate() override {
         if (!audioStream)
             return 0;
-        return Pa_GetStreamInfo(audioStream.get())->sampleRate;
+        auto info = Pa_GetStreamInfo(audioStream.get());
+        return info ? static_cast<unsigned int>(info->sampleRate) : 0;
     }
 
 
@@ -148,6 +148,15 @@ public:
         }
         return audioFmt;
     }
+    // 设备支持的格式是位掩码，需要逐位转换
+    constexpr static AudioFormats rtAudioFormatsToAudioFormats(RtAudioFormat formats)
+    {
+        AudioFormats audioFmts{ AudioFormat{ 0 } };
+        for (auto fmt : AudioFormatList)
+            if (formats & audioFormatToRtAudioFormat(fmt))
+                audioFmts |= fmt;
+        return audioFmts;
+    }
     constexpr static RtAudioStreamFlags audioStreamFlagsToRtAudioStreamFlags(AudioStreamFlags f) {
         RtAudioStreamFlags rst = static_cast<RtAudioStreamFlags>(0);
         if (f & AudioAdapter::NonInterleaved)
@@ -302,7 +311,7 @@ public:
         info.sampleRates = rtInfo.sampleRates;
         info.currentSampleRate = rtInfo.currentSampleRate;
         info.preferredSampleRate = rtInfo.preferredSampleRate;
-        info.nativeFormats = rtAudioFormatToAudioFormat(rtInfo.nativeFormats);
+        info.nativeFormats = rtAudioFormatsToAudioFormats(rtInfo.nativeFormats);
         return info;
     }
 
@@ -1,5 +1,6 @@
 #include "AudioPlayer.h"
 #include <FrameProcessor.h>
+#include <LoudnessScanner.h>
 
 bool AudioPlayer::prepareBeforePlayback()
 {
@@ -24,6 +25,7 @@ bool AudioPlayer::prepareBeforePlayback()
         psv.formatCtx = psv.demuxer.load()->getFormatContext();
         psv.streamIndex = psv.demuxer.load()->getStreamIndex(psv.demuxerStreamType);
         psv.packetQueue = psv.demuxer.load()->getPacketQueue(psv.demuxerStreamType);
+        psv.durationInAvTimeBase.store(psv.formatCtx ? psv.formatCtx->duration : 0);
 
         if (requestTaskQueueHandlerMode == ComponentWorkMode::Internal)
         {
@@ -71,6 +73,12 @@ bool AudioPlayer::prepareBeforePlayback()
         resetPlayer();
         return false;
     }
+    // 按扫描结果设置响度归一化增益，没有结果时请求优先扫描
+    {
+        std::unique_lock lock(mtxLoudness);
+        loudnessTrackPath = playbackStateVariables.filePath;
+    }
+    applyLoudnessNormalization();
     // 打开音频设备
     if (!this->playbackStateVariables.codecCtx->frame_size)
         this->playbackStateVariables.codecCtx->frame_size = DEFAULT_AUDIO_OUTPUT_STREAM_BUFFER_SIZE;
@@ -112,6 +120,141 @@ bool AudioPlayer::playAudioFile()
     return true;
 }
 
+bool AudioPlayer::setNextFilePath(const std::string& filePath)
+{
+    if (demuxerMode != ComponentWorkMode::Internal)
+    {
+        logger.warning("Next track is only supported with the internal demuxer.");
+        return false;
+    }
+    auto& psv = playbackStateVariables;
+    std::unique_lock lock(psv.mtxTrackSwitch);
+    if (isStopped() || playerState == PlayerState::Stopping || playerState == PlayerState::Preparing)
+        return false;
+    psv.nextFilePath = filePath;
+    psv.trackTransitionPending.store(!filePath.empty());
+    // 取消或重新预加载需等待后台线程结束，不持有mtxTrackSwitch，解码线程切换曲目时不被打开文件阻塞
+    // 解码线程只取走与nextFilePath一致的结果；期间其他调用又修改了下一项时按最新的重新预加载
+    std::string preloadPath = filePath;
+    while (true)
+    {
+        lock.unlock();
+        if (preloadPath.empty())
+            trackPreloader.cancel();
+        else
+            preloadNextTrack(preloadPath);
+        lock.lock();
+        if (psv.nextFilePath == preloadPath)
+            break;
+        preloadPath = psv.nextFilePath;
+    }
+    lock.unlock();
+    // 当前曲目可能已经解码完毕，唤醒解码线程处理切换或输出暂存的尾部
+    psv.threadStateManager.wakeUpById(ThreadIdentifier::Decoder);
+    return true;
+}
+
+void AudioPlayer::preloadNextTrack(const std::string& filePath)
+{
+    double seconds = TRACK_PRELOAD_DECODE_SECONDS;
+    if (trackTransitionMode.load() == TrackTransitionMode::Crossfade)
+        seconds += crossfadeSeconds.load();
+    trackPreloader.preload(filePath, playbackStateVariables.playOptions.streamIndexSelector, seconds);
+}
+
+void AudioPlayer::setLoudnessScanner(LoudnessScanner* scanner)
+{
+    // 添加与移除监听器时不持有mtxLoudness，避免与扫描线程中的回调互相等待
+    LoudnessScanner* oldScanner = nullptr;
+    size_t oldListenerId = 0;
+    {
+        std::unique_lock lock(mtxLoudness);
+        oldScanner = loudnessScanner;
+        oldListenerId = loudnessListenerId;
+        loudnessScanner = nullptr;
+        loudnessListenerId = 0;
+    }
+    if (oldScanner && oldListenerId)
+        oldScanner->removeListener(oldListenerId);
+    if (scanner)
+    {
+        size_t id = scanner->addListener([this](const LoudnessScanner::TrackLoudness& track) {
+            std::unique_lock lock(mtxLoudness);
+            if (loudnessTrackPath.empty() || loudnessOptions.mode == LoudnessNormalizationMode::Off)
+                return;
+            // 专辑模式下同一目录中任一曲目的结果都可能使专辑扫描完成
+            const bool affected = loudnessOptions.mode == LoudnessNormalizationMode::Album
+                ? std::filesystem::path(track.path).parent_path() == std::filesystem::path(loudnessTrackPath).parent_path()
+                : track.path == loudnessTrackPath;
+            lock.unlock();
+            if (affected)
+                applyLoudnessNormalization();
+            });
+        std::unique_lock lock(mtxLoudness);
+        loudnessScanner = scanner;
+        loudnessListenerId = id;
+    }
+    applyLoudnessNormalization();
+}
+
+void AudioPlayer::setLoudnessNormalization(const LoudnessNormalizationOptions& options)
+{
+    {
+        std::unique_lock lock(mtxLoudness);
+        loudnessOptions = options;
+    }
+    applyLoudnessNormalization();
+}
+
+void AudioPlayer::applyLoudnessNormalization(double transitionSeconds)
+{
+    LoudnessScanner* scanner = nullptr;
+    LoudnessNormalizationOptions options;
+    std::string path;
+    {
+        std::unique_lock lock(mtxLoudness);
+        scanner = loudnessScanner;
+        options = loudnessOptions;
+        path = loudnessTrackPath;
+    }
+    double gain = 1.0;
+    bool found = false;
+    if (scanner && options.mode != LoudnessNormalizationMode::Off && !path.empty())
+    {
+        double loudness = 0.0;
+        double peak = 0.0;
+        LoudnessScanner::TrackLoudness track;
+        const bool cached = scanner->lookup(path, track);
+        // 专辑响度只在目录中的曲目全部扫描完成后使用，此前用单曲响度，避免增益随其余曲目的结果反复变化
+        LoudnessScanner::AlbumLoudness album;
+        const bool albumReady = options.mode == LoudnessNormalizationMode::Album && scanner->lookupAlbum(path, album) && album.complete;
+        if (!cached || (options.mode == LoudnessNormalizationMode::Album && !album.complete))
+            scanner->prioritize(path);
+        if (albumReady)
+        {
+            loudness = album.integratedLufs;
+            peak = album.truePeak;
+            found = true;
+        }
+        else if (cached && track.valid)
+        {
+            loudness = track.integratedLufs;
+            peak = track.truePeak;
+            found = true;
+        }
+        if (found)
+        {
+            const double gainDb = std::min(options.targetLufs - loudness + options.preAmpDb, options.maxGainDb);
+            gain = std::pow(10.0, gainDb / 20.0);
+            if (options.preventClipping && peak > 0.0)
+                gain = std::min(gain, audioDsp.getLimiterThreshold() / peak);
+            logger.info("Loudness normalization: {} LUFS, peak {}, gain {} dB", loudness, peak, 20.0 * std::log10(gain));
+        }
+    }
+    audioDsp.setNormalizationGain(gain, transitionSeconds);
+    audioDsp.setLimiterEnabled(found && options.limiter);
+}
+
 void AudioPlayer::cleanupAfterPlayback()
 {
     // 关闭音频输出流
@@ -125,6 +268,233 @@ void AudioPlayer::cleanupAfterPlayback()
 void AudioPlayer::audioOutputStreamErrorCallback(AudioAdapter::AudioErrorType type, const std::string& errorText)
 {
     logger.error("AudioAdapter Error ({}): {}", static_cast<int>(type), errorText.c_str());
+    // 可能在后端的线程中调用，不能在这里关闭输出流，交给伴随线程重新打开
+    if (type == AudioAdapter::DeviceDisconnect)
+        requestOutputReconnect(OutputReconnectReason::DeviceDisconnected);
+}
+
+void AudioPlayer::requestOutputReconnect(OutputReconnectReason reason)
+{
+    if (shouldStop() || playerState == PlayerState::Preparing)
+        return;
+    playbackStateVariables.outputReconnectReason.store(reason);
+    playbackStateVariables.outputReconnectRequested.store(true);
+    playbackStateVariables.threadStateManager.wakeUpById(ThreadIdentifier::Renderer);
+}
+
+void AudioPlayer::serviceOutputReconnect()
+{
+    auto& psv = playbackStateVariables;
+    auto& ctx = outputReconnect;
+    const auto now = std::chrono::steady_clock::now();
+    // 等待解码线程转换期间的新请求留到本次完成之后处理
+    if (!ctx.streamOpened && psv.outputReconnectRequested.exchange(false))
+    {
+        if (!ctx.active)
+        {
+            ctx.active = true;
+            ctx.attempts = 0;
+            ctx.startTime = now;
+        }
+        ctx.reason = psv.outputReconnectReason.load();
+        ctx.nextAttemptTime = now;
+    }
+    if (!ctx.active)
+    {
+        // 跟随默认设备时检查默认设备是否改变，新的默认设备不可用时忽略
+        // 正在使用的实例在打开时枚举设备，之后可能不再更新，因此每次创建新的实例查询；混音器输入没有设备可选，不检查
+        if (preferredOutputDeviceId.load() != FOLLOW_DEFAULT_OUTPUT_DEVICE || now < ctx.nextDefaultDevicePollTime
+            || !psv.audioDevice || !psv.audioDevice->isStreamRunning())
+            return;
+        ctx.nextDefaultDevicePollTime = now + std::chrono::milliseconds(DEFAULT_OUTPUT_DEVICE_POLL_INTERVAL_MS);
+        const AudioOutputBackend backend = getAudioOutputBackend();
+        if (backend.mixer)
+            return;
+        UniquePtrD<AudioAdapter> probe(createOutputAudioAdapter(backend));
+        if (!probe || probe->getDeviceCount() == 0)
+            return;
+        const AudioAdapter::AudioDeviceInfo defaultDeviceInfo = probe->getDeviceInfo(probe->getDefaultOutputDevice());
+        if (defaultDeviceInfo.outputChannels > 0 && defaultDeviceInfo.name != psv.outputDeviceName)
+            requestOutputReconnect(OutputReconnectReason::DefaultDeviceChanged);
+        return;
+    }
+    if (!ctx.streamOpened)
+    {
+        if (now < ctx.nextAttemptTime)
+            return;
+        ++ctx.attempts;
+        if (!reopenOutputAudioStream())
+        {
+            if (ctx.attempts == 1)
+                logger.warning("No audio output device available, retrying every {} ms", OUTPUT_RECONNECT_RETRY_INTERVAL_MS);
+            ctx.nextAttemptTime = now + std::chrono::milliseconds(OUTPUT_RECONNECT_RETRY_INTERVAL_MS);
+            return;
+        }
+        ctx.streamOpened = true;
+    }
+    if (psv.outputReconfigurePending.load())
+        return; // 等待解码线程转换缓冲的数据
+    finishOutputReconnect();
+}
+
+bool AudioPlayer::reopenOutputAudioStream()
+{
+    auto& psv = playbackStateVariables;
+    auto& ctx = outputReconnect;
+    // 回调停止后缓冲的数据保留在环形缓冲区中，解码线程写满后暂停，音频时钟停在当前位置
+    stopAndCloseOutputAudioStream();
+    psv.audioDevice.reset();
+    processCallbackMessages(); // 关闭前发出的消息按旧格式处理
+    // 优先协商当前的输出格式，新设备支持时不需要转换缓冲的数据
+    unsigned int frameBufferSize = psv.audioOutputStreamBufferSize.load();
+    av_channel_layout_uninit(&ctx.format.channelLayout);
+    if (!openOutputAudioDevice(psv.outputSampleRate.load(), psv.outputChannelLayout, AUDIO_OUTPUT_FORMAT, &frameBufferSize, ctx.format))
+        return false;
+    ctx.formatChanged = ctx.format.sampleRate != psv.outputSampleRate.load() || av_channel_layout_compare(&ctx.format.channelLayout, &psv.outputChannelLayout) != 0;
+    if (ctx.formatChanged)
+    {
+        psv.pendingOutputSampleRate = ctx.format.sampleRate;
+        av_channel_layout_uninit(&psv.pendingOutputChannelLayout);
+        av_channel_layout_copy(&psv.pendingOutputChannelLayout, &ctx.format.channelLayout);
+        psv.outputReconfigurePending.store(true);
+        psv.threadStateManager.wakeUpById(ThreadIdentifier::Decoder);
+    }
+    return true;
+}
+
+void AudioPlayer::finishOutputReconnect()
+{
+    auto& psv = playbackStateVariables;
+    auto& ctx = outputReconnect;
+    applyOutputStreamFormat(ctx.format, ctx.formatChanged);
+    bufferController.restart(); // 新的输出流开始时不统计下溢
+    audioDsp.requestFadeIn();
+    ctx.streamOpened = false;
+    if (!startOutputAudioStream())
+    {
+        logger.error("Cannot start audio output stream on device {}: {}", ctx.format.deviceId, psv.audioDevice->getLastErrorText());
+        stopAndCloseOutputAudioStream();
+        psv.audioDevice.reset();
+        ctx.nextAttemptTime = std::chrono::steady_clock::now() + std::chrono::milliseconds(OUTPUT_RECONNECT_RETRY_INTERVAL_MS);
+        return;
+    }
+    ctx.active = false;
+    OutputReconnectInfo info;
+    info.reason = ctx.reason;
+    info.deviceId = ctx.format.deviceId;
+    info.sampleRate = ctx.format.sampleRate;
+    info.numberOfChannels = ctx.format.channelLayout.nb_channels;
+    info.formatChanged = ctx.formatChanged;
+    info.attempts = ctx.attempts;
+    info.elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - ctx.startTime).count();
+    {
+        std::unique_lock lock(mtxOutputReconnectInfo);
+        lastOutputReconnect = info;
+    }
+    logger.info("Audio output reconnected to device {} in {} ms after {} attempt(s), sample rate: {}, channels: {}, format changed: {}",
+        info.deviceId, info.elapsedMs, info.attempts, info.sampleRate, info.numberOfChannels, info.formatChanged);
+    outputReconnectEvent(info);
+}
+
+void AudioPlayer::convertBufferedAudio(int oldSampleRate, const AVChannelLayout& oldChannelLayout)
+{
+    auto& psv = playbackStateVariables;
+    auto& ringBuffer = psv.streamRingBuffer;
+    const int oldChannels = oldChannelLayout.nb_channels;
+    const int newSampleRate = psv.pendingOutputSampleRate;
+    const AVChannelLayout& newChannelLayout = psv.pendingOutputChannelLayout;
+    const int newChannels = newChannelLayout.nb_channels;
+    // 取出环形缓冲区中尚未播放的数据，之后依次接上等待期间未能写入的数据与交叉淡化器暂存的尾部
+    const uint64_t readPosition = ringBuffer.readPosition();
+    std::vector<AudioSampleFormatType> samples;
+    std::vector<AudioRingBuffer::PtsMarker> markers;
+    uint64_t frames = ringBuffer.drain(samples, markers);
+    for (AudioRingBuffer::PtsMarker marker : psv.heldOutputMarkers)
+    {
+        marker.position += frames;
+        markers.push_back(marker);
+    }
+    samples.insert(samples.end(), psv.heldOutputSamples.begin(), psv.heldOutputSamples.end());
+    frames += oldChannels > 0 ? psv.heldOutputSamples.size() / oldChannels : 0;
+    psv.heldOutputSamples.clear();
+    psv.heldOutputMarkers.clear();
+    crossfader.flush([&](const AudioRingBuffer::PtsMarker* marker, const AudioSampleFormatType* data, uint64_t n) {
+        if (marker)
+        {
+            AudioRingBuffer::PtsMarker m = *marker;
+            m.position = frames;
+            markers.push_back(m);
+        }
+        samples.insert(samples.end(), data, data + n * oldChannels);
+        frames += n;
+        });
+    std::vector<AudioSampleFormatType> converted;
+    if (frames > 0 && oldSampleRate > 0 && newSampleRate > 0 && oldChannels > 0 && newChannels > 0)
+    {
+        SwrContext* swr = nullptr;
+        int ret = swr_alloc_set_opts2(&swr,
+            &newChannelLayout, AUDIO_PROCESSING_FORMAT, newSampleRate,
+            &oldChannelLayout, AUDIO_PROCESSING_FORMAT, oldSampleRate,
+            0, nullptr);
+        UniquePtr<SwrContext> swrCtx{ swr, [](auto* s) { if (s) swr_free(&s); } };
+        if (ret >= 0 && swrCtx && (ret = swr_init(swrCtx.get())) >= 0)
+        {
+            int convertedFrames = 0;
+            const uint8_t* in[] = { reinterpret_cast<const uint8_t*>(samples.data()) };
+            const uint8_t** input = in;
+            int inputFrames = static_cast<int>(frames);
+            // 第二次传入空输入，取出重采样器中的残余数据
+            for (int pass = 0; pass < 2; ++pass)
+            {
+                const int maxOutputFrames = swr_get_out_samples(swrCtx.get(), inputFrames);
+                if (maxOutputFrames <= 0)
+                    break;
+                converted.resize(static_cast<size_t>(convertedFrames + maxOutputFrames) * newChannels);
+                uint8_t* out[] = { reinterpret_cast<uint8_t*>(converted.data() + static_cast<size_t>(convertedFrames) * newChannels) };
+                ret = swr_convert(swrCtx.get(), out, maxOutputFrames, input, inputFrames);
+                if (ret < 0)
+                    break;
+                convertedFrames += ret;
+                input = nullptr;
+                inputFrames = 0;
+            }
+            converted.resize(static_cast<size_t>(convertedFrames) * newChannels);
+        }
+        if (ret < 0)
+        {
+            char err[AV_ERROR_MAX_STRING_SIZE];
+            logger.error("Cannot convert buffered audio: {}", av_make_error_string(err, AV_ERROR_MAX_STRING_SIZE, ret));
+        }
+    }
+    const uint64_t convertedFrames = newChannels > 0 ? converted.size() / newChannels : 0;
+    const double rateRatio = oldSampleRate > 0 ? static_cast<double>(newSampleRate) / oldSampleRate : 1.0;
+    // 按新格式准备环形缓冲区，位置与插值步长按采样率换算后写回数据与标记
+    psv.outputSampleRate.store(newSampleRate);
+    av_channel_layout_uninit(&psv.outputChannelLayout);
+    av_channel_layout_copy(&psv.outputChannelLayout, &newChannelLayout);
+    psv.numberOfAudioOutputChannels.store(newChannels);
+    const uint64_t ringBufferFrames = std::max({ bufferController.requiredCapacityFrames(newSampleRate), static_cast<uint64_t>(newSampleRate * MIN_AUDIO_RING_BUFFER_SECONDS), convertedFrames });
+    ringBuffer.prepare(ringBufferFrames, newChannels);
+    bufferController.prepare(newSampleRate, ringBuffer.capacityFrames());
+    psv.syncAdjustmentEndPosition.store(0); // 位置重新从0开始，正在生效的调整随缓冲数据一起换算后不再等待
+    uint64_t written = 0;
+    for (AudioRingBuffer::PtsMarker marker : markers)
+    {
+        const uint64_t position = std::min(static_cast<uint64_t>(marker.position * rateRatio + 0.5), convertedFrames);
+        if (position > written)
+            written += ringBuffer.write(converted.data() + written * newChannels, position - written);
+        marker.position = ringBuffer.writePosition();
+        marker.secondsPerFrame /= rateRatio;
+        ringBuffer.pushMarker(marker);
+    }
+    if (convertedFrames > written)
+        ringBuffer.write(converted.data() + written * newChannels, convertedFrames - written);
+    // 缓冲区中尚未播放到的新曲目起点同样换算
+    const uint64_t trackChangePosition = psv.trackChangePosition.load();
+    if (trackChangePosition != NO_TRACK_CHANGE)
+        psv.trackChangePosition.store(static_cast<uint64_t>((trackChangePosition > readPosition ? trackChangePosition - readPosition : 0) * rateRatio));
+    logger.info("Converted {} buffered frames from {} Hz, {} channels to {} Hz, {} channels",
+        frames, oldSampleRate, oldChannels, newSampleRate, newChannels);
 }
 
 bool AudioPlayer::startOutputAudioStream()
@@ -160,66 +530,22 @@ bool AudioPlayer::openOutputAudioStream(int sampleRate, AVChannelLayout channelL
 {
     // 删除已有的音频设备实例
     // audioDevice.reset();
-    constexpr AudioAdapterFactory::AudioAdapterAdapter audioDeviceApiType = AudioAdapterFactory::RtAudioAdapter;
-#ifdef _WIN32
-    constexpr AudioAdapter::AudioApi audioApiType = AudioAdapter::WindowsWasapi;
-    //constexpr AudioAdapter::AudioApi audioApiType = AudioAdapter::Unspecified;
-#elif defined(__linux__)
-    constexpr AudioAdapter::AudioApi audioApiType = AudioAdapter::Unspecified;
-#else
-    constexpr AudioAdapter::AudioApi audioApiType = AudioAdapter::Unspecified;
-#endif
-    // 创建新的RtAudio实例
-    playbackStateVariables.audioDevice.reset(AudioAdapterFactory::create(audioDeviceApiType, audioApiType));
-    if (!playbackStateVariables.audioDevice)
-        return false;
-    if (playbackStateVariables.audioDevice->getDeviceCount() == 0) // 没有可用音频设备
-    {
-        playbackStateVariables.audioDevice.reset();
-        return false;
-    }
-    // 设置错误回调函数
-    try {
-        playbackStateVariables.audioDevice->setErrorCallback([this](AudioAdapter::AudioErrorType type, const std::string& errorText) {
-            this->audioOutputStreamErrorCallback(type, errorText);
-            });
-    }
-    catch (const std::exception& e) {
-        logger.error("Cannot set audio error callback: {}", e.what());
-    }
-    // 音频输出流
-    AudioAdapter::AudioStreamParameters outputParams;
-    outputParams.deviceId = playbackStateVariables.audioDevice->getDefaultOutputDevice();
-    outputParams.firstChannel = 0;
-    outputParams.nChannels = channelLayout.nb_channels;
-    AudioAdapter::AudioStreamOptions options;
-    if (audioDeviceApiType == AudioAdapterFactory::PortAudioAdapter)
-        options.flags = AudioAdapter::ClipOff;
-    unsigned int defaultBufferSize = DEFAULT_AUDIO_OUTPUT_STREAM_BUFFER_SIZE;
-    unsigned int* pFrameBufferSize = frameBufferSize;
-    if (!pFrameBufferSize)
-        pFrameBufferSize = &defaultBufferSize;
-    // 如果传入的缓冲区大小为0，则使用最小允许值，即使默认值是0也会被替换为最小允许值
-    if (*pFrameBufferSize == 0 && audioDeviceApiType == AudioAdapterFactory::RtAudioAdapter)
-        options.flags = AudioAdapter::MinimizeLatency;
-    AudioAdapter::AudioStreamOptions* pOptions = &options;
-    // 采用S16格式播放：RTAUDIO_SINT16
-    AudioAdapter::AudioErrorType result = playbackStateVariables.audioDevice->openStream(
-        &outputParams, nullptr,
-        AudioAdapter::avSampleFormatToTargetAudioFormat(sampleFmt), sampleRate, pFrameBufferSize,
-        [this](void* outputBuffer, void* inputBuffer, unsigned int nFrames, double streamTime, AudioAdapter::AudioStreamStatuses status, AudioAdapter::RawArgsType rawArgs, AudioAdapter::UserDataType userData) -> AudioAdapter::AudioCallbackResult {
-            return this->renderAudioAsyncCallback(outputBuffer, inputBuffer, nFrames, streamTime, status, rawArgs, userData);
-        },
-        this, pOptions);
-
-    if (result != AudioAdapter::NoError)
-    {
-        playbackStateVariables.audioDevice.reset();
+    OutputStreamFormat format;
+    if (!openOutputAudioDevice(sampleRate, channelLayout, sampleFmt, frameBufferSize, format))
         return false;
-    }
-
-    playbackStateVariables.numberOfAudioOutputChannels.store(channelLayout.nb_channels);
-    playbackStateVariables.audioOutputStreamBufferSize.store(*pFrameBufferSize);
+    const int outputChannels = format.channelLayout.nb_channels;
+    playbackStateVariables.numberOfAudioOutputChannels.store(outputChannels);
+    playbackStateVariables.outputSampleRate.store(format.sampleRate);
+    av_channel_layout_uninit(&playbackStateVariables.outputChannelLayout);
+    av_channel_layout_copy(&playbackStateVariables.outputChannelLayout, &format.channelLayout);
+    applyOutputStreamFormat(format, true);
+    logger.info("Audio output format: {}, sample rate: {} (source: {}), channels: {} (source: {}), buffer size: {}, latency: {} frames",
+        av_get_sample_fmt_name(format.sampleFormat), format.sampleRate, sampleRate, outputChannels, channelLayout.nb_channels, format.bufferFrames, format.latencyFrames);
+    uint64_t ringBufferFrames = std::max<uint64_t>(bufferController.requiredCapacityFrames(format.sampleRate), static_cast<uint64_t>(format.sampleRate * MIN_AUDIO_RING_BUFFER_SECONDS));
+    playbackStateVariables.streamRingBuffer.prepare(ringBufferFrames, outputChannels);
+    playbackStateVariables.syncAdjustmentEndPosition.store(0);
+    bufferController.prepare(format.sampleRate, playbackStateVariables.streamRingBuffer.capacityFrames());
+    playbackStateVariables.decoderWakeRequested.store(false);
     //PaError err = Pa_Initialize();
     //if (err != paNoError)
     //    return false;
@@ -256,6 +582,136 @@ bool AudioPlayer::openOutputAudioStream(int sampleRate, AVChannelLayout channelL
     return true;
 }
 
+AudioAdapter* AudioPlayer::createOutputAudioAdapter(const AudioOutputBackend& backend)
+{
+    if (backend.mixer)
+        return new MixerAudioAdapter(backend.mixer);
+    const AudioAdapterFactory::AudioAdapterAdapter audioDeviceApiType = backend.api == AudioAdapter::Dummy ? AudioAdapterFactory::NullAudioAdapter : backend.adapter;
+#ifdef _WIN32
+    constexpr AudioAdapter::AudioApi defaultAudioApiType = AudioAdapter::WindowsWasapi;
+    //constexpr AudioAdapter::AudioApi defaultAudioApiType = AudioAdapter::Unspecified;
+#elif defined(__linux__)
+    constexpr AudioAdapter::AudioApi defaultAudioApiType = AudioAdapter::Unspecified;
+#else
+    constexpr AudioAdapter::AudioApi defaultAudioApiType = AudioAdapter::Unspecified;
+#endif
+    const AudioAdapter::AudioApi audioApiType = backend.api == AudioAdapter::Unspecified ? defaultAudioApiType : backend.api;
+    AudioAdapter* adapter = AudioAdapterFactory::create(audioDeviceApiType, audioApiType);
+    if (auto* nullAdapter = dynamic_cast<NullAudioAdapter*>(adapter))
+        nullAdapter->setOptions(backend.nullOptions);
+    return adapter;
+}
+
+bool AudioPlayer::openOutputAudioDevice(int sampleRate, const AVChannelLayout& channelLayout, AVSampleFormat sampleFmt, unsigned int* frameBufferSize, OutputStreamFormat& outFormat)
+{
+    const AudioOutputBackend backend = getAudioOutputBackend();
+    const AudioAdapterFactory::AudioAdapterAdapter audioDeviceApiType = backend.api == AudioAdapter::Dummy ? AudioAdapterFactory::NullAudioAdapter : backend.adapter;
+    // 创建新的音频设备实例，重新连接时新实例才能枚举到变化后的设备
+    auto& audioDevice = playbackStateVariables.audioDevice;
+    audioDevice.reset(createOutputAudioAdapter(backend));
+    if (!audioDevice)
+        return false;
+    if (audioDevice->getDeviceCount() == 0) // 没有可用音频设备
+    {
+        audioDevice.reset();
+        return false;
+    }
+    // 设置错误回调函数
+    try {
+        audioDevice->setErrorCallback([this](AudioAdapter::AudioErrorType type, const std::string& errorText) {
+            this->audioOutputStreamErrorCallback(type, errorText);
+            });
+    }
+    catch (const std::exception& e) {
+        logger.error("Cannot set audio error callback: {}", e.what());
+    }
+    AudioAdapter::AudioStreamOptions options;
+    if (audioDeviceApiType == AudioAdapterFactory::PortAudioAdapter)
+        options.flags = AudioAdapter::ClipOff;
+    unsigned int defaultBufferSize = DEFAULT_AUDIO_OUTPUT_STREAM_BUFFER_SIZE;
+    unsigned int* pFrameBufferSize = frameBufferSize;
+    if (!pFrameBufferSize)
+        pFrameBufferSize = &defaultBufferSize;
+    // 如果传入的缓冲区大小为0，则使用最小允许值，即使默认值是0也会被替换为最小允许值
+    if (*pFrameBufferSize == 0 && audioDeviceApiType == AudioAdapterFactory::RtAudioAdapter)
+        options.flags = AudioAdapter::MinimizeLatency;
+    // 候选设备：选择的设备不可用时回退到默认设备
+    const unsigned int defaultDeviceId = audioDevice->getDefaultOutputDevice();
+    const unsigned int preferredDeviceId = preferredOutputDeviceId.load();
+    std::vector<unsigned int> deviceIds;
+    if (preferredDeviceId != FOLLOW_DEFAULT_OUTPUT_DEVICE && preferredDeviceId != defaultDeviceId)
+        deviceIds.push_back(preferredDeviceId);
+    deviceIds.push_back(defaultDeviceId);
+    for (unsigned int deviceId : deviceIds)
+    {
+        // 音频输出流
+        AudioAdapter::AudioStreamParameters outputParams;
+        outputParams.deviceId = deviceId;
+        outputParams.firstChannel = 0;
+        // 按设备能力协商采样率、声道布局与样本格式，与源一致时解码线程不需要重采样与重混音
+        AudioAdapter::AudioDeviceInfo deviceInfo = audioDevice->getDeviceInfo(outputParams.deviceId);
+        if (deviceInfo.outputChannels == 0)
+        {
+            logger.warning("Audio output device {} is not available.", deviceId);
+            continue;
+        }
+        int outputSampleRate = AudioOutputConverter::negotiateSampleRate(deviceInfo, sampleRate);
+        AVChannelLayout outputChannelLayout{};
+        AudioOutputConverter::negotiateChannelLayout(deviceInfo, channelLayout, outputChannelLayout);
+        AVSampleFormat outputFmt = AudioOutputConverter::negotiate(deviceInfo.nativeFormats, sampleFmt);
+        outputParams.nChannels = outputChannelLayout.nb_channels;
+        unsigned int bufferFrames = *pFrameBufferSize;
+        AudioAdapter::AudioStreamOptions* pOptions = &options;
+        AudioAdapter::AudioErrorType result = audioDevice->openStream(
+            &outputParams, nullptr,
+            AudioAdapter::avSampleFormatToTargetAudioFormat(outputFmt), outputSampleRate, &bufferFrames,
+            [this](void* outputBuffer, void* inputBuffer, unsigned int nFrames, double streamTime, AudioAdapter::AudioStreamStatuses status, AudioAdapter::RawArgsType rawArgs, AudioAdapter::UserDataType userData) -> AudioAdapter::AudioCallbackResult {
+                return this->renderAudioAsyncCallback(outputBuffer, inputBuffer, nFrames, streamTime, status, rawArgs, userData);
+            },
+            this, pOptions);
+        if (result != AudioAdapter::NoError)
+        {
+            logger.warning("Cannot open audio output device {}: {}", deviceId, audioDevice->getLastErrorText());
+            av_channel_layout_uninit(&outputChannelLayout);
+            continue;
+        }
+        *pFrameBufferSize = bufferFrames;
+        outFormat.deviceId = deviceId;
+        outFormat.deviceName = deviceInfo.name;
+        outFormat.sampleRate = outputSampleRate;
+        av_channel_layout_uninit(&outFormat.channelLayout);
+        outFormat.channelLayout = outputChannelLayout; // 转移所有权
+        outFormat.sampleFormat = outputFmt;
+        outFormat.bufferFrames = bufferFrames;
+        outFormat.latencyFrames = std::max(audioDevice->getOutputStreamLatency(), 0L);
+        return true;
+    }
+    audioDevice.reset();
+    return false;
+}
+
+void AudioPlayer::applyOutputStreamFormat(const OutputStreamFormat& format, bool prepareStreamBuffers)
+{
+    const int outputChannels = format.channelLayout.nb_channels;
+    playbackStateVariables.outputDeviceId = format.deviceId;
+    playbackStateVariables.outputDeviceName = format.deviceName;
+    playbackStateVariables.outputLatencyFrames.store(format.latencyFrames);
+    playbackStateVariables.audioOutputStreamBufferSize.store(format.bufferFrames);
+    if (prepareStreamBuffers)
+    {
+        audioDsp.prepare(format.sampleRate, outputChannels);
+        analyzer.prepare(format.sampleRate, outputChannels);
+    }
+    outputConverter.prepare(format.sampleFormat, outputChannels, format.bufferFrames);
+    // 回调消息中的数据缓冲区按两倍回调帧数预先分配，回调中只拷贝
+    const size_t callbackDataBytes = static_cast<size_t>(format.bufferFrames) * 2 * outputChannels * outputConverter.bytesPerSample();
+    callbackMessages.clear();
+    callbackMessages.forEachSlot([callbackDataBytes](AudioCallbackMessage& message) {
+        message.data.assign(callbackDataBytes, 0);
+        message.dataSize = 0;
+        });
+}
+
 bool AudioPlayer::openAndStartOutputAudioStream(int sampleRate, AVChannelLayout channelLayout, AVSampleFormat sampleFmt, unsigned int* frameBufferSize)
 {
     if (!openOutputAudioStream(sampleRate, channelLayout, sampleFmt, frameBufferSize))
@@ -359,11 +815,14 @@ void AudioPlayer::packet2AudioStreams()
 
     // 转换音频格式
     UniquePtr<AVFrame> convertedFrame = { nullptr, constDeleterAVFrame };
-    // 使用swresample进行格式转换
+    // 使用swresample进行格式转换，只在采样率不同或输入不是float时使用
     UniquePtr<SwrContext> swrCtx{ nullptr, [](auto* s) { if(s) swr_free(&s); } };
-    AudioStreamInfo audioStreamInfo;
-    //std::vector<uint8_t> audioDataBuffer;
-    uint64_t bufferedAudioDataIdx = 0;
+    // 采样率相同时由原生混音矩阵完成解交错与下混
+    AudioChannelMixer channelMixer;
+    std::vector<AudioSampleFormatType> mixedSamples;
+    auto& ringBuffer = playbackStateVariables.streamRingBuffer;
+    int outputSampleRate = playbackStateVariables.outputSampleRate.load(); // 输出设备重新连接后可能改变
+    const AVChannelLayout& outputChannelLayout = playbackStateVariables.outputChannelLayout;
 
     SharedPtr<IFrameFilter> noneFilter = std::make_shared<FFmpegFrameNoneFilter>(filterGraphStreamType, formatCtx, codecCtx.get(), streamIndex);
     UniquePtr<FFmpegFrameFilterGraph> filterGraph = std::make_unique<FFmpegFrameFilterGraph>(filterGraphStreamType, formatCtx, codecCtx.get(), streamIndex);
@@ -371,52 +830,310 @@ void AudioPlayer::packet2AudioStreams()
 
     SharedPtr<AudioFrameProcessor> frameProcessor = std::make_shared<AudioFrameProcessor>(logger);
 
-    auto audioDataEnqueue = [this, &audioStreamInfo] {
-        // data数组，如果是packed（交错）格式，则每个采样点的所有通道数据依次排列存储；
-        // 如果是planar（平面）格式，则每个通道的数据依次排列存储，通道1：data[0]，通道2：data[1]，依此类推
-        // 使用emplace减少一次vector构造拷贝
-        //audioStreamQueue.emplace((signed int*)convertedFrame->data[0], (signed int*)convertedFrame->data[0] + num);
-        if (audioStreamInfo.dataBytes.size())
+    // 写入环形缓冲区，空间不足时等待回调消费，停止或seek时丢弃剩余数据
+    // 输出格式改变时回调不再运行，剩余数据暂存，转换缓冲的数据时一并转换；暂存期间之后的数据也接在暂存数据之后，保持顺序
+    auto& heldSamples = playbackStateVariables.heldOutputSamples;
+    auto audioDataWriteHandler = [this, &ringBuffer, &heldSamples](const AudioSampleFormatType* samples, uint64_t frames) {
+        const int channels = ringBuffer.numberOfChannels();
+        while (frames > 0 && heldSamples.empty())
         {
-            //logger.info("Enqueue frame pts: {}", audioStreamInfo.pts);
-            enqueue(playbackStateVariables.streamQueue, std::move(audioStreamInfo));
+            uint64_t written = ringBuffer.write(samples, frames);
+            samples += written * channels;
+            frames -= written;
+            if (frames == 0 || shouldStop() || playerState != PlayerState::Playing)
+                return;
+            if (playbackStateVariables.outputReconfigurePending.load())
+                break;
+            ThreadSleepMs(1);
         }
-        //std::unique_lock lockMtxStreamQueue(playbackStateVariables.mtxStreamQueue);
-        //playbackStateVariables.streamQueue.emplace(std::move(vecAudioData), filteredFrame->pts, timeBaseRational, filteredFrame->pts * timeBase);
+        heldSamples.insert(heldSamples.end(), samples, samples + frames * channels);
         };
-    auto audioDataEnqueueHandler = [&audioDataEnqueue, &audioStreamInfo, &bufferedAudioDataIdx, &convertedFrame, &timeBase, &timeBaseRational] (uint8_t* audioData, uint64_t audioDataSize, AVFrame* curFrame) {
-        // 溢出的音频数据
-        std::span<uint8_t> overflowAudioData{ audioData, audioDataSize };
-        while (!overflowAudioData.empty())
+    // 交叉淡化器之后的输出：在写入位置记录时间戳标记并写入环形缓冲区
+    auto ringOutput = [this, &ringBuffer, &heldSamples, &audioDataWriteHandler](const AudioRingBuffer::PtsMarker* marker, const AudioSampleFormatType* samples, uint64_t frames) {
+        if (marker)
         {
-            int dataSize = av_samples_get_buffer_size(nullptr, convertedFrame->ch_layout.nb_channels, convertedFrame->nb_samples, AUDIO_OUTPUT_FORMAT, 1);
-            if (!dataSize)
-                continue;
-            auto& audioDataBuffer = audioStreamInfo.dataBytes;
-            if (audioDataBuffer.empty())
-                audioDataBuffer.resize(static_cast<uint64_t>(dataSize), 0);
-            audioStreamInfo.pts = static_cast<uint64_t>(curFrame->pts);
-            audioStreamInfo.timeBase = timeBaseRational;
-            audioStreamInfo.frameTime = (curFrame->pts) * timeBase;
-            uint64_t toCopyCount = audioDataBuffer.size() - bufferedAudioDataIdx; // buffer剩余空间大小
-            if (toCopyCount >= overflowAudioData.size())
-                toCopyCount = overflowAudioData.size();
-            //else if (toCopyCount < overflowAudioData.size()) // 数据溢出
-            //{
-            //}
-            std::move(overflowAudioData.begin(), overflowAudioData.begin() + toCopyCount, audioDataBuffer.data() + bufferedAudioDataIdx); // 将音频数据写入AudioAdapter音频流队列
-            bufferedAudioDataIdx += toCopyCount;
-            overflowAudioData = overflowAudioData.subspan(toCopyCount);
-            if (bufferedAudioDataIdx == audioDataBuffer.size()) // 数据已满，准备入队
+            AudioRingBuffer::PtsMarker m = *marker;
+            if (heldSamples.empty())
+            {
+                m.position = ringBuffer.writePosition();
+                ringBuffer.pushMarker(m);
+            }
+            else
+            {
+                m.position = heldSamples.size() / ringBuffer.numberOfChannels();
+                playbackStateVariables.heldOutputMarkers.push_back(m);
+            }
+        }
+        audioDataWriteHandler(samples, frames);
+        };
+    crossfader.prepare(outputChannelLayout.nb_channels, static_cast<uint64_t>(MAX_CROSSFADE_SECONDS * outputSampleRate));
+    // 经过变速器与交叉淡化器后写入环形缓冲区，并在写入位置记录解码帧的时间戳，音频时钟保持为媒体时间
+    std::vector<AudioSampleFormatType> stretchedSamples;
+    timeStretcher.prepare(outputSampleRate, outputChannelLayout.nb_channels);
+    // 预留0.25倍速时一次输出的最大长度，解码循环中一般不再分配
+    stretchedSamples.reserve(static_cast<size_t>(playbackStateVariables.audioOutputStreamBufferSize / AudioTimeStretcher::MIN_RATIO + timeStretcher.latencyFrames()) * outputChannelLayout.nb_channels);
+    // 时钟同步的调整在解码阶段完成，不阻塞音频回调：音频超前时插入静音（期间音频时钟停在当前帧），落后时丢弃即将写入的数据
+    std::vector<AudioSampleFormatType> silenceSamples(static_cast<size_t>(DEFAULT_AUDIO_OUTPUT_STREAM_BUFFER_SIZE) * outputChannelLayout.nb_channels, AudioSampleFormatType{ 0 });
+    auto& pendingSyncAdjustment = playbackStateVariables.pendingSyncAdjustmentFrames;
+    auto stretchedDataEnqueueHandler = [this, &ringBuffer, &ringOutput, &stretchedSamples, &silenceSamples, &pendingSyncAdjustment, &timeBase, &timeBaseRational, &outputSampleRate](const AudioSampleFormatType* samples, int frames, AVFrame* curFrame) {
+        timeStretcher.process(samples, frames, stretchedSamples);
+        const int channels = ringBuffer.numberOfChannels();
+        if (stretchedSamples.empty() || channels <= 0)
+            return;
+        // 输出的第一帧来自更早的输入（窗长延迟与变速积压），按变速器报告的滞后修正媒体时间
+        AudioRingBuffer::PtsMarker marker{
+            ringBuffer.writePosition(),
+            static_cast<uint64_t>(curFrame->pts),
+            timeBaseRational,
+            curFrame->pts * timeBase - (outputSampleRate > 0 ? timeStretcher.lastOutputLagFrames() / outputSampleRate : 0.0),
+            outputSampleRate > 0 ? timeStretcher.getRatio() / outputSampleRate : 0.0
+        };
+        const AudioSampleFormatType* data = stretchedSamples.data();
+        uint64_t dataFrames = stretchedSamples.size() / channels;
+        int64_t adjustment = pendingSyncAdjustment.exchange(0);
+        if (adjustment > 0)
+        {
+            AudioRingBuffer::PtsMarker silenceMarker = marker;
+            silenceMarker.secondsPerFrame = 0.0;
+            const AudioRingBuffer::PtsMarker* pSilenceMarker = &silenceMarker;
+            const uint64_t chunkFrames = silenceSamples.size() / channels;
+            for (uint64_t remaining = static_cast<uint64_t>(adjustment); remaining > 0 && chunkFrames > 0 && !shouldStop() && playerState == PlayerState::Playing;)
             {
-                bufferedAudioDataIdx = 0;
-                // 数据足够，取出数据并入队
-                audioDataEnqueue();
+                const uint64_t n = std::min(remaining, chunkFrames);
+                crossfader.push(pSilenceMarker, silenceSamples.data(), n, ringOutput);
+                pSilenceMarker = nullptr;
+                remaining -= n;
             }
         }
+        else if (adjustment < 0)
+        {
+            // 本次不够丢弃的部分留到下一帧，期间有新的调整请求时以新的为准
+            const int64_t remaining = AudioSyncAdjustment::dropFrames(adjustment, data, dataFrames, channels, marker);
+            int64_t expected = 0;
+            pendingSyncAdjustment.compare_exchange_strong(expected, remaining);
+        }
+        // 调整在当前写入位置之前完成，读取位置越过它（加上输出延迟）之后才发出新的调整
+        if (adjustment != 0)
+            playbackStateVariables.syncAdjustmentEndPosition.store(std::max<uint64_t>(ringBuffer.writePosition(), 1));
+        if (dataFrames == 0)
+            return;
+        crossfader.push(&marker, data, dataFrames, ringOutput);
         };
 
 
+    // 单个解码帧的处理：滤镜、混音或重采样到输出格式，再经变速器写入
+    auto processDecodedFrame = [&](AVFrame* decodedFrame) {
+        //logger.info("Got frame pts: {}", frame->pts);
+        SharedPtr<AVFrame> filteredFrame{ nullptr };
+        if (filterGraph->isValid())
+        {
+            bool needMoreFrame = false;
+            filteredFrame = frameProcessor->filterFrame(decodedFrame, filterGraph.get(), needMoreFrame);
+            if (!filteredFrame)
+                return; // filter失败，或者滤镜图需要更多帧才能输出，继续解码下一帧
+
+        }
+        else
+            filteredFrame = noneFilter->filter(decodedFrame);
+        // 允许外部添加滤镜图进行处理
+        if (frameFilterGraphCreator)
+        {
+            DecodedFrameContext frameCtx{ formatCtx, codecCtx.get(), streamIndex, decodedFrame };
+            std::vector<IFrameFilterGraph*> externalFilterGraphs;
+            bool shouldResetSwrContext = false;
+            bool useFilterGraph = frameFilterGraphCreator(externalFilterGraphs, shouldResetSwrContext, frameCtx, frameFilterGraphCreatorUserData);
+            if (shouldResetSwrContext)
+                convertedFrame.reset();
+            bool needMoreFrame = false;
+            if (useFilterGraph)
+            {
+                for (auto& fg : externalFilterGraphs)
+                {
+                    if (!fg || !fg->isValid())
+                        continue;
+                    filteredFrame = frameProcessor->filterFrame(decodedFrame, fg, needMoreFrame);
+                    needMoreFrame = !filteredFrame; // 如果滤镜图没有输出，说明需要更多帧才能输出
+                    if (needMoreFrame)
+                        break; // 需要更多帧，停止当前帧的外部滤镜处理，继续解码下一帧
+                }
+            }
+            if (needMoreFrame)
+                return;
+        }
+        const AVSampleFormat inputFormat = static_cast<AVSampleFormat>(filteredFrame->format);
+        // 采样率相同且输入为float或16/32位整数时不经过swr：布局相同的交错float直接送入变速器，其余由原生矩阵转换、解交错或下混
+        if (filteredFrame->sample_rate == outputSampleRate && AudioChannelMixer::canProcess(inputFormat)
+            && channelMixer.prepare(filteredFrame->ch_layout, outputChannelLayout))
+        {
+            if (inputFormat == AV_SAMPLE_FMT_FLT && channelMixer.isIdentity())
+            {
+                stretchedDataEnqueueHandler(reinterpret_cast<const AudioSampleFormatType*>(filteredFrame->data[0]), filteredFrame->nb_samples, decodedFrame);
+                return;
+            }
+            mixedSamples.resize(static_cast<size_t>(filteredFrame->nb_samples) * channelMixer.numberOfOutputChannels()); // 容量只增不减
+            channelMixer.process(filteredFrame->data, inputFormat, filteredFrame->nb_samples, mixedSamples.data());
+            stretchedDataEnqueueHandler(mixedSamples.data(), filteredFrame->nb_samples, decodedFrame);
+            return;
+        }
+        // 输入参数与swr配置时不同则重建
+        if (convertedFrame && swrCtx)
+        {
+            int64_t swrInputRate = 0;
+            AVSampleFormat swrInputFormat = AV_SAMPLE_FMT_NONE;
+            AVChannelLayout swrInputLayout{};
+            av_opt_get_int(swrCtx.get(), "in_sample_rate", 0, &swrInputRate);
+            av_opt_get_sample_fmt(swrCtx.get(), "in_sample_fmt", 0, &swrInputFormat);
+            av_opt_get_chlayout(swrCtx.get(), "in_chlayout", 0, &swrInputLayout);
+            if (swrInputRate != filteredFrame->sample_rate || swrInputFormat != filteredFrame->format || av_channel_layout_compare(&swrInputLayout, &filteredFrame->ch_layout) != 0)
+                convertedFrame.reset();
+            av_channel_layout_uninit(&swrInputLayout);
+        }
+        // 转换格式
+        if (!convertedFrame)
+        {
+            swrCtx.reset();
+            convertedFrame.reset(av_frame_alloc());
+            convertedFrame->sample_rate = outputSampleRate;
+            av_channel_layout_copy(&convertedFrame->ch_layout, &outputChannelLayout);
+            convertedFrame->format = AUDIO_PROCESSING_FORMAT;
+            convertedFrame->nb_samples = playbackStateVariables.audioOutputStreamBufferSize; // 输出固定样本数
+            int ret = av_frame_get_buffer(convertedFrame.get(), 0);
+            if (ret < 0)
+            {
+                char err[AV_ERROR_MAX_STRING_SIZE];
+                logger.error("av_frame_get_buffer error: {}", av_make_error_string(err, AV_ERROR_MAX_STRING_SIZE, ret));
+                return;
+            }
+            SwrContext* swr = nullptr;
+            ret = swr_alloc_set_opts2(&swr,
+                // out
+                &convertedFrame->ch_layout/*ch_layout*/, (AVSampleFormat)convertedFrame->format/*sample_fmt*/, convertedFrame->sample_rate, /*sample_rate*/
+                // in
+                &filteredFrame->ch_layout/*ch_layout*/, (AVSampleFormat)filteredFrame->format/*sample_fmt*/, filteredFrame->sample_rate, /*sample_rate*/
+                0, nullptr);
+            if (ret < 0)
+            {
+                char err[AV_ERROR_MAX_STRING_SIZE];
+                logger.error("swr_alloc_set_opts2 error: {}", av_make_error_string(err, AV_ERROR_MAX_STRING_SIZE, ret));
+                return;
+            }
+            swrCtx.reset(swr);
+            if (swrCtx)
+                swr_init(swrCtx.get());
+        }
+        if (!swrCtx)
+            return;
+        int ret = swr_convert(swrCtx.get(), convertedFrame->data, convertedFrame->nb_samples,
+            (const uint8_t**)filteredFrame->data, filteredFrame->nb_samples);
+        if (ret <= 0)
+        {
+            char err[AV_ERROR_MAX_STRING_SIZE];
+            logger.error("swr_convert error: {}", av_make_error_string(err, AV_ERROR_MAX_STRING_SIZE, ret));
+            return;
+        }
+        // 播放音频
+        // 复制音频数据
+        stretchedDataEnqueueHandler(reinterpret_cast<const AudioSampleFormatType*>(convertedFrame->data[0]), ret, decodedFrame);
+        // 获取缓冲区内的残余数据
+        while ((ret = swr_convert(swrCtx.get(), convertedFrame->data, convertedFrame->nb_samples, 0, 0)) > 0)
+            stretchedDataEnqueueHandler(reinterpret_cast<const AudioSampleFormatType*>(convertedFrame->data[0]), ret, decodedFrame);
+        };
+    // 包队列已空且解复用器读到文件结尾时冲洗解码器，取出最后几帧，无缝衔接时不能丢弃
+    auto drainDecoder = [&]() {
+        avcodec_send_packet(codecCtx.get(), nullptr);
+        while (avcodec_receive_frame(codecCtx.get(), frame.get()) == 0)
+            processDecodedFrame(frame.get());
+        };
+    // 切换到预加载的下一项：接管其解复用器与解码器，旧曲目的上下文交给伴随线程释放，设备与环形缓冲区保持不变
+    // 下一项仍在预加载时等待，期间停止或暂停则返回false，之后重试
+    auto switchToNextTrack = [&]() -> bool {
+        auto& psv = playbackStateVariables;
+        while (!trackPreloader.waitFinished(TRACK_PRELOAD_WAIT_INTERVAL_MS))
+            if (shouldStop() || playerState != PlayerState::Playing || waitObj.isBlocking())
+                return false;
+        AudioTrackPreloader::PreloadedTrack next;
+        std::string nextFilePath;
+        bool taken = false;
+        {
+            std::unique_lock lock(psv.mtxTrackSwitch);
+            nextFilePath = psv.nextFilePath;
+            const auto result = trackPreloader.take(nextFilePath, next);
+            // 下一项刚被修改，新的预加载尚未开始，setNextFilePath开始预加载后唤醒解码线程
+            if (result == AudioTrackPreloader::TakeResult::NotReady)
+                return false;
+            taken = result == AudioTrackPreloader::TakeResult::Taken;
+            psv.nextFilePath.clear();
+        }
+        if (!taken)
+        {
+            if (!nextFilePath.empty())
+                logger.error("Cannot switch to next track: {}", nextFilePath);
+            // 先输出暂存的尾部再清除标志，回调据此判断播放结束，期间又设置了下一项时保留
+            crossfader.flush(ringOutput);
+            std::unique_lock lock(psv.mtxTrackSwitch);
+            psv.trackTransitionPending.store(!psv.nextFilePath.empty());
+            return false;
+        }
+        auto& nextDemuxer = next.demuxer;
+        nextDemuxer->setMaxPacketQueueSize(MAX_AUDIO_PACKET_QUEUE_SIZE);
+        nextDemuxer->setMinPacketQueueSize(MIN_AUDIO_PACKET_QUEUE_SIZE);
+        nextDemuxer->setPacketEnqueueCallback(std::bind(&AudioPlayer::packetEnqueueCallback, this));
+        // 旧曲目已读到结尾，停止其读取线程
+        SharedPtr<SingleDemuxer> oldDemuxer = internalDemuxer;
+        oldDemuxer->stop();
+        oldDemuxer->waitStop();
+        oldDemuxer->flushPacketQueue();
+        {
+            std::unique_lock lock(psv.mtxTrackSwitch);
+            psv.retiredDemuxer = oldDemuxer;
+            psv.retiredCodecCtx = std::move(psv.codecCtx);
+            internalDemuxer = nextDemuxer;
+            psv.demuxer.store(nextDemuxer.get());
+            psv.formatCtx = nextDemuxer->getFormatContext();
+            psv.streamIndex = nextDemuxer->getStreamIndex(psv.demuxerStreamType);
+            psv.packetQueue = nextDemuxer->getPacketQueue(psv.demuxerStreamType);
+            psv.codecCtx = std::move(next.codecCtx);
+            psv.filePath = nextFilePath;
+            psv.durationInAvTimeBase.store(psv.formatCtx->duration);
+        }
+        psv.endOfTrackDrained.store(next.decoderDrained);
+        nextDemuxer->start();
+        if (shouldStop()) // 停止请求可能停止的是旧的解复用器
+            nextDemuxer->stop();
+        // 按新曲目重建时间基与滤镜，swr在输入参数变化时自动重建
+        timeBaseRational = formatCtx->streams[streamIndex]->time_base;
+        timeBase = av_q2d(timeBaseRational);
+        noneFilter = std::make_shared<FFmpegFrameNoneFilter>(filterGraphStreamType, formatCtx, codecCtx.get(), streamIndex);
+        filterGraph = std::make_unique<FFmpegFrameFilterGraph>(filterGraphStreamType, formatCtx, codecCtx.get(), streamIndex);
+        filterGraph->configureFilterGraph();
+        // 暂存的尾部转为淡出的一路，新曲目的数据从当前写入位置开始
+        crossfader.beginFade();
+        crossfader.setHoldFrames(0, ringOutput);
+        psv.trackChangePosition.store(ringBuffer.writePosition() + heldSamples.size() / ringBuffer.numberOfChannels()); // 暂存的数据随后写入
+        for (auto& preloadedFrame : next.frames)
+            processDecodedFrame(preloadedFrame.get());
+        std::unique_lock lock(psv.mtxTrackSwitch);
+        // 切换期间又设置了下一项时继续等待，否则清除标志
+        psv.trackTransitionPending.store(!psv.nextFilePath.empty());
+        logger.info("Switched to next track: {}", nextFilePath);
+        return true;
+        };
+
+    // 输出设备重新连接后采样率或声道布局改变：转换缓冲的数据，按新格式重建变速器、交叉淡化器与格式转换
+    auto reconfigureOutput = [&]() {
+        AVChannelLayout oldChannelLayout{};
+        av_channel_layout_copy(&oldChannelLayout, &outputChannelLayout);
+        convertBufferedAudio(outputSampleRate, oldChannelLayout);
+        av_channel_layout_uninit(&oldChannelLayout);
+        outputSampleRate = playbackStateVariables.outputSampleRate.load();
+        timeStretcher.prepare(outputSampleRate, outputChannelLayout.nb_channels);
+        timeStretcher.reset();
+        crossfader.prepare(outputChannelLayout.nb_channels, static_cast<uint64_t>(MAX_CROSSFADE_SECONDS * outputSampleRate));
+        silenceSamples.assign(static_cast<size_t>(DEFAULT_AUDIO_OUTPUT_STREAM_BUFFER_SIZE) * outputChannelLayout.nb_channels, AudioSampleFormatType{ 0 });
+        convertedFrame.reset(); // swr按新的输出参数重建
+        playbackStateVariables.outputReconfigurePending.store(false);
+        };
+
     while (1)
     {
         if (waitObj.isBlocking())
@@ -424,30 +1141,52 @@ void AudioPlayer::packet2AudioStreams()
 
         if (shouldStop())
             break;
-        else if (playerState != PlayerState::Playing)
+        // 暂停时同样处理，伴随线程等待转换完成后才启动新的输出流
+        if (playbackStateVariables.outputReconfigurePending.load())
+            reconfigureOutput();
+        if (playerState != PlayerState::Playing)
         {
             waitObj.pause();
             continue;
         }
+        // 交叉淡化时，下一项就绪前暂存当前曲目的最新数据，作为淡出的一路
+        {
+            uint64_t holdFrames = 0;
+            if (playbackStateVariables.trackTransitionPending.load() && trackTransitionMode.load() == TrackTransitionMode::Crossfade)
+                holdFrames = static_cast<uint64_t>(crossfadeSeconds.load() * outputSampleRate);
+            crossfader.setHoldFrames(holdFrames, ringOutput);
+        }
         //std::unique_lock lockMtxStreamQueue(playbackStateVariables.mtxStreamQueue);
         //auto streamQueueSize = playbackStateVariables.streamQueue.size();
         //lockMtxStreamQueue.unlock();
-        auto streamQueueSize = getQueueSize(playbackStateVariables.streamQueue);
-        if (streamQueueSize >= MAX_AUDIO_OUTPUT_STREAM_QUEUE_SIZE)
+        auto streamQueueSize = ringBuffer.readableFrames();
+        if (streamQueueSize >= bufferController.targetFrames())
         {
             waitObj.pause();
-            continue; // 如果音频流队列中有太多数据，等待消费掉一些再继续解码
+            continue; // 如果环形缓冲区中有太多数据，等待消费掉一些再继续解码
         }
         if (getQueueSize(*playbackStateVariables.packetQueue) < MIN_AUDIO_PACKET_QUEUE_SIZE)
             playbackStateVariables.demuxer.load()->wakeUp(); // 包队列数据过少，唤醒解复用器读取更多数据
 
 
-        logger.trace("Current audio stream queue size: {}", streamQueueSize);
+        logger.trace("Current audio ring buffer frames: {}", streamQueueSize);
         // 如果队列中有包，则取出解码
         AVPacket* pkt = nullptr;
         if (!tryDequeue(*playbackStateVariables.packetQueue, pkt))
         {
-            audioDataEnqueue(); // 没有包的时候先把残余数据入队，保证不会有数据遗漏
+            // 当前曲目的包已全部取出：冲洗解码器，设置了下一项时直接切换
+            if (demuxerMode == ComponentWorkMode::Internal && internalDemuxer->isEndOfFile())
+            {
+                if (!playbackStateVariables.endOfTrackDrained.exchange(true))
+                    drainDecoder();
+                if (playbackStateVariables.trackTransitionPending.load())
+                {
+                    if (switchToNextTrack())
+                        continue;
+                }
+                else
+                    crossfader.flush(ringOutput);
+            }
             waitObj.pause();
             continue; // 出队失败，说明队列为空
         }
@@ -456,100 +1195,19 @@ void AudioPlayer::packet2AudioStreams()
         logger.trace("Got audio packet, current audio packet queue size: {}", getQueueSize(*playbackStateVariables.packetQueue));
         UniquePtr<AVPacket> pktPtr{ pkt, constDeleterAVPacket };
         int aspRst = avcodec_send_packet(playbackStateVariables.codecCtx.get(), pkt);
+        if (aspRst == AVERROR_EOF) // 结尾处冲洗过解码器后又seek回来，重置解码器状态
+        {
+            avcodec_flush_buffers(playbackStateVariables.codecCtx.get());
+            aspRst = avcodec_send_packet(playbackStateVariables.codecCtx.get(), pkt);
+        }
         if (aspRst < 0 && aspRst != AVERROR(EAGAIN) && aspRst != AVERROR_EOF)
             continue;
         while (avcodec_receive_frame(playbackStateVariables.codecCtx.get(), frame.get()) == 0)
-        {
-            //logger.info("Got frame pts: {}", frame->pts);
-            SharedPtr<AVFrame> filteredFrame{ nullptr };
-            if (filterGraph->isValid())
-            {
-                bool needMoreFrame = false;
-                filteredFrame = frameProcessor->filterFrame(frame.get(), filterGraph.get(), needMoreFrame);
-                if (!filteredFrame)
-                    continue; // filter失败，或者滤镜图需要更多帧才能输出，继续解码下一帧
-
-            }
-            else
-                filteredFrame = noneFilter->filter(frame.get());
-            // 允许外部添加滤镜图进行处理
-            if (frameFilterGraphCreator)
-            {
-                DecodedFrameContext frameCtx{ formatCtx, codecCtx.get(), streamIndex, frame.get() };
-                std::vector<IFrameFilterGraph*> externalFilterGraphs;
-                bool shouldResetSwrContext = false;
-                bool useFilterGraph = frameFilterGraphCreator(externalFilterGraphs, shouldResetSwrContext, frameCtx, frameFilterGraphCreatorUserData);
-                if (shouldResetSwrContext)
-                    convertedFrame.reset();
-                bool needMoreFrame = false;
-                if (useFilterGraph)
-                {
-                    for (auto& fg : externalFilterGraphs)
-                    {
-                        if (!fg || !fg->isValid())
-                            continue;
-                        filteredFrame = frameProcessor->filterFrame(frame.get(), fg, needMoreFrame);
-                        needMoreFrame = !filteredFrame; // 如果滤镜图没有输出，说明需要更多帧才能输出
-                        if (needMoreFrame)
-                            break; // 需要更多帧，停止当前帧的外部滤镜处理，继续解码下一帧
-                    }
-                }
-                if (needMoreFrame)
-                    continue;
-            }
-            // 转换格式
-            if (!convertedFrame)
-            {
-                convertedFrame.reset(av_frame_alloc());
-                convertedFrame->sample_rate = filteredFrame->sample_rate;
-                convertedFrame->ch_layout = filteredFrame->ch_layout;
-                convertedFrame->format = AUDIO_OUTPUT_FORMAT;
-                convertedFrame->nb_samples = playbackStateVariables.audioOutputStreamBufferSize; // 输出固定样本数
-                int ret = av_frame_get_buffer(convertedFrame.get(), 0);
-                if (ret < 0)
-                {
-                    char err[AV_ERROR_MAX_STRING_SIZE];
-                    logger.error("av_frame_get_buffer error: {}", av_make_error_string(err, AV_ERROR_MAX_STRING_SIZE, ret));
-                    continue;
-                }
-                SwrContext* swr = nullptr;
-                ret = swr_alloc_set_opts2(&swr,
-                    // out
-                    &convertedFrame->ch_layout/*ch_layout*/, (AVSampleFormat)convertedFrame->format/*sample_fmt*/, convertedFrame->sample_rate, /*sample_rate*/
-                    // in
-                    &filteredFrame->ch_layout/*ch_layout*/, (AVSampleFormat)filteredFrame->format/*sample_fmt*/, filteredFrame->sample_rate, /*sample_rate*/
-                    0, nullptr);
-                if (ret < 0)
-                {
-                    char err[AV_ERROR_MAX_STRING_SIZE];
-                    logger.error("swr_alloc_set_opts2 error: {}", av_make_error_string(err, AV_ERROR_MAX_STRING_SIZE, ret));
-                    continue;
-                }
-                swrCtx.reset(swr);
-                if (swrCtx)
-                    swr_init(swrCtx.get());
-            }
-            if (!swrCtx)
-                continue;
-            int ret = swr_convert(swrCtx.get(), convertedFrame->data, convertedFrame->nb_samples,
-                (const uint8_t**)filteredFrame->data, filteredFrame->nb_samples);
-            if (ret <= 0)
-            {
-                char err[AV_ERROR_MAX_STRING_SIZE];
-                logger.error("swr_convert error: {}", av_make_error_string(err, AV_ERROR_MAX_STRING_SIZE, ret));
-                continue;
-            }
-            // 播放音频
-            // 复制音频数据
-            audioDataEnqueueHandler(reinterpret_cast<uint8_t*>(convertedFrame->data[0]), static_cast<uint64_t>(ret) * filteredFrame->ch_layout.nb_channels * AUDIO_OUTPUT_FORMAT_BYTES_PER_SAMPLE, frame.get());
-            // 获取缓冲区内的残余数据
-            while ((ret = swr_convert(swrCtx.get(), convertedFrame->data, convertedFrame->nb_samples, 0, 0)) > 0)
-                audioDataEnqueueHandler(reinterpret_cast<uint8_t*>(convertedFrame->data[0]), static_cast<uint64_t>(ret) * filteredFrame->ch_layout.nb_channels * AUDIO_OUTPUT_FORMAT_BYTES_PER_SAMPLE, frame.get());
-        }
+            processDecodedFrame(frame.get());
     }
 }
 
-// 音频渲染
+// 音频回调的伴随线程
 void AudioPlayer::renderAudio()
 {
     auto& threadStateManager = playbackStateVariables.threadStateManager;
@@ -559,132 +1217,225 @@ void AudioPlayer::renderAudio()
     {
         if (waitObj.isBlocking())
             waitObj.block();
+        processCallbackMessages();
         if (shouldStop())
             break;
-        // 睡眠，直到唤醒
-        waitObj.pause();
+        serviceOutputReconnect();
+        if (playerState != PlayerState::Playing && !outputReconnect.active)
+        {
+            // 暂停时回调不再发出消息，睡眠直到唤醒
+            waitObj.pause();
+            continue;
+        }
+        ThreadSleepMs(CALLBACK_MESSAGE_POLL_INTERVAL_MS);
+    }
+}
+
+void AudioPlayer::processCallbackMessages()
+{
+    bool rendered = false;
+    double streamTime = 0.0;
+    // 解码线程切换曲目时会替换上下文，这里取得当前的指针后释放被替换下来的上下文，本次处理期间不会再被释放
+    AVFormatContext* formatCtx = nullptr;
+    AVCodecContext* codecCtx = nullptr;
+    StreamIndexType streamIndex = -1;
+    SharedPtr<SingleDemuxer> retiredDemuxer{ nullptr };
+    UniquePtr<AVCodecContext> retiredCodecCtx{ nullptr, constDeleterAVCodecContext };
+    {
+        std::unique_lock lock(playbackStateVariables.mtxTrackSwitch);
+        formatCtx = playbackStateVariables.formatCtx;
+        codecCtx = playbackStateVariables.codecCtx.get();
+        streamIndex = playbackStateVariables.streamIndex;
+        retiredDemuxer = std::move(playbackStateVariables.retiredDemuxer);
+        retiredCodecCtx = std::move(playbackStateVariables.retiredCodecCtx);
+    }
+    retiredDemuxer.reset();
+    retiredCodecCtx.reset();
+    while (AudioCallbackMessage* message = callbackMessages.front())
+    {
+        switch (message->type)
+        {
+        case AudioCallbackMessage::Rendered:
+        {
+            SampleFrameContext frameCtx{
+                formatCtx,
+                codecCtx,
+                streamIndex,
+                { message->data.data(), message->dataSize },
+                static_cast<int>(message->dataSize),
+                message->nFrames,
+                playbackStateVariables.outputSampleRate.load(),
+                playbackStateVariables.numberOfAudioOutputChannels,
+                message->pts,
+                message->timeBase,
+                message->frameTime,
+                message->streamTime
+            };
+            frameCtx.sampleFormat = message->sampleFormat;
+            AudioRenderEvent audioEvent{ &frameCtx };
+            event(&audioEvent);
+            logger.trace("Current presentation timestamp: {}, duration: {}", av_rescale_q(message->pts, message->timeBase, AV_TIME_BASE_Q), message->durationInAvTimeBase);
+            rendered = true;
+            streamTime = message->streamTime;
+            break;
+        }
+        case AudioCallbackMessage::Finished:
+            logger.trace("Audio playback finished.");
+            break;
+        case AudioCallbackMessage::Stopped:
+            logger.trace("Audio playback stopped by user.");
+            break;
+        case AudioCallbackMessage::TrackChanged:
+        {
+            std::string filePath;
+            {
+                std::unique_lock lock(playbackStateVariables.mtxTrackSwitch);
+                filePath = playbackStateVariables.filePath;
+            }
+            logger.info("Now playing: {}", filePath);
+            // 响度归一化按新曲目重新设置：交叉淡化时回调刚读到淡化的起点，两首曲目叠加输出，
+            // 增益在淡化时长内从旧曲目的值线性过渡到新曲目的值，跟随淡出淡入的主导曲目，不在起点突变
+            {
+                std::unique_lock lock(mtxLoudness);
+                loudnessTrackPath = filePath;
+            }
+            applyLoudnessNormalization(trackTransitionMode.load() == TrackTransitionMode::Crossfade ? crossfadeSeconds.load() : 0.0);
+            trackChangeEvent(filePath);
+            break;
+        }
+        }
+        callbackMessages.pop();
+    }
+    // 同步时钟，以最近一次输出的流时间为准，调整量交给解码线程完成
+    if (rendered && playbackStateVariables.playOptions.clockSyncFunction)
+    {
+        int64_t sleepTime = 0;
+        playbackStateVariables.realtimeClock = streamTime;
+        auto rst = playbackStateVariables.playOptions.clockSyncFunction(playbackStateVariables.audioClock, true, playbackStateVariables.realtimeClock, sleepTime); // 同步时钟
+        // 上一次的调整尚未取出，或尚未播放到输出端时，时钟差仍包含该调整，不再重复发出
+        const uint64_t adjustmentEnd = playbackStateVariables.syncAdjustmentEndPosition.load();
+        const bool adjustmentInFlight = playbackStateVariables.pendingSyncAdjustmentFrames.load() != 0
+            || (adjustmentEnd != 0 && playbackStateVariables.streamRingBuffer.readPosition() < adjustmentEnd + static_cast<uint64_t>(std::max<long>(playbackStateVariables.outputLatencyFrames.load(), 0)));
+        if (rst && sleepTime != 0 && !adjustmentInFlight)
+        {
+            if (sleepTime > 0)
+                logger.trace("Audio insert silence: {} ms", sleepTime); // 需要等待
+            else
+                logger.trace("Audio drop frame to catch up: {} ms", -sleepTime); // 落后太多，跳过帧
+            playbackStateVariables.pendingSyncAdjustmentFrames.store(sleepTime * playbackStateVariables.outputSampleRate.load() / 1000);
+        }
+    }
+    if (playbackStateVariables.decoderWakeRequested.exchange(false))
+        playbackStateVariables.threadStateManager.wakeUpById(ThreadIdentifier::Decoder);
+    if (uint64_t dropped = callbackMessages.droppedCount(); dropped != droppedCallbackMessages)
+    {
+        logger.warning("Audio callback messages dropped: {}", dropped - droppedCallbackMessages);
+        droppedCallbackMessages = dropped;
+    }
+    // 回调内的阻塞操作只计数，在这里输出
+    if (uint64_t violations = RealtimeSafety::violationCount(); violations != reportedRealtimeViolations)
+    {
+        logger.warning("Blocking operations in audio callback: {} (last: {})", violations - reportedRealtimeViolations, RealtimeSafety::lastViolation());
+        reportedRealtimeViolations = violations;
     }
 }
 
 // 异步音频输出
 AudioAdapter::AudioCallbackResult AudioPlayer::renderAudioAsyncCallback(void*& outputBuffer, void*& inputBuffer, unsigned int& nFrames, double& streamTime, AudioAdapter::AudioStreamStatuses& status, AudioAdapter::RawArgsType& rawArgs, AudioAdapter::UserDataType& userData)
 {
+    RealtimeSafety::RealtimeScope realtimeScope; // 调试版本中检查回调内的睡眠、加锁与内存分配
     auto& numberOfChannels = playbackStateVariables.numberOfAudioOutputChannels;
-    std::span<AudioSampleFormatType> spanOutBuffer{ reinterpret_cast<AudioSampleFormatType*>(outputBuffer), static_cast<uint64_t>(numberOfChannels * nFrames) };
-    std::span<uint8_t> spanOutBuffer8Bits{ reinterpret_cast<uint8_t*>(outputBuffer), spanOutBuffer.size() * AUDIO_OUTPUT_FORMAT_BYTES_PER_SAMPLE };
-    auto adjustVolume = [&spanOutBuffer, &nFrames, &numberOfChannels, &userData] (double vol) {
-        // 简单音量调整：线性调节
-        for (auto& sample : spanOutBuffer)
-            sample = std::round(sample * vol);
-
-        // 简单EQ音量调整
-        //// 预加重系数（根据音量调整）
-        //double preemphasis = 1.0 + (1.0 - vol) * 0.3;  // 音量越小时补偿越多
-        //// 简单的一阶IIR滤波器
-        //if (!userData.has_value() || userData.type() != typeid(double))
-        //    userData.emplace<double>(0.0);
-        //double& prev = std::any_cast<double&>(userData);
-        //double alpha = 0.05; // 影响频率
-        //for (auto& sample : spanOutBuffer)
-        //{
-        //    double calcSample = static_cast<double>(sample);
-        //    // 高频增强
-        //    calcSample = calcSample + alpha * (calcSample - prev);
-        //    prev = calcSample;
-        //    calcSample *= vol; // 应用音量
-        //    // 限制范围
-        //    auto min = std::numeric_limits<AudioSampleFormatType>::min();
-        //    auto max = std::numeric_limits<AudioSampleFormatType>::max();
-        //    sample = static_cast<int16_t>(calcSample);
-        //    if (sample > max) sample = max;
-        //    else if (sample < min) sample = min;
-        //}
-        };
+    // float输出时直接在设备缓冲区中处理，否则在转换器的缓冲区中处理后再转换
+    std::span<AudioSampleFormatType> spanOutBuffer{ outputConverter.processBuffer(outputBuffer, nFrames), static_cast<uint64_t>(numberOfChannels * nFrames) };
+    const size_t outputBytes = static_cast<size_t>(numberOfChannels * nFrames) * outputConverter.bytesPerSample();
 
+    auto& ringBuffer = playbackStateVariables.streamRingBuffer;
     uint64_t currentPts = 0;
     AVRational currentTimeBase = AV_TIME_BASE_Q;
-    //std::unique_lock lockMtxStreamQueue(playbackStateVariables.mtxStreamQueue);
-    AudioStreamInfo one;
-    if (nFrames && isPlaying() && tryDequeue(playbackStateVariables.streamQueue, one))
-    {
-        //auto& one = playbackStateVariables.streamQueue.front();
-        // logger.info("Audio sample: {}", outBuffer[i]);
-        playbackStateVariables.audioClock.store(one.frameTime); // 更新音频时钟
-        auto pts = currentPts = one.pts;
-        auto timeBase = currentTimeBase = one.timeBase;
-        auto frameTime = one.frameTime;
-        std::copy(one.dataBytes.begin(), one.dataBytes.end(), spanOutBuffer8Bits.data()); // std::span<uint8_t> dataBytes{};
-        //std::copy(one.dataBytes.begin(), one.dataBytes.end(), outBuffer + i * oneSize); // std::vector<uint8_t> dataBytes{}
-        //std::memcpy(outBuffer + i * oneSize, one.dataBytes.data(), one.dataBytes.size());
-        adjustVolume((!playbackStateVariables.isMute.load()) ? playbackStateVariables.volume.load() : 0.0);
-        //playbackStateVariables.streamQueue.pop();
-
-        // 填充音频数据后调用事件回调
-        SampleFrameContext frameCtx{
-            playbackStateVariables.formatCtx,
-            playbackStateVariables.codecCtx.get(),
-            playbackStateVariables.streamIndex,
-            { static_cast<uint8_t*>(outputBuffer), spanOutBuffer8Bits.size() },
-            spanOutBuffer8Bits.size(),
-            nFrames,
-            playbackStateVariables.codecCtx->sample_rate,
-            playbackStateVariables.numberOfAudioOutputChannels,
-            pts,
-            timeBase,
-            frameTime,
-            streamTime
-        };
-        AudioRenderEvent audioEvent{ &frameCtx };
-        event(&audioEvent);
+    // 后端的回调帧数可能与打开时不同，记录观察到的最大值，用于解码线程的转换缓冲区
+    if (nFrames > playbackStateVariables.audioOutputStreamBufferSize.load(std::memory_order_relaxed))
+        playbackStateVariables.audioOutputStreamBufferSize.store(nFrames);
+    AudioRingBuffer::PtsMarker marker;
+    uint64_t markerOffsetFrames = 0;
+    bool hasMarker = false;
+    uint64_t framesRead = 0;
+    if (nFrames && isPlaying() && numberOfChannels == ringBuffer.numberOfChannels())
+    {
+        bufferController.onCallback(nFrames, ringBuffer.readableFrames(), status.testFlag(AudioAdapter::OutputUnderflow));
+        hasMarker = ringBuffer.currentPtsMarker(marker, markerOffsetFrames);
+        framesRead = ringBuffer.read(spanOutBuffer.data(), nFrames);
     }
-    else
+    if (framesRead)
     {
-        adjustVolume(0.0);
-        // logger.info("音频缓冲区下溢，填充静音数据。Audio sample: {}", outBuffer[i]);
+        double frameTime = playbackStateVariables.audioClock.load();
+        if (hasMarker)
+        {
+            frameTime = marker.frameTime + markerOffsetFrames * marker.secondsPerFrame;
+            // 更新音频时钟，补偿输出延迟后为正在播出的位置
+            // 延迟中的数据按当前倍速播放，每帧对应的媒体时间为倍速除以输出采样率；不使用标记的步长，静音标记的步长为0
+            double clock = frameTime;
+            const int outputSampleRate = playbackStateVariables.outputSampleRate.load(std::memory_order_relaxed);
+            if (outputLatencyCompensation.load(std::memory_order_relaxed) && outputSampleRate > 0)
+                clock = std::max(clock - playbackStateVariables.outputLatencyFrames.load(std::memory_order_relaxed) * timeStretcher.getRatio() / outputSampleRate, 0.0);
+            playbackStateVariables.audioClock.store(clock);
+            currentPts = marker.pts;
+            currentTimeBase = marker.timeBase;
+        }
+        // 数据不足时剩余部分填充静音
+        std::fill(spanOutBuffer.begin() + framesRead * numberOfChannels, spanOutBuffer.end(), AudioSampleFormatType{ 0 });
+        audioDsp.process(spanOutBuffer.data(), nFrames, numberOfChannels); // 均衡器与平滑音量
+        analyzer.push(spanOutBuffer.data(), nFrames); // 分析线程处理，缓冲区满时丢弃
+        outputConverter.convert(spanOutBuffer.data(), outputBuffer, nFrames);
+
+        // 渲染事件由伴随线程分发，这里只拷贝数据到预先分配的消息中，队列满时丢弃
+        if (AudioCallbackMessage* message = callbackMessages.beginPush())
+        {
+            message->type = AudioCallbackMessage::Rendered;
+            message->nFrames = nFrames;
+            message->pts = currentPts;
+            message->timeBase = currentTimeBase;
+            message->frameTime = frameTime;
+            message->streamTime = streamTime;
+            message->durationInAvTimeBase = playbackStateVariables.durationInAvTimeBase.load(std::memory_order_relaxed);
+            message->sampleFormat = outputConverter.outputFormat();
+            message->dataSize = std::min(outputBytes, message->data.size());
+            std::memcpy(message->data.data(), outputBuffer, message->dataSize);
+            callbackMessages.commitPush();
+        }
     }
+    else
+        outputConverter.silence(outputBuffer, nFrames);
 
-    //lockMtxStreamQueue.unlock();
-    // 同步时钟，放在数据填充后可以免去seek后音频时钟跳动的问题（seek后未来得及修改时钟到正确的时钟就执行时钟同步）
-    if (playbackStateVariables.playOptions.clockSyncFunction)
+    // 读到了新曲目的起始位置，由伴随线程分发曲目切换事件
+    uint64_t trackChangePosition = playbackStateVariables.trackChangePosition.load(std::memory_order_acquire);
+    if (trackChangePosition != NO_TRACK_CHANGE && ringBuffer.readPosition() > trackChangePosition
+        && playbackStateVariables.trackChangePosition.compare_exchange_strong(trackChangePosition, NO_TRACK_CHANGE))
     {
-        int64_t sleepTime = 0;
-        playbackStateVariables.realtimeClock = streamTime;
-        auto rst = playbackStateVariables.playOptions.clockSyncFunction(playbackStateVariables.audioClock, true, playbackStateVariables.realtimeClock, sleepTime); // 同步时钟
-        if (rst && sleepTime != 0)
+        if (AudioCallbackMessage* message = callbackMessages.beginPush())
         {
-            if (sleepTime > 0)
-            {
-                // 需要等待
-                logger.trace("Audio sleep: {} ms", sleepTime);
-                ThreadSleepMs(sleepTime);
-            }
-            else //if (sleepTime < 0)
-            {
-                // 落后太多，跳过帧
-                logger.trace("Audio drop frame to catch up: {} ms", -sleepTime);
-                //while (!playbackStateVariables.streamQueue.empty() && playbackStateVariables.streamQueue.front().pts < currentPts)
-                //    playbackStateVariables.streamQueue.pop();
-            }
+            message->type = AudioCallbackMessage::TrackChanged;
+            message->dataSize = 0;
+            callbackMessages.commitPush();
         }
     }
-    //if (playbackStateVariables.streamQueue.size() < MIN_AUDIO_OUTPUT_STREAM_QUEUE_SIZE)
-    if (getQueueSize(playbackStateVariables.streamQueue) < MIN_AUDIO_OUTPUT_STREAM_QUEUE_SIZE)
-        playbackStateVariables.threadStateManager.wakeUpById(ThreadIdentifier::Decoder);
-    //logger.trace("Got audio streams, current audio stream queue size: {}", playbackStateVariables.streamQueue.size());
+    // 时钟同步由伴随线程完成，解码线程唤醒也交给伴随线程（需要加锁）
+    if (ringBuffer.readableFrames() < bufferController.lowWatermarkFrames())
+        playbackStateVariables.decoderWakeRequested.store(true, std::memory_order_relaxed);
     uint64_t currentPtsInAvTimeBase = currentTimeBase.num * currentPts * AV_TIME_BASE / currentTimeBase.den;
-    logger.trace("Current presentation timestamp: {}, duration: {}", currentPtsInAvTimeBase, playbackStateVariables.formatCtx->duration);
+    // 等待切换到下一项时数据耗尽只是下溢，不结束播放
     if (playerState == PlayerState::Stopped || playerState == PlayerState::Stopping
-        || (currentPtsInAvTimeBase >= playbackStateVariables.formatCtx->duration && !getQueueSize(playbackStateVariables.streamQueue)))
-        //|| (currentPtsInAvTimeBase >= playbackStateVariables.formatCtx->duration && playbackStateVariables.streamQueue.empty()))
+        || (currentPtsInAvTimeBase >= static_cast<uint64_t>(playbackStateVariables.durationInAvTimeBase.load(std::memory_order_relaxed)) && !ringBuffer.readableFrames()
+            && !playbackStateVariables.trackTransitionPending.load(std::memory_order_acquire)))
     {
         // 状态改变，播放结束
-        if (playerState == PlayerState::Stopped || playerState == PlayerState::Stopping)
+        const bool stoppedByUser = playerState == PlayerState::Stopped || playerState == PlayerState::Stopping;
+        if (AudioCallbackMessage* message = callbackMessages.beginPush())
         {
-            logger.trace("Audio playback stopped by user.");
-            return AudioAdapter::Abort;
+            message->type = stoppedByUser ? AudioCallbackMessage::Stopped : AudioCallbackMessage::Finished;
+            message->dataSize = 0;
+            callbackMessages.commitPush();
         }
-        logger.trace("Audio playback finished.");
-        return AudioAdapter::Complete;
+        return stoppedByUser ? AudioAdapter::Abort : AudioAdapter::Complete;
     }
     return AudioAdapter::Continue;
 }
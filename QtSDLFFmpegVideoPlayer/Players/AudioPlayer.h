@@ -3,27 +3,59 @@
 
 // 音频库
 #include <AudioAdapter.h>
+#include <NullAudioAdapter.h>
+#include <MixerAudioAdapter.h>
+#include <AudioDspChain.h>
+#include <AudioTimeStretcher.h>
+#include <AudioRingBuffer.h>
+#include <AudioOutputConverter.h>
+#include <AudioChannelMixer.h>
+#include <AudioBufferController.h>
+#include <RealtimeMessageQueue.h>
+#include <AudioAnalyzer.h>
+#include <AudioCrossfader.h>
+#include <AudioSyncAdjustment.h>
+#include <AudioTrackPreloader.h>
+
+class LoudnessScanner;
 
 class AudioPlayer : public AbstractPlayer, private ConcurrentQueueOps
 {
 public:
     // 用于AudioAdapter音频缓冲区大小
     static constexpr unsigned int DEFAULT_AUDIO_OUTPUT_STREAM_BUFFER_SIZE = 1024;
-    // 用于音频队列
-    static constexpr int MAX_AUDIO_OUTPUT_STREAM_QUEUE_SIZE = 5;
-    static constexpr int MIN_AUDIO_OUTPUT_STREAM_QUEUE_SIZE = 3;// MAX_AUDIO_OUTPUT_STREAM_QUEUE_SIZE / 2; // 1 / 2
-    // 默认音频输出通道数
-    static constexpr int DEFAULT_NUMBER_CHANNELS_AUDIO_OUTPUT = 1;
+    // PCM环形缓冲区的最小容量，单位：秒，需容纳高水位之上一个包解码（以及0.25倍速拉伸）后的数据
+    // 高低水位由AudioBufferController按下溢情况自适应调整
+    static constexpr double MIN_AUDIO_RING_BUFFER_SECONDS = 1.0;
+    // 默认音频输出通道数，实际通道数按源布局与设备通道数协商
+    static constexpr int DEFAULT_NUMBER_CHANNELS_AUDIO_OUTPUT = 2;
     // 下面两个常量需同时满足，解码才会暂停
     static constexpr uint64_t MAX_AUDIO_PACKET_QUEUE_SIZE = 200; // 最大音频帧队列数量
     //static constexpr uint64_t MAX_AUDIO_FRAME_QUEUE_SIZE = 200; // 最大音频帧队列数量
     // 低于下列值开始继续读取新的帧，取出新的值后<下列值开始通知读取线程
     static constexpr uint64_t MIN_AUDIO_PACKET_QUEUE_SIZE = 100; // 最小音频帧队列数量
-    // 统一音频转换后用于播放的格式
-    static constexpr AVSampleFormat AUDIO_OUTPUT_FORMAT = AVSampleFormat::AV_SAMPLE_FMT_S16;
-    using AudioSampleFormatType = int16_t;
-    // 用于播放的格式每单位样本大小
-    static constexpr int AUDIO_OUTPUT_FORMAT_BYTES_PER_SAMPLE = sizeof(AudioSampleFormatType); // AV_SAMPLE_FMT_S16 每个样本2字节
+    // 解码后统一转换的内部处理格式，变速、均衡器与音量都在float下进行，直到输出设备
+    static constexpr AVSampleFormat AUDIO_PROCESSING_FORMAT = AVSampleFormat::AV_SAMPLE_FMT_FLT;
+    using AudioSampleFormatType = float;
+    // 首选的设备输出格式，实际使用的格式按设备原生格式协商，设备不支持float时才转换为整数
+    static constexpr AVSampleFormat AUDIO_OUTPUT_FORMAT = AVSampleFormat::AV_SAMPLE_FMT_FLT;
+    // 音频回调发往伴随线程的消息队列容量，伴随线程来不及处理时丢弃新消息
+    static constexpr size_t CALLBACK_MESSAGE_QUEUE_SIZE = 64;
+    // 伴随线程处理回调消息的轮询间隔，单位：毫秒
+    static constexpr uint64_t CALLBACK_MESSAGE_POLL_INTERVAL_MS = 5;
+    // 下一项预先解码的时长，单位：秒，交叉淡化时另加淡化时长
+    static constexpr double TRACK_PRELOAD_DECODE_SECONDS = 0.5;
+    // 交叉淡化的最长时长，单位：秒，按此预先分配暂存缓冲区
+    static constexpr double MAX_CROSSFADE_SECONDS = 10.0;
+    // 当前曲目结束而下一项仍在预加载时，解码线程检查停止请求的间隔，单位：毫秒
+    static constexpr uint64_t TRACK_PRELOAD_WAIT_INTERVAL_MS = 5;
+    static constexpr uint64_t NO_TRACK_CHANGE = UINT64_MAX;
+    // 输出设备：跟随系统默认设备
+    static constexpr unsigned int FOLLOW_DEFAULT_OUTPUT_DEVICE = std::numeric_limits<unsigned int>::max();
+    // 跟随默认设备时检查默认设备是否改变的间隔，单位：毫秒
+    static constexpr uint64_t DEFAULT_OUTPUT_DEVICE_POLL_INTERVAL_MS = 1000;
+    // 重新打开输出流失败（例如暂时没有可用设备）后重试的间隔，单位：毫秒
+    static constexpr uint64_t OUTPUT_RECONNECT_RETRY_INTERVAL_MS = 500;
 
     static constexpr StreamTypes STREAM_TYPES = StreamType::STAudio;
 
@@ -46,6 +78,54 @@ public:
         double streamTime{ 0.0 }; // 流时间，单位s
         double volume{ 1.0 }; // 音量，范围0.0 ~ 1.0
         bool isMute{ false }; // 静音
+        AVSampleFormat sampleFormat{ AUDIO_OUTPUT_FORMAT }; // data中的样本格式，即协商得到的设备输出格式
+    };
+
+    // 响度归一化：按LoudnessScanner的扫描结果调整增益，曲目模式使用单曲响度，专辑模式使用同一目录下曲目全部扫描完成后的合并响度，完成前使用单曲响度
+    enum class LoudnessNormalizationMode {
+        Off,
+        Track,
+        Album
+    };
+    struct LoudnessNormalizationOptions {
+        LoudnessNormalizationMode mode{ LoudnessNormalizationMode::Off };
+        double targetLufs{ -18.0 }; // ReplayGain 2.0的参考响度
+        double preAmpDb{ 0.0 };
+        double maxGainDb{ 12.0 }; // 安静曲目的最大提升
+        bool preventClipping{ false }; // 按真峰值限制增益，使峰值不超过限幅阈值
+        bool limiter{ true }; // 启用限幅器，增益提升后的峰值由限幅器处理
+    };
+
+    // 曲目切换：设置了下一项时，当前曲目结束后不关闭设备，解码线程接管预加载的下一项继续写入同一个环形缓冲区
+    enum class TrackTransitionMode {
+        Gapless, // 样本级无缝衔接
+        Crossfade // 当前曲目的结尾与下一项的开头交叉淡化
+    };
+    struct TrackTransitionOptions {
+        TrackTransitionMode mode{ TrackTransitionMode::Gapless };
+        double crossfadeSeconds{ 3.0 }; // 不超过MAX_CROSSFADE_SECONDS
+    };
+    // 音频输出后端，下次打开输出流时生效
+    struct AudioOutputBackend {
+        AudioAdapterFactory::AudioAdapterAdapter adapter{ AudioAdapterFactory::RtAudioAdapter };
+        AudioAdapter::AudioApi api{ AudioAdapter::Unspecified }; // Unspecified时使用平台默认值，Dummy时使用NullAudioAdapter
+        NullAudioAdapter::Options nullOptions; // 仅NullAudioAdapter使用
+        std::shared_ptr<AudioMixer> mixer{ nullptr }; // 非空时作为混音器的一路输入，不单独打开设备，忽略以上设置
+    };
+    // 输出设备热切换：设备断开、默认设备改变或指定了新设备时，在伴随线程中重新打开输出流，解码线程不停止
+    enum class OutputReconnectReason {
+        DeviceDisconnected,
+        DefaultDeviceChanged,
+        DeviceSelected
+    };
+    struct OutputReconnectInfo {
+        OutputReconnectReason reason{ OutputReconnectReason::DeviceDisconnected };
+        unsigned int deviceId{ 0 };
+        int sampleRate{ 0 };
+        int numberOfChannels{ 0 };
+        bool formatChanged{ false }; // 采样率或声道布局改变，缓冲的数据已转换到新格式
+        unsigned int attempts{ 0 }; // 打开输出流的尝试次数
+        double elapsedMs{ 0.0 }; // 从关闭旧的输出流到新的输出流启动
     };
 
     struct DecodedFrameContext {
@@ -93,19 +173,14 @@ public:
 
 
 private:
-    struct AudioStreamInfo {
-        std::vector<uint8_t> dataBytes{}; // 如果是uint16_t格式的数据，nFrames表示播放缓冲区大小（在音频播放回调中使用），则dataBytes.size()应该是numberOfAudioOutputChannels * sizeof(uint16_t) * nFrames
-        //std::span<uint8_t> dataBytes{}; // 如果是uint16_t格式的数据，nFrames表示播放缓冲区大小（在音频播放回调中使用），则dataBytes.size()应该是numberOfAudioOutputChannels * sizeof(uint16_t) * nFrames
-        //std::vector<uint8_t> dataBytes{}; // 如果是uint16_t格式的数据，则dataBytes.size()应该是numberOfAudioOutputChannels * sizeof(uint16_t)
-        uint64_t pts{ 0 }; // Presentation Time Stamp
-        AVRational timeBase{ 1, AV_TIME_BASE }; // 时间基
-        double frameTime{ 0.0 }; // 帧对应的时间，单位s
-    };
-
     struct AudioPlaybackStateVariables { // 用于存储播放状态相关的数据
         // 用于回调时获取所属播放器对象
         AudioPlayer* owner{ nullptr };
         AudioPlaybackStateVariables(AudioPlayer* o) : owner(o) {}
+        ~AudioPlaybackStateVariables() {
+            av_channel_layout_uninit(&outputChannelLayout);
+            av_channel_layout_uninit(&pendingOutputChannelLayout);
+        }
 
         // 线程等待对象管理器
         ThreadStateManager threadStateManager;
@@ -113,9 +188,41 @@ private:
         // 音频输出与设备
         UniquePtrD<AudioAdapter> audioDevice;
         AtomicInt numberOfAudioOutputChannels = DEFAULT_NUMBER_CHANNELS_AUDIO_OUTPUT;
-        Atomic<unsigned int> audioOutputStreamBufferSize = DEFAULT_AUDIO_OUTPUT_STREAM_BUFFER_SIZE;
+        // 协商得到的设备采样率与声道布局，打开输出流或解码线程转换缓冲的数据时写入
+        // 采样率同时被回调与外部线程（getOutputLatency）读取，因此为原子变量；声道布局只在解码线程与打开输出流的线程访问
+        AtomicInt outputSampleRate{ 0 };
+        AVChannelLayout outputChannelLayout{};
+        Atomic<unsigned int> audioOutputStreamBufferSize = DEFAULT_AUDIO_OUTPUT_STREAM_BUFFER_SIZE; // 回调帧数超过打开时的值会被更新为观察到的最大值
+        unsigned int outputDeviceId{ 0 }; // 正在使用的设备，只在打开输出流的线程访问
+        std::string outputDeviceName; // 正在使用的设备名称，不同设备实例的编号可能不同，检查默认设备时按名称比较
+        Atomic<long> outputLatencyFrames{ 0 }; // 后端报告的输出延迟，单位：帧，打开输出流时写入，回调据此补偿音频时钟
+        // 输出设备重新连接：错误回调或外部请求置位，伴随线程处理
+        AtomicBool outputReconnectRequested{ false };
+        Atomic<OutputReconnectReason> outputReconnectReason{ OutputReconnectReason::DeviceDisconnected };
+        // 新设备的采样率或声道布局不同时，伴随线程写入新格式后置位，解码线程转换缓冲的数据后清除，期间回调不运行
+        AtomicBool outputReconfigurePending{ false };
+        int pendingOutputSampleRate{ 0 };
+        AVChannelLayout pendingOutputChannelLayout{};
+        // 等待转换期间环形缓冲区已满、未能写入的数据与时间戳标记，只在解码线程访问，转换时接在环形缓冲区的数据之后
+        std::vector<AudioSampleFormatType> heldOutputSamples;
+        std::vector<AudioRingBuffer::PtsMarker> heldOutputMarkers; // 位置相对于暂存数据的起点
         //Mutex mtxStreamQueue; // 用于保证在写入一段的时候不被读取
-        ConcurrentQueue<AudioStreamInfo> streamQueue;
+        AudioRingBuffer streamRingBuffer; // 解码线程写入，音频回调读取
+        // 时钟同步要求的调整量，单位：帧，伴随线程写入，解码线程取出：正值在写入位置插入静音，负值丢弃即将写入的数据
+        Atomic<int64_t> pendingSyncAdjustmentFrames{ 0 };
+        // 上一次调整在环形缓冲区中的结束位置，解码线程完成调整时写入，0表示没有正在生效的调整
+        // 读位置越过此处并再经过输出延迟后调整才体现在音频时钟上，此前伴随线程不再发出新的调整，避免重复修正
+        Atomic<uint64_t> syncAdjustmentEndPosition{ 0 };
+        AtomicBool decoderWakeRequested{ false }; // 回调中缓冲量低于低水位时置位，由伴随线程唤醒解码线程
+        Atomic<int64_t> durationInAvTimeBase{ 0 }; // 当前解码曲目的时长，回调据此判断播放结束
+        AtomicBool endOfTrackDrained{ false }; // 当前曲目的包已全部取出并冲洗了解码器，seek时重置
+        // 曲目切换，解码线程写入
+        AtomicBool trackTransitionPending{ false }; // 已设置下一项且尚未切换，期间数据耗尽时回调不结束播放
+        Atomic<uint64_t> trackChangePosition{ NO_TRACK_CHANGE }; // 新曲目在环形缓冲区中的起始位置，回调读到此处时通知伴随线程
+        mutable Mutex mtxTrackSwitch; // 保护文件路径、下一项、切换时替换的上下文指针与被替换下来的上下文
+        std::string nextFilePath;
+        SharedPtr<SingleDemuxer> retiredDemuxer{ nullptr }; // 切换前的曲目，伴随线程不再引用后释放
+        UniquePtr<AVCodecContext> retiredCodecCtx{ nullptr, constDeleterAVCodecContext };
         // 每次渲染音频修改的上下文
         //FrameContext renderFrameContext;
 
@@ -143,7 +250,7 @@ private:
 
         // 时钟
         AtomicDouble audioClock{ 0.0 }; // 单位s
-        double realtimeClock{ 0.0 };
+        double realtimeClock{ 0.0 }; // 只在伴随线程与请求处理线程中访问
 
         // 文件
         std::string filePath;
@@ -156,8 +263,15 @@ private:
             //std::unique_lock lockMtxStreamQueue(mtxStreamQueue); // 记得加锁
             //Queue<AudioStreamInfo> streamQueueNew;
             //streamQueue.swap(streamQueueNew);
-            ConcurrentQueue<AudioStreamInfo> streamQueueNew;
-            streamQueue.swap(streamQueueNew);
+            streamRingBuffer.reset();
+            heldOutputSamples.clear();
+            heldOutputMarkers.clear();
+            pendingSyncAdjustmentFrames.store(0);
+            syncAdjustmentEndPosition.store(0);
+            endOfTrackDrained.store(false);
+            // 新曲目还未输出就被清空时，在下一次回调中立即通知
+            if (trackChangePosition.load() != NO_TRACK_CHANGE)
+                trackChangePosition.store(0);
         }
         // 重置所有变量，除了playOptions和filePath
         void reset() {
@@ -171,6 +285,21 @@ private:
             codecCtx.reset();
             audioClock.store(0.0);
             realtimeClock = 0.0;
+            outputSampleRate.store(0);
+            av_channel_layout_uninit(&outputChannelLayout);
+            outputReconnectRequested.store(false);
+            outputReconfigurePending.store(false);
+            pendingOutputSampleRate = 0;
+            av_channel_layout_uninit(&pendingOutputChannelLayout);
+            durationInAvTimeBase.store(0);
+            trackTransitionPending.store(false);
+            trackChangePosition.store(NO_TRACK_CHANGE);
+            {
+                std::unique_lock lock(mtxTrackSwitch);
+                nextFilePath.clear();
+                retiredDemuxer.reset();
+                retiredCodecCtx.reset();
+            }
             // 清空请求任务队列
             requestQueueHandler = nullptr;
             //requestQueueHandler.reset();
@@ -190,6 +319,79 @@ private:
     Atomic<PlayerState> playerState{ PlayerState::Stopped };
     AtomicWaitObject<bool> waitStopped{ false }; // true表示已停止，false表示未停止
     AudioPlaybackStateVariables playbackStateVariables{ this };
+    AudioDspChain audioDsp; // 输出前的音量与均衡器处理
+    AudioOutputConverter outputConverter; // float到设备格式的转换
+    AudioBufferController bufferController; // 按回调统计自适应调整缓冲量
+    AudioTimeStretcher timeStretcher; // 变速不变调，只在解码线程处理
+    AudioAnalyzer analyzer; // 频谱与波形分析，回调只写入无锁环形缓冲区
+    // 曲目切换，预加载在后台线程中进行，交叉淡化只在解码线程处理
+    AudioTrackPreloader trackPreloader{ loggerName };
+    AudioCrossfader crossfader;
+    Atomic<TrackTransitionMode> trackTransitionMode{ TrackTransitionMode::Gapless };
+    AtomicDouble crossfadeSeconds{ 3.0 };
+    // 响度归一化，扫描器由外部持有，结果在扫描线程中回调
+    Mutex mtxLoudness;
+    LoudnessScanner* loudnessScanner{ nullptr };
+    size_t loudnessListenerId{ 0 };
+    LoudnessNormalizationOptions loudnessOptions;
+    std::string loudnessTrackPath; // 正在播放的文件
+    Mutex mtxOutputBackend;
+    AudioOutputBackend outputBackend;
+    Atomic<unsigned int> preferredOutputDeviceId{ FOLLOW_DEFAULT_OUTPUT_DEVICE };
+    // 打开输出流时协商得到的设备格式
+    struct OutputStreamFormat {
+        unsigned int deviceId{ 0 };
+        std::string deviceName;
+        int sampleRate{ 0 };
+        AVChannelLayout channelLayout{};
+        AVSampleFormat sampleFormat{ AUDIO_OUTPUT_FORMAT };
+        unsigned int bufferFrames{ 0 };
+        long latencyFrames{ 0 };
+        OutputStreamFormat() = default;
+        OutputStreamFormat(const OutputStreamFormat&) = delete;
+        OutputStreamFormat& operator=(const OutputStreamFormat&) = delete;
+        ~OutputStreamFormat() {
+            av_channel_layout_uninit(&channelLayout);
+        }
+    };
+    // 输出设备重新连接的进度，只在伴随线程访问
+    struct OutputReconnectContext {
+        bool active{ false }; // 旧的输出流已关闭，新的输出流尚未启动
+        bool streamOpened{ false }; // 新的输出流已打开，格式改变时等待解码线程转换缓冲的数据
+        OutputReconnectReason reason{ OutputReconnectReason::DeviceDisconnected };
+        unsigned int attempts{ 0 };
+        std::chrono::steady_clock::time_point startTime;
+        std::chrono::steady_clock::time_point nextAttemptTime;
+        std::chrono::steady_clock::time_point nextDefaultDevicePollTime;
+        bool formatChanged{ false };
+        OutputStreamFormat format;
+    };
+    OutputReconnectContext outputReconnect;
+    AtomicBool outputLatencyCompensation{ true };
+    Mutex mtxOutputReconnectInfo;
+    OutputReconnectInfo lastOutputReconnect;
+    // 音频回调发往伴随线程的消息，事件分发、日志与时钟同步都在伴随线程中完成
+    struct AudioCallbackMessage {
+        enum Type {
+            Rendered, // 输出了一块数据
+            Finished, // 播放到结尾
+            Stopped, // 用户停止
+            TrackChanged // 开始输出下一项
+        };
+        Type type{ Rendered };
+        unsigned int nFrames{ 0 };
+        uint64_t pts{ 0 };
+        AVRational timeBase{ 1, AV_TIME_BASE };
+        double frameTime{ 0.0 };
+        double streamTime{ 0.0 };
+        uint64_t durationInAvTimeBase{ 0 };
+        AVSampleFormat sampleFormat{ AUDIO_OUTPUT_FORMAT };
+        std::vector<uint8_t> data; // 输出数据的拷贝，打开输出流时预先分配，回调返回后设备缓冲区即失效
+        size_t dataSize{ 0 }; // 实际拷贝的字节数，预分配不足时截断
+    };
+    RealtimeMessageQueue<AudioCallbackMessage, CALLBACK_MESSAGE_QUEUE_SIZE> callbackMessages;
+    uint64_t droppedCallbackMessages{ 0 }; // 已报告的丢弃数，只在伴随线程访问
+    uint64_t reportedRealtimeViolations{ 0 }; // 已报告的回调内阻塞操作数（调试版本），只在伴随线程访问
     ComponentWorkMode demuxerMode{ ComponentWorkMode::Internal };
     SharedPtr<SingleDemuxer> internalDemuxer{ std::make_shared<SingleDemuxer>(loggerName, playbackStateVariables.demuxerStreamType) };
     SharedPtr<UnifiedDemuxer> externalDemuxer{ nullptr };
@@ -205,6 +407,7 @@ public:
     AudioPlayer() : AbstractPlayer(logger) {}
     ~AudioPlayer() {
         stop();
+        setLoudnessScanner(nullptr);
     }
     // options如果非空则覆盖之前的选项
     bool play(const std::string& filePath, const AudioPlayOptions& options) {
@@ -285,6 +488,78 @@ public:
         }
     }
 
+    // 音量与静音在音频回调中由audioDsp平滑调整，立即生效，不经过解码队列
+    void setVolume(double volume) {
+        playbackStateVariables.volume.store(std::clamp(volume, 0.0, 1.0));
+        updateOutputGain();
+    }
+    double getVolume() const { return playbackStateVariables.volume.load(); }
+    void setMute(bool state) {
+        playbackStateVariables.isMute.store(state);
+        updateOutputGain();
+    }
+    bool getMute() const { return playbackStateVariables.isMute.load(); }
+    // 原生DSP链，可在任意线程设置均衡器参数
+    AudioDspChain& getAudioDspChain() { return audioDsp; }
+    // 频谱与波形分析，启用后由独立线程按固定帧率输出分析帧
+    AudioAnalyzer& getAudioAnalyzer() { return analyzer; }
+    // 自适应缓冲，可设置延迟范围并读取回调间隔、下溢与填充量统计
+    AudioBufferController& getAudioBufferController() { return bufferController; }
+    // 设置响度扫描器，不持有所有权，销毁扫描器前需先设置为nullptr
+    // 播放的文件没有扫描结果时会被移到扫描队列的最前面，结果到达后立即生效
+    void setLoudnessScanner(LoudnessScanner* scanner);
+    void setLoudnessNormalization(const LoudnessNormalizationOptions& options);
+    LoudnessNormalizationOptions getLoudnessNormalization() {
+        std::unique_lock lock(mtxLoudness);
+        return loudnessOptions;
+    }
+    // 设置当前曲目结束后衔接的下一项，空字符串表示取消，需在播放中设置，停止后清除
+    // 设置后立即在后台预加载，只在内部解复用器模式下可用，外部解复用器由所属的播放器管理，返回false
+    bool setNextFilePath(const std::string& filePath);
+    std::string getNextFilePath() {
+        std::unique_lock lock(playbackStateVariables.mtxTrackSwitch);
+        return playbackStateVariables.nextFilePath;
+    }
+    void setTrackTransition(const TrackTransitionOptions& options) {
+        trackTransitionMode.store(options.mode);
+        crossfadeSeconds.store(std::clamp(options.crossfadeSeconds, 0.0, MAX_CROSSFADE_SECONDS));
+    }
+    TrackTransitionOptions getTrackTransition() const {
+        return { trackTransitionMode.load(), crossfadeSeconds.load() };
+    }
+    // 设置音频输出后端，下次打开输出流时生效
+    void setAudioOutputBackend(const AudioOutputBackend& backend) {
+        std::unique_lock lock(mtxOutputBackend);
+        outputBackend = backend;
+    }
+    AudioOutputBackend getAudioOutputBackend() {
+        std::unique_lock lock(mtxOutputBackend);
+        return outputBackend;
+    }
+    // 选择输出设备，FOLLOW_DEFAULT_OUTPUT_DEVICE表示跟随系统默认设备，设备不可用时回退到默认设备
+    // 播放中立即在伴随线程中重新打开输出流，缓冲的数据与音频时钟保持不变
+    void setOutputDevice(unsigned int deviceId) {
+        if (preferredOutputDeviceId.exchange(deviceId) != deviceId)
+            requestOutputReconnect(OutputReconnectReason::DeviceSelected);
+    }
+    unsigned int getOutputDevice() const { return preferredOutputDeviceId.load(); }
+    // 最近一次重新连接输出设备的结果，没有发生过时attempts为0
+    OutputReconnectInfo getLastOutputReconnect() {
+        std::unique_lock lock(mtxOutputReconnectInfo);
+        return lastOutputReconnect;
+    }
+    // 输出设备报告的延迟，单位：秒，后端不报告时为0
+    double getOutputLatency() const {
+        const int rate = playbackStateVariables.outputSampleRate.load();
+        return rate > 0 ? static_cast<double>(playbackStateVariables.outputLatencyFrames.load()) / rate : 0.0;
+    }
+    // 开启时音频时钟减去输出延迟，表示正在从设备播出的位置，而不是刚交给设备的位置
+    void setOutputLatencyCompensation(bool enabled) { outputLatencyCompensation.store(enabled); }
+    bool getOutputLatencyCompensation() const { return outputLatencyCompensation.load(); }
+    // 倍速由解码线程中的WSOLA变速处理，范围0.25 ~ 4.0，可连续调整，不需要重建滤镜图
+    void setSpeed(double speed) { timeStretcher.setRatio(speed); }
+    double getSpeed() const { return timeStretcher.getRatio(); }
+
     //void mute() { setMute(true); }
     //void unmute() { setMute(false); }
     //virtual void setMute(bool state) override {
@@ -353,10 +628,13 @@ public:
 
 
     virtual void setFilePath(const std::string& filePath) override {
+        std::unique_lock lock(playbackStateVariables.mtxTrackSwitch);
         this->playbackStateVariables.filePath = filePath;
     }
 
+    // 曲目切换后返回正在解码的曲目，可能先于trackChangeEvent改变
     virtual std::string getFilePath() const override {
+        std::unique_lock lock(playbackStateVariables.mtxTrackSwitch);
         return playbackStateVariables.filePath;
     }
     
@@ -415,6 +693,14 @@ protected:
     // 渲染事件处理函数，子类可重写以实现自定义渲染逻辑
     virtual void renderEvent(AudioRenderEvent* e) {
 
+    }
+    // 曲目切换事件，下一项开始输出时在伴随线程中调用，之后的渲染事件属于新曲目
+    virtual void trackChangeEvent(const std::string& filePath) {
+
+    }
+    // 输出设备重新连接完成后在伴随线程中调用
+    virtual void outputReconnectEvent(const OutputReconnectInfo& info) {
+
     }
     void clearBuffers() {
         // 清空队列
@@ -422,6 +708,11 @@ protected:
         // 刷新解码器buffer
         if (playbackStateVariables.codecCtx)
             avcodec_flush_buffers(playbackStateVariables.codecCtx.get());
+        // 丢弃变速器中缓存的旧位置数据
+        timeStretcher.reset();
+        crossfader.reset();
+        // 重新预充期间不统计下溢
+        bufferController.restart();
     }
     int64_t clockSync(uint64_t pts, StreamIndexType streamIndex, bool isStable) {
         if (streamIndex >= 0 && streamIndex < playbackStateVariables.formatCtx->nb_streams)
@@ -460,10 +751,21 @@ private:
     }
 
     void resetPlayer() {
+        trackPreloader.cancel();
         playbackStateVariables.reset();
+        outputReconnect.active = false;
+        outputReconnect.streamOpened = false;
         setPlayerState(PlayerState::Stopped);
     }
 
+    // 按当前文件的扫描结果设置DSP链的归一化增益与限幅器
+    // \param transitionSeconds 增益从当前值线性过渡的时长，单位：秒
+    void applyLoudnessNormalization(double transitionSeconds = 0.0);
+
+    void updateOutputGain() {
+        audioDsp.setGain(playbackStateVariables.isMute.load() ? 0.0 : playbackStateVariables.volume.load());
+    }
+
 
     bool shouldCommitRequest() {
         return !isStopped() && playerState != PlayerState::Stopping
@@ -495,10 +797,26 @@ private:
     void cleanupAfterPlayback();
 
     void audioOutputStreamErrorCallback(AudioAdapter::AudioErrorType type, const std::string& errorText);
+    // 请求在伴随线程中重新打开输出流，未播放时忽略
+    void requestOutputReconnect(OutputReconnectReason reason);
+    // 伴随线程中调用：处理重新连接请求、重试与等待解码线程，跟随默认设备时检查默认设备是否改变
+    void serviceOutputReconnect();
+    // 重新打开输出流：格式不变时直接接管环形缓冲区，否则交给解码线程转换，返回false表示需要重试
+    bool reopenOutputAudioStream();
+    // 新的输出流已就绪，准备回调使用的组件后启动
+    void finishOutputReconnect();
+    // 解码线程中调用：把环形缓冲区与交叉淡化器中缓冲的数据转换到新的采样率与声道布局，标记随之换算
+    void convertBufferedAudio(int oldSampleRate, const AVChannelLayout& oldChannelLayout);
     
     // 打开------------------------------------------------------
     // frameBufferSize = 0 时使用默认缓冲区大小（1024），或者 *frameBufferSize = 0 时，即最小允许值（根据RtAudio文档），该参数将返回实际使用的缓冲区大小
     bool openOutputAudioStream(int sampleRate, AVChannelLayout channelLayout, AVSampleFormat sampleFmt, unsigned int* frameBufferSize = 0);
+    // 按输出后端创建新的设备实例，由调用方持有，新实例才能枚举到变化后的设备
+    static AudioAdapter* createOutputAudioAdapter(const AudioOutputBackend& backend);
+    // 创建设备实例、协商格式并打开输出流，不修改播放状态，优先使用选择的设备，失败时回退到默认设备
+    bool openOutputAudioDevice(int sampleRate, const AVChannelLayout& channelLayout, AVSampleFormat sampleFmt, unsigned int* frameBufferSize, OutputStreamFormat& outFormat);
+    // 按协商得到的格式准备输出转换与回调消息，prepareStreamBuffers为true时同时准备DSP、分析器与环形缓冲区
+    void applyOutputStreamFormat(const OutputStreamFormat& format, bool prepareStreamBuffers);
     bool startOutputAudioStream();
     bool openAndStartOutputAudioStream(int sampleRate, AVChannelLayout channelLayout, AVSampleFormat sampleFmt, unsigned int* frameBufferSize = 0);
     // ----------------------------------------------------------
@@ -546,12 +864,16 @@ private:
     
     // 将包转化为音频输出流
     void packet2AudioStreams();
+    // 开始预加载下一项，会等待之前的预加载线程结束，不能持有mtxTrackSwitch
+    void preloadNextTrack(const std::string& filePath);
 
-    // 播放音频，预留用于同步输出，异步输出将使用renderAudioAsyncCallback
+    // 音频回调的伴随线程（非实时），处理renderAudioAsyncCallback发出的消息
     void renderAudio();
+    // 处理队列中所有回调消息：分发渲染事件、输出日志、同步时钟并按需唤醒解码线程
+    void processCallbackMessages();
 
     // 音频输出回调，用于异步输出
-    // 内部处理音频的回调函数
+    // 内部处理音频的回调函数，运行在后端的实时线程中，只做无等待的操作：不加锁、不睡眠、不分配内存、不输出日志
     // \param userData 保留参数，暂时为指向当前VideoPlayer实例的指针
     AudioAdapter::AudioCallbackResult renderAudioAsyncCallback(void*& outputBuffer, void*& inputBuffer, unsigned int& nFrames, double& streamTime, AudioAdapter::AudioStreamStatuses& status, AudioAdapter::RawArgsType& rawArgs, AudioAdapter::UserDataType& userData);
 
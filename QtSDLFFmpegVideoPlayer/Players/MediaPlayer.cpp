@@ -52,6 +52,7 @@ void MediaPlayer::requestTaskHandlerSeek(MediaRequestHandleEvent* e, std::any us
     }
     videoPlayer->clearBuffers();
     audioPlayer->clearBuffers();
+    subtitlePlayer->clearBuffers();
     AVPacket* packet = nullptr;
     demuxer->readOnePacket(&packet);
     if (packet)
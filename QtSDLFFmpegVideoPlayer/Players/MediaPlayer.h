@@ -3,6 +3,8 @@
 #include "PlayerPredefine.h"
 #include "VideoPlayer.h"
 #include "AudioPlayer.h"
+#include "SubtitlePlayer.h"
+#include <ControlExecutor.h>
 
 class MediaPlayer : public AbstractPlayer
 {
@@ -34,6 +36,7 @@ public:
     using VideoDecodeType = VideoPlayer::DecodeType;
     using VideoFrameFilterGraphCreator = VideoPlayer::VideoFrameFilterGraphCreator;
     using AudioFrameFilterGraphCreator = AudioPlayer::AudioFrameFilterGraphCreator;
+    using VideoPowerMode = VideoPlayer::PowerMode;
 
     struct MediaPlayOptions {
         VideoDecodeType decodeType{ VideoDecodeType::Unset/*默认,不设置*/ }; // Video
@@ -158,6 +161,14 @@ public:
             // 转发渲染事件
             player.event(e);
         }
+        virtual void trackChangeEvent(const std::string& filePath) override {
+            {
+                std::unique_lock lock(player.mtxFilePath);
+                player.filePath = filePath;
+            }
+            player.logger.info("Track changed: {}", filePath);
+            player.trackChangeEvent(filePath);
+        }
     };
     friend class MediaVideoPlayer;
     friend class MediaAudioPlayer;
@@ -171,7 +182,10 @@ private:
     Mutex singlePlaybackMtx; // 单次播放互斥锁
     AtomicWaitObject<bool> isPlayingFlag{ false }; // 是否正在播放标志
 
+    mutable Mutex mtxFilePath; // 纯音频播放时曲目切换在音频伴随线程中修改filePath
     std::string filePath;
+    // 没有视频流（或只有封面图）的文件由音频播放器的内部解复用器单独播放，可衔接下一项
+    AtomicBool audioOnlyPlayback{ false };
     Atomic<AVSyncMode> avSyncMode{ AVSyncMode::VideoSyncToAudio };
     // 默认的流索引选择器：选择第一个流
     StreamIndexSelector streamIndexSelector = [](StreamIndexType& outStreamIndex, StreamType type, const std::span<AVStream*>& streamsSpan, const AVFormatContext* fmtCtx) -> bool {
@@ -269,33 +283,35 @@ private:
     //MediaAudioPlayer* audioPlayer{ static_cast<MediaAudioPlayer*>(players[1].get()) };
     UniquePtrD<MediaVideoPlayer> videoPlayer{ std::make_unique<MediaVideoPlayer>(*this) }; // 视频播放器
     UniquePtrD<MediaAudioPlayer> audioPlayer{ std::make_unique<MediaAudioPlayer>(*this) }; // 音频播放器
+    UniquePtrD<SubtitlePlayer> subtitlePlayer{ std::make_unique<SubtitlePlayer>() }; // 字幕播放器，仅在外部解复用器模式下工作
 
     // 状态，用于中转处理
     Atomic<PlayerState> playerState{ PlayerState::Stopped };
     // 解复用器
     SharedPtr<UnifiedDemuxer> demuxer{ std::make_shared<UnifiedDemuxer>(loggerName) };
-    StreamTypes demuxerStreamTypes{ static_cast<StreamType>(STVideo | STAudio) };
+    StreamTypes demuxerStreamTypes{ static_cast<StreamType>(STVideo | STAudio | STSubtitle) };
     ComponentWorkMode demuxerMode{ ComponentWorkMode::External };
     ComponentWorkMode requestTaskQueueHandlerMode{ ComponentWorkMode::External };
     SharedPtr<RequestTaskQueueHandler> requestTaskQueueHandler{ std::make_shared<RequestTaskQueueHandler>(this) };
 
+    // 控制命令在常驻线程中并行执行，放在子播放器之后声明，先于子播放器销毁
+    ControlExecutor controlExecutor;
+    Atomic<int64_t> controlTimeoutMs{ 0 }; // 0表示一直等待
+
     // 无论是否异步执行，函数对象均进行拷贝，保证对象有效
-    void execPlayerWithThreads(const std::vector<std::function<void()>>& functions, bool wait = true) {
-        std::vector<std::thread> threads;
-        for (const auto& func : functions)
-            threads.emplace_back([func]() { func(); }); // 拷贝函数对象，以防止引用失效
-        if (wait)
+    // 不等待或使用超时时，函数对象不能引用调用者的局部变量
+    void execPlayerControl(const char* command, const std::vector<std::function<void()>>& functions, bool wait = true, bool useTimeout = false) {
+        if (!wait)
         {
-            for (auto& thread : threads)
-                if (thread.joinable())
-                    thread.join();
+            controlExecutor.post(functions);
+            return;
         }
+        const std::chrono::milliseconds timeout{ useTimeout ? controlTimeoutMs.load() : 0 };
+        auto result = controlExecutor.run(functions, timeout);
+        if (!result.completed)
+            logger.warning("Player control {} timed out after {} ms, continuing in background.", command, timeout.count());
         else
-        {
-            for (auto& thread : threads)
-                if (thread.joinable())
-                    thread.detach();
-        }
+            logger.trace("Player control {} took {} ms.", command, result.latencyMs);
     }
 
     bool playMediaFile(const MediaPlayOptions& options) {
@@ -316,20 +332,58 @@ private:
         };
         bool ar = true;
         bool vr = true;
-        execPlayerWithThreads({ [&] { waitComponentsStop(); }, [&] { vr = videoPlayer->play(filePath, videoOptions); }, [&] { ar = audioPlayer->play(filePath, audioOptions); } });
+        const std::string path = getFilePath();
+        if (audioOnlyPlayback.load())
+        {
+            controlExecutor.run({ [&] { ar = audioPlayer->play(path, audioOptions); } }, ControlExecutor::NO_TIMEOUT, false);
+            return ar;
+        }
+        // 播放任务在整个播放期间占用执行线程，不计入控制延迟
+        controlExecutor.run({ [&] { waitComponentsStop(); }, [&] { vr = videoPlayer->play(path, videoOptions); }, [&] { ar = audioPlayer->play(path, audioOptions); } }, ControlExecutor::NO_TIMEOUT, false);
         return ar && vr;
     }
     bool playMediaFile() {
         bool ar = true;
         bool vr = true;
-        execPlayerWithThreads({ [&] { waitComponentsStop(); } , [&] { vr = videoPlayer->play(); }, [&] { ar = audioPlayer->play(); } });
+        if (audioOnlyPlayback.load())
+        {
+            controlExecutor.run({ [&] { ar = audioPlayer->play(); } }, ControlExecutor::NO_TIMEOUT, false);
+            return ar;
+        }
+        controlExecutor.run({ [&] { waitComponentsStop(); } , [&] { vr = videoPlayer->play(); }, [&] { ar = audioPlayer->play(); } }, ControlExecutor::NO_TIMEOUT, false);
         return ar && vr;
     }
+    // 没有视频流，或唯一的视频流是封面图（attached pic）
+    bool isAudioOnly() const {
+        const StreamIndexType videoIndex = demuxer->getStreamIndex(StreamType::STVideo);
+        if (videoIndex < 0)
+            return true;
+        const AVFormatContext* fmtCtx = demuxer->getFormatContext();
+        return fmtCtx && (fmtCtx->streams[videoIndex]->disposition & AV_DISPOSITION_ATTACHED_PIC);
+    }
+    // 切换到音频播放器的内部解复用器与请求处理器，曲目衔接时由音频播放器打开下一项
+    void setAudioOnlyPlayback(bool audioOnly) {
+        if (audioOnlyPlayback.exchange(audioOnly) == audioOnly)
+            return;
+        const ComponentWorkMode mode = audioOnly ? ComponentWorkMode::Internal : ComponentWorkMode::External;
+        setDemuxerMode(mode);
+        setRequestTaskQueueHandlerMode(mode);
+    }
     bool prepareToPlay() {
+        setAudioOnlyPlayback(false);
         if (demuxerMode == ComponentWorkMode::External)
         {
             try {
-                demuxer->openAndSelectStreams(filePath, demuxerStreamTypes, streamIndexSelector);
+                demuxer->openAndSelectStreams(getFilePath(), demuxerStreamTypes, streamIndexSelector);
+                if (isAudioOnly())
+                {
+                    // 封面图不显示，音频播放器重新打开文件
+                    demuxer->close();
+                    setAudioOnlyPlayback(true);
+                    logger.info("No video stream, playing audio only.");
+                    return true;
+                }
+                subtitlePlayer->open(); // 没有字幕流或者打开失败时不显示字幕，不影响音视频播放
                 demuxer->start();
             }
             catch (std::exception e) { // openAndSelectStreams failed
@@ -347,6 +401,8 @@ private:
             requestTaskQueueHandler->waitStop();
     }
     void cleanUpPlayer() {
+        subtitlePlayer->close();
+        setAudioOnlyPlayback(false);
         audioClock.store(0);
         isAudioClockStable.store(false);
         playerState.set(PlayerState::Stopped);
@@ -407,22 +463,22 @@ public:
         return rst;
     }
     virtual void resume() override {
-        execPlayerWithThreads({ [&] { videoPlayer->resume(); }, [&] { audioPlayer->resume(); } });
+        execPlayerControl("resume", { [this] { videoPlayer->resume(); }, [this] { audioPlayer->resume(); } }, true, true);
     }
     virtual void pause() override {
-        execPlayerWithThreads({ [&] { videoPlayer->pause(); }, [&] { audioPlayer->pause(); } });
+        execPlayerControl("pause", { [this] { videoPlayer->pause(); }, [this] { audioPlayer->pause(); } }, true, true);
     }
     virtual void notifyStop() override {
         if (demuxerMode == ComponentWorkMode::External)
             demuxer->stop();
-        execPlayerWithThreads({ [&] { videoPlayer->notifyStop(); }, [&] { audioPlayer->notifyStop(); } });
+        execPlayerControl("notifyStop", { [this] { videoPlayer->notifyStop(); }, [this] { audioPlayer->notifyStop(); } }, true, true);
         if (requestTaskQueueHandlerMode == ComponentWorkMode::External)
             requestTaskQueueHandler->stop();
     }
     virtual void stop() override {
         if (demuxerMode == ComponentWorkMode::External)
             demuxer->stop();
-        execPlayerWithThreads({ [&] { videoPlayer->stop(); }, [&] { audioPlayer->stop(); } });
+        execPlayerControl("stop", { [this] { videoPlayer->stop(); }, [this] { audioPlayer->stop(); } }, true, true);
         if (requestTaskQueueHandlerMode == ComponentWorkMode::External)
             requestTaskQueueHandler->stop();
         isPlayingFlag.wait(false);
@@ -446,7 +502,7 @@ public:
     //    return audioPlayer->getVolume();
     //}
     //virtual void setSpeed(double speed) override {
-    //    execPlayerWithThreads({ [&] { videoPlayer->setSpeed(speed); }, [&] { audioPlayer->setSpeed(speed); } }, true);
+    //    execPlayerControl("setSpeed", { [&] { videoPlayer->setSpeed(speed); }, [&] { audioPlayer->setSpeed(speed); } }, true);
     //}
     //virtual double getSpeed() const override {
     //    double vs = videoPlayer->getSpeed();
@@ -482,7 +538,7 @@ public:
         videoSeekingCount.fetch_add(1); // Fix the problem that audio haven't seeked yet when video seeked complete
         audioSeekingCount.fetch_add(1); // 修复视频seek完成时音频还没有seek的问题
         if (demuxerMode == ComponentWorkMode::Internal)
-            execPlayerWithThreads({ [&] { videoPlayer->notifySeek(pts, streamIndex); }, [&] { audioPlayer->notifySeek(pts, streamIndex); } });
+            execPlayerControl("notifySeek", { [this, pts, streamIndex] { videoPlayer->notifySeek(pts, streamIndex); }, [this, pts, streamIndex] { audioPlayer->notifySeek(pts, streamIndex); } });
         else
             requestTaskQueueHandler->push(RequestTaskType::Seek, { ThreadIdentifier::Demuxer, ThreadIdentifier::Decoder, ThreadIdentifier::Renderer }, new MediaSeekEvent{ StreamType::STAll, pts, streamIndex }, std::bind(&MediaPlayer::requestTaskHandlerSeek, this, std::placeholders::_1, std::placeholders::_2));
         videoSeekingCount.fetch_sub(1); // Fix
@@ -492,7 +548,7 @@ public:
         videoSeekingCount.fetch_add(1); // Fix the problem that audio haven't seeked yet when video seeked complete
         audioSeekingCount.fetch_add(1); // 修复视频seek完成时音频还没有seek的问题
         if (demuxerMode == ComponentWorkMode::Internal)
-            execPlayerWithThreads({ [&] { videoPlayer->seek(pts, streamIndex); }, [&] { audioPlayer->seek(pts, streamIndex); } });
+            execPlayerControl("seek", { [this, pts, streamIndex] { videoPlayer->seek(pts, streamIndex); }, [this, pts, streamIndex] { audioPlayer->seek(pts, streamIndex); } });
         else
             requestTaskQueueHandler->push(RequestTaskType::Seek, { ThreadIdentifier::Demuxer, ThreadIdentifier::Decoder, ThreadIdentifier::Renderer }, new MediaSeekEvent{ StreamType::STAll, pts, streamIndex }, std::bind(&MediaPlayer::requestTaskHandlerSeek, this, std::placeholders::_1, std::placeholders::_2));
         videoSeekingCount.fetch_sub(1); // Fix
@@ -517,13 +573,34 @@ public:
     }
 
     virtual void setFilePath(const std::string& filePath) override {
-        this->filePath = filePath;
+        {
+            std::unique_lock lock(mtxFilePath);
+            this->filePath = filePath;
+        }
         this->videoPlayer->setFilePath(filePath);
         this->audioPlayer->setFilePath(filePath);
     }
+    // 纯音频播放衔接到下一项后返回新曲目
     virtual std::string getFilePath() const override {
+        std::unique_lock lock(mtxFilePath);
         return this->filePath;
     }
+    // 设置当前曲目结束后无缝衔接或交叉淡化的下一项，空字符串表示取消
+    // 只在纯音频播放（没有视频流）时可用，否则返回false，由调用者在播放结束后播放下一项
+    bool setNextFilePath(const std::string& filePath) {
+        if (!audioOnlyPlayback.load())
+            return false;
+        return audioPlayer->setNextFilePath(filePath);
+    }
+    std::string getNextFilePath() {
+        return audioPlayer->getNextFilePath();
+    }
+    void setTrackTransition(const AudioPlayer::TrackTransitionOptions& options) {
+        audioPlayer->setTrackTransition(options);
+    }
+    bool isAudioOnlyPlayback() const {
+        return audioOnlyPlayback.load();
+    }
 private:
     virtual void setDemuxerMode(ComponentWorkMode mode) override {
         this->videoPlayer->setDemuxerMode(mode);
@@ -536,6 +613,7 @@ private:
     virtual void setExternalDemuxer(const SharedPtr<UnifiedDemuxer>& demuxer) override {
         this->videoPlayer->setExternalDemuxer(demuxer);
         this->audioPlayer->setExternalDemuxer(demuxer);
+        this->subtitlePlayer->setExternalDemuxer(demuxer);
     }
     virtual void setRequestTaskQueueHandlerMode(ComponentWorkMode mode) override {
         this->videoPlayer->setRequestTaskQueueHandlerMode(mode);
@@ -569,11 +647,106 @@ public:
         this->videoPlayer->enableHardwareDecoding(enabled);
     }
 
+    // 视频省电模式，窗口最小化、隐藏或被遮挡时使用，音频照常播放
+    // 从Suspended恢复时只重新同步视频，音频不受影响：
+    // 内部解复用器时视频单独seek到音频时钟；共享的外部解复用器不能只seek视频流，
+    // 读取位置本就跟随音频，视频从之后的第一个关键帧恢复，落后的帧由时钟同步丢弃
+    void setVideoPowerMode(VideoPowerMode mode) {
+        VideoPowerMode oldMode = videoPlayer->getPowerMode();
+        videoPlayer->setPowerMode(mode);
+        if (mode == VideoPowerMode::Suspended)
+            isVideoClockStable.store(false); // 视频时钟不再更新
+        else if (oldMode == VideoPowerMode::Suspended && !videoPlayer->isStopped() && !audioPlayer->isStopped())
+        {
+            if (demuxerMode == ComponentWorkMode::Internal)
+            {
+                logger.info("Video resumed from power saving, seeking video to audio clock: {} s", audioClock.load());
+                videoSeekingCount.fetch_add(1);
+                videoPlayer->seek(static_cast<uint64_t>(audioClock.load() * AV_TIME_BASE), -1);
+                videoSeekingCount.fetch_sub(1);
+            }
+            else
+                logger.info("Video resumed from power saving, resuming from the next keyframe.");
+        }
+    }
+    VideoPowerMode getVideoPowerMode() const {
+        return videoPlayer->getPowerMode();
+    }
+
+    // 字幕播放器，渲染器通过它将字幕混合到视频帧
+    SubtitlePlayer* getSubtitlePlayer() const {
+        return this->subtitlePlayer.get();
+    }
+    // 音频输出前的原生DSP链（均衡器）
+    AudioDspChain& getAudioDspChain() {
+        return audioPlayer->getAudioDspChain();
+    }
+    // 音频频谱与波形分析
+    AudioAnalyzer& getAudioAnalyzer() {
+        return audioPlayer->getAudioAnalyzer();
+    }
+    // 音频自适应缓冲的延迟范围与统计
+    AudioBufferController& getAudioBufferController() {
+        return audioPlayer->getAudioBufferController();
+    }
+    // 响度归一化，扫描器由调用者持有
+    void setLoudnessScanner(LoudnessScanner* scanner) {
+        audioPlayer->setLoudnessScanner(scanner);
+    }
+    void setLoudnessNormalization(const AudioPlayer::LoudnessNormalizationOptions& options) {
+        audioPlayer->setLoudnessNormalization(options);
+    }
+    // 音频输出后端，下次播放时生效；Dummy为无设备的空输出，可写入WAV文件并加速时钟
+    void setAudioOutputBackend(const AudioPlayer::AudioOutputBackend& backend) {
+        audioPlayer->setAudioOutputBackend(backend);
+    }
+    AudioPlayer::AudioOutputBackend getAudioOutputBackend() {
+        return audioPlayer->getAudioOutputBackend();
+    }
+    // 输出设备热切换，播放中立即重新打开输出流，缓冲的数据与音频时钟保持不变
+    void setAudioOutputDevice(unsigned int deviceId) {
+        audioPlayer->setOutputDevice(deviceId);
+    }
+    unsigned int getAudioOutputDevice() const {
+        return audioPlayer->getOutputDevice();
+    }
+    AudioPlayer::OutputReconnectInfo getLastAudioOutputReconnect() {
+        return audioPlayer->getLastOutputReconnect();
+    }
+    // 音频输出延迟，单位：秒，开启补偿时音频时钟（以及同步到它的视频）按此提前
+    double getAudioOutputLatency() const {
+        return audioPlayer->getOutputLatency();
+    }
+    void setAudioOutputLatencyCompensation(bool enabled) {
+        audioPlayer->setOutputLatencyCompensation(enabled);
+    }
+    bool getAudioOutputLatencyCompensation() const {
+        return audioPlayer->getOutputLatencyCompensation();
+    }
+    // 暂停、恢复与停止等待子播放器的最长时间，单位：毫秒，0表示一直等待，超时后命令在后台继续执行
+    void setControlTimeout(int64_t ms) { controlTimeoutMs.store(std::max<int64_t>(ms, 0)); }
+    int64_t getControlTimeout() const { return controlTimeoutMs.load(); }
+    // 控制命令从提交到子播放器全部完成的延迟与执行线程统计
+    ControlExecutor::Statistics getControlStatistics() { return controlExecutor.getStatistics(); }
+    void setAudioVolume(double volume) {
+        audioPlayer->setVolume(volume);
+    }
+    void setAudioMute(bool state) {
+        audioPlayer->setMute(state);
+    }
+    // 音频变速不变调，视频跟随音频时钟，因此整体倍速随之改变
+    void setAudioSpeed(double speed) {
+        audioPlayer->setSpeed(speed);
+    }
+    double getAudioSpeed() const {
+        return audioPlayer->getSpeed();
+    }
+
 
     StreamTypes getStreamTypes() {
         AVFormatContext* fmtCtx = nullptr;
         // 打开文件
-        if (!openInput(filePath, fmtCtx))
+        if (!openInput(getFilePath(), fmtCtx))
             return StreamType::STNone;
         // 查找流信息
         if (!findStreamInfo(fmtCtx))
@@ -632,6 +805,9 @@ protected:
     // seek进度调整事件
     virtual void seekEvent(MediaSeekEvent* e) override {
     }
+    // 纯音频播放衔接到下一项，新曲目开始输出时在音频伴随线程中调用
+    virtual void trackChangeEvent(const std::string& filePath) {
+    }
 
 private:
     void setPlayerState(PlayerState state) {
@@ -121,15 +121,22 @@ bool AbstractPlayer::event(IMediaEvent* e)
 }
 
 
-bool MediaDecodeUtils::openFile(Logger* logger, AVFormatContext*& fmtCtx, const std::string& filePath)
+bool MediaDecodeUtils::openFile(Logger* logger, AVFormatContext*& fmtCtx, const std::string& filePath, const AVIOInterruptCB* interruptCallback)
 {
     if (filePath.empty())
     {
         logger->error("File path is empty.");
         return false;
     }
-    // 打开输入文件
+    // 打开输入文件，需要中断回调时先分配上下文，打开失败时由avformat_open_input释放
     fmtCtx = nullptr;
+    if (interruptCallback && interruptCallback->callback)
+    {
+        fmtCtx = avformat_alloc_context();
+        if (!fmtCtx)
+            return false;
+        fmtCtx->interrupt_callback = *interruptCallback;
+    }
     if (avformat_open_input(&fmtCtx, filePath.c_str(), nullptr, nullptr) < 0)
     {
         logger->error("Cannot open file: {}", filePath.c_str());
@@ -137,10 +144,10 @@ bool MediaDecodeUtils::openFile(Logger* logger, AVFormatContext*& fmtCtx, const
     }
     return true;
 }
-bool MediaDecodeUtils::openFile(Logger* logger, UniquePtr<AVFormatContext>& fmtCtx, const std::string& filePath)
+bool MediaDecodeUtils::openFile(Logger* logger, UniquePtr<AVFormatContext>& fmtCtx, const std::string& filePath, const AVIOInterruptCB* interruptCallback)
 {
     AVFormatContext* p = nullptr;
-    bool rst = openFile(logger, p, filePath);
+    bool rst = openFile(logger, p, filePath, interruptCallback);
     fmtCtx.reset(p);
     return rst;
 }
@@ -236,6 +243,37 @@ bool MediaDecodeUtils::findAndOpenAudioDecoder(Logger* logger, AVFormatContext*
     codecContext.reset(codecCtx);
     return true;
 }
+bool MediaDecodeUtils::findAndOpenSubtitleDecoder(Logger* logger, AVFormatContext* formatCtx, StreamIndexType streamIndex, UniquePtr<AVCodecContext>& codecContext)
+{
+    if (streamIndex < 0)
+    {
+        logger->error("Stream index is negative");
+        return false;
+    }
+    auto* codecPar = formatCtx->streams[streamIndex]->codecpar;
+    const AVCodec* codec = avcodec_find_decoder(codecPar->codec_id); // 查找解码器，不需要手动释放
+    if (!codec)
+    {
+        logger->error("Cannot find subtitle decoder.");
+        return false;
+    }
+    auto* codecCtx = avcodec_alloc_context3(codec);
+    UniquePtr<AVCodecContext> uniquePtr(codecCtx, constDeleterAVCodecContext);
+    if (avcodec_parameters_to_context(codecCtx, codecPar) < 0)
+    {
+        logger->error("Cannot copy subtitle decoder parameters to context.");
+        return false;
+    }
+    codecCtx->pkt_timebase = formatCtx->streams[streamIndex]->time_base; // 字幕解码器依赖它计算AVSubtitle::pts和显示时长
+    if (avcodec_open2(codecCtx, codec, nullptr) < 0)
+    {
+        logger->error("Cannot open subtitle decoder.");
+        return false;
+    }
+    uniquePtr.release();
+    codecContext.reset(codecCtx);
+    return true;
+}
 bool MediaDecodeUtils::findAndOpenVideoDecoder(Logger* logger, AVFormatContext* formatCtx, StreamIndexType streamIndex, UniquePtr<AVCodecContext>& codecContext, bool useHardwareDecoder, uint64_t hardwareExtraFrameCount, AVHWDeviceType* hwDeviceType, AVPixelFormat* hwPixelFormat)
 {
     if (streamIndex < 0)
@@ -404,7 +442,7 @@ bool PlayerTypes::AbstractDemuxer::open(const std::string& url)
         opened = false;
     }
     this->url = url;
-    return opened = MediaDecodeUtils::openFile(&logger, formatCtx, url);
+    return opened = MediaDecodeUtils::openFile(&logger, formatCtx, url, &interruptCallback);
 }
 void PlayerTypes::AbstractDemuxer::close()
 {
@@ -498,6 +536,7 @@ void PlayerTypes::SingleDemuxer::flushPacketQueue()
     AVPacket* pkt = nullptr;
     while (ConcurrentQueueOps::tryDequeue(packetQueue, pkt))
         av_packet_free(&pkt);
+    endOfFile.store(false);
 }
 void PlayerTypes::SingleDemuxer::reset()
 {
@@ -526,10 +565,12 @@ void PlayerTypes::SingleDemuxer::readPackets(std::function<void()> packetEnqueue
         }
         // Read frame from the format context 读取帧
         AVPacket* pkt = nullptr;
-        if (!MediaDecodeUtils::readFrame(&logger, formatCtx.get(), pkt, true))
+        bool isEof = false;
+        if (!MediaDecodeUtils::readFrame(&logger, formatCtx.get(), pkt, true, &isEof))
         {
             if (pkt) av_packet_free(&pkt); // 释放包
             logger.trace("Read frame finished.");
+            endOfFile.store(isEof);
             //break; // 读取结束，退出循环
             // 读取结束，暂停线程，等待通知
             threadStateController.pause();
@@ -697,10 +738,12 @@ void PlayerTypes::UnifiedDemuxer::readPackets()
 
         // Read frame from the format context 读取帧
         AVPacket* pkt = nullptr;
-        if (!MediaDecodeUtils::readFrame(&logger, formatCtx.get(), pkt, true))
+        bool isEof = false;
+        if (!MediaDecodeUtils::readFrame(&logger, formatCtx.get(), pkt, true, &isEof))
         {
             if (pkt) av_packet_free(&pkt); // 释放包
             logger.trace("Read frame finished.");
+            endOfFile.store(isEof);
             //break; // 读取结束，退出循环
             // 读取结束，暂停线程，等待通知
             threadStateController.pause();
@@ -711,7 +754,9 @@ void PlayerTypes::UnifiedDemuxer::readPackets()
         for (auto& [stype, sctx] : streamContexts)
         {
             auto oldPktQueueSize = ConcurrentQueueOps::getQueueSize(sctx.packetQueue);
-            if (oldPktQueueSize < sctx.maxPacketQueueSize)
+            // 被丢弃的流（如省电模式下的视频流）不会再有包入队，不参与判断，否则将一直读到文件结尾
+            bool discarded = sctx.index >= 0 && formatCtx->streams[sctx.index]->discard == AVDISCARD_ALL;
+            if (oldPktQueueSize < sctx.maxPacketQueueSize && !discarded)
                 shouldPause = false;
             if (pkt->stream_index != sctx.index)
                 continue;
@@ -947,6 +992,10 @@ std::string PlayerTypes::IFrameFilter::getFilterNameByType(FilterType type)
         return "huesaturation";
     case IFrameFilter::VideoHwFrameScaleCudaFilter:
         return "scale_cuda";
+    case IFrameFilter::VideoBwdifDeinterlaceFilter:
+        return "bwdif";
+    case IFrameFilter::VideoYadifDeinterlaceFilter:
+        return "yadif";
     case IFrameFilter::NoneFilter:
     default:
         break;
@@ -1051,24 +1100,8 @@ AVFilterContext* PlayerTypes::IFFmpegFrameFilter::createFilterContext(AVFilterGr
     return outFilterCtx;
 }
 
-bool PlayerTypes::IFFmpegFrameFilter::createSrcSinkFilterCtx(StreamType streamType, AVFilterGraph* graph, AVCodecContext* codecCtx, AVFormatContext* formatCtx, StreamIndexType streamIndex, AVFilterContext*& outSrcFilterCtx, AVFilterContext*& outSinkFilterCtx)
+std::string PlayerTypes::IFFmpegFrameFilter::getBufferSrcFilterArguments(StreamType streamType, AVCodecContext* codecCtx, AVFormatContext* formatCtx, StreamIndexType streamIndex)
 {
-    // 创建bufferSrc滤镜（输入）
-    const AVFilter* bufferSrc = nullptr;
-    // 创建bufferSink滤镜（输出）
-    const AVFilter* bufferSink = nullptr;
-    if (streamType & StreamType::STVideo)
-    {
-        bufferSrc = avfilter_get_by_name("buffer");
-        bufferSink = avfilter_get_by_name("buffersink");
-    }
-    if (streamType & StreamType::STAudio)
-    {
-        bufferSrc = avfilter_get_by_name("abuffer");
-        bufferSink = avfilter_get_by_name("abuffersink");
-    }
-    if (!bufferSrc || !bufferSink)
-        return false;
     uint64_t channelLayoutMask = 0;
     if (codecCtx->ch_layout.order != AV_CHANNEL_ORDER_UNSPEC)
         channelLayoutMask = codecCtx->ch_layout.u.mask;
@@ -1083,7 +1116,7 @@ bool PlayerTypes::IFFmpegFrameFilter::createSrcSinkFilterCtx(StreamType streamTy
     if (streamType & StreamType::STVideo)
     {
         if (streamIndex < 0)
-            return false;
+            return "";
         const char* pixFmtName = av_get_pix_fmt_name(codecCtx->sw_pix_fmt);
         
         AVRational frameRate = codecCtx->framerate;
@@ -1121,6 +1154,28 @@ bool PlayerTypes::IFFmpegFrameFilter::createSrcSinkFilterCtx(StreamType streamTy
             "sample_rate={}:sample_fmt={}:channel_layout=0x{:X}", // 0x{:X}格式化为大写的十六进制
             codecCtx->sample_rate, sampleFormatName ? sampleFormatName : "",
             channelLayoutMask);
+    return bufferSrcFilterArguments;
+}
+
+bool PlayerTypes::IFFmpegFrameFilter::createSrcSinkFilterCtx(StreamType streamType, AVFilterGraph* graph, AVCodecContext* codecCtx, AVFormatContext* formatCtx, StreamIndexType streamIndex, AVFilterContext*& outSrcFilterCtx, AVFilterContext*& outSinkFilterCtx)
+{
+    // 创建bufferSrc滤镜（输入）
+    const AVFilter* bufferSrc = nullptr;
+    // 创建bufferSink滤镜（输出）
+    const AVFilter* bufferSink = nullptr;
+    if (streamType & StreamType::STVideo)
+    {
+        bufferSrc = avfilter_get_by_name("buffer");
+        bufferSink = avfilter_get_by_name("buffersink");
+    }
+    if (streamType & StreamType::STAudio)
+    {
+        bufferSrc = avfilter_get_by_name("abuffer");
+        bufferSink = avfilter_get_by_name("abuffersink");
+    }
+    if (!bufferSrc || !bufferSink)
+        return false;
+    std::string bufferSrcFilterArguments = getBufferSrcFilterArguments(streamType, codecCtx, formatCtx, streamIndex);
     if (bufferSrcFilterArguments.empty())
         return false;
     AVFilterContext* srcFilterCtx = nullptr;
@@ -1212,6 +1267,10 @@ PlayerTypes::SharedPtr<PlayerTypes::IFrameFilter> PlayerTypes::FFmpegFrameFilter
         return std::make_shared<FFmpegRGBFrameVideoHueSaturationFilter>(streamType, formatCtx, codecCtx, streamIndex);
     case IFFmpegFrameFilter::VideoHwFrameScaleCudaFilter:
         return std::make_shared<FFmpegHwFrameVideoScaleCudaFilter>(streamType, formatCtx, codecCtx, streamIndex);
+    case IFFmpegFrameFilter::VideoBwdifDeinterlaceFilter:
+        return std::make_shared<FFmpegFrameVideoDeinterlaceFilter>(streamType, formatCtx, codecCtx, streamIndex, FFmpegFrameVideoDeinterlaceFilter::Algorithm::Bwdif);
+    case IFFmpegFrameFilter::VideoYadifDeinterlaceFilter:
+        return std::make_shared<FFmpegFrameVideoDeinterlaceFilter>(streamType, formatCtx, codecCtx, streamIndex, FFmpegFrameVideoDeinterlaceFilter::Algorithm::Yadif);
     default:
         break;
     }
@@ -1274,21 +1333,57 @@ bool PlayerTypes::FFmpegFrameFilterGraph::linkFilters()
 
 bool PlayerTypes::FFmpegFrameFilterGraph::addFrame(AVFrame* frame, IFrameFilter::FilterSrcFlag srcFlags)
 {
+    // 线程策略或耗时统计开关在配置后被修改，在处理线程中重建使其生效
+    if (configured.load() && settingsVersion.load() != appliedSettingsVersion)
+        rebuildFilterGraph(nullptr);
+    updatePassthroughState();
+    if (passthroughActive)
+    {
+        SharedPtr<AVFrame> ref{ makeSharedFrame() };
+        if (srcFlags & IFrameFilter::SrcFlagKeepReference)
+        {
+            if (av_frame_ref(ref.get(), frame) < 0)
+                return false;
+        }
+        else
+            av_frame_move_ref(ref.get(), frame);
+        passthroughFrames.push_back(ref);
+        return true;
+    }
+    // 耗时统计模式下送入第一段
+    AVFilterContext* inputFilterCtx = timedSegments.empty() ? srcFilterCtx : timedSegments.front().srcFilterCtx;
     if (frame->hw_frames_ctx)
-        IFFmpegFrameFilter::setSrcFilterCtxHwFramesCtx(srcFilterCtx, frame->hw_frames_ctx);
+        IFFmpegFrameFilter::setSrcFilterCtxHwFramesCtx(inputFilterCtx, frame->hw_frames_ctx);
     else
-        IFFmpegFrameFilter::unsetSrcFilterCtxHwFramesCtx(srcFilterCtx, static_cast<AVPixelFormat>(frame->format));
+        IFFmpegFrameFilter::unsetSrcFilterCtxHwFramesCtx(inputFilterCtx, static_cast<AVPixelFormat>(frame->format));
     // 添加帧到滤镜图
-    if (!IFFmpegFrameFilter::addFrameWithFlags(this->srcFilterCtx, frame, srcFlags))
+    if (!IFFmpegFrameFilter::addFrameWithFlags(inputFilterCtx, frame, srcFlags))
         return false;
+    graphHasInput = true;
+    if (!timedSegments.empty())
+        ++timedInputFrames;
     return true;
 }
 
 PlayerTypes::SharedPtr<AVFrame> PlayerTypes::FFmpegFrameFilterGraph::getOutputFrame(bool* needMore, IFrameFilter::FilterSinkFlag sinkFlags)
 {
+    if (!passthroughFrames.empty())
+    {
+        auto o = passthroughFrames.front();
+        passthroughFrames.pop_front();
+        if (needMore)
+            *needMore = false;
+        return o;
+    }
+    if (passthroughActive)
+    {
+        if (needMore)
+            *needMore = true;
+        return makeSharedFrame(nullptr);
+    }
     bool nm = false;
     // 从滤镜图获取处理后的帧
-    auto&& o = IFFmpegFrameFilter::getOutputFrame(this->sinkFilterCtx, nm, sinkFlags);
+    auto&& o = timedSegments.empty() ? IFFmpegFrameFilter::getOutputFrame(this->sinkFilterCtx, nm, sinkFlags) : getTimedOutputFrame(nm, sinkFlags);
     if (needMore)
         *needMore = nm;
     return o;
@@ -1301,21 +1396,46 @@ bool PlayerTypes::FFmpegFrameFilterGraph::createFilterGraph()
 
 bool PlayerTypes::FFmpegFrameFilterGraph::resetFilterGraph()
 {
+    releaseTimedSegments();
+    srcFilterCtx = nullptr;
+    sinkFilterCtx = nullptr;
+    graphHasInput = false;
     configured.store(false);
     for (auto& filter : filterList)
         filter->resetFilterCtx();
-    // 初始化滤镜图
-    filterGraph.reset(avfilter_graph_alloc());
+    // 之后构建的滤镜图使用当前的设置
+    appliedSettingsVersion = settingsVersion.load();
+    appliedThreadingPolicy = getThreadingPolicy();
+    filterTimingActive = filterTimingRequested.load();
+    // 初始化滤镜图，旧滤镜图连同滤镜内部缓存的数据一起释放
+    filterGraph.reset(allocFilterGraph().release());
     if (!filterGraph)
         return false;
     return true;
 }
 
+PlayerTypes::UniquePtr<AVFilterGraph> PlayerTypes::FFmpegFrameFilterGraph::allocFilterGraph() const
+{
+    UniquePtr<AVFilterGraph> graph{ avfilter_graph_alloc(), constDeleterAVFilterGraph };
+    if (!graph)
+        return graph;
+    // 滤镜图的线程池在创建第一个滤镜时初始化，必须在此之前设置
+    graph->nb_threads = std::max(appliedThreadingPolicy.threadCount, 0);
+    graph->thread_type = appliedThreadingPolicy.sliceThreading ? AVFILTER_THREAD_SLICE : 0;
+    return graph;
+}
+
 bool PlayerTypes::FFmpegFrameFilterGraph::configureFilterGraph()
 {
     if (configured.load())
         return true; // 已经配置过了，不再配置
     if (!filterGraph) return false;
+    if (filterTimingActive)
+    {
+        bool rst = configureTimedSegments();
+        configured.store(!timedSegments.empty());
+        return rst;
+    }
     bool linkSuccess = linkFilters();
     // 配置滤镜图
     if (avfilter_graph_config(filterGraph.get(), nullptr) < 0)
@@ -1327,6 +1447,240 @@ bool PlayerTypes::FFmpegFrameFilterGraph::configureFilterGraph()
     return linkSuccess;
 }
 
+bool PlayerTypes::FFmpegFrameFilterGraph::rebuildFilterGraph(const std::function<void(FFmpegFrameFilterGraph& graph)>& modifier)
+{
+    if (!resetFilterGraph())
+        return false;
+    if (modifier)
+        modifier(*this);
+    return configureFilterGraph();
+}
+
+void PlayerTypes::FFmpegFrameFilterGraph::setThreadingPolicy(const ThreadingPolicy& policy)
+{
+    threadCount.store(std::max(policy.threadCount, 0));
+    sliceThreading.store(policy.sliceThreading);
+    ++settingsVersion;
+}
+
+void PlayerTypes::FFmpegFrameFilterGraph::setFilterTimingEnabled(bool enabled)
+{
+    if (filterTimingRequested.exchange(enabled) != enabled)
+        ++settingsVersion;
+}
+
+std::vector<PlayerTypes::FFmpegFrameFilterGraph::FilterTiming> PlayerTypes::FFmpegFrameFilterGraph::getFilterTimings() const
+{
+    std::lock_guard lock(filterTimingMutex);
+    std::vector<FilterTiming> timings;
+    for (const auto& timing : filterTimings)
+    {
+        if (!timing.instanceId.empty()) // 没有滤镜时的直通段不统计
+            timings.push_back(timing);
+    }
+    return timings;
+}
+
+void PlayerTypes::FFmpegFrameFilterGraph::resetFilterTimings()
+{
+    std::lock_guard lock(filterTimingMutex);
+    for (auto& timing : filterTimings)
+    {
+        timing.frames = 0;
+        timing.totalMs = 0.0;
+        timing.lastMs = 0.0;
+        timing.maxMs = 0.0;
+    }
+}
+
+namespace {
+    // 根据buffersink协商后的输出参数生成下一段buffer/abuffer的参数
+    std::string getBufferSinkOutputArguments(AVFilterContext* sinkFilterCtx, bool isVideo)
+    {
+        AVRational timeBase = av_buffersink_get_time_base(sinkFilterCtx);
+        if (isVideo)
+        {
+            AVRational frameRate = av_buffersink_get_frame_rate(sinkFilterCtx);
+            AVRational sar = av_buffersink_get_sample_aspect_ratio(sinkFilterCtx);
+            if (sar.num <= 0 || sar.den <= 0)
+                sar = AVRational(1, 1);
+            const char* pixFmtName = av_get_pix_fmt_name(static_cast<AVPixelFormat>(av_buffersink_get_format(sinkFilterCtx)));
+            const char* colorSpaceName = av_color_space_name(av_buffersink_get_colorspace(sinkFilterCtx));
+            const char* colorRangeName = av_color_range_name(av_buffersink_get_color_range(sinkFilterCtx));
+            return LoggerFormatNS::format(
+                "video_size={}x{}:pix_fmt={}:time_base={}/{}:frame_rate={}/{}:colorspace={}:range={}:pixel_aspect={}/{}",
+                av_buffersink_get_w(sinkFilterCtx), av_buffersink_get_h(sinkFilterCtx),
+                pixFmtName ? pixFmtName : "", timeBase.num, timeBase.den,
+                frameRate.num, frameRate.den > 0 ? frameRate.den : 1,
+                colorSpaceName ? colorSpaceName : "unknown", colorRangeName ? colorRangeName : "unknown",
+                sar.num, sar.den);
+        }
+        AVChannelLayout layout{};
+        char layoutName[128]{};
+        if (av_buffersink_get_ch_layout(sinkFilterCtx, &layout) >= 0)
+            av_channel_layout_describe(&layout, layoutName, sizeof(layoutName));
+        av_channel_layout_uninit(&layout);
+        const char* sampleFormatName = av_get_sample_fmt_name(static_cast<AVSampleFormat>(av_buffersink_get_format(sinkFilterCtx)));
+        return LoggerFormatNS::format("sample_rate={}:sample_fmt={}:channel_layout={}:time_base={}/{}",
+            av_buffersink_get_sample_rate(sinkFilterCtx), sampleFormatName ? sampleFormatName : "", layoutName, timeBase.num, timeBase.den);
+    }
+}
+
+bool PlayerTypes::FFmpegFrameFilterGraph::configureTimedSegments()
+{
+    releaseTimedSegments();
+    std::string srcArgs = IFFmpegFrameFilter::getBufferSrcFilterArguments(streamType, codecCtx, formatCtx, streamIndex);
+    if (srcArgs.empty())
+        return false;
+    const bool isVideo = streamType & StreamType::STVideo;
+    AVBufferRef* hwFramesCtx = nullptr; // 上一段输出的硬件帧上下文
+    // 构建src -> filter -> sink一段滤镜图，filter为nullptr时为直通
+    auto buildSegment = [&](const SharedPtr<IFrameFilter>& filter, const std::string& instanceId) -> bool {
+        TimedSegment segment;
+        segment.filter = filter;
+        segment.graph.reset(allocFilterGraph().release());
+        if (!segment.graph)
+            return false;
+        segment.srcFilterCtx = IFFmpegFrameFilter::createFilterContext(segment.graph.get(), isVideo ? "buffer" : "abuffer", "in", srcArgs, nullptr);
+        segment.sinkFilterCtx = IFFmpegFrameFilter::createFilterContext(segment.graph.get(), isVideo ? "buffersink" : "abuffersink", "out", "", nullptr);
+        if (!segment.srcFilterCtx || !segment.sinkFilterCtx)
+            return false;
+        if (hwFramesCtx)
+            IFFmpegFrameFilter::setSrcFilterCtxHwFramesCtx(segment.srcFilterCtx, hwFramesCtx);
+        AVFilterContext* lastFilterCtx = segment.srcFilterCtx;
+        if (filter)
+        {
+            if (!filter->createFilterCtxForGraph(segment.graph.get(), instanceId)
+                || avfilter_link(segment.srcFilterCtx, 0, filter->getFilterCtx(), 0) < 0)
+            {
+                filter->resetFilterCtxForGraph();
+                return false;
+            }
+            lastFilterCtx = filter->getFilterCtx();
+        }
+        if (avfilter_link(lastFilterCtx, 0, segment.sinkFilterCtx, 0) < 0 || avfilter_graph_config(segment.graph.get(), nullptr) < 0)
+        {
+            if (filter)
+                filter->resetFilterCtxForGraph();
+            return false;
+        }
+        // 下一段的输入参数取自本段的输出
+        srcArgs = getBufferSinkOutputArguments(segment.sinkFilterCtx, isVideo);
+        hwFramesCtx = av_buffersink_get_hw_frames_ctx(segment.sinkFilterCtx);
+        timedSegments.push_back(std::move(segment));
+        return true;
+    };
+    bool failed = false;
+    std::vector<FilterTiming> timings;
+    for (const auto& filter : filterList)
+    {
+        if (filter->type() == IFrameFilter::NoneFilter)
+            continue;
+        auto basicFilter = dynamic_cast<IFFmpegFrameBasicFilter*>(filter.get());
+        std::string instanceId = basicFilter ? basicFilter->getOrCreateInstanceIdForFilterGraph(this) : useUniqueFilterId();
+        if (!buildSegment(filter, instanceId))
+        {
+            // 与linkFilters一致，跳过无法链接的滤镜，其余滤镜继续工作
+            failed = true;
+            continue;
+        }
+        timings.push_back({ instanceId, IFrameFilter::getFilterNameByType(filter->type()) });
+    }
+    if (timedSegments.empty())
+    {
+        if (!buildSegment(nullptr, ""))
+            return false;
+        timings.emplace_back();
+    }
+    // 保留重建前同一滤镜实例的统计
+    std::lock_guard lock(filterTimingMutex);
+    for (auto& timing : timings)
+    {
+        auto it = std::find_if(filterTimings.begin(), filterTimings.end(), [&timing](const FilterTiming& t) { return !t.instanceId.empty() && t.instanceId == timing.instanceId; });
+        if (it != filterTimings.end())
+            timing = *it;
+    }
+    filterTimings = std::move(timings);
+    return !failed;
+}
+
+void PlayerTypes::FFmpegFrameFilterGraph::releaseTimedSegments()
+{
+    for (auto& segment : timedSegments)
+    {
+        if (segment.filter)
+            segment.filter->resetFilterCtx();
+    }
+    timedSegments.clear();
+    timedInputFrames = 0;
+}
+
+PlayerTypes::SharedPtr<AVFrame> PlayerTypes::FFmpegFrameFilterGraph::getTimedOutputFrame(bool& needMore, IFrameFilter::FilterSinkFlag sinkFlags)
+{
+    using Clock = std::chrono::steady_clock;
+    const size_t count = timedSegments.size();
+    std::vector<double> elapsedMs(count, 0.0);
+    std::vector<uint64_t> inputFrames(count, 0);
+    inputFrames[0] = timedInputFrames;
+    timedInputFrames = 0;
+    // 滤镜在buffersink取帧时才真正处理，取出前面各段的全部输出送入下一段，分别计时
+    for (size_t i = 0; i + 1 < count; ++i)
+    {
+        while (true)
+        {
+            auto begin = Clock::now();
+            bool nm = false;
+            auto frame = IFFmpegFrameFilter::getOutputFrame(timedSegments[i].sinkFilterCtx, nm);
+            elapsedMs[i] += std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+            if (!frame)
+                break;
+            if (IFFmpegFrameFilter::addFrameWithFlags(timedSegments[i + 1].srcFilterCtx, frame.get()))
+                ++inputFrames[i + 1];
+        }
+    }
+    auto begin = Clock::now();
+    auto o = IFFmpegFrameFilter::getOutputFrame(timedSegments.back().sinkFilterCtx, needMore, sinkFlags);
+    elapsedMs[count - 1] += std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+    std::lock_guard lock(filterTimingMutex);
+    for (size_t i = 0; i < count && i < filterTimings.size(); ++i)
+    {
+        auto& timing = filterTimings[i];
+        timing.frames += inputFrames[i];
+        timing.totalMs += elapsedMs[i];
+        timing.lastMs = elapsedMs[i];
+        timing.maxMs = std::max(timing.maxMs, elapsedMs[i]);
+    }
+    return o;
+}
+
+bool PlayerTypes::FFmpegFrameFilterGraph::isIdentity() const
+{
+    if (!identityBypassEnabled.load() || !configured.load() || filterTimingActive)
+        return false;
+    return std::all_of(filterList.begin(), filterList.end(), [](const SharedPtr<IFrameFilter>& filter) { return filter->isIdentity(); });
+}
+
+void PlayerTypes::FFmpegFrameFilterGraph::updatePassthroughState()
+{
+    bool identity = isIdentity();
+    if (identity == passthroughActive)
+        return;
+    if (graphHasInput && sinkFilterCtx)
+    {
+        if (identity)
+        {
+            // EOF之后buffersink会取出所有滤镜中剩余的数据
+            IFFmpegFrameFilter::addFrameWithFlags(srcFilterCtx, nullptr);
+            bool needMore = false;
+            while (auto frame = IFFmpegFrameFilter::getOutputFrame(sinkFilterCtx, needMore))
+                passthroughFrames.push_back(frame);
+        }
+        // 收到EOF的滤镜图不能再接收帧，滤镜内部状态也无法清空，重建为干净的滤镜图
+        rebuildFilterGraph(nullptr);
+    }
+    passthroughActive = identity;
+}
+
 bool PlayerTypes::FFmpegFrameFilterGraph::addFilter(SharedPtr<IFrameFilter> filter)
 {
     if (configured.load())
@@ -1466,7 +1820,7 @@ bool PlayerTypes::IFFmpegFrameBasicFilter::createFilterCtxForGraph(AVFilterGraph
 {
     this->externalFilterGraph = filterGraph;
     this->m_id = uniqueInstanceId;
-    AVFilterContext* ctx = createFilterContext(filterGraph, type(), uniqueInstanceId, getFilterArguments(), &logger);
+    AVFilterContext* ctx = createFilterContext(filterGraph, type(), uniqueInstanceId, getFilterArgumentsForGraph(), &logger);
     this->filterCtx = ctx;
     return ctx;
 }
@@ -1517,6 +1871,29 @@ bool PlayerTypes::IFFmpegFrameBasicFilter::setOption(std::string key, std::strin
     return ret1 >= 0 && ret2 >= 0;
 }
 
+bool PlayerTypes::IFFmpegFrameBasicFilter::setBypassed(bool bypassed)
+{
+    if (m_bypassed.exchange(bypassed) == bypassed)
+        return true;
+    if (bypassWithTimeline())
+        return setOption("enable", bypassed ? "0" : "1");
+    return applyBypassParameters();
+}
+
+std::string PlayerTypes::IFFmpegFrameBasicFilter::getFilterArgumentsForGraph() const
+{
+    std::string args = getFilterArguments();
+    if (isBypassed() && bypassWithTimeline())
+        args += args.empty() ? "enable=0" : ":enable=0";
+    return args;
+}
+
+bool PlayerTypes::IFFmpegFrameBasicFilter::supportsTimeline() const
+{
+    const AVFilter* f = avfilter_get_by_name(getFilterNameByType(type()).c_str());
+    return f && (f->flags & AVFILTER_FLAG_SUPPORT_TIMELINE);
+}
+
 bool PlayerTypes::IFFmpegFrameBasicFilter::sendCommandForSingleFilter(std::string cmd, std::string args, std::string& res)
 {
     int ret = 0;
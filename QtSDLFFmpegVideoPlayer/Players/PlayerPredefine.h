@@ -315,6 +315,7 @@ public:
     enum class RequestTaskType : char {
         None = 0,
         Seek = 1,
+        StreamDiscard = 2, // 修改解复用器中流的丢弃策略，需在解复用器阻塞时进行
     };
     enum class RequestHandleState {
         BeforeEnqueue,
@@ -397,6 +398,8 @@ public:
             VideoHueFilter,
             VideoRGBFrameHueSaturationFilter,
             VideoHwFrameScaleCudaFilter,
+            VideoBwdifDeinterlaceFilter,
+            VideoYadifDeinterlaceFilter,
         };
         // 根据FilterType获取滤镜名称
         static std::string getFilterNameByType(FilterType type);
@@ -406,6 +409,8 @@ public:
         virtual FilterType type() const = 0;
         virtual SharedPtr<AVFrame> filter(AVFrame* frame, bool* needMore = nullptr, FilterSrcFlag srcFlag = SrcFlagKeepReference, FilterSinkFlag sinkFlag = SinkFlagNone) = 0;
         virtual bool isValid() const = 0;
+        // 当前参数下滤镜是否不改变帧数据，无法判断的滤镜返回false
+        virtual bool isIdentity() const { return false; }
         virtual void resetFilterCtx() = 0;
         virtual AVFilterContext* getFilterCtx() = 0;
         virtual const AVFilterContext* getFilterCtx() const = 0;
@@ -483,6 +488,8 @@ public:
     public:
         static AVFilterContext* createFilterContext(AVFilterGraph* filterGraph, FilterType type, std::string id, std::string args, Logger* logger);
         static AVFilterContext* createFilterContext(AVFilterGraph* filterGraph, std::string filterName, std::string id, std::string args, Logger* logger);
+        // 源滤镜（buffer/abuffer）的参数
+        static std::string getBufferSrcFilterArguments(StreamType streamType, AVCodecContext* codecCtx, AVFormatContext* formatCtx, StreamIndexType streamIndex);
         static bool createSrcSinkFilterCtx(StreamType streamType, AVFilterGraph* graph, AVCodecContext* codecCtx, AVFormatContext* formatCtx, StreamIndexType streamIndex, AVFilterContext*& outSrcFilterCtx, AVFilterContext*& outSinkFilterCtx);
         static bool addFrameWithFlags(AVFilterContext* srcFilterCtx, AVFrame* frame, FilterSrcFlag flags = SrcFlagNone); // 将frame添加到滤镜图中
         static SharedPtr<AVFrame> getOutputFrame(AVFilterContext* sinkFilterCtx, bool& needMore, FilterSinkFlag flags = SinkFlagNone); // 从滤镜图中获取输出frame
@@ -532,6 +539,8 @@ public:
         virtual SharedPtr<AVFrame> getOutputFrame(bool* needMore = nullptr, IFrameFilter::FilterSinkFlag sinkFlags = IFrameFilter::SinkFlagNone) = 0;
         // 判断滤镜图是否有效/是否已正确初始化
         virtual bool isValid() const = 0;
+        // 滤镜图整体是否不改变帧数据，为true时帧可以直接以引用方式通过
+        virtual bool isIdentity() const { return false; }
         // 创建滤镜图
         virtual bool createFilterGraph() = 0;
         // 重置滤镜图
@@ -561,18 +570,75 @@ public:
         AVFilterContext* sinkFilterCtx{ nullptr };
         std::list<SharedPtr<IFrameFilter>> filterList{};
         AtomicBool configured{ false };
+        // 线程策略与耗时统计开关，可在任意线程设置，处理线程在下一次addFrame时重建滤镜图使其生效
+        Atomic<int> threadCount{ 0 };
+        AtomicBool sliceThreading{ true };
+        AtomicBool filterTimingRequested{ false };
+        Atomic<uint64_t> settingsVersion{ 0 };
+        uint64_t appliedSettingsVersion{ 0 };
+        // 耗时统计模式下每个滤镜单独构成一段滤镜图，依次处理并分别计时
+        struct TimedSegment {
+            SharedPtr<IFrameFilter> filter{ nullptr };
+            UniquePtr<AVFilterGraph> graph{ nullptr, constDeleterAVFilterGraph };
+            AVFilterContext* srcFilterCtx{ nullptr };
+            AVFilterContext* sinkFilterCtx{ nullptr };
+        };
+        std::vector<TimedSegment> timedSegments;
+        bool filterTimingActive{ false }; // 当前滤镜图是否按段配置
+        // 恒等直通：所有滤镜在当前参数下都不改变数据时，帧以引用方式直接通过，不经过buffersrc/buffersink
+        AtomicBool identityBypassEnabled{ true };
+        bool passthroughActive{ false };
+        bool graphHasInput{ false }; // 当前滤镜图自构建后是否送入过帧，送入过的滤镜图内部可能积累了数据
+        std::deque<SharedPtr<AVFrame>> passthroughFrames; // 直通的帧，以及进入直通前滤镜图中已处理完的帧
+        uint64_t timedInputFrames{ 0 }; // 送入第一段但还未计入统计的帧数
+        mutable Mutex filterTimingMutex; // 保护filterTimings，统计在处理线程写入，可在任意线程读取
     public:
+        // 滤镜图线程策略，在分配滤镜图后、创建滤镜前写入nb_threads/thread_type
+        struct ThreadingPolicy {
+            int threadCount{ 0 }; // 0表示由FFmpeg按CPU核心数决定，1表示不使用线程
+            bool sliceThreading{ true }; // 支持切片线程的滤镜（scale、eq、hue等）是否按切片并行处理
+        };
+        // 单个滤镜实例的耗时统计，以滤镜在滤镜图中的实例id区分
+        struct FilterTiming {
+            std::string instanceId;
+            std::string filterName;
+            uint64_t frames{ 0 }; // 送入该滤镜的帧数
+            double totalMs{ 0.0 };
+            double lastMs{ 0.0 };
+            double maxMs{ 0.0 };
+            double averageMs() const { return frames ? totalMs / frames : 0.0; }
+        };
+        // 视频滤镜图默认按切片并行，音频滤镜基本不支持切片线程，默认不创建线程池
+        static ThreadingPolicy defaultThreadingPolicy(StreamType streamType) {
+            return (streamType & StreamType::STVideo) ? ThreadingPolicy{ 0, true } : ThreadingPolicy{ 1, false };
+        }
         // Factory method, 工厂函数
         static SharedPtr<IFrameFilter> createFilter(IFrameFilter::FilterType filterType, StreamType streamType, AVFormatContext* formatCtx, AVCodecContext* codecCtx, StreamIndexType streamIndex);
         // 销毁一个IFrameFilter实例，如果已经加入滤镜图，此函数不会将滤镜移出滤镜图
         //static bool destroyFilter(IFrameFilter* filter);
     protected:
         bool linkFilters();
+        // 分配滤镜图并应用线程策略
+        UniquePtr<AVFilterGraph> allocFilterGraph() const;
+        // 耗时统计模式：每个滤镜单独配置为一段滤镜图，后一段的输入参数取自前一段的输出
+        bool configureTimedSegments();
+        void releaseTimedSegments();
+        // 依次驱动各段滤镜图，返回最后一段的一帧输出
+        SharedPtr<AVFrame> getTimedOutputFrame(bool& needMore, IFrameFilter::FilterSinkFlag sinkFlags);
+        // 根据isIdentity切换直通状态
+        // 进入直通时送入EOF冲刷滤镜内部积累的数据（如atempo的重叠缓冲）并排在直通帧之前，保证输出顺序
+        // 送入过帧的滤镜图在切换时重建，退出直通时不会先输出进入直通前残留的旧数据
+        void updatePassthroughState();
+        std::vector<FilterTiming> filterTimings; // 与timedSegments一一对应，由filterTimingMutex保护
+        ThreadingPolicy appliedThreadingPolicy; // 当前滤镜图使用的线程策略
     public:
         explicit FFmpegFrameFilterGraph(StreamType streamType) {}
         // 构造函数，传入codecCtx用于创建滤镜图
         explicit FFmpegFrameFilterGraph(StreamType streamType, AVFormatContext* fmtCtx, AVCodecContext* codecCtx, StreamIndexType streamIndex)
-            : streamType(streamType), formatCtx(fmtCtx), codecCtx(codecCtx), streamIndex(streamIndex) { createFilterGraph(); }
+            : streamType(streamType), formatCtx(fmtCtx), codecCtx(codecCtx), streamIndex(streamIndex) {
+            setThreadingPolicy(defaultThreadingPolicy(streamType));
+            createFilterGraph();
+        }
         virtual ~FFmpegFrameFilterGraph() = default;
         virtual AVFilterGraph* getAVFilterGraph() { return filterGraph.get(); }
         virtual const AVFilterGraph* getAVFilterGraph() const { return filterGraph.get(); }
@@ -588,6 +654,23 @@ public:
         virtual bool resetFilterGraph() override;
         // 配置滤镜图
         virtual bool configureFilterGraph() override;
+        // 重建滤镜图并切换，用于无法通过命令/旁路完成的结构变化，滤镜内部缓存的数据随旧滤镜图丢弃
+        // 音频的倍速与均衡器已由AudioPlayer的原生处理完成，播放中不再需要重建音频滤镜图
+        // \param modifier 修改滤镜列表，调用时滤镜图处于未配置状态
+        bool rebuildFilterGraph(const std::function<void(FFmpegFrameFilterGraph& graph)>& modifier);
+        // 设置线程策略，已配置的滤镜图在下一次addFrame时重建
+        void setThreadingPolicy(const ThreadingPolicy& policy);
+        ThreadingPolicy getThreadingPolicy() const { return { threadCount.load(), sliceThreading.load() }; }
+        // 开启后每个滤镜单独构成一段滤镜图以测量各滤镜实例的耗时，自动插入的格式转换会计入相邻滤镜
+        // 该模式下不走恒等直通，已配置的滤镜图在下一次addFrame时重建
+        void setFilterTimingEnabled(bool enabled);
+        bool isFilterTimingEnabled() const { return filterTimingRequested.load(); }
+        std::vector<FilterTiming> getFilterTimings() const;
+        void resetFilterTimings();
+        // 所有滤镜均为恒等（包括没有滤镜）且未在统计耗时时返回true，参数变为非中性时自动恢复经过滤镜图
+        virtual bool isIdentity() const override;
+        void setIdentityBypassEnabled(bool enabled) { identityBypassEnabled.store(enabled); }
+        bool isIdentityBypassEnabled() const { return identityBypassEnabled.load(); }
         // 添加一个现有的滤镜到滤镜图中，该滤镜将排在最后，配置滤镜图前才能添加，将接管生命周期，需使用
         // \return true表示成功添加滤镜，不会失败
         virtual bool addFilter(SharedPtr<IFrameFilter> filter) override;
@@ -637,6 +720,16 @@ public:
         virtual bool setOption(std::string key, std::string value);
         virtual bool sendCommandForSingleFilter(std::string cmd, std::string args, std::string& res);
         virtual bool sendCommandForFilterGraph(std::string cmd, std::string args, std::string& res);
+        // 旁路滤镜：滤镜保留在滤镜图中但不再改变数据，开关旁路只发送命令，不需要重建滤镜图
+        // \return false表示该滤镜不支持旁路或命令发送失败
+        virtual bool setBypassed(bool bypassed);
+        // 创建滤镜上下文时使用的参数，包含旁路状态
+        std::string getFilterArgumentsForGraph() const;
+        virtual bool isBypassed() const { return m_bypassed.load(); }
+        // 旁路的滤镜不改变数据，子类可根据参数进一步判断
+        virtual bool isIdentity() const override { return isBypassed(); }
+        // 滤镜是否支持时间线（enable选项）
+        bool supportsTimeline() const;
 
         virtual SharedPtr<IFrameFilter> clone() const override = 0;
         virtual FilterType type() const override = 0;
@@ -645,6 +738,11 @@ public:
     protected:
         AVFilterGraph* externalFilterGraph{ nullptr };
         std::string m_id;
+        AtomicBool m_bypassed{ false };
+        // 是否通过时间线旁路，默认支持时间线的滤镜使用，子类可改为设置中性参数（保持滤镜内部状态连续）
+        virtual bool bypassWithTimeline() const { return supportsTimeline(); }
+        // 不使用时间线旁路时，重新发送当前参数（getFilterArguments等需根据isBypassed返回中性参数）
+        virtual bool applyBypassParameters() { return false; }
     private:
         IFFmpegFrameBasicFilter(const IFFmpegFrameBasicFilter& other) = delete;
         IFFmpegFrameBasicFilter& operator=(const IFFmpegFrameBasicFilter& other) = delete;
@@ -662,6 +760,7 @@ public:
         virtual SharedPtr<IFrameFilter> clone() const override { return std::make_shared<FFmpegFrameNoneFilter>(*this); }
         virtual SharedPtr<AVFrame> filter(AVFrame* frame, bool* needMore = nullptr, FilterSrcFlag srcFlag = SrcFlagKeepReference, FilterSinkFlag sinkFlag = SinkFlagNone) override;
         virtual bool isValid() const override { return true; }
+        virtual bool isIdentity() const override { return true; }
         virtual FilterType type() const override { return FilterType::NoneFilter; }
         virtual std::string getFilterName() const { return "None"; }
         virtual std::string getFilterArguments() const { return ""; }
@@ -683,6 +782,7 @@ public:
         virtual SharedPtr<IFrameFilter> clone() const override { return std::make_shared<FFmpegFrameVolumeFilter>(*this, this->volume()); }
         virtual bool setVolume(double vol);
         virtual double volume() const { return vol.load(); }
+        virtual bool isIdentity() const override { return volume() == 1.0 || isBypassed(); }
         virtual FilterType type() const override { return FilterType::AudioVolumeFilter; }
         virtual std::string getFilterArguments() const override {
             return LoggerFormatNS::format("{}={}", getFilterKeyName(), volume());
@@ -700,6 +800,7 @@ public:
         double clampSpeed(double speed) { return std::clamp(speed, minSpeed(), maxSpeed()); }
         virtual bool setSpeed(double speed);
         virtual double speed() const { return m_speed.load(); }
+        virtual bool isIdentity() const override { return speed() == 1.0 || isBypassed(); }
         virtual double maxSpeed() const { return 100.0; }
         virtual double minSpeed() const { return 0.5; }
         virtual FilterType type() const override = 0;
@@ -758,12 +859,15 @@ public:
             double frequency{ 0.0 };
             double gain{ 0.0 };
         };
-        virtual const std::vector<BandInfo>& getBandGains() const = 0;
+        // 返回副本，频段增益可能在其他线程被修改
+        virtual std::vector<BandInfo> getBandGains() const = 0;
         virtual bool setBandGain(uint64_t bandIndex, double gain) = 0;
         virtual bool setBandGains(std::vector<BandInfo> gains) = 0;
         //virtual bool setBandGain(double frequency, double gain) = 0;
         virtual std::vector<BandInfo> getDefaultBandGains() const = 0;
     protected:
+        // 保护子类的bandGains：UI线程修改，处理线程在isIdentity中读取
+        mutable Mutex mtxBandGains;
 
     private:
         IFFmpegFrameAudioEqualizerFilter(const IFFmpegFrameAudioEqualizerFilter& other) = delete;
@@ -798,37 +902,58 @@ public:
         virtual FilterType type() const override { return FilterType::Audio18BandEqualizerFilter; }
         virtual std::string getFilterArguments() const override {
             // 18-band equalizer with default flat settings
+            std::lock_guard lock(mtxBandGains);
             std::string fmtStr;
             for (uint64_t i = 0; i < bandGains.size(); ++i)
-                fmtStr += LoggerFormatNS::format("{}b={}:", i + 1, bandGains[i].gain);
+                fmtStr += LoggerFormatNS::format("{}b={}:", i + 1, effectiveGain(i));
             if (bandGains.size())
                 fmtStr.pop_back(); // 移除最后一个冒号
             return fmtStr;
         }
         // 0~17对应1~18频段，增幅单位：倍
         virtual bool setBandGain(uint64_t bandIndex, double gain) override {
-            if (bandIndex > bandGains.size())
-                return false;
-            bandGains[bandIndex].gain = gain;
+            {
+                std::lock_guard lock(mtxBandGains);
+                if (bandIndex > bandGains.size())
+                    return false;
+                bandGains[bandIndex].gain = gain;
+            }
+            if (isBypassed())
+                return true;
             return setOption(std::to_string(bandIndex + 1) + "b", std::to_string(gain));
         }
         virtual bool setBandGains(std::vector<BandInfo> gains) override {
-            if (gains.size() != bandGains.size())
-                return false;
-            bool rst = true;
-            for (uint64_t i = 0; i < gains.size(); ++i)
+            std::vector<uint64_t> changed;
             {
-                if (bandGains[i].gain != gains[i].gain)
+                std::lock_guard lock(mtxBandGains);
+                if (gains.size() != bandGains.size())
+                    return false;
+                for (uint64_t i = 0; i < gains.size(); ++i)
                 {
-                    bandGains[i].gain = gains[i].gain;
-                    if (!setOption(std::to_string(i + 1) + "b", std::to_string(gains[i].gain)))
-                        rst = false;
+                    if (bandGains[i].gain != gains[i].gain)
+                    {
+                        bandGains[i].gain = gains[i].gain;
+                        changed.push_back(i);
+                    }
                 }
             }
+            bool rst = true;
+            for (uint64_t i : changed)
+                if (!isBypassed() && !setOption(std::to_string(i + 1) + "b", std::to_string(gains[i].gain)))
+                    rst = false;
             return rst;
         }
-        virtual const std::vector<BandInfo>& getBandGains() const override { return bandGains; }
+        virtual std::vector<BandInfo> getBandGains() const override {
+            std::lock_guard lock(mtxBandGains);
+            return bandGains;
+        }
         virtual std::vector<BandInfo> getDefaultBandGains() const override { return defaultBandGains(); }
+        virtual bool isIdentity() const override {
+            if (isBypassed())
+                return true;
+            std::lock_guard lock(mtxBandGains);
+            return std::all_of(bandGains.begin(), bandGains.end(), [](const BandInfo& band) { return band.gain == 1.0; });
+        }
         static std::vector<BandInfo> defaultBandGains() {
             return {
                 {    65, 1.0 },
@@ -851,14 +976,32 @@ public:
                 { 20000, 1.0 }
             };
         }
+    protected:
+        // 旁路时所有频段增益为1倍，调用时需持有mtxBandGains
+        double effectiveGain(uint64_t bandIndex) const { return isBypassed() ? 1.0 : bandGains[bandIndex].gain; }
+        virtual bool bypassWithTimeline() const override { return false; }
+        virtual bool applyBypassParameters() override {
+            std::vector<double> gains;
+            {
+                std::lock_guard lock(mtxBandGains);
+                for (uint64_t i = 0; i < bandGains.size(); ++i)
+                    gains.push_back(effectiveGain(i));
+            }
+            bool rst = true;
+            for (uint64_t i = 0; i < gains.size(); ++i)
+                if (!setOption(std::to_string(i + 1) + "b", std::to_string(gains[i])))
+                    rst = false;
+            return rst;
+        }
     };
 
     class FFmpegFrameAudio10BandEqualizerFilter : public IFFmpegFrameAudioEqualizerFilter {
         std::vector<BandInfo> bandGains = std::vector<BandInfo>{ defaultBandGains() }; // 每个频段的增益，单位dB
+        // 调用时需持有mtxBandGains
         std::string getGainEntryString() const {
             std::string fmtStr;
             for (uint64_t i = 0; i < bandGains.size(); ++i)
-                fmtStr += LoggerFormatNS::format("entry({},{});", bandGains[i].frequency, bandGains[i].gain);
+                fmtStr += LoggerFormatNS::format("entry({},{});", bandGains[i].frequency, isBypassed() ? 0.0 : bandGains[i].gain); // 旁路时为平直响应
             if (bandGains.size())
                 fmtStr.pop_back();
             return fmtStr;
@@ -868,33 +1011,53 @@ public:
         virtual SharedPtr<IFrameFilter> clone() const override { return std::make_shared<FFmpegFrameAudio10BandEqualizerFilter>(streamType, formatCtx, codecCtx, streamIndex); }
         virtual FilterType type() const override { return FilterType::Audio10BandEqualizerFilter; }
         virtual std::string getFilterArguments() const override {
+            std::lock_guard lock(mtxBandGains);
             return "gain='gain_interpolate(f)':gain_entry='" + getGainEntryString() + "'";
         }
         // 0~9对应1~10频段，增幅单位：dB（分贝）
         virtual bool setBandGain(uint64_t bandIndex, double gain) override {
-            if (bandIndex > bandGains.size())
-                return false;
-            bandGains[bandIndex].gain = gain;
-            return setOption("gain_entry", getGainEntryString());
+            std::string entry;
+            {
+                std::lock_guard lock(mtxBandGains);
+                if (bandIndex > bandGains.size())
+                    return false;
+                bandGains[bandIndex].gain = gain;
+                entry = getGainEntryString();
+            }
+            return setOption("gain_entry", entry);
         }
         virtual bool setBandGains(std::vector<BandInfo> gains) override {
-            if (gains.size() != bandGains.size())
-                return false;
-            bool equal = true;
-            for (uint64_t i = 0; i < gains.size(); ++i)
+            std::string entry;
             {
-                if (bandGains[i].gain != gains[i].gain)
+                std::lock_guard lock(mtxBandGains);
+                if (gains.size() != bandGains.size())
+                    return false;
+                bool equal = true;
+                for (uint64_t i = 0; i < gains.size(); ++i)
                 {
-                    equal = false;
-                    bandGains[i].gain = gains[i].gain;
+                    if (bandGains[i].gain != gains[i].gain)
+                    {
+                        equal = false;
+                        bandGains[i].gain = gains[i].gain;
+                    }
                 }
+                if (equal)
+                    return true;
+                entry = getGainEntryString();
             }
-            if (!equal)
-                return setOption("gain_entry", getGainEntryString());
-            return true;
+            return setOption("gain_entry", entry);
+        }
+        virtual std::vector<BandInfo> getBandGains() const override {
+            std::lock_guard lock(mtxBandGains);
+            return bandGains;
         }
-        virtual const std::vector<BandInfo>& getBandGains() const override { return bandGains; }
         virtual std::vector<BandInfo> getDefaultBandGains() const override { return defaultBandGains(); }
+        virtual bool isIdentity() const override {
+            if (isBypassed())
+                return true;
+            std::lock_guard lock(mtxBandGains);
+            return std::all_of(bandGains.begin(), bandGains.end(), [](const BandInfo& band) { return band.gain == 0.0; });
+        }
         static std::vector<BandInfo> defaultBandGains() {
             return std::vector<BandInfo>{
                 {    60, 0.0 }, // 超低音
@@ -909,6 +1072,17 @@ public:
                 { 16000, 0.0 } // 超高频
             };
         }
+    protected:
+        // FIR滤波器的延迟与增益无关，旁路时改为平直响应而不是关闭滤镜，开关均衡器时输出不会错位
+        virtual bool bypassWithTimeline() const override { return false; }
+        virtual bool applyBypassParameters() override {
+            std::string entry;
+            {
+                std::lock_guard lock(mtxBandGains);
+                entry = getGainEntryString();
+            }
+            return setOption("gain_entry", entry);
+        }
     };
 
     /**
@@ -964,6 +1138,10 @@ public:
                 paramContrast, contrast, paramBrightness, brightness, paramSaturation, saturation, 
                 paramGamma, gamma, paramGammaR, gammaR, paramGammaG, gammaG, paramGammaB, gammaB, paramGammaWeight, gammaWeight);
         }
+        virtual bool isIdentity() const override {
+            return isBypassed() || (contrast == 1.0f && brightness == 0.0f && saturation == 1.0f
+                && gamma == 1.0f && gammaR == 1.0f && gammaG == 1.0f && gammaB == 1.0f);
+        }
     };
 
     // @param h hue angle in degrees/radians, default 0
@@ -971,10 +1149,11 @@ public:
     // @param hueInRadians hue angle in radians or degrees, default false (degrees)
     // @param b brightness, default 0.0, range [-10.0, 10.0]
     class FFmpegFrameVideoHueFilter : public IFFmpegFrameBasicFilter {
-        float h{ 0.0f };
+        // 可在UI线程修改，处理线程在isIdentity中读取
+        Atomic<float> h{ 0.0f };
         bool hueInRadians{ false };
-        float s{ 1.0f };
-        float b{ 0.0f };
+        Atomic<float> s{ 1.0f };
+        Atomic<float> b{ 0.0f };
         constexpr static const char* paramh = "h";
         constexpr static const char* paramH = "H";
         constexpr static const char* params = "s";
@@ -988,26 +1167,27 @@ public:
             : IFFmpegFrameBasicFilter(other.streamType, other.formatCtx, other.codecCtx, other.streamIndex), h(h), hueInRadians(hueInRadians), s(s), b(b) {
         }
         virtual SharedPtr<IFrameFilter> clone() const override {
-            return std::make_shared<FFmpegFrameVideoHueFilter>(*this, h, hueInRadians, s, b);
+            return std::make_shared<FFmpegFrameVideoHueFilter>(*this, h.load(), hueInRadians, s.load(), b.load());
         }
         virtual FilterType type() const override {
             return FilterType::VideoHueFilter;
         }
         virtual std::string getFilterArguments() const {
-            return LoggerFormatNS::format("{}={}:{}={}:{}={}", hueInRadians ? paramH : paramh, h, params, s, paramb, b);
+            return LoggerFormatNS::format("{}={}:{}={}:{}={}", hueInRadians ? paramH : paramh, h.load(), params, s.load(), paramb, b.load());
         }
         virtual bool setHue(float hue) {
-            h = hue;
+            h.store(hue);
             return setOption(paramh, std::to_string(hue));
         }
         virtual bool setSaturation(float saturation) {
-            s = saturation;
+            s.store(saturation);
             return setOption(params, std::to_string(saturation));
         }
         virtual bool setBrightness(float brightness) {
-            b = brightness;
+            b.store(brightness);
             return setOption(paramb, std::to_string(brightness));
         }
+        virtual bool isIdentity() const override { return isBypassed() || (h.load() == 0.0f && s.load() == 1.0f && b.load() == 0.0f); }
     };
 
     // 对应ffmpeg的滤镜：huesaturation
@@ -1120,6 +1300,49 @@ public:
         }
     };
 
+    // 对应ffmpeg的滤镜：bwdif/yadif，只能用于软件帧
+    // @param algorithm 去隔行算法，bwdif画质更好，yadif更快
+    // @param mode 输出模式，SendFrame每帧输出一帧（帧率不变，如50i->25p），SendField每场输出一帧（场率输出，如50i->50p）
+    // @param parity 场序，Auto表示按帧的AV_FRAME_FLAG_TOP_FIELD_FIRST标志自动判断
+    // @param deint 需要去隔行的帧，All表示所有帧，Interlaced表示仅带有AV_FRAME_FLAG_INTERLACED标志的帧
+    class FFmpegFrameVideoDeinterlaceFilter : public IFFmpegFrameBasicFilter {
+    public:
+        enum class Algorithm { Bwdif = 0, Yadif };
+        enum class Mode { SendFrame = 0, SendField = 1 };
+        enum class Parity { Auto = -1, TopFieldFirst = 0, BottomFieldFirst = 1 };
+        enum class Deint { All = 0, Interlaced = 1 };
+    private:
+        Algorithm algorithm{ Algorithm::Bwdif };
+        Mode mode{ Mode::SendField };
+        Parity parity{ Parity::Auto };
+        Deint deint{ Deint::Interlaced };
+        constexpr static const char* parammode = "mode";
+        constexpr static const char* paramparity = "parity";
+        constexpr static const char* paramdeint = "deint";
+    public:
+        FFmpegFrameVideoDeinterlaceFilter(StreamType streamType, AVFormatContext* fmtCtx, AVCodecContext* codecCtx, StreamIndexType streamIndex,
+            Algorithm algorithm = Algorithm::Bwdif, Mode mode = Mode::SendField, Parity parity = Parity::Auto, Deint deint = Deint::Interlaced)
+            : IFFmpegFrameBasicFilter(streamType, fmtCtx, codecCtx, streamIndex), algorithm(algorithm), mode(mode), parity(parity), deint(deint) {
+        }
+        FFmpegFrameVideoDeinterlaceFilter(const FFmpegFrameVideoDeinterlaceFilter& other)
+            : IFFmpegFrameBasicFilter(other.streamType, other.formatCtx, other.codecCtx, other.streamIndex),
+            algorithm(other.algorithm), mode(other.mode), parity(other.parity), deint(other.deint) {
+        }
+        virtual SharedPtr<IFrameFilter> clone() const override {
+            return std::make_shared<FFmpegFrameVideoDeinterlaceFilter>(*this);
+        }
+        virtual FilterType type() const override {
+            return algorithm == Algorithm::Yadif ? FilterType::VideoYadifDeinterlaceFilter : FilterType::VideoBwdifDeinterlaceFilter;
+        }
+        virtual std::string getFilterArguments() const {
+            return LoggerFormatNS::format("{}={}:{}={}:{}={}", parammode, static_cast<int>(mode), paramparity, static_cast<int>(parity), paramdeint, static_cast<int>(deint));
+        }
+        Algorithm getAlgorithm() const { return algorithm; }
+        Mode getMode() const { return mode; }
+        // 每输入一帧最多输出的帧数
+        int maxOutputFramesPerInput() const { return mode == Mode::SendField ? 2 : 1; }
+    };
+
 
 
     class MediaEventType {
@@ -1539,6 +1762,7 @@ public:
             throw std::runtime_error("ThreadIdentifier not found in ThreadStateManager.");
         }
         bool wakeUpById(ThreadIdentifier tid) {
+            RealtimeSafety::check("lock (ThreadStateManager::wakeUpById)"); // 需要加锁，不能在音频回调中调用
             try {
                 auto&& t = get(tid);
                 t.wakeUp();
@@ -1550,6 +1774,7 @@ public:
             return true;
         }
         void wakeUpAll() {
+            RealtimeSafety::check("lock (ThreadStateManager::wakeUpAll)");
             std::shared_lock readLockMtxMapObjs(mtxMapObjs);
             for (auto it = mapObjs.begin(); it != mapObjs.end(); ++it)
                 ThreadStateController(it->second).wakeUp();
@@ -1590,6 +1815,8 @@ public:
         }
         virtual bool open(const std::string& url);
         virtual void close();
+        // 打开文件前设置，打开、查找流信息与读取时回调返回非0即中断；清除需对已打开的格式上下文单独处理
+        void setInterruptCallback(const AVIOInterruptCB& callback) { interruptCallback = callback; }
         virtual bool isOpen() const { return opened; }
         virtual bool findStreamInfo();
         virtual bool selectStreamsIndexes(StreamTypes streamTypes, StreamIndexSelector selector) = 0;
@@ -1646,6 +1873,7 @@ public:
         AbstractDemuxer(Logger& logger) : logger(logger) {}
         std::string url; // 当前打开的URL
         bool opened{ false };
+        AVIOInterruptCB interruptCallback{ nullptr, nullptr };
         UniquePtr<AVFormatContext> formatCtx{ nullptr, constDeleterAVFormatContext };
         // 协调线程控制
         ThreadStateManager::ThreadStateObj threadStateObj{ ThreadIdentifier::Demuxer };
@@ -1673,6 +1901,7 @@ public:
 
         AtomicBool stopped{ false };
         AtomicWaitObject<bool> waitStopped{ true };
+        AtomicBool endOfFile{ false }; // 读取线程已读到文件结尾，清空包队列（seek）时重置
 
     public:
         explicit SingleDemuxer(const std::string& loggerNameSuffix)
@@ -1717,6 +1946,8 @@ public:
         virtual uint64_t getMinPacketQueueSize(StreamType type) const override { if (type != streamType) return 0; return minPacketQueueSize; }
         virtual ConcurrentQueue<AVPacket*>* getPacketQueue(StreamType type) override { if (type != streamType) return nullptr; return &packetQueue; }
         /*非虚函数*/ConcurrentQueue<AVPacket*>& getPacketQueue() { return packetQueue; }
+        // 读取线程是否已读到文件结尾，与包队列为空同时成立时说明所有包都已取出
+        /*非虚函数*/bool isEndOfFile() const { return endOfFile.load(); }
         // 高级api
         virtual void start() override {
             stopped.set(false);
@@ -1884,13 +2115,15 @@ class MediaDecodeUtils : public PlayerTypes
 {
 private:
 public:
-    static bool openFile(Logger* logger, AVFormatContext*& fmtCtx, const std::string& filePath);
-    static bool openFile(Logger* logger, UniquePtr<AVFormatContext>& fmtCtx, const std::string& filePath);
+    // \param interruptCallback 非空时在打开前设置到格式上下文，之后的阻塞读取同样可被中断
+    static bool openFile(Logger* logger, AVFormatContext*& fmtCtx, const std::string& filePath, const AVIOInterruptCB* interruptCallback = nullptr);
+    static bool openFile(Logger* logger, UniquePtr<AVFormatContext>& fmtCtx, const std::string& filePath, const AVIOInterruptCB* interruptCallback = nullptr);
     static void closeFile(Logger* logger, AVFormatContext*& fmtCtx);
     static void closeFile(Logger* logger, UniquePtr<AVFormatContext>& fmtCtx);
     static bool findStreamInfo(Logger* logger, AVFormatContext* formatCtx);
     static bool readFrame(Logger* logger, AVFormatContext* fmtCtx, AVPacket*& packet, bool allocPacket = true, bool* isEof = nullptr);
     static bool findAndOpenAudioDecoder(Logger* logger, AVFormatContext* formatCtx, StreamIndexType streamIndex, UniquePtr<AVCodecContext>& codecContext);
+    static bool findAndOpenSubtitleDecoder(Logger* logger, AVFormatContext* formatCtx, StreamIndexType streamIndex, UniquePtr<AVCodecContext>& codecContext);
     static bool findAndOpenVideoDecoder(Logger* logger, AVFormatContext* formatCtx, StreamIndexType streamIndex, UniquePtr<AVCodecContext>& codecContext, bool useHardwareDecoder = false, uint64_t hardwareExtraFrameCount = 20, AVHWDeviceType* hwDeviceType = nullptr, AVPixelFormat* hwPixelFormat = nullptr);
     static void listAllHardwareDecoders(Logger* logger);
     // fromType 表示从AVHWDeviceType的哪一个的下一个开始遍历查找
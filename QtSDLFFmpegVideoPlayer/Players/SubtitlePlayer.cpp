@@ -0,0 +1,483 @@
+#include "SubtitlePlayer.h"
+#include "VideoPlayer.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// dst = (src * a + dst * (255 - a)) / 255
+// 全程16位无符号运算且循环内没有分支，GCC -O3/MSVC /O2下会被自动向量化，-O2的GCC 12仍为标量循环
+static inline void blendRow(uint8_t* __restrict dst, const uint8_t* __restrict src, const uint8_t* __restrict alpha, int width)
+{
+    for (int i = 0; i < width; ++i)
+    {
+        uint16_t a = alpha[i];
+        uint16_t t = static_cast<uint16_t>(src[i] * a + dst[i] * (255 - a) + 128);
+        dst[i] = static_cast<uint8_t>((t + (t >> 8)) >> 8); // 近似除以255并四舍五入
+    }
+}
+
+void SubtitlePlayer::setExternalDemuxer(const SharedPtr<UnifiedDemuxer>& demuxer)
+{
+    if (this->demuxer)
+    {
+        this->demuxer->setPacketEnqueueCallback(StreamType::STSubtitle, nullptr);
+        this->demuxer->removeStreamType(StreamType::STSubtitle);
+    }
+    demuxer->addStreamType(StreamType::STSubtitle);
+    // 字幕包入队后立即在回调中取走，最大队列长度设为0，避免空的字幕队列阻止解复用器在音视频队列已满时暂停
+    demuxer->setMaxPacketQueueSize(StreamType::STSubtitle, 0);
+    demuxer->setPacketEnqueueCallback(StreamType::STSubtitle, std::bind(&SubtitlePlayer::packetEnqueueCallback, this));
+    this->demuxer = demuxer;
+}
+
+bool SubtitlePlayer::open()
+{
+    close();
+    if (!demuxer)
+        return false;
+    auto* formatCtx = demuxer->getFormatContext();
+    StreamIndexType streamIndex = demuxer->getStreamIndex(StreamType::STSubtitle);
+    if (!formatCtx || streamIndex < 0)
+        return false; // 没有字幕流
+    UniquePtr<AVCodecContext> ctx{ nullptr, constDeleterAVCodecContext };
+    if (!MediaDecodeUtils::findAndOpenSubtitleDecoder(&logger, formatCtx, streamIndex, ctx))
+        return false;
+    std::lock_guard lock(mtx);
+    codecCtx.reset(ctx.release());
+    streamTimeBase = formatCtx->streams[streamIndex]->time_base;
+    const AVCodecDescriptor* desc = avcodec_descriptor_get(codecCtx->codec_id);
+    isBitmapCodec = desc && (desc->props & AV_CODEC_PROP_BITMAP_SUB);
+    if (!isBitmapCodec)
+    {
+#ifdef SUBTITLE_PLAYER_USE_LIBASS
+        if (!initAss(formatCtx))
+        {
+            closeAss();
+            codecCtx.reset();
+            return false;
+        }
+#else
+        logger.warning("Subtitle stream {} ({}) is a text subtitle, which is not supported in a build without libass", streamIndex, avcodec_get_name(codecCtx->codec_id));
+        codecCtx.reset();
+        return false;
+#endif
+    }
+    logger.info("Opened subtitle stream {}, codec: {}, bitmap: {}", streamIndex, avcodec_get_name(codecCtx->codec_id), isBitmapCodec);
+    return true;
+}
+
+void SubtitlePlayer::close()
+{
+    std::lock_guard lock(mtx);
+#ifdef SUBTITLE_PLAYER_USE_LIBASS
+    closeAss();
+#endif
+    events.clear();
+    codecCtx.reset();
+    bitmapSwsCtx.reset();
+    isBitmapCodec = false;
+}
+
+void SubtitlePlayer::clearBuffers()
+{
+    std::lock_guard lock(mtx);
+    events.clear();
+    if (codecCtx)
+        avcodec_flush_buffers(codecCtx.get());
+#ifdef SUBTITLE_PLAYER_USE_LIBASS
+    if (assTrack)
+        ass_flush_events(assTrack);
+    assOverlay.reset();
+#endif
+}
+
+void SubtitlePlayer::packetEnqueueCallback()
+{
+    auto* queue = demuxer ? demuxer->getPacketQueue(StreamType::STSubtitle) : nullptr;
+    if (!queue)
+        return;
+    AVPacket* pkt = nullptr;
+    while (ConcurrentQueueOps::tryDequeue(*queue, pkt))
+    {
+        decodePacket(pkt);
+        av_packet_free(&pkt);
+    }
+}
+
+void SubtitlePlayer::decodePacket(AVPacket* pkt)
+{
+    std::lock_guard lock(mtx);
+    if (!codecCtx)
+        return;
+    AVSubtitle sub{};
+    int gotSubtitle = 0;
+    int rst = avcodec_decode_subtitle2(codecCtx.get(), &sub, &gotSubtitle, pkt);
+    if (rst < 0)
+    {
+        char errStrBuf[AV_ERROR_MAX_STRING_SIZE];
+        logger.error("Error decoding subtitle packet: code: {}, message: {}", rst, av_make_error_string(errStrBuf, AV_ERROR_MAX_STRING_SIZE, rst));
+        return;
+    }
+    if (!gotSubtitle)
+        return;
+    // AVSubtitle::pts的单位为AV_TIME_BASE，显示起止时间为相对pts的毫秒数
+    double baseTime = 0.0;
+    if (sub.pts != AV_NOPTS_VALUE)
+        baseTime = sub.pts / static_cast<double>(AV_TIME_BASE);
+    else if (pkt->pts != AV_NOPTS_VALUE)
+        baseTime = pkt->pts * av_q2d(streamTimeBase);
+    else
+    {
+        avsubtitle_free(&sub);
+        return;
+    }
+    SubtitleEvent event;
+    event.startTime = baseTime + sub.start_display_time / 1000.0;
+    if (sub.end_display_time != 0 && sub.end_display_time != UINT32_MAX)
+        event.endTime = baseTime + sub.end_display_time / 1000.0;
+    else if (isBitmapCodec)
+        event.endTime = std::numeric_limits<double>::infinity(); // PGS等由下一个显示集（可能为空）结束
+    else if (pkt->duration > 0)
+        event.endTime = event.startTime + pkt->duration * av_q2d(streamTimeBase);
+    else
+        event.endTime = event.startTime + DEFAULT_TEXT_DURATION;
+    if (codecCtx->width > 0 && codecCtx->height > 0)
+        event.canvasSize = SizeI{ codecCtx->width, codecCtx->height };
+    for (unsigned i = 0; i < sub.num_rects; ++i)
+    {
+        const AVSubtitleRect* rect = sub.rects[i];
+        switch (rect->type)
+        {
+        case SUBTITLE_BITMAP:
+        {
+            if (rect->w <= 0 || rect->h <= 0 || !rect->data[0] || !rect->data[1])
+                break;
+            // 按调色板展开为RGB32，光栅化时只需要sws缩放和转换
+            BitmapRect bitmap{ rect->x, rect->y, makeSharedFrame() };
+            bitmap.frame->width = rect->w;
+            bitmap.frame->height = rect->h;
+            bitmap.frame->format = AV_PIX_FMT_RGB32;
+            if (av_frame_get_buffer(bitmap.frame.get(), 0) < 0)
+                break;
+            const uint32_t* palette = reinterpret_cast<const uint32_t*>(rect->data[1]);
+            for (int y = 0; y < rect->h; ++y)
+            {
+                const uint8_t* src = rect->data[0] + y * rect->linesize[0];
+                uint32_t* dst = reinterpret_cast<uint32_t*>(bitmap.frame->data[0] + y * bitmap.frame->linesize[0]);
+                for (int x = 0; x < rect->w; ++x)
+                    dst[x] = palette[src[x]];
+            }
+            event.bitmaps.push_back(std::move(bitmap));
+            break;
+        }
+        case SUBTITLE_ASS:
+        {
+            if (!rect->ass)
+                break;
+#ifdef SUBTITLE_PLAYER_USE_LIBASS
+            // 文本字幕交给libass按时间渲染，不保存为事件
+            if (assTrack)
+                ass_process_chunk(assTrack, rect->ass, static_cast<int>(strlen(rect->ass)),
+                    std::llround(event.startTime * 1000), std::llround((event.endTime - event.startTime) * 1000));
+#endif
+            break;
+        }
+        default:
+            break;
+        }
+    }
+    avsubtitle_free(&sub);
+    ++stats.decodedEvents;
+    addEvent(std::move(event));
+}
+
+// 需要持有锁
+void SubtitlePlayer::addEvent(SubtitleEvent&& event)
+{
+    // 位图字幕的新显示集（包括用于清屏的空显示集）会替换当前画面
+    if (isBitmapCodec)
+    {
+        for (auto& e : events)
+            if (e.startTime < event.startTime && e.endTime > event.startTime)
+                e.endTime = event.startTime;
+    }
+    if (event.bitmaps.empty())
+        return;
+    auto it = std::upper_bound(events.begin(), events.end(), event.startTime,
+        [](double t, const SubtitleEvent& e) { return t < e.startTime; });
+    events.insert(it, std::move(event));
+    while (events.size() > MAX_EVENT_COUNT)
+        events.pop_front();
+}
+
+bool SubtitlePlayer::composite(AVFrame* frame, double time, SizeI videoSize)
+{
+    if (!frame || frame->format != AV_PIX_FMT_YUV420P || !enabled.load())
+        return false;
+    std::lock_guard lock(mtx);
+    if (!codecCtx)
+        return false;
+    SizeI frameSize{ frame->width, frame->height };
+    // 渲染按时间顺序进行，已经结束的事件不会再显示
+    std::erase_if(events, [time](const SubtitleEvent& e) { return e.endTime <= time; });
+    bool composited = false;
+    if (isBitmapCodec)
+    {
+        for (auto& event : events)
+        {
+            if (event.startTime > time)
+                break;
+            if (!event.overlay || !(event.overlay->frameSize == frameSize))
+            {
+                event.overlay = rasterizeBitmapEvent(event, frameSize, videoSize);
+                ++stats.rasterizedOverlays;
+            }
+            else
+                ++stats.overlayCacheHits;
+            if (event.overlay && !event.overlay->regions.empty())
+            {
+                blendOverlay(frame, *event.overlay);
+                composited = true;
+            }
+        }
+    }
+#ifdef SUBTITLE_PLAYER_USE_LIBASS
+    else if (assTrack)
+    {
+        auto overlay = renderAss(time, frameSize, videoSize);
+        if (overlay && !overlay->regions.empty())
+        {
+            blendOverlay(frame, *overlay);
+            composited = true;
+        }
+    }
+#endif
+    if (composited)
+        ++stats.compositedFrames;
+    return composited;
+}
+
+SubtitlePlayer::SharedPtr<SubtitlePlayer::Overlay> SubtitlePlayer::rasterizeBitmapEvent(const SubtitleEvent& event, SizeI frameSize, SizeI videoSize)
+{
+    auto overlay = std::make_shared<Overlay>();
+    overlay->frameSize = frameSize;
+    SizeI canvasSize = (event.canvasSize.width() > 0 && event.canvasSize.height() > 0) ? event.canvasSize : videoSize;
+    if (canvasSize.width() <= 0 || canvasSize.height() <= 0)
+        return overlay;
+    double scaleX = frameSize.width() / static_cast<double>(canvasSize.width());
+    double scaleY = frameSize.height() / static_cast<double>(canvasSize.height());
+    for (const auto& bitmap : event.bitmaps)
+    {
+        // 区域起点和尺寸都对齐到偶数，超出输出帧的部分在混合时裁剪
+        OverlayRegion region;
+        region.x = static_cast<int>(std::lround(bitmap.x * scaleX)) & ~1;
+        region.y = static_cast<int>(std::lround(bitmap.y * scaleY)) & ~1;
+        int width = std::max(2, (static_cast<int>(std::lround(bitmap.frame->width * scaleX)) + 1) & ~1);
+        int height = std::max(2, (static_cast<int>(std::lround(bitmap.frame->height * scaleY)) + 1) & ~1);
+        region.frame = makeSharedFrame();
+        region.frame->width = width;
+        region.frame->height = height;
+        region.frame->format = AV_PIX_FMT_YUVA420P;
+        if (av_frame_get_buffer(region.frame.get(), 0) < 0)
+            continue;
+        // 字幕位图很小，单线程即可；不经过共享缓存，尺寸各异的字幕不会挤掉视频与缩略图的swsCtx
+        SwsContext* swsCtx = sws_getCachedContext(bitmapSwsCtx.release(), bitmap.frame->width, bitmap.frame->height, AV_PIX_FMT_RGB32,
+            width, height, AV_PIX_FMT_YUVA420P, SWS_BILINEAR, nullptr, nullptr, nullptr);
+        bitmapSwsCtx.reset(swsCtx);
+        if (!swsCtx || !VideoPlayer::swsScaleFrame(swsCtx, bitmap.frame.get(), region.frame.get(), &logger))
+            continue;
+        computeChromaAlpha(region);
+        overlay->regions.push_back(std::move(region));
+    }
+    return overlay;
+}
+
+void SubtitlePlayer::computeChromaAlpha(OverlayRegion& region)
+{
+    const AVFrame* f = region.frame.get();
+    int chromaWidth = (f->width + 1) / 2;
+    int chromaHeight = (f->height + 1) / 2;
+    region.chromaAlpha.resize(static_cast<size_t>(chromaWidth) * chromaHeight);
+    for (int cy = 0; cy < chromaHeight; ++cy)
+    {
+        const uint8_t* row0 = f->data[3] + (2 * cy) * f->linesize[3];
+        const uint8_t* row1 = (2 * cy + 1 < f->height) ? row0 + f->linesize[3] : row0;
+        uint8_t* dst = region.chromaAlpha.data() + static_cast<size_t>(cy) * chromaWidth;
+        for (int cx = 0; cx < chromaWidth; ++cx)
+        {
+            int x0 = 2 * cx;
+            int x1 = std::min(x0 + 1, f->width - 1);
+            dst[cx] = static_cast<uint8_t>((row0[x0] + row0[x1] + row1[x0] + row1[x1] + 2) >> 2);
+        }
+    }
+}
+
+void SubtitlePlayer::blendOverlay(AVFrame* frame, const Overlay& overlay)
+{
+    for (const auto& region : overlay.regions)
+    {
+        const AVFrame* src = region.frame.get();
+        // 亮度平面，裁剪到输出帧范围内
+        int x0 = std::max(region.x, 0);
+        int y0 = std::max(region.y, 0);
+        int x1 = std::min(region.x + src->width, frame->width);
+        int y1 = std::min(region.y + src->height, frame->height);
+        if (x1 <= x0 || y1 <= y0)
+            continue;
+        for (int y = y0; y < y1; ++y)
+        {
+            int sy = y - region.y;
+            blendRow(frame->data[0] + y * frame->linesize[0] + x0,
+                src->data[0] + sy * src->linesize[0] + (x0 - region.x),
+                src->data[3] + sy * src->linesize[3] + (x0 - region.x),
+                x1 - x0);
+        }
+        // 色度平面，region的坐标为偶数，可以直接除以2
+        int regionCx = region.x / 2;
+        int regionCy = region.y / 2;
+        int srcChromaWidth = (src->width + 1) / 2;
+        int cx0 = x0 / 2;
+        int cy0 = y0 / 2;
+        int cx1 = std::min((x1 + 1) / 2, (frame->width + 1) / 2);
+        int cy1 = std::min((y1 + 1) / 2, (frame->height + 1) / 2);
+        for (int cy = cy0; cy < cy1; ++cy)
+        {
+            int sy = cy - regionCy;
+            const uint8_t* alpha = region.chromaAlpha.data() + static_cast<size_t>(sy) * srcChromaWidth + (cx0 - regionCx);
+            for (int plane = 1; plane <= 2; ++plane)
+                blendRow(frame->data[plane] + cy * frame->linesize[plane] + cx0,
+                    src->data[plane] + sy * src->linesize[plane] + (cx0 - regionCx),
+                    alpha, cx1 - cx0);
+        }
+    }
+}
+
+#ifdef SUBTITLE_PLAYER_USE_LIBASS
+// 需要持有锁
+bool SubtitlePlayer::initAss(AVFormatContext* formatCtx)
+{
+    assLibrary = ass_library_init();
+    if (!assLibrary)
+    {
+        logger.error("Could not initialize libass");
+        return false;
+    }
+    ass_set_extract_fonts(assLibrary, 1);
+    // 加载容器中以附件形式携带的字体（MKV常见）
+    for (unsigned i = 0; i < formatCtx->nb_streams; ++i)
+    {
+        const AVStream* stream = formatCtx->streams[i];
+        if (stream->codecpar->codec_type != AVMEDIA_TYPE_ATTACHMENT || !stream->codecpar->extradata)
+            continue;
+        const AVDictionaryEntry* filename = av_dict_get(stream->metadata, "filename", nullptr, 0);
+        const AVDictionaryEntry* mimetype = av_dict_get(stream->metadata, "mimetype", nullptr, 0);
+        if (!filename || !mimetype)
+            continue;
+        std::string mime{ mimetype->value };
+        if (mime.find("font") == std::string::npos && mime.find("truetype") == std::string::npos && mime.find("opentype") == std::string::npos)
+            continue;
+        ass_add_font(assLibrary, filename->value, reinterpret_cast<char*>(stream->codecpar->extradata), stream->codecpar->extradata_size);
+    }
+    assRenderer = ass_renderer_init(assLibrary);
+    if (!assRenderer)
+    {
+        logger.error("Could not initialize libass renderer");
+        return false;
+    }
+    ass_set_fonts(assRenderer, nullptr, "sans-serif", ASS_FONTPROVIDER_AUTODETECT, nullptr, 1);
+    assTrack = ass_new_track(assLibrary);
+    if (!assTrack)
+    {
+        logger.error("Could not create libass track");
+        return false;
+    }
+    // 文本字幕解码器（包括SRT）都会输出ASS事件，字幕头中包含样式定义
+    if (codecCtx->subtitle_header && codecCtx->subtitle_header_size > 0)
+        ass_process_codec_private(assTrack, reinterpret_cast<char*>(codecCtx->subtitle_header), codecCtx->subtitle_header_size);
+    return true;
+}
+
+// 需要持有锁
+void SubtitlePlayer::closeAss()
+{
+    assOverlay.reset();
+    if (assTrack)
+        ass_free_track(assTrack);
+    if (assRenderer)
+        ass_renderer_done(assRenderer);
+    if (assLibrary)
+        ass_library_done(assLibrary);
+    assTrack = nullptr;
+    assRenderer = nullptr;
+    assLibrary = nullptr;
+}
+
+// 需要持有锁
+SubtitlePlayer::SharedPtr<SubtitlePlayer::Overlay> SubtitlePlayer::renderAss(double time, SizeI frameSize, SizeI videoSize)
+{
+    bool sizeChanged = !assOverlay || !(assOverlay->frameSize == frameSize);
+    if (sizeChanged)
+    {
+        ass_set_frame_size(assRenderer, frameSize.width(), frameSize.height());
+        if (videoSize.width() > 0 && videoSize.height() > 0)
+            ass_set_storage_size(assRenderer, videoSize.width(), videoSize.height());
+    }
+    int changed = 0;
+    ASS_Image* images = ass_render_frame(assRenderer, assTrack, std::llround(time * 1000), &changed);
+    if (!sizeChanged && changed == 0) // 画面与上一次相同
+    {
+        ++stats.overlayCacheHits;
+        return assOverlay;
+    }
+    auto overlay = std::make_shared<Overlay>();
+    overlay->frameSize = frameSize;
+    for (ASS_Image* image = images; image; image = image->next)
+    {
+        if (image->w <= 0 || image->h <= 0)
+            continue;
+        // ASS_Image是单色的透明度蒙版，color为RGBA，其中A为透明度（0表示不透明）
+        int r = (image->color >> 24) & 0xFF;
+        int g = (image->color >> 16) & 0xFF;
+        int b = (image->color >> 8) & 0xFF;
+        int opacity = 255 - static_cast<int>(image->color & 0xFF);
+        // BT.601 limited range
+        uint8_t colorY = static_cast<uint8_t>(16 + ((66 * r + 129 * g + 25 * b + 128) >> 8));
+        uint8_t colorU = static_cast<uint8_t>(128 + ((-38 * r - 74 * g + 112 * b + 128) >> 8));
+        uint8_t colorV = static_cast<uint8_t>(128 + ((112 * r - 94 * g - 18 * b + 128) >> 8));
+        OverlayRegion region;
+        region.x = image->dst_x & ~1;
+        region.y = image->dst_y & ~1;
+        int offsetX = image->dst_x - region.x;
+        int offsetY = image->dst_y - region.y;
+        region.frame = makeSharedFrame();
+        region.frame->width = (image->w + offsetX + 1) & ~1;
+        region.frame->height = (image->h + offsetY + 1) & ~1;
+        region.frame->format = AV_PIX_FMT_YUVA420P;
+        if (av_frame_get_buffer(region.frame.get(), 0) < 0)
+            continue;
+        AVFrame* f = region.frame.get();
+        for (int y = 0; y < f->height; ++y)
+        {
+            memset(f->data[0] + y * f->linesize[0], colorY, f->width);
+            memset(f->data[3] + y * f->linesize[3], 0, f->width);
+        }
+        for (int y = 0; y < (f->height + 1) / 2; ++y)
+        {
+            memset(f->data[1] + y * f->linesize[1], colorU, (f->width + 1) / 2);
+            memset(f->data[2] + y * f->linesize[2], colorV, (f->width + 1) / 2);
+        }
+        for (int y = 0; y < image->h; ++y)
+        {
+            const uint8_t* src = image->bitmap + y * image->stride;
+            uint8_t* dst = f->data[3] + (y + offsetY) * f->linesize[3] + offsetX;
+            for (int x = 0; x < image->w; ++x)
+                dst[x] = static_cast<uint8_t>((src[x] * opacity + 127) / 255);
+        }
+        computeChromaAlpha(region);
+        overlay->regions.push_back(std::move(region));
+    }
+    ++stats.rasterizedOverlays;
+    assOverlay = overlay;
+    return overlay;
+}
+#endif
@@ -0,0 +1,130 @@
+#pragma once
+#include "PlayerPredefine.h"
+#include <deque>
+
+// 文本字幕（SRT/ASS等）由libass渲染，构建时定义SUBTITLE_PLAYER_USE_LIBASS并链接libass（qmake: CONFIG+=libass）
+// 默认构建不带libass，只支持位图字幕（PGS/DVB/DVD），文本字幕流不会打开
+#ifdef SUBTITLE_PLAYER_USE_LIBASS
+extern "C"
+{
+#include <ass/ass.h>
+}
+#endif
+
+// 字幕播放器，与音视频播放器并列，由外部UnifiedDemuxer提供字幕包
+// 字幕包在解复用线程的入队回调中直接解码（字幕流很稀疏，不单独开线程），解码结果按时间保存为字幕事件
+// 渲染线程根据视频帧时间调用composite，将当前字幕混合到YUV420P输出帧上
+// 位图字幕（PGS/DVB等）每个事件按输出尺寸光栅化一次后缓存，使用独立的swsCtx，不占用视频共享的SwsContextCache
+// 文本字幕仅在启用libass时支持，画面不变时复用上一次的结果
+class SubtitlePlayer : public PlayerTypes {
+public:
+    static constexpr size_t MAX_EVENT_COUNT = 256; // 最多保存的字幕事件数量，超出时丢弃最早的事件
+    static constexpr double DEFAULT_TEXT_DURATION = 5.0; // 文本字幕没有给出显示时长时的默认时长，单位：秒
+
+    // 光栅化后的一块字幕区域，坐标为输出帧上的像素坐标（偶数对齐，便于4:2:0色度混合）
+    struct OverlayRegion {
+        int x{ 0 };
+        int y{ 0 };
+        SharedPtr<AVFrame> frame{ nullptr }; // YUVA420P
+        std::vector<uint8_t> chromaAlpha; // 2x2下采样后的透明度，尺寸为色度平面尺寸
+    };
+    // 某一输出尺寸下的字幕画面
+    struct Overlay {
+        SizeI frameSize;
+        std::vector<OverlayRegion> regions;
+    };
+    struct Statistics {
+        uint64_t decodedEvents{ 0 };
+        uint64_t rasterizedOverlays{ 0 }; // 光栅化次数
+        uint64_t overlayCacheHits{ 0 }; // 复用已缓存画面的次数
+        uint64_t compositedFrames{ 0 }; // 实际混合了字幕的视频帧数量
+        size_t eventCount{ 0 }; // 当前保存的字幕事件数量
+    };
+
+private:
+    const std::string loggerName{ "SubtitlePlayer" };
+    DefinePlayerLoggerSinks(loggerSinks, loggerName);
+    Logger logger{ loggerName, loggerSinks };
+
+    // 位图字幕的一个矩形，已按调色板展开为RGB32，坐标为字幕画布坐标
+    struct BitmapRect {
+        int x{ 0 };
+        int y{ 0 };
+        SharedPtr<AVFrame> frame{ nullptr };
+    };
+    struct SubtitleEvent {
+        double startTime{ 0.0 }; // 单位：秒，与视频帧时间同一时间轴
+        double endTime{ 0.0 }; // 单位：秒，位图字幕未给出结束时间时为无穷大，由下一个事件截断
+        SizeI canvasSize; // 位图字幕的画布尺寸，未知时为无效尺寸，使用视频尺寸
+        std::vector<BitmapRect> bitmaps;
+        SharedPtr<Overlay> overlay{ nullptr }; // 缓存的光栅化结果
+    };
+
+    SharedPtr<UnifiedDemuxer> demuxer{ nullptr };
+    UniquePtr<AVCodecContext> codecCtx{ nullptr, constDeleterAVCodecContext };
+    AVRational streamTimeBase{ 0, 1 };
+    bool isBitmapCodec{ false };
+
+    mutable Mutex mtx; // 保护以下成员，解码在解复用线程，混合在渲染线程
+    std::deque<SubtitleEvent> events; // 按开始时间排序
+    // 位图光栅化用的swsCtx，只在尺寸变化时重建（sws_getCachedContext）
+    UniquePtr<SwsContext> bitmapSwsCtx{ nullptr, [](SwsContext* p) { sws_freeContext(p); } };
+    Statistics stats;
+    AtomicBool enabled{ true };
+
+#ifdef SUBTITLE_PLAYER_USE_LIBASS
+    ASS_Library* assLibrary{ nullptr };
+    ASS_Renderer* assRenderer{ nullptr };
+    ASS_Track* assTrack{ nullptr };
+    SharedPtr<Overlay> assOverlay{ nullptr };
+#endif
+
+public:
+    SubtitlePlayer() = default;
+    SubtitlePlayer(const SubtitlePlayer&) = delete;
+    SubtitlePlayer& operator=(const SubtitlePlayer&) = delete;
+    ~SubtitlePlayer() {
+        close();
+    }
+
+    // 在解复用器中添加字幕流，需在demuxer选择流之前调用
+    void setExternalDemuxer(const SharedPtr<UnifiedDemuxer>& demuxer);
+    // 打开解复用器所选字幕流的解码器，在demuxer选择流之后、启动之前调用
+    // 文件没有字幕流，或者字幕流为文本而未启用libass时返回false
+    bool open();
+    void close();
+    bool isOpen() const {
+        std::lock_guard lock(mtx);
+        return codecCtx != nullptr;
+    }
+    // seek后调用，清空已解码的字幕事件和解码器状态
+    void clearBuffers();
+
+    void setEnabled(bool enabled) { this->enabled.store(enabled); }
+    bool isEnabled() const { return enabled.load(); }
+
+    // 将time时刻的字幕混合到frame（YUV420P）上，videoSize为缩放前视频帧尺寸，用于定位位图字幕
+    // \return 是否混合了字幕
+    bool composite(AVFrame* frame, double time, SizeI videoSize);
+
+    Statistics statistics() const {
+        std::lock_guard lock(mtx);
+        Statistics s = stats;
+        s.eventCount = events.size();
+        return s;
+    }
+
+private:
+    void packetEnqueueCallback();
+    void decodePacket(AVPacket* pkt);
+    void addEvent(SubtitleEvent&& event);
+    SharedPtr<Overlay> rasterizeBitmapEvent(const SubtitleEvent& event, SizeI frameSize, SizeI videoSize);
+    static void blendOverlay(AVFrame* frame, const Overlay& overlay);
+    static void computeChromaAlpha(OverlayRegion& region);
+
+#ifdef SUBTITLE_PLAYER_USE_LIBASS
+    bool initAss(AVFormatContext* formatCtx);
+    void closeAss();
+    SharedPtr<Overlay> renderAss(double time, SizeI frameSize, SizeI videoSize);
+#endif
+};
@@ -1,5 +1,6 @@
 #include "VideoPlayer.h"
 #include <FrameProcessor.h>
+#include <SwsContextCache.h>
 
 bool VideoPlayer::prepareBeforePlayback()
 {
@@ -196,6 +197,41 @@ void VideoPlayer::packet2VideoFrames()
     auto& threadStateManager = playbackStateVariables.threadStateManager;
     auto&& waitObj = threadStateManager.addThread(ThreadIdentifier::Decoder);
     ThreadStateManager::AutoRemovedThreadObj autoRemoveWaitObj{ threadStateManager, waitObj };
+    AVCodecContext* codecCtx = playbackStateVariables.codecCtx.get();
+    // 省电模式：已生效的模式，模式改变时调整解码器与流的丢弃策略
+    PowerMode appliedPowerMode = PowerMode::Normal;
+    bool waitingForKeyframe = false; // 等待关键帧的包，到达后恢复正常解码，避免参考帧缺失造成花屏
+    auto applyPowerMode = [&](PowerMode mode) {
+        const bool externalDemuxer = demuxerMode == ComponentWorkMode::External;
+        if (mode == PowerMode::Suspended)
+        {
+            if (externalDemuxer)
+            {
+                // 共享的解复用器不再读出视频包，音频照常；已解码未渲染的帧作废
+                requestStreamDiscard(AVDISCARD_ALL);
+                AVFrame* frame = nullptr;
+                while (tryDequeue(playbackStateVariables.frameQueue, frame))
+                    av_frame_free(&frame);
+                renderResetRequested.store(true);
+            }
+            playbackStateVariables.isVideoClockStable.store(false);
+        }
+        else
+        {
+            const bool packetsDropped = appliedPowerMode == PowerMode::Suspended && externalDemuxer;
+            if (packetsDropped)
+            {
+                requestStreamDiscard(AVDISCARD_DEFAULT);
+                avcodec_flush_buffers(codecCtx); // 期间的包已被丢弃，解码器中的参考帧作废
+            }
+            // 跳过过非关键帧或丢弃过包时参考帧不完整，恢复正常模式也要等到下一个关键帧
+            const bool referencesLost = packetsDropped || codecCtx->skip_frame != AVDISCARD_DEFAULT;
+            if (mode == PowerMode::KeyframesOnly || referencesLost)
+                codecCtx->skip_frame = AVDISCARD_NONKEY;
+            waitingForKeyframe = mode == PowerMode::Normal && referencesLost;
+        }
+        appliedPowerMode = mode;
+        };
     while (true)
     {
         if (waitObj.isBlocking())
@@ -208,6 +244,20 @@ void VideoPlayer::packet2VideoFrames()
             waitObj.pause();
             continue;
         }
+        if (PowerMode mode = powerMode.load(); mode != appliedPowerMode)
+            applyPowerMode(mode);
+        if (appliedPowerMode == PowerMode::Suspended)
+        {
+            // 丢弃切换前已入队的包，内部解复用器的包保留，读满包队列后解复用器自行暂停
+            if (demuxerMode == ComponentWorkMode::External)
+            {
+                AVPacket* pkt = nullptr;
+                while (tryDequeue(*playbackStateVariables.packetQueue, pkt))
+                    av_packet_free(&pkt);
+            }
+            waitObj.pause();
+            continue;
+        }
         if (getQueueSize(playbackStateVariables.frameQueue) >= MAX_VIDEO_FRAME_QUEUE_SIZE)
         {
             waitObj.pause(); // 如果视频帧队列中有太多数据，等待消费掉一些再继续解码
@@ -226,11 +276,16 @@ void VideoPlayer::packet2VideoFrames()
             continue;
         logger.trace("Got video packet, current video packet queue size: {}", getQueueSize(*playbackStateVariables.packetQueue));
         UniquePtr<AVPacket> pktPtr{ videoPkt, constDeleterAVPacket };
-        int aspRst = avcodec_send_packet(playbackStateVariables.codecCtx.get(), videoPkt);
+        if (waitingForKeyframe && (videoPkt->flags & AV_PKT_FLAG_KEY))
+        {
+            codecCtx->skip_frame = AVDISCARD_DEFAULT; // 从关键帧开始恢复正常解码
+            waitingForKeyframe = false;
+        }
+        int aspRst = avcodec_send_packet(codecCtx, videoPkt);
         if (aspRst < 0 && aspRst != AVERROR(EAGAIN) && aspRst != AVERROR_EOF)
             continue;
         UniquePtr<AVFrame> frame{ av_frame_alloc(), constDeleterAVFrame }; // 用于存放解码后的视频帧
-        while (avcodec_receive_frame(playbackStateVariables.codecCtx.get(), frame.get()) == 0)
+        while (avcodec_receive_frame(codecCtx, frame.get()) == 0)
         {
             AVFrame* refFrame{ av_frame_alloc() };
             if (av_frame_ref(refFrame, frame.get()) < 0)
@@ -264,6 +319,12 @@ void VideoPlayer::renderVideo()
         frameDuration = av_q2d(av_inv_q(frameRate)); // 每帧的秒数，用于备选：计算视频时钟
     // 软硬件
     SharedPtr<AVFrame> rawFrame{ makeSharedFrame(nullptr) };
+    // 去隔行输出的帧，场率输出时一帧隔行帧对应两帧
+    std::deque<SharedPtr<AVFrame>> deinterlacedFrames;
+    AVRational streamTimeBase = playbackStateVariables.formatCtx->streams[playbackStateVariables.streamIndex]->time_base;
+    deinterlacer.reset();
+    renderResetRequested.store(false);
+    bool discontinuity = true; // 下一帧是否为不连续后的第一帧
 
     //UniquePtr<AVFrame> rawFrame{ makeUniqueFrame(nullptr) };
     //UniquePtr<AVFrame> switchedFrame{ makeUniqueFrame() }; // 用于存放转换为新格式的视频帧
@@ -350,9 +411,22 @@ void VideoPlayer::renderVideo()
             waitObj.pause();
             continue;
         }
+        if (renderResetRequested.exchange(false))
+        {
+            // seek前的帧不能再显示，包括去隔行滤镜图中缓存的和已输出未显示的
+            deinterlacer.reset();
+            deinterlacedFrames.clear();
+            discontinuity = true;
+        }
         if (getQueueSize(playbackStateVariables.frameQueue) < MIN_VIDEO_FRAME_QUEUE_SIZE)
             threadStateManager.wakeUpById(ThreadIdentifier::Decoder);
-        // 从队列中取出一个视频帧进行处理
+        // 从队列中取出一个视频帧进行处理，去隔行输出的帧优先
+        if (!deinterlacedFrames.empty())
+        {
+            rawFrame = deinterlacedFrames.front();
+            deinterlacedFrames.pop_front();
+        }
+        else
         {
             AVFrame* frame = nullptr;
             if (!tryDequeue(playbackStateVariables.frameQueue, frame))
@@ -362,6 +436,26 @@ void VideoPlayer::renderVideo()
                 continue; // 队列为空，继续下一轮循环
             }
             rawFrame.reset(frame, constDeleterAVFrame); // 取出队列头部元素
+            // 去隔行，所有帧都要送入滤镜图（bwdif/yadif需要前后帧作参考），硬件帧先下载到内存
+            if (deinterlacer.wants(rawFrame.get()))
+            {
+                SharedPtr<AVFrame> swFrame{ rawFrame };
+                if (rawFrame->hw_frames_ctx)
+                {
+                    if (hwFramePixFmt == AV_PIX_FMT_NONE)
+                        hwFramePixFmt = getHwFramePixelFormat(rawFrame->hw_frames_ctx);
+                    swFrame = makeSharedFrame();
+                    if (!hwToSwFrame(swFrame.get(), rawFrame.get(), hwFramePixFmt))
+                        swFrame.reset();
+                }
+                if (swFrame && deinterlacer.process(swFrame.get(), streamTimeBase, deinterlacedFrames))
+                {
+                    if (deinterlacedFrames.empty())
+                        continue; // 滤镜需要后一帧作参考
+                    rawFrame = deinterlacedFrames.front();
+                    deinterlacedFrames.pop_front();
+                }
+            }
         }
         logger.trace("Got video frame, current video frame queue size: {}", getQueueSize(playbackStateVariables.frameQueue));
         auto timeBeforeTimeSync = std::chrono::high_resolution_clock::now();
@@ -384,7 +478,7 @@ void VideoPlayer::renderVideo()
             {
                 // 如果没有时间戳，使用累计时间，但是第一帧需要特殊处理
                 //if (playbackStateVariables.isVideoClockStable.load()) // 时钟稳定，正常累加，否则不予理会
-                    videoClockInside += frameDuration;
+                    videoClockInside += (rawFrame->duration > 0 ? rawFrame->duration * timeBase : frameDuration); // 场率输出时每帧时长减半
                 playbackStateVariables.videoClock.store(videoClockInside);
             }
             };
@@ -439,7 +533,9 @@ void VideoPlayer::renderVideo()
                 {
                     // 需要等待
                     logger.trace("Video sleep: {} ms", sleepTime);
-                    ThreadSleepMs(sleepTime); // 后续可以替换为可打断的睡眠，防止睡眠时间过长导致收不到阻塞/退出信号
+                    // 分段睡眠，只解码关键帧时两帧的间隔可达数秒，期间仍需响应阻塞/退出信号
+                    for (int64_t slept = 0; slept < sleepTime && !shouldStop() && !waitObj.isBlocking(); slept += MAX_RENDER_SLEEP_SLICE_MS)
+                        ThreadSleepMs(std::min(sleepTime - slept, MAX_RENDER_SLEEP_SLICE_MS));
                 }
                 else if (sleepTime < -300) // 超过x ms就跳帧
                 {
@@ -473,6 +569,8 @@ void VideoPlayer::renderVideo()
         frameCtx.filteredFrame = filteredFrame.get();
         frameCtx.isHardwareDecoded = isHardwareDecoded;
         frameCtx.hwFramePixelFormat = hwFramePixFmt;
+        frameCtx.isDiscontinuity = discontinuity;
+        discontinuity = false;
 
         // 渲染视频帧
         auto timeBeforeRender = std::chrono::high_resolution_clock::now();
@@ -590,9 +688,39 @@ AVPixelFormat VideoPlayer::getSupportedPixelFormat(AVPixelFormat pixFmt, bool& i
     return pixFmt;
 }
 
-SwsContext* VideoPlayer::checkAndGetCorrectSwsContext(SizeI srcSize, AVPixelFormat srcFmt, SizeI dstSize, AVPixelFormat dstFmt, SwsFlags flags, Logger* logger)
+VideoPlayer::AtomicInt VideoPlayer::swsThreadCount{ DEFAULT_SWS_THREAD_COUNT };
+
+SwsContext* VideoPlayer::allocSwsContext(SizeI srcSize, AVPixelFormat srcFmt, SizeI dstSize, AVPixelFormat dstFmt, SwsFlags flags, int threadCount, Logger* logger)
+{
+    SwsContext* sws = sws_alloc_context();
+    if (!sws)
+        return nullptr;
+    av_opt_set_int(sws, "srcw", srcSize.width(), 0);
+    av_opt_set_int(sws, "srch", srcSize.height(), 0);
+    av_opt_set_int(sws, "src_format", srcFmt, 0);
+    av_opt_set_int(sws, "dstw", dstSize.width(), 0);
+    av_opt_set_int(sws, "dsth", dstSize.height(), 0);
+    av_opt_set_int(sws, "dst_format", dstFmt, 0);
+    av_opt_set_int(sws, "sws_flags", flags, 0);
+    av_opt_set_int(sws, "threads", threadCount, 0); // 切片线程数，0为自动
+    int rst = sws_init_context(sws, nullptr, nullptr);
+    if (rst < 0)
+    {
+        char errStrBuf[AV_ERROR_MAX_STRING_SIZE];
+        if (logger) logger->error("Could not initialize SwsContext: code: {}, message: {}", rst, av_make_error_string(errStrBuf, AV_ERROR_MAX_STRING_SIZE, rst));
+        sws_freeContext(sws);
+        return nullptr;
+    }
+    return sws;
+}
+
+SwsContext* VideoPlayer::checkAndGetCorrectSwsContext(SizeI srcSize, AVPixelFormat srcFmt, SizeI dstSize, AVPixelFormat dstFmt, SwsFlags flags, Logger* logger, int threadCount)
 {
-    auto* sws = sws_getContext(srcSize.width(), srcSize.height(), srcFmt, dstSize.width(), dstSize.height(), dstFmt, flags, nullptr, nullptr, nullptr);
+    if (threadCount < 0)
+        threadCount = swsThreadCount.load();
+    auto* sws = allocSwsContext(srcSize, srcFmt, dstSize, dstFmt, flags, threadCount, logger);
+    if (!sws)
+        return nullptr;
     bool isDeprecated = false;
     auto target = getSupportedPixelFormat(srcFmt, isDeprecated);
     if (isDeprecated)
@@ -607,7 +735,9 @@ SwsContext* VideoPlayer::checkAndGetCorrectSwsContext(SizeI srcSize, AVPixelForm
             return sws;
         }
         sws_freeContext(sws);
-        sws = sws_getContext(srcSize.width(), srcSize.height(), target, dstSize.width(), dstSize.height(), dstFmt, flags, nullptr, nullptr, nullptr);
+        sws = allocSwsContext(srcSize, target, dstSize, dstFmt, flags, threadCount, logger);
+        if (!sws)
+            return nullptr;
         srcRange = 1; // 0-255
         sws_setColorspaceDetails(sws, invTable, srcRange, table, dstRange, b, c, s);
         if (logger) logger->info("Deprecated pixel format: {} to supported pixel format: {}", static_cast<std::underlying_type_t<AVPixelFormat>>(srcFmt), static_cast<std::underlying_type_t<AVPixelFormat>>(target));
@@ -615,7 +745,23 @@ SwsContext* VideoPlayer::checkAndGetCorrectSwsContext(SizeI srcSize, AVPixelForm
     return sws;
 }
 
-VideoPlayer::SharedPtr<SwsContext> VideoPlayer::createSwsContext(AVFrame* targetFrame, AVPixelFormat srcPixFmt, SizeI srcSize, Logger* logger)
+void VideoPlayer::setSwsSourceColorDetails(SwsContext* swsCtx, AVColorSpace srcColorSpace, AVColorRange srcColorRange)
+{
+    if (!swsCtx || (srcColorSpace == AVCOL_SPC_UNSPECIFIED && srcColorRange == AVCOL_RANGE_UNSPECIFIED))
+        return;
+    int* invTable = nullptr;
+    int* table = nullptr;
+    int srcRange{ 0 }, dstRange{ 0 }, b{ 0 }, c{ 0 }, s{ 0 };
+    int rst = sws_getColorspaceDetails(swsCtx, &invTable, &srcRange, &table, &dstRange, &b, &c, &s);
+    if (rst < 0 || !invTable || !table) // 源或目标不是YUV格式时不支持
+        return;
+    const int* coefficients = srcColorSpace != AVCOL_SPC_UNSPECIFIED ? sws_getCoefficients(srcColorSpace) : invTable;
+    if (srcColorRange != AVCOL_RANGE_UNSPECIFIED)
+        srcRange = srcColorRange == AVCOL_RANGE_JPEG ? 1 : 0; // 1: 0-255
+    sws_setColorspaceDetails(swsCtx, coefficients, srcRange, table, dstRange, b, c, s);
+}
+
+VideoPlayer::SharedPtr<SwsContext> VideoPlayer::createSwsContext(AVFrame* targetFrame, AVPixelFormat srcPixFmt, SizeI srcSize, Logger* logger, int threadCount, AVColorSpace srcColorSpace, AVColorRange srcColorRange)
 {
     SharedPtr<SwsContext> swsCtx{ nullptr, [](SwsContext* p) { if (p) sws_freeContext(p); } };
     constexpr int ALIGN_SIZE = 64; // 帧buffer的对齐大小
@@ -627,10 +773,17 @@ VideoPlayer::SharedPtr<SwsContext> VideoPlayer::createSwsContext(AVFrame* target
         if (logger) logger->error("Could not fill image arrays for switched frame: code: {}, message: {}", rst, av_make_error_string(errStrBuf, AV_ERROR_MAX_STRING_SIZE, rst));
         return swsCtx;
     }
-    // 创建图像转换上下文, srcSize,srcFormat,dstSize,dstFormat
-    swsCtx.reset(checkAndGetCorrectSwsContext(srcSize, srcPixFmt, { targetFrame->width, targetFrame->height }, static_cast<AVPixelFormat>(targetFrame->format), SWS_FLAGS),
-        [](SwsContext* p) { if (p) sws_freeContext(p); }
-    );
+    if (threadCount < 0)
+        threadCount = swsThreadCount.load();
+    // 创建图像转换上下文, srcSize,srcFormat,dstSize,dstFormat，优先从共享缓存中取出
+    SizeI dstSize{ targetFrame->width, targetFrame->height };
+    AVPixelFormat dstPixFmt = static_cast<AVPixelFormat>(targetFrame->format);
+    SwsContextCache::Key key{ srcSize, srcPixFmt, dstSize, dstPixFmt, SWS_FLAGS, threadCount, srcColorSpace, srcColorRange };
+    swsCtx = SwsContextCache::instance().acquire(key, [&] {
+        SwsContext* sws = checkAndGetCorrectSwsContext(srcSize, srcPixFmt, dstSize, dstPixFmt, SWS_FLAGS, logger, threadCount);
+        setSwsSourceColorDetails(sws, srcColorSpace, srcColorRange);
+        return sws;
+        });
     return swsCtx;
 }
 
@@ -641,7 +794,11 @@ bool VideoPlayer::swsScaleFrame(SwsContext* swsCtx, AVFrame* srcFrame, AVFrame*
         if (logger) logger->error("SwsContext is null, cannot convert the image from pixel format {} to {}", av_get_pix_fmt_name(static_cast<AVPixelFormat>(srcFrame->format)), av_get_pix_fmt_name(static_cast<AVPixelFormat>(targetFrame->format)));
         return false;
     }
-    int outputSliceHeight = sws_scale(swsCtx, (const uint8_t* const*)srcFrame->data, srcFrame->linesize, 0, srcFrame->height, targetFrame->data, targetFrame->linesize); // 转换像素格式
+    int outputSliceHeight = 0;
+    if (srcFrame->buf[0] && targetFrame->buf[0]) // sws_scale_frame需要引用计数帧，多线程的swsCtx只有通过它才会并行处理各个切片
+        outputSliceHeight = sws_scale_frame(swsCtx, targetFrame, srcFrame); // 成功返回0
+    else
+        outputSliceHeight = sws_scale(swsCtx, (const uint8_t* const*)srcFrame->data, srcFrame->linesize, 0, srcFrame->height, targetFrame->data, targetFrame->linesize); // 转换像素格式
     av_frame_copy_props(targetFrame, srcFrame); // 复制属性信息
     if (outputSliceHeight >= 0)
         return true;
@@ -720,6 +877,7 @@ void VideoPlayer::requestTaskHandlerSeek(MediaRequestHandleEvent* e, std::any us
     }
     // 清空队列
     playbackStateVariables.clearPktAndFrameQueues();
+    renderResetRequested.store(true);
     // 刷新解码器buffer
     avcodec_flush_buffers(playbackStateVariables.codecCtx.get());
     // 先重置一下时钟
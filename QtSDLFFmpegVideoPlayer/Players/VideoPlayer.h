@@ -1,5 +1,6 @@
 #pragma once
 #include "PlayerPredefine.h"
+#include "VideoDeinterlacer.h"
 
 class VideoPlayer : public AbstractPlayer, private ConcurrentQueueOps
 {
@@ -14,6 +15,9 @@ public:
     //static constexpr uint64_t MAX_AUDIO_FRAME_QUEUE_SIZE = 200; // 最大音频帧队列数量
     // 低于下列值开始继续读取新的帧，取出新的值后<下列值开始通知读取线程
     static constexpr uint64_t MIN_VIDEO_PACKET_QUEUE_SIZE = 100; // 最小视频帧队列数量
+    // 用于sws图像格式转换/缩放
+    static constexpr int DEFAULT_SWS_THREAD_COUNT = 0; // libswscale切片线程数，0表示自动（按CPU核心数），1表示单线程
+    static constexpr int64_t MAX_RENDER_SLEEP_SLICE_MS = 20; // 渲染线程等待时钟时单次睡眠的最长时间
 
     static constexpr StreamTypes STREAM_TYPES = StreamType::STVideo;
 
@@ -37,6 +41,7 @@ public:// 这个区域用于定义公共类型
         AVHWDeviceType hwDeviceType{ AV_HWDEVICE_TYPE_NONE }; // 硬件设备类型，仅在isHardwareDecoded为true时有效
         AVPixelFormat hwPixelFormat{ AV_PIX_FMT_NONE }; // 硬件的像素格式，仅在isHardwareDecoded为true时有效
         AVPixelFormat hwFramePixelFormat{ AV_PIX_FMT_NONE }; // 硬件解码帧转到CPU的像素格式，仅在isHardwareDecoded为true时有效，否则为AV_PIX_FMT_NONE
+        bool isDiscontinuity{ false }; // 开始播放、seek或清空缓冲后渲染的第一帧，渲染端应丢弃依赖前后帧的状态
     };
     // FrameContext中的frameSwitchOptions成员表示当前帧的格式转换选项
     using VideoRenderFunction = std::function<void(const DecodedFrameContext& frameContext, UserDataType userData)>;
@@ -60,6 +65,13 @@ public:// 这个区域用于定义公共类型
         Hardware = 2,
     };
 
+    // 省电模式，窗口最小化、隐藏时降低视频解码开销，音频不受影响
+    enum class PowerMode {
+        Normal = 0, // 正常解码与渲染
+        KeyframesOnly = 1, // 只解码关键帧（AVDISCARD_NONKEY），画面低频更新
+        Suspended = 2, // 停止视频解码，外部解复用器中视频流设为AVDISCARD_ALL，内部解复用器时读满包队列后暂停读取
+    };
+
     struct VideoPlayOptions {
         StreamIndexSelector streamIndexSelector{ nullptr };
         VideoClockSyncFunction clockSyncFunction{ nullptr };
@@ -158,6 +170,13 @@ private:
     DefinePlayerLoggerSinks(loggerSinks, loggerName);
     mutable Logger logger{ loggerName, loggerSinks };
 
+    // 去隔行，在渲染线程中处理
+    VideoDeinterlacer deinterlacer{ logger };
+    // seek、清空缓冲等之后由渲染线程重置渲染端的状态（去隔行滤镜图及其输出队列），下一帧标记为isDiscontinuity
+    AtomicBool renderResetRequested{ false };
+    // 省电模式，在解码线程中生效
+    Atomic<PowerMode> powerMode{ PowerMode::Normal };
+
     // 播放器状态
     Mutex mtxSinglePlayback;
     AtomicStateMachine<PlayerState> playerState{ PlayerState::Stopped };
@@ -351,6 +370,41 @@ public:
         this->playbackStateVariables.playOptions.decodeType = (b ? DecodeType::Hardware : DecodeType::Software);
     }
 
+    // 去隔行设置，可在播放中修改，下一帧生效
+    void setDeinterlaceMode(VideoDeinterlacer::Mode mode) {
+        deinterlacer.setMode(mode);
+    }
+    VideoDeinterlacer::Mode getDeinterlaceMode() const {
+        return deinterlacer.getMode();
+    }
+    void setDeinterlaceAlgorithm(VideoDeinterlacer::Algorithm algorithm) {
+        deinterlacer.setAlgorithm(algorithm);
+    }
+    // true: 场率输出（50i->50p），false: 帧率输出（50i->25p）
+    void setDeinterlaceFieldRateOutput(bool b) {
+        deinterlacer.setFieldRateOutput(b);
+    }
+    // 0表示自动，1表示单线程
+    void setDeinterlaceThreadCount(int count) {
+        deinterlacer.setThreadCount(count);
+    }
+    VideoDeinterlacer::Statistics getDeinterlaceStatistics() const {
+        return deinterlacer.statistics();
+    }
+
+    // 省电模式，可在播放中修改，解码线程下一轮生效
+    // 退出Suspended或KeyframesOnly后从下一个关键帧开始正常解码，需要立即追上时钟时由调用者seek（只seek视频）
+    void setPowerMode(PowerMode mode) {
+        PowerMode oldMode = powerMode.exchange(mode);
+        if (oldMode == mode)
+            return;
+        logger.info("Video power mode changed: {} -> {}", static_cast<int>(oldMode), static_cast<int>(mode));
+        playbackStateVariables.threadStateManager.wakeUpById(ThreadIdentifier::Decoder);
+    }
+    PowerMode getPowerMode() const {
+        return powerMode.load();
+    }
+
 
 
 protected:
@@ -367,9 +421,25 @@ protected:
 
     }
 
+    // 修改外部解复用器中视频流的丢弃策略：读取线程读包时会访问discard，交给请求处理线程在解复用器阻塞期间修改
+    // 请求按提交顺序处理，先后切换的模式不会乱序生效
+    void requestStreamDiscard(AVDiscard discard) {
+        auto handler = [this, discard](MediaRequestHandleEvent* e, std::any userData) {
+            if (playbackStateVariables.formatCtx && playbackStateVariables.streamIndex >= 0)
+                playbackStateVariables.formatCtx->streams[playbackStateVariables.streamIndex]->discard = discard;
+            };
+        playbackStateVariables.requestQueueHandler->push(RequestTaskType::StreamDiscard, { ThreadIdentifier::Demuxer }, new MediaRequestHandleEvent{ STREAM_TYPES, RequestTaskType::StreamDiscard }, handler);
+    }
+
     void clearBuffers() {
+        // 省电模式已退出Suspended时先恢复读取视频流（seek处理时解复用器已阻塞），seek后的第一个关键帧不被解复用器丢弃
+        if (powerMode.load() != PowerMode::Suspended && demuxerMode == ComponentWorkMode::External
+            && playbackStateVariables.formatCtx && playbackStateVariables.streamIndex >= 0)
+            playbackStateVariables.formatCtx->streams[playbackStateVariables.streamIndex]->discard = AVDISCARD_DEFAULT;
         // 清空队列
         playbackStateVariables.clearPktAndFrameQueues();
+        // 渲染线程丢弃去隔行滤镜图中缓存的帧与已输出未显示的帧
+        renderResetRequested.store(true);
         // 刷新解码器buffer
         if (playbackStateVariables.codecCtx)
             avcodec_flush_buffers(playbackStateVariables.codecCtx.get());
@@ -506,16 +576,36 @@ private:
         }
     };
     static std::unordered_map<DeprecatedPixelFormat, SupportedPixelFormat, DeprecatedSupportedPixelFormatHashType> mapDeprecatedSupportedPixelFormat;
+
+    static AtomicInt swsThreadCount; // 新建的SwsContext使用的线程数
+    // 通过AVOptions创建并初始化swsCtx，以便设置线程数（sws_getContext无法设置）
+    static SwsContext* allocSwsContext(SizeI srcSize, AVPixelFormat srcFmt, SizeI dstSize, AVPixelFormat dstFmt, SwsFlags flags, int threadCount, Logger* logger = nullptr);
 public:
     static bool isDeprecatedPixelFormat(AVPixelFormat pixFmt);
 
     static AVPixelFormat getSupportedPixelFormat(AVPixelFormat pixFmt, bool& isDeprecated);
 
-    static SwsContext* checkAndGetCorrectSwsContext(SizeI srcSize, AVPixelFormat srcFmt, SizeI dstSize, AVPixelFormat dstFmt, SwsFlags flags, Logger* logger = nullptr);
+    // 设置之后新建的SwsContext的切片线程数，0表示自动，1表示单线程，已创建的SwsContext不受影响
+    static void setSwsThreadCount(int count) {
+        swsThreadCount.store(std::max(count, 0));
+    }
+    static int getSwsThreadCount() {
+        return swsThreadCount.load();
+    }
+
+    // \param threadCount 切片线程数，-1表示使用setSwsThreadCount设置的值
+    static SwsContext* checkAndGetCorrectSwsContext(SizeI srcSize, AVPixelFormat srcFmt, SizeI dstSize, AVPixelFormat dstFmt, SwsFlags flags, Logger* logger = nullptr, int threadCount = -1);
+
+    // 按源帧的色彩空间与范围设置swsCtx的转换系数，未指定的一项保持创建时按像素格式选择的值
+    static void setSwsSourceColorDetails(SwsContext* swsCtx, AVColorSpace srcColorSpace, AVColorRange srcColorRange);
 
     // 通过targetFrame的width,height,format信息创建swsCtx
-    static SharedPtr<SwsContext> createSwsContext(AVFrame* targetFrame, AVPixelFormat srcPixFmt, SizeI srcSize, Logger* logger = nullptr);
+    // 返回的swsCtx取自SwsContextCache，使用期间独占，析构时归还缓存
+    // \param threadCount 切片线程数，-1表示使用setSwsThreadCount设置的值
+    // \param srcColorSpace, srcColorRange 源帧的色彩空间与范围，属于缓存键的一部分
+    static SharedPtr<SwsContext> createSwsContext(AVFrame* targetFrame, AVPixelFormat srcPixFmt, SizeI srcSize, Logger* logger = nullptr, int threadCount = -1, AVColorSpace srcColorSpace = AVCOL_SPC_UNSPECIFIED, AVColorRange srcColorRange = AVCOL_RANGE_UNSPECIFIED);
 
+    // 帧均为引用计数帧时使用sws_scale_frame，swsCtx线程数大于1时会按切片并行转换
     static bool swsScaleFrame(SwsContext* swsCtx, AVFrame* srcFrame, AVFrame* targetFrame, Logger* logger = nullptr);
 
     static SizeI getCorrectScaleSize(const SizeI& scaleSize, const SizeI& frameSize);
@@ -5,6 +5,9 @@
 #include <QRegularExpression>
 #include "AnimatedMenu.h"
 
+const QString PlayListWidget::supportedVideoFormats = "*.mp4 *.avi *.mkv *.mov *.flv *.wmv";
+const QString PlayListWidget::supportedAudioFormats = "*.mp3 *.wav *.flac *.alac *.apc *.aac *.ogg *.wma";
+
 PlayListWidget::PlayListWidget(QWidget* parent)
     : QWidget(parent)
 {
@@ -16,6 +19,11 @@ PlayListWidget::PlayListWidget(QWidget* parent)
         updateUISearchTotalNumberLabel();
         searchItems();
     });
+    connect(m_playListModel, &QAbstractListModel::rowsInserted, this, &PlayListWidget::playListChanged);
+    connect(m_playListModel, &QAbstractListModel::rowsRemoved, this, &PlayListWidget::playListChanged);
+    connect(m_playListModel, &QAbstractListModel::rowsMoved, this, &PlayListWidget::playListChanged);
+    connect(m_playListModel, &QAbstractListModel::modelReset, this, &PlayListWidget::playListChanged);
+    connect(m_playListModel, &QAbstractListModel::layoutChanged, this, &PlayListWidget::playListChanged);
     // test
     //QFileInfo fileInfo("D:\\Softwares\\Jijidown\\Download\\「鏡音鈴」「Gimme×Gimme」 Sour式鏡音Rin×Sour式初音Miku[PV] - 1.gimme bili(Av84791490,P1).mp4");
     //appendFile(fileInfo.absoluteFilePath());
@@ -62,6 +70,12 @@ qsizetype PlayListWidget::getNextPlayingIndex(bool* overflow) const
     return curIdx;
 }
 
+bool PlayListWidget::isAudioFile(const QString& url)
+{
+    const QString suffix = QFileInfo(url).suffix().toLower();
+    return !suffix.isEmpty() && supportedAudioFormats.split(' ').contains("*." + suffix);
+}
+
 qsizetype PlayListWidget::getPreviousPlayingIndex(bool* overflow) const
 {
     auto curIdx = getCurrentPlayingIndex();
@@ -209,8 +223,6 @@ void PlayListWidget::sortItems()
 
 QStringList PlayListWidget::selectFiles()
 {
-    const QString supportedVideoFormats = "*.mp4 *.avi *.mkv *.mov *.flv *.wmv";
-    const QString supportedAudioFormats = "*.mp3 *.wav *.flac *.alac *.apc *.aac *.ogg *.wma";
     // 打开文件对话框
     QFileDialog fileDialog(this, tr("Open Files"), tr(""),
         tr("All Supported Files") + QString(" (%1 %2);;").arg(supportedVideoFormats).arg(supportedAudioFormats)
@@ -43,6 +43,9 @@ public:
 
     qsizetype getPreviousPlayingIndex(bool* overflow = nullptr) const;
 
+    // 按扩展名判断是否为音频文件
+    static bool isAudioFile(const QString& url);
+
     void appendFiles(const QStringList& urls) {
         for (auto& url : urls)
             appendFile(url);
@@ -59,6 +62,7 @@ protected:
 
 signals:
     void play(qsizetype index); // 播放当前选中项
+    void playListChanged(); // 播放列表的项或顺序改变
 
 public slots:
     void appendFiles();
@@ -83,6 +87,9 @@ private slots:
 private:
     Ui_PlayListWidgetClass ui;
 
+    static const QString supportedVideoFormats;
+    static const QString supportedAudioFormats;
+
     QStringList selectFiles();
     QString selectFolder();
     QStringList listFilesInFolder(const QString& folderPath);
@@ -5,6 +5,9 @@
 #include "PlayListWidget.h"
 #include <QThread>
 #include "PlayerOptionsWidget.h"
+#include <SwsContextCache.h>
+#include <QStandardPaths>
+#include <QDir>
 #ifdef USE_SDL_WIDGET
 #include "SDLApp.h"
 #elif defined(USE_QT_MULTIMEDIA_WIDGET)
@@ -73,10 +76,19 @@ QtSDLFFmpegVideoPlayer::QtSDLFFmpegVideoPlayer(QWidget* parent)
     ui.btnVolume->setBackgroundBrush(Qt::transparent);
     // 初始化播放器音频音量
     playerSetVolume(getVolumeFromUI());
+    // 响度归一化：扫描结果缓存在应用数据目录中，播放的文件没有结果时优先扫描
+    QString appDataPath = QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation);
+    if (!appDataPath.isEmpty() && QDir().mkpath(appDataPath))
+        loudnessScanner.setCacheFile(QDir(appDataPath).filePath("LoudnessCache.txt").toStdString());
+    mediaPlayer.setLoudnessScanner(&loudnessScanner);
+    AudioPlayer::LoudnessNormalizationOptions loudnessOptions;
+    loudnessOptions.mode = AudioPlayer::LoudnessNormalizationMode::Track;
+    mediaPlayer.setLoudnessNormalization(loudnessOptions);
 
     // 播放列表
     // 绑定播放器控制按钮槽函数
     ui.playListDockWidgetContents->connect(ui.playListDockWidgetContents, &PlayListWidget::play, this, &QtSDLFFmpegVideoPlayer::playerPlayByPlayListIndex);
+    ui.playListDockWidgetContents->connect(ui.playListDockWidgetContents, &PlayListWidget::playListChanged, this, &QtSDLFFmpegVideoPlayer::playerUpdateNextTrack);
 
     optionsWidget = new PlayerOptionsWidget(this);
     optionsWidget->connect(optionsWidget, &PlayerOptionsWidget::stepBackLong, [&]() { playerStepBack(PLAYER_STEP_LONG_MS); });
@@ -242,6 +254,20 @@ bool QtSDLFFmpegVideoPlayer::eventFilter(QObject* watched, QEvent* event)
 {
     if (watched == this)
     {
+        switch (event->type())
+        {
+        case QEvent::WindowStateChange:
+        case QEvent::Hide:
+        case QEvent::Show:
+        {
+            // 窗口最小化或隐藏时暂停视频解码，只播放音频，恢复时视频seek到音频时钟
+            bool visible = isVisible() && !isMinimized();
+            mediaPlayer.setVideoPowerMode(visible ? TargetMediaPlayer::VideoPowerMode::Normal : TargetMediaPlayer::VideoPowerMode::Suspended);
+            break;
+        }
+        default:
+            break;
+        }
         return false;
     }
     else if (watched == ui.sliderMediaProgress)
@@ -309,13 +335,18 @@ bool QtSDLFFmpegVideoPlayer::eventFilter(QObject* watched, QEvent* event)
             uint8_t* imageData[4] = { image.bits(), nullptr, nullptr, nullptr };
             int imageLinesize[4] = { static_cast<int>(image.bytesPerLine()), 0, 0, 0 };
             // sws转换插值算法
+            constexpr SwsFlags swsFlags = SWS_BILINEAR;
+            AbstractPlayer::SizeI frameSize{ frame->width, frame->height };
+            AVPixelFormat frameFormat = static_cast<AVPixelFormat>(frame->format);
+            SwsContextCache::Key swsKey{ frameSize, frameFormat, AbstractPlayer::SizeI{ scaleSize.width(), scaleSize.height() }, AV_PIX_FMT_RGB24, swsFlags, 1, frame->colorspace, frame->color_range };
+            previewSwsCtx.reset(); // 先归还上一次的swsCtx，相同参数时可直接命中缓存
+            previewSwsCtx = SwsContextCache::instance().acquire(swsKey, [&] {
+                SwsContext* sws = VideoPlayer::checkAndGetCorrectSwsContext(frameSize, frameFormat, swsKey.dstSize, AV_PIX_FMT_RGB24, swsFlags, &logger, 1);
+                VideoPlayer::setSwsSourceColorDetails(sws, frame->colorspace, frame->color_range);
+                return sws;
+                });
             if (!previewSwsCtx)
-            {
-                constexpr SwsFlags swsFlags = SWS_BILINEAR;
-                previewSwsCtx.reset(sws_getContext(frame->width, frame->height, static_cast<AVPixelFormat>(frame->format), scaleSize.width(), scaleSize.height(), AV_PIX_FMT_RGB24, swsFlags, 0, 0, 0));
-                if (!previewSwsCtx)
-                    break;
-            }
+                break;
             // 转换像素格式
             int outputSliceHeight = sws_scale(previewSwsCtx.get(), (const uint8_t* const*)frame->data, frame->linesize, 0, frame->height, imageData, imageLinesize);
             if (outputSliceHeight < 0)
@@ -583,7 +614,7 @@ void QtSDLFFmpegVideoPlayer::playerPlay(QString filePath)
         previewDemuxer->close();
         previewDemuxer->open(filePath.toStdString());
         previewDemuxer->findStreamInfo();
-        previewSwsCtx.reset(nullptr);
+        previewSwsCtx.reset();
         //previewVideoCapture.open(filePath.toStdString());
         lock.unlock();
 #ifdef USE_SDL_WIDGET
@@ -618,6 +649,59 @@ void QtSDLFFmpegVideoPlayer::playerPlayByPlayListIndex(qsizetype index)
     playerPlay(filePath);
 }
 
+void QtSDLFFmpegVideoPlayer::playerUpdateNextTrack()
+{
+    auto playList = ui.playListDockWidgetContents;
+    qsizetype nextIndex = -1;
+    QString nextFilePath;
+    if (mediaPlayer.isAudioOnlyPlayback() && playList->getCurrentPlayingIndex() >= 0)
+    {
+        bool overflow = false;
+        qsizetype index = playList->getNextPlayingIndex(&overflow);
+        if (!overflow && index < playList->getPlayListSize())
+        {
+            QString url = playList->getPlayListItem(index).url;
+            if (PlayListWidget::isAudioFile(url))
+            {
+                nextIndex = index;
+                nextFilePath = url;
+            }
+        }
+    }
+    pendingNextIndex = nextIndex;
+    std::string path = nextFilePath.toStdString();
+    if (path == mediaPlayer.getNextFilePath())
+        return; // 未改变，不重新预加载
+    if (mediaPlayer.setNextFilePath(path) && !path.empty())
+        logger.info("Next track: {}", path);
+}
+
+void QtSDLFFmpegVideoPlayer::playerTrackChanged(QString filePath)
+{
+    auto playList = ui.playListDockWidgetContents;
+    qsizetype index = -1;
+    if (pendingNextIndex >= 0 && pendingNextIndex < playList->getPlayListSize() && playList->getPlayListItem(pendingNextIndex).url == filePath)
+        index = pendingNextIndex;
+    else // 预加载后播放列表被修改，按路径查找
+    {
+        for (qsizetype i = 0; i < playList->getPlayListSize(); ++i)
+        {
+            if (playList->getPlayListItem(i).url == filePath)
+            {
+                index = i;
+                break;
+            }
+        }
+    }
+    pendingNextIndex = -1;
+    if (index >= 0)
+    {
+        playList->setCurrentPlayingIndex(index);
+        ui.labelMediaName->setText(getElidedString(playList->getPlayListItem(index).title, ui.labelMediaName->width(), ui.labelMediaName->font()));
+    }
+    playerUpdateNextTrack();
+}
+
 void QtSDLFFmpegVideoPlayer::playerSetVolume(double volume)
 {
     mediaPlayer.setVolume(volume);
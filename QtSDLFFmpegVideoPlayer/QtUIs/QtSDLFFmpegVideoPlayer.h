@@ -10,6 +10,8 @@
 #include "TaskbarMediaController.h"
 // 系统音量调节
 #include <SystemVolumeController.h>
+// 响度扫描
+#include <LoudnessScanner.h>
 
 // 处理视频预览缩略图
 // #include <opencv2/opencv.hpp>
@@ -83,6 +85,16 @@ class QtSDLFFmpegVideoPlayer : public QMainWindow
                 vInited.store(false); // 重置初始化状态
             stopped.store(false);
             owner.setPlayPauseButtonState(true);
+            if (e->streamType() == StreamType::STAudio)
+                QMetaObject::invokeMethod(&owner, [this] { owner.playerUpdateNextTrack(); }, Qt::QueuedConnection);
+        }
+        // 纯音频播放衔接到下一项，之后的渲染事件属于新曲目，重新计算时长
+        virtual void trackChangeEvent(const std::string& filePath) override {
+            TargetMediaPlayer::trackChangeEvent(filePath);
+            owner.resetMediaPlayerStates();
+            aInited.store(false);
+            QString path = QString::fromStdString(filePath);
+            QMetaObject::invokeMethod(&owner, [this, path] { owner.playerTrackChanged(path); }, Qt::QueuedConnection);
         }
         virtual void seekEvent(MediaSeekEvent* e) override {
             switch (e->handleState())
@@ -197,7 +209,7 @@ private:
     // 预览解码器
     std::mutex mtxPreviewDemuxer;
     AbstractPlayer::SharedPtr<AbstractPlayer::SingleDemuxer> previewDemuxer{ std::make_shared<AbstractPlayer::SingleDemuxer>(loggerName, AbstractPlayer::STVideo) };
-    AbstractPlayer::UniquePtr<SwsContext> previewSwsCtx{ nullptr, [](auto* ctx) { sws_freeContext(ctx); } };
+    AbstractPlayer::SharedPtr<SwsContext> previewSwsCtx{ nullptr }; // 取自SwsContextCache
     AbstractPlayer::UniquePtr<AVCodecContext> previewCodecCtx{ nullptr, AbstractPlayer::constDeleterAVCodecContext };
     std::atomic<uint64_t> previewCurrentTimeMs{ 0 };
     //cv::VideoCapture previewVideoCapture;
@@ -213,6 +225,7 @@ private:
     std::unique_ptr<VideoWidget> videoWidget{ nullptr };
 #endif
     QTimer* sdlEventTimer{ nullptr }; // SDL事件轮询定时器，只执行一次，回调中循环
+    LoudnessScanner loudnessScanner; // 响度归一化使用的后台扫描器，需在播放器之前构造、之后析构
     QtSDLMediaPlayer mediaPlayer{ *this }; // 媒体播放器实例
     std::vector<AbstractPlayer::IFFmpegFrameAudioEqualizerFilter::BandInfo> mediaPlayerAudioEqualizerDefaultGains{ AbstractPlayer::FFmpegFrameAudio10BandEqualizerFilter::defaultBandGains() };
 
@@ -360,6 +373,13 @@ private:
     // 不会检查索引有效性，调用前请确保索引有效
     void playerPlayByPlayListIndex(qsizetype index);
 
+    // 纯音频播放时把播放列表的下一项交给播放器预加载，当前曲目结束时直接衔接；下一项不是音频文件或已到列表末尾时取消
+    // 在UI线程中调用，播放开始、播放列表改变与曲目切换后更新
+    void playerUpdateNextTrack();
+    // 播放器衔接到下一项后在UI线程中调用，更新当前播放项与媒体名称
+    void playerTrackChanged(QString filePath);
+    qsizetype pendingNextIndex{ -1 }; // 交给播放器的下一项在播放列表中的索引
+
     void playerSetVolume(double volume);
 
     void playerSetSpeed(double speed);
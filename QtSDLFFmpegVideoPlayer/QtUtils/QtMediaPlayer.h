@@ -9,7 +9,9 @@ class QtMultiMediaPlayer : public MediaPlayer
 public:
 
 public:
-    QtMultiMediaPlayer() {}
+    QtMultiMediaPlayer() {
+        getAudioDspChain().setEqualizerBands(equalizerBandGains);
+    }
     ~QtMultiMediaPlayer() {
         if (!isStopped())
             this->stop();
@@ -25,6 +27,7 @@ public:
 
     void setEqualizerEnabled(bool enabled) {
         isEqualizerEnabled = enabled;
+        getAudioDspChain().setEqualizerEnabled(enabled);
     }
     bool getEqualizerEnabled() const {
         return isEqualizerEnabled;
@@ -34,6 +37,7 @@ public:
         if (bandIndex >= equalizerBandGains.size())
             return;
         equalizerBandGains[bandIndex] = gain;
+        getAudioDspChain().setEqualizerBands(equalizerBandGains);
     }
 
     double getSpeed() const {
@@ -41,6 +45,7 @@ public:
     }
     void setSpeed(double sp) {
         speed = sp;
+        setAudioSpeed(sp);
     }
 
     double getVolume() const {
@@ -48,12 +53,14 @@ public:
     }
     void setVolume(double vol) {
         volume = vol;
+        setAudioVolume(vol);
     }
     bool getMute() const {
         return isMute.load();
     }
     void setMute(bool state) {
         isMute = state;
+        setAudioMute(state);
     }
 
     void setBrightness(float value) {
@@ -90,7 +97,6 @@ private:
     Atomic<double> volume{ 1.0 };
     Atomic<bool> isMute{ false };
     Atomic<bool> isEqualizerEnabled{ false };
-    bool lastEqualizerEnabledState = isEqualizerEnabled.load();
     std::vector<IFFmpegFrameAudioEqualizerFilter::BandInfo> equalizerBandGains{ FFmpegFrameAudio10BandEqualizerFilter::defaultBandGains() };
     
     Atomic<float> brightness{ 0.0f };
@@ -18,7 +18,10 @@ void SDLMediaPlayer::renderVideoFrame(const VideoDecodedFrameContext& frameCtx,
 {
     VideoRenderUserData* ud = std::any_cast<VideoRenderUserData*>(userData);
     if (!ud->processor)
+    {
         ud->processor = std::make_shared<VideoFrameProcessor>(logger, brightness, contrast, saturation, hue);
+        ud->processor->setSubtitlePlayer(getSubtitlePlayer());
+    }
     if (!ud->processor) return;
     
     SizeI windowSize;
@@ -198,83 +201,8 @@ bool SDLMediaPlayer::play(const std::string& filePath, SDL_WindowID winId, Video
     };
     mediaOptions.videoFrameFilterGraphCreatorUserData = VideoUserDataType{};
 
-    auto audioFilterGraph = UniquePtrD<FFmpegFrameFilterGraph>(nullptr);
-    auto equalizerFilter = SharedPtr<FFmpegFrameAudio10BandEqualizerFilter>(nullptr);
-    auto volumeFilter = SharedPtr<FFmpegFrameVolumeFilter>(nullptr);
-    auto speedFilter = SharedPtr<FFmpegFrameAudioSpeedFilter>(nullptr);
-    auto lastEqualizerEnabledState = false;
-    mediaOptions.audioFrameFilterGraphCreator = [
-        this, &audioFilterGraph, &equalizerFilter, &volumeFilter, &speedFilter, &lastEqualizerEnabledState
-    ](std::vector<IFrameFilterGraph*>& outFilterGraphs, bool& shouldResetSwrContext, const AudioDecodedFrameContext& frameContext, AudioUserDataType userData) -> bool {
-        if (!audioFilterGraph)
-        {
-            auto& streamIndex = frameContext.streamIndex;
-            auto& formatCtx = frameContext.formatCtx;
-            auto& codecCtx = frameContext.codecCtx;
-            audioFilterGraph = std::make_unique<FFmpegFrameFilterGraph>(StreamType::STAudio, formatCtx, codecCtx, streamIndex);
-            equalizerFilter = std::make_shared<FFmpegFrameAudio10BandEqualizerFilter>(StreamType::STAudio, formatCtx, codecCtx, streamIndex);
-            volumeFilter = std::make_shared<FFmpegFrameVolumeFilter>(StreamType::STAudio, formatCtx, codecCtx, streamIndex, volume);
-            speedFilter = std::make_shared<FFmpegFrameAudioSpeedFilter>(StreamType::STAudio, formatCtx, codecCtx, streamIndex, speed);
-            if (lastEqualizerEnabledState)
-                audioFilterGraph->addFilter(equalizerFilter);
-            audioFilterGraph->addFilter(volumeFilter);
-            if (speed != 1.0)
-                audioFilterGraph->addFilter(speedFilter); // 默认1倍速，不需要该滤镜，否则需要添加滤镜
-            audioFilterGraph->configureFilterGraph();
-        }
-        outFilterGraphs.push_back(audioFilterGraph.get());
-
-        double oldSpeed = speedFilter->speed();
-        speedFilter->setSpeed(speed);
-        volumeFilter->setVolume(volume);
-        equalizerFilter->setBandGains(equalizerBandGains);
-        Queue<std::function<void()>> postFilterGraphConfigTasks;
-        if (oldSpeed != speed && oldSpeed == 1.0)
-        {
-            // 从1x倍速改为变速
-            // 重建滤镜图
-            postFilterGraphConfigTasks.push([&] {
-                audioFilterGraph->addFilter(speedFilter);
-                });
-        }
-        else if (oldSpeed != speed && speed == 1.0)
-        {
-            // 1x取消倍速，防止音质受损
-            // 重建滤镜图
-            postFilterGraphConfigTasks.push([&] {
-                audioFilterGraph->removeFilter(speedFilter.get());
-                });
-        }
-        else if (oldSpeed > 2.0 && speed < 2.0)
-        {
-            // 重建滤镜图
-            postFilterGraphConfigTasks.push([&] {}); // 入队一个空的任务，后续判断postFilterGraphConfigTasks是否为空来决定是否重建滤镜图
-        }
-        if (lastEqualizerEnabledState != isEqualizerEnabled)
-        {
-            lastEqualizerEnabledState = isEqualizerEnabled;
-            // 重建滤镜图
-            postFilterGraphConfigTasks.push([&] {
-                if (isEqualizerEnabled)
-                    audioFilterGraph->addFilter(equalizerFilter);
-                else
-                    audioFilterGraph->removeFilter(equalizerFilter.get());
-                });
-        }
-        if (!postFilterGraphConfigTasks.empty())
-        {
-            audioFilterGraph->resetFilterGraph();
-            while (!postFilterGraphConfigTasks.empty())
-            {
-                auto& task = postFilterGraphConfigTasks.front();
-                task();
-                postFilterGraphConfigTasks.pop();
-            }
-            audioFilterGraph->configureFilterGraph();
-        }
-        return true;
-    };
-    mediaOptions.audioFrameFilterGraphCreatorUserData = AudioUserDataType{};
+    // 音量、均衡器和倍速都由AudioPlayer内的原生处理完成，不需要音频滤镜图
+    setAudioSpeed(speed);
 
     bool r = MediaPlayer::play(filePath, mediaOptions);
     return r;
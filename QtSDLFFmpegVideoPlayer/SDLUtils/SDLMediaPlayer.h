@@ -25,7 +25,9 @@ public:
     };
 
 public:
-    SDLMediaPlayer() {}
+    SDLMediaPlayer() {
+        getAudioDspChain().setEqualizerBands(equalizerBandGains);
+    }
     ~SDLMediaPlayer() {
         if (!isStopped())
             this->stop();
@@ -48,6 +50,7 @@ public:
 
     void setEqualizerEnabled(bool enabled) {
         isEqualizerEnabled = enabled;
+        getAudioDspChain().setEqualizerEnabled(enabled);
     }
     bool getEqualizerEnabled() const {
         return isEqualizerEnabled;
@@ -57,6 +60,7 @@ public:
         if (bandIndex >= equalizerBandGains.size())
             return;
         equalizerBandGains[bandIndex] = gain;
+        getAudioDspChain().setEqualizerBands(equalizerBandGains);
     }
 
     double getSpeed() const {
@@ -64,6 +68,7 @@ public:
     }
     void setSpeed(double sp) {
         speed = sp;
+        setAudioSpeed(sp);
     }
 
     double getVolume() const {
@@ -71,12 +76,14 @@ public:
     }
     void setVolume(double vol) {
         volume = vol;
+        setAudioVolume(vol);
     }
     bool getMute() const {
         return isMute.load();
     }
     void setMute(bool state) {
         isMute = state;
+        setAudioMute(state);
     }
 
     void setBrightness(float value) {
@@ -122,7 +129,6 @@ private:
     Atomic<double> volume{ 1.0 };
     Atomic<bool> isMute{ false };
     Atomic<bool> isEqualizerEnabled{ false };
-    bool lastEqualizerEnabledState = isEqualizerEnabled.load();
     std::vector<IFFmpegFrameAudioEqualizerFilter::BandInfo> equalizerBandGains{ FFmpegFrameAudio10BandEqualizerFilter::defaultBandGains() };
 
     Atomic<float> brightness{ 0.0f };
@@ -0,0 +1,265 @@
+#include <QtTest/QtTest>
+#include "AudioRingBuffer.h"
+#include "AudioChannelMixer.h"
+#include "LoudnessMeter.h"
+#include "AudioCrossfader.h"
+#include "AudioSyncAdjustment.h"
+#include "ControlExecutor.h"
+
+// 不依赖音频设备、界面与媒体文件的工具类的单元测试
+class PlayerToolsTest : public QObject {
+    Q_OBJECT
+
+    using PtsMarker = AudioRingBuffer::PtsMarker;
+    // 交叉淡化器的输出：收集数据与带标记的位置
+    struct CollectedOutput {
+        std::vector<float> samples;
+        std::vector<std::pair<uint64_t, PtsMarker>> markers;
+        int channels{ 1 };
+        void operator()(const PtsMarker* marker, const float* data, uint64_t frames) {
+            if (marker)
+                markers.emplace_back(samples.size() / channels, *marker);
+            samples.insert(samples.end(), data, data + frames * channels);
+        }
+    };
+    static PtsMarker makeMarker(double frameTime, double secondsPerFrame) {
+        PtsMarker marker;
+        marker.frameTime = frameTime;
+        marker.secondsPerFrame = secondsPerFrame;
+        return marker;
+    }
+
+private slots:
+    // 容量向上取整到2的幂，回绕后数据顺序不变，满时只写入可写的部分
+    void ringBufferWrapsAround() {
+        AudioRingBuffer ringBuffer;
+        ringBuffer.prepare(5, 2);
+        QCOMPARE(ringBuffer.capacityFrames(), uint64_t{ 8 });
+        std::vector<float> input(32);
+        for (size_t i = 0; i < input.size(); ++i)
+            input[i] = static_cast<float>(i);
+        std::vector<float> output(16);
+        QCOMPARE(ringBuffer.write(input.data(), 6), uint64_t{ 6 });
+        QCOMPARE(ringBuffer.read(output.data(), 4), uint64_t{ 4 });
+        QCOMPARE(ringBuffer.write(input.data() + 12, 10), uint64_t{ 6 }); // 只剩6帧空间
+        QCOMPARE(ringBuffer.writableFrames(), uint64_t{ 0 });
+        QCOMPARE(ringBuffer.read(output.data(), 8), uint64_t{ 8 });
+        for (size_t i = 0; i < output.size(); ++i)
+            QCOMPARE(output[i], static_cast<float>(i + 8));
+        QCOMPARE(ringBuffer.readableFrames(), uint64_t{ 0 });
+    }
+    // 标记在读到其位置后生效，偏移为读取起点相对标记的帧数；reset后丢弃之前的数据与标记
+    void ringBufferMarkersAndReset() {
+        AudioRingBuffer ringBuffer;
+        ringBuffer.prepare(16, 1);
+        std::vector<float> samples(4, 0.5f);
+        std::vector<float> output(4);
+        PtsMarker marker = makeMarker(1.0, 0.1);
+        marker.position = ringBuffer.writePosition();
+        ringBuffer.pushMarker(marker);
+        ringBuffer.write(samples.data(), 4);
+        marker = makeMarker(5.0, 0.1);
+        marker.position = ringBuffer.writePosition();
+        ringBuffer.pushMarker(marker);
+        ringBuffer.write(samples.data(), 4);
+
+        PtsMarker current;
+        uint64_t offset = 0;
+        ringBuffer.read(output.data(), 2);
+        QVERIFY(ringBuffer.currentPtsMarker(current, offset));
+        QCOMPARE(current.frameTime, 1.0);
+        QCOMPARE(offset, uint64_t{ 2 });
+        ringBuffer.read(output.data(), 3);
+        QVERIFY(ringBuffer.currentPtsMarker(current, offset));
+        QCOMPARE(current.frameTime, 5.0);
+        QCOMPARE(offset, uint64_t{ 1 });
+
+        ringBuffer.reset();
+        QCOMPARE(ringBuffer.readableFrames(), uint64_t{ 0 });
+        QCOMPARE(ringBuffer.read(output.data(), 4), uint64_t{ 0 });
+        QVERIFY(!ringBuffer.currentPtsMarker(current, offset));
+        ringBuffer.write(samples.data(), 4);
+        QCOMPARE(ringBuffer.read(output.data(), 4), uint64_t{ 4 });
+    }
+    // 布局相同时只做格式转换与解交错，16位整数按2的幂缩放，转换精确
+    void channelMixerConvertsPlanarS16() {
+        AudioChannelMixer mixer;
+        AVChannelLayout stereo = AV_CHANNEL_LAYOUT_STEREO;
+        QVERIFY(AudioChannelMixer::canProcess(AV_SAMPLE_FMT_S16P));
+        QVERIFY(!AudioChannelMixer::canProcess(AV_SAMPLE_FMT_DBL));
+        QVERIFY(mixer.prepare(stereo, stereo));
+        QVERIFY(mixer.isIdentity());
+        const int16_t left[] = { 16384, -32768, 0 };
+        const int16_t right[] = { -16384, 32767, 1 };
+        const uint8_t* data[] = { reinterpret_cast<const uint8_t*>(left), reinterpret_cast<const uint8_t*>(right) };
+        float out[6]{};
+        mixer.process(data, AV_SAMPLE_FMT_S16P, 3, out);
+        const float expected[] = { 0.5f, -0.5f, -1.0f, 32767.0f / 32768.0f, 0.0f, 1.0f / 32768.0f };
+        for (int i = 0; i < 6; ++i)
+            QVERIFY(out[i] == expected[i]);
+    }
+    // 5.1下混到立体声：中置与环绕按-3dB混入左右，LFE丢弃，矩阵按最大行和归一化
+    void channelMixerDownmixes51() {
+        AudioChannelMixer mixer;
+        AVChannelLayout surround = AV_CHANNEL_LAYOUT_5POINT1;
+        AVChannelLayout stereo = AV_CHANNEL_LAYOUT_STEREO;
+        QVERIFY(mixer.prepare(surround, stereo));
+        QVERIFY(!mixer.isIdentity());
+        QCOMPARE(mixer.numberOfOutputChannels(), 2);
+        const float level = AudioChannelMixer::CENTER_MIX_LEVEL;
+        const float rowSum = 1.0f + level + level; // L + C + SL
+        // 依次只有FL、FC、LFE、SL有信号的4帧
+        std::vector<float> input(4 * 6, 0.0f);
+        const int channelsInOrder[] = {
+            av_channel_layout_index_from_channel(&surround, AV_CHAN_FRONT_LEFT),
+            av_channel_layout_index_from_channel(&surround, AV_CHAN_FRONT_CENTER),
+            av_channel_layout_index_from_channel(&surround, AV_CHAN_LOW_FREQUENCY),
+            av_channel_layout_index_from_channel(&surround, AV_CHAN_SIDE_LEFT),
+        };
+        for (int f = 0; f < 4; ++f)
+            input[f * 6 + channelsInOrder[f]] = 1.0f;
+        const uint8_t* data[] = { reinterpret_cast<const uint8_t*>(input.data()) };
+        float out[8]{};
+        mixer.process(data, AV_SAMPLE_FMT_FLT, 4, out);
+        const float expected[] = { 1.0f / rowSum, 0.0f, level / rowSum, level / rowSum, 0.0f, 0.0f, level / rowSum, 0.0f };
+        for (int i = 0; i < 8; ++i)
+            QVERIFY(std::abs(out[i] - expected[i]) < 1e-6f);
+    }
+    // EBU Tech 3341 用例1：-23 dBFS的1 kHz立体声正弦波测得-23.0 LUFS（允许±0.1 LU）
+    void loudnessMeterSineReference() {
+        constexpr int sampleRate = 48000;
+        LoudnessMeter meter;
+        AVChannelLayout layout = AV_CHANNEL_LAYOUT_STEREO;
+        QVERIFY(meter.prepare(sampleRate, layout));
+        const double amplitude = std::pow(10.0, -23.0 / 20.0);
+        std::vector<float> samples(static_cast<size_t>(sampleRate) * 2 * 10);
+        for (size_t f = 0; f < samples.size() / 2; ++f)
+        {
+            const float value = static_cast<float>(amplitude * std::sin(2.0 * std::numbers::pi * 1000.0 * f / sampleRate));
+            samples[f * 2] = value;
+            samples[f * 2 + 1] = value;
+        }
+        meter.process(samples.data(), samples.size() / 2);
+        const LoudnessMeter::Result result = meter.result();
+        QVERIFY(result.isValid());
+        QVERIFY(std::abs(result.integratedLufs + 23.0) <= 0.1);
+        QVERIFY(result.loudnessRangeLu < 0.1);
+        QVERIFY(std::abs(result.samplePeak - amplitude) < 1e-3);
+        QCOMPARE(result.frames, uint64_t{ samples.size() / 2 });
+    }
+    // 静音低于绝对门限，没有有效的综合响度
+    void loudnessMeterSilenceIsInvalid() {
+        LoudnessMeter meter;
+        AVChannelLayout layout = AV_CHANNEL_LAYOUT_MONO;
+        QVERIFY(meter.prepare(44100, layout));
+        std::vector<float> samples(44100 * 2, 0.0f);
+        meter.process(samples.data(), samples.size());
+        QVERIFY(!meter.result().isValid());
+    }
+    // 不暂存时原样输出；暂存时保留最新的holdFrames帧，淡化按等功率曲线混合，结束后恢复直通
+    void crossfaderHoldsTailAndFades() {
+        AudioCrossfader crossfader;
+        crossfader.prepare(1, 8);
+        CollectedOutput out;
+        std::vector<float> ones(10, 1.0f);
+        PtsMarker marker = makeMarker(2.0, 0.5);
+        crossfader.push(&marker, ones.data(), 10, out);
+        QCOMPARE(out.samples.size(), size_t{ 10 });
+        QCOMPARE(out.markers.size(), size_t{ 1 });
+
+        out = CollectedOutput{};
+        crossfader.setHoldFrames(4, out);
+        crossfader.push(&marker, ones.data(), 10, out);
+        QCOMPARE(out.samples.size(), size_t{ 6 });
+        QCOMPARE(crossfader.heldFrames(), uint64_t{ 4 });
+
+        crossfader.beginFade();
+        QVERIFY(crossfader.isFading());
+        QCOMPARE(crossfader.heldFrames(), uint64_t{ 0 });
+        crossfader.setHoldFrames(0, out);
+        out = CollectedOutput{};
+        std::vector<float> zeros(6, 0.0f);
+        crossfader.push(&marker, zeros.data(), 6, out);
+        QCOMPARE(out.samples.size(), size_t{ 6 });
+        QVERIFY(!crossfader.isFading());
+        // 新曲目为静音，前4帧为淡出的一路：cos曲线单调下降，之后直通
+        for (int i = 0; i < 4; ++i)
+        {
+            const double t = (i + 0.5) / 4.0;
+            QVERIFY(std::abs(out.samples[i] - std::cos(t * std::numbers::pi / 2.0)) < 1e-6);
+        }
+        QVERIFY(out.samples[4] == 0.0f && out.samples[5] == 0.0f);
+        QCOMPARE(out.markers.size(), size_t{ 1 });
+        QCOMPARE(out.markers[0].first, uint64_t{ 0 });
+    }
+    // 负的同步调整从数据头部丢弃帧，标记随之后移，不够丢弃的部分留到下一段数据；正的调整不丢弃数据
+    void syncAdjustmentDropsFrames() {
+        const std::vector<float> samples = { 0.0f, 0.0f, 1.0f, 1.0f, 2.0f, 2.0f, 3.0f, 3.0f };
+        const float* data = samples.data();
+        uint64_t frames = 4;
+        PtsMarker marker = makeMarker(1.0, 0.25);
+        QCOMPARE(AudioSyncAdjustment::dropFrames(int64_t{ -3 }, data, frames, 2, marker), int64_t{ 0 });
+        QCOMPARE(frames, uint64_t{ 1 });
+        QCOMPARE(data[0], 3.0f);
+        QCOMPARE(marker.frameTime, 1.75);
+
+        data = samples.data();
+        frames = 4;
+        marker = makeMarker(1.0, 0.25);
+        QCOMPARE(AudioSyncAdjustment::dropFrames(int64_t{ -6 }, data, frames, 2, marker), int64_t{ -2 });
+        QCOMPARE(frames, uint64_t{ 0 });
+        QCOMPARE(marker.frameTime, 2.0);
+
+        data = samples.data();
+        frames = 4;
+        QCOMPARE(AudioSyncAdjustment::dropFrames(int64_t{ 5 }, data, frames, 2, marker), int64_t{ 0 });
+        QCOMPARE(frames, uint64_t{ 4 });
+        QVERIFY(data == samples.data());
+    }
+    // 空闲线程被复用，线程数不超过一批中的任务数；任务抛出的异常在run中重新抛出
+    void controlExecutorRunsAndReusesThreads() {
+        ControlExecutor executor;
+        std::atomic<int> counter{ 0 };
+        for (int batch = 0; batch < 3; ++batch)
+        {
+            ControlExecutor::Result result = executor.run({ [&] { ++counter; }, [&] { ++counter; } });
+            QVERIFY(result.completed);
+            // 等待线程回到空闲状态，下一批任务才会复用它们
+            for (int i = 0; i < 1000; ++i)
+            {
+                const ControlExecutor::Statistics statistics = executor.getStatistics();
+                if (statistics.idleThreads == statistics.threadsCreated)
+                    break;
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+        QCOMPARE(counter.load(), 6);
+        const ControlExecutor::Statistics statistics = executor.getStatistics();
+        QCOMPARE(statistics.batches, uint64_t{ 3 });
+        QCOMPARE(statistics.tasks, uint64_t{ 6 });
+        QVERIFY(statistics.threadsCreated <= 2);
+        bool thrown = false;
+        try {
+            executor.run({ [] { throw std::runtime_error("task failed"); } });
+        }
+        catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        QVERIFY(thrown);
+    }
+    // 超时返回时任务仍在后台执行，计入超时统计
+    void controlExecutorTimeout() {
+        std::atomic<bool> release{ false };
+        ControlExecutor executor;
+        ControlExecutor::Result result = executor.run({ [&] {
+            while (!release.load())
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            } }, std::chrono::milliseconds(20));
+        QVERIFY(!result.completed);
+        QCOMPARE(executor.getStatistics().timeouts, uint64_t{ 1 });
+        release.store(true); // 析构时等待任务结束
+    }
+};
+
+QTEST_APPLESS_MAIN(PlayerToolsTest)
+#include "PlayerToolsTest.moc"
@@ -0,0 +1,403 @@
+#pragma once
+#include "PlayerPredefine.h"
+#include "AudioRingBuffer.h"
+#include <cmath>
+#include <numbers>
+
+// 频谱与波形分析：音频回调在DSP处理之后把数据写入无锁环形缓冲区（满时丢弃，不等待），
+// 分析线程按固定帧率取出数据，加Hann窗做实数FFT（可配置点数与重叠），输出频谱、对数频带、各通道电平与波形帧
+// 结果通过监听器（分析线程中调用）或getLatestFrame获取，可视化不占用音频线程
+class AudioAnalyzer : public PlayerTypes {
+public:
+    static constexpr int MIN_FFT_SIZE = 256;
+    static constexpr int MAX_FFT_SIZE = 16384;
+    static constexpr double RING_BUFFER_SECONDS = 0.5; // 分析线程停顿超过该时长时丢弃数据
+    static constexpr float SILENCE_DB = -120.0f;
+
+    struct Options {
+        int fftSize{ 2048 }; // 向下取整到2的幂
+        double overlap{ 0.5 }; // 相邻FFT窗口的重叠比例，范围0 ~ 0.95
+        double frameRate{ 30.0 }; // 输出帧率，单位：Hz
+        int bands{ 64 }; // 对数间隔的频带数
+        double minFrequency{ 20.0 };
+        double maxFrequency{ 20000.0 };
+        double falloffDbPerSecond{ 48.0 }; // 频谱下降的速度，上升不限制
+        int waveformPoints{ 256 }; // 每帧波形的点数，每个点为一段数据的最小值与最大值
+    };
+    struct AnalysisFrame {
+        uint64_t sequence{ 0 };
+        int sampleRate{ 0 };
+        int fftSize{ 0 };
+        std::vector<float> spectrumDb; // fftSize / 2 + 1个频点，正弦波满幅为0dB
+        std::vector<float> bandFrequencies; // 频带中心频率，单位：Hz
+        std::vector<float> bandsDb;
+        std::vector<float> rmsDb; // 各通道自上一帧以来的电平
+        std::vector<float> peakDb;
+        std::vector<float> waveformMin; // 单声道混合后的波形
+        std::vector<float> waveformMax;
+    };
+    using FrameListener = std::function<void(const AnalysisFrame&)>;
+
+private:
+    // 回调线程写入，分析线程读取
+    AudioRingBuffer ringBuffer;
+    AtomicBool enabled{ false };
+
+    // 分析线程
+    std::thread worker;
+    AtomicBool stopRequested{ false };
+    Mutex mtxAnalysis; // 保护以下成员，回调线程不使用
+    Options options;
+    bool optionsChanged{ true };
+    int sampleRate{ 0 };
+    int channels{ 0 };
+    int fftSize{ 0 };
+    int hopSize{ 0 };
+    std::vector<float> readBuffer;
+    std::vector<float> history; // 最近fftSize个单声道样本
+    int pendingHopFrames{ 0 }; // 上一次FFT之后新到的帧数
+    std::vector<float> window;
+    float windowGain{ 1.0f };
+    std::vector<int> bitReverse;
+    std::vector<float> twiddleRe, twiddleIm; // 复数FFT（fftSize / 2点）各级共用的旋转因子
+    std::vector<float> splitRe, splitIm; // 实数FFT后处理的旋转因子
+    std::vector<float> fftRe, fftIm;
+    std::vector<std::pair<int, int>> bandBins; // 每个频带的频点范围[first, last]
+    std::vector<double> channelSquares;
+    std::vector<float> channelPeaks;
+    uint64_t levelFrames{ 0 };
+    std::vector<float> waveformSamples;
+    AnalysisFrame working;
+    bool hasNewSpectrum{ false };
+
+    Mutex mtxLatest;
+    AnalysisFrame latest;
+    Mutex mtxListener; // 调用监听器期间持有，不阻塞getLatestFrame；setFrameListener返回后旧的监听器不再被调用
+    FrameListener listener;
+
+public:
+    AudioAnalyzer() = default;
+    AudioAnalyzer(const AudioAnalyzer&) = delete;
+    AudioAnalyzer& operator=(const AudioAnalyzer&) = delete;
+    ~AudioAnalyzer() {
+        setEnabled(false);
+    }
+
+    // 打开输出流时调用，此时回调尚未开始
+    void prepare(int sampleRate, int numberOfChannels) {
+        std::unique_lock lock(mtxAnalysis);
+        this->sampleRate = sampleRate;
+        channels = std::max(numberOfChannels, 0);
+        ringBuffer.prepare(static_cast<uint64_t>(std::max(sampleRate, 0) * RING_BUFFER_SECONDS), channels);
+        optionsChanged = true;
+    }
+
+    // 启用时启动分析线程，禁用时停止线程，回调不再写入
+    void setEnabled(bool state) {
+        if (state)
+        {
+            if (enabled.load())
+                return;
+            // 丢弃上次禁用前留下的数据，并重新开始历史、电平与波形，启用后只分析新的数据
+            ringBuffer.reset();
+            {
+                std::unique_lock lock(mtxAnalysis);
+                optionsChanged = true;
+            }
+            enabled.store(true);
+            stopRequested.store(false);
+            worker = std::thread(&AudioAnalyzer::workerLoop, this);
+        }
+        else
+        {
+            if (!enabled.exchange(false))
+                return;
+            stopRequested.store(true);
+            if (worker.joinable())
+                worker.join();
+        }
+    }
+    bool isEnabled() const { return enabled.load(); }
+
+    void setOptions(const Options& newOptions) {
+        std::unique_lock lock(mtxAnalysis);
+        options = newOptions;
+        optionsChanged = true;
+    }
+    Options getOptions() {
+        std::unique_lock lock(mtxAnalysis);
+        return options;
+    }
+    // 监听器在分析线程中调用，不能在其中调用setEnabled(false)
+    void setFrameListener(FrameListener func) {
+        std::unique_lock lock(mtxListener);
+        listener = std::move(func);
+    }
+    // 返回false表示还没有任何帧
+    bool getLatestFrame(AnalysisFrame& frame) {
+        std::unique_lock lock(mtxLatest);
+        if (latest.sequence == 0)
+            return false;
+        frame = latest;
+        return true;
+    }
+
+    // 在音频回调中调用，写入DSP处理后的交错float数据，无等待
+    void push(const float* samples, unsigned int frames) {
+        if (!enabled.load(std::memory_order_relaxed) || !samples)
+            return;
+        ringBuffer.write(samples, frames);
+    }
+
+private:
+    void workerLoop() {
+        auto next = std::chrono::steady_clock::now();
+        while (!stopRequested.load())
+        {
+            double frameRate = 30.0;
+            {
+                std::unique_lock lock(mtxAnalysis);
+                if (optionsChanged)
+                    configure();
+                frameRate = std::clamp(options.frameRate, 1.0, 240.0);
+                analyze(1.0 / frameRate);
+            }
+            publish();
+            next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / frameRate));
+            const auto now = std::chrono::steady_clock::now();
+            if (next < now)
+                next = now; // 落后时不追赶
+            std::this_thread::sleep_until(next);
+        }
+    }
+
+    // 调用时需持有mtxAnalysis
+    void configure() {
+        optionsChanged = false;
+        fftSize = static_cast<int>(std::bit_floor(static_cast<unsigned int>(std::clamp(options.fftSize, MIN_FFT_SIZE, MAX_FFT_SIZE))));
+        hopSize = std::max(1, static_cast<int>(fftSize * (1.0 - std::clamp(options.overlap, 0.0, 0.95))));
+        const int half = fftSize / 2;
+        history.assign(fftSize, 0.0f);
+        pendingHopFrames = 0;
+        window.resize(fftSize);
+        double sum = 0.0;
+        for (int i = 0; i < fftSize; ++i)
+        {
+            window[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * std::numbers::pi * i / fftSize));
+            sum += window[i];
+        }
+        windowGain = static_cast<float>(2.0 / sum); // 正弦波满幅的幅值归一化为1
+        // 实数FFT通过fftSize / 2点的复数FFT计算
+        bitReverse.resize(half);
+        const int bits = std::countr_zero(static_cast<unsigned int>(half));
+        for (int i = 0; i < half; ++i)
+        {
+            int r = 0;
+            for (int b = 0; b < bits; ++b)
+                r |= ((i >> b) & 1) << (bits - 1 - b);
+            bitReverse[i] = r;
+        }
+        twiddleRe.resize(half / 2);
+        twiddleIm.resize(half / 2);
+        for (int k = 0; k < half / 2; ++k)
+        {
+            twiddleRe[k] = static_cast<float>(std::cos(-2.0 * std::numbers::pi * k / half));
+            twiddleIm[k] = static_cast<float>(std::sin(-2.0 * std::numbers::pi * k / half));
+        }
+        splitRe.resize(half + 1);
+        splitIm.resize(half + 1);
+        for (int k = 0; k <= half; ++k)
+        {
+            splitRe[k] = static_cast<float>(std::cos(-2.0 * std::numbers::pi * k / fftSize));
+            splitIm[k] = static_cast<float>(std::sin(-2.0 * std::numbers::pi * k / fftSize));
+        }
+        fftRe.resize(half);
+        fftIm.resize(half);
+
+        working = AnalysisFrame{};
+        working.sampleRate = sampleRate;
+        working.fftSize = fftSize;
+        working.spectrumDb.assign(half + 1, SILENCE_DB);
+        // 对数频带，窄于一个频点的频带取中心所在的频点
+        const int bands = std::max(options.bands, 1);
+        const double nyquist = sampleRate * 0.5;
+        const double low = std::clamp(options.minFrequency, 1.0, std::max(nyquist - 1.0, 1.0));
+        const double high = std::clamp(options.maxFrequency, low + 1.0, std::max(nyquist, low + 1.0));
+        const double binWidth = sampleRate > 0 ? static_cast<double>(sampleRate) / fftSize : 1.0;
+        bandBins.resize(bands);
+        working.bandFrequencies.resize(bands);
+        working.bandsDb.assign(bands, SILENCE_DB);
+        for (int b = 0; b < bands; ++b)
+        {
+            const double f0 = low * std::pow(high / low, static_cast<double>(b) / bands);
+            const double f1 = low * std::pow(high / low, static_cast<double>(b + 1) / bands);
+            const double center = std::sqrt(f0 * f1);
+            int first = static_cast<int>(std::ceil(f0 / binWidth));
+            int last = static_cast<int>(std::floor(f1 / binWidth));
+            if (last < first)
+                first = last = static_cast<int>(std::lround(center / binWidth));
+            bandBins[b] = { std::clamp(first, 0, half), std::clamp(last, 0, half) };
+            working.bandFrequencies[b] = static_cast<float>(center);
+        }
+        channelSquares.assign(channels, 0.0);
+        channelPeaks.assign(channels, 0.0f);
+        working.rmsDb.assign(channels, SILENCE_DB);
+        working.peakDb.assign(channels, SILENCE_DB);
+        levelFrames = 0;
+        const int points = std::max(options.waveformPoints, 1);
+        working.waveformMin.assign(points, 0.0f);
+        working.waveformMax.assign(points, 0.0f);
+        waveformSamples.clear();
+        readBuffer.assign(static_cast<size_t>(std::max(hopSize, 1024)) * std::max(channels, 1), 0.0f);
+        hasNewSpectrum = false;
+    }
+
+    // 取出环形缓冲区中的所有数据，每凑满一个步长做一次FFT；调用时需持有mtxAnalysis
+    void analyze(double frameSeconds) {
+        if (channels <= 0 || sampleRate <= 0 || !ringBuffer.isPrepared())
+            return;
+        const float falloff = static_cast<float>(options.falloffDbPerSecond * frameSeconds);
+        for (auto& v : working.spectrumDb)
+            v = std::max(v - falloff, SILENCE_DB);
+        for (auto& v : working.bandsDb)
+            v = std::max(v - falloff, SILENCE_DB);
+        const uint64_t capacityFrames = readBuffer.size() / channels;
+        uint64_t n = 0;
+        while ((n = ringBuffer.read(readBuffer.data(), capacityFrames)) > 0)
+        {
+            const float scale = 1.0f / channels;
+            for (uint64_t f = 0; f < n; ++f)
+            {
+                const float* frame = readBuffer.data() + f * channels;
+                float mono = 0.0f;
+                for (int c = 0; c < channels; ++c)
+                {
+                    const float x = frame[c];
+                    channelSquares[c] += static_cast<double>(x) * x;
+                    channelPeaks[c] = std::max(channelPeaks[c], std::abs(x));
+                    mono += x;
+                }
+                mono *= scale;
+                waveformSamples.push_back(mono);
+                history[fftSize - hopSize + pendingHopFrames] = mono;
+                if (++pendingHopFrames == hopSize)
+                {
+                    runFft();
+                    // 保留后fftSize - hopSize个样本，为下一个步长腾出位置
+                    std::copy(history.begin() + hopSize, history.end(), history.begin());
+                    pendingHopFrames = 0;
+                }
+            }
+            levelFrames += n;
+        }
+    }
+
+    void runFft() {
+        const int half = fftSize / 2;
+        // 偶数样本为实部、奇数样本为虚部，按位反转顺序放入
+        float* __restrict re = fftRe.data();
+        float* __restrict im = fftIm.data();
+        for (int i = 0; i < half; ++i)
+        {
+            const int j = bitReverse[i];
+            re[j] = history[2 * i] * window[2 * i];
+            im[j] = history[2 * i + 1] * window[2 * i + 1];
+        }
+        // 迭代基2蝶形运算，内层沿同一级的蝶形进行
+        // 标量实现：前几级每组只有1、2个蝶形，旋转因子按step跨步读取，编译器一般不会向量化这些循环
+        for (int size = 2; size <= half; size <<= 1)
+        {
+            const int halfSize = size / 2;
+            const int step = half / size;
+            for (int start = 0; start < half; start += size)
+            {
+                for (int j = 0; j < halfSize; ++j)
+                {
+                    const float wr = twiddleRe[j * step];
+                    const float wi = twiddleIm[j * step];
+                    const int a = start + j;
+                    const int b = a + halfSize;
+                    const float xr = re[b] * wr - im[b] * wi;
+                    const float xi = re[b] * wi + im[b] * wr;
+                    re[b] = re[a] - xr;
+                    im[b] = im[a] - xi;
+                    re[a] += xr;
+                    im[a] += xi;
+                }
+            }
+        }
+        // 由复数结果Z拆分出实数序列的频谱：X[k] = E[k] + W^k * O[k]
+        // 其中E = (Z[k] + conj(Z[M-k])) / 2，O = -i * (Z[k] - conj(Z[M-k])) / 2
+        for (int k = 0; k <= half; ++k)
+        {
+            const int a = k == half ? 0 : k;
+            const int b = k == 0 ? 0 : half - k;
+            const float er = (re[a] + re[b]) * 0.5f, ei = (im[a] - im[b]) * 0.5f;
+            const float dr = (re[a] - re[b]) * 0.5f, di = (im[a] + im[b]) * 0.5f;
+            const float wr = splitRe[k], wi = splitIm[k];
+            const float xr = er + wr * di + wi * dr;
+            const float xi = ei - wr * dr + wi * di;
+            const float magnitude = std::sqrt(xr * xr + xi * xi) * windowGain;
+            const float db = magnitude > 1e-6f ? 20.0f * std::log10(magnitude) : SILENCE_DB;
+            working.spectrumDb[k] = std::max(working.spectrumDb[k], db);
+        }
+        for (size_t b = 0; b < bandBins.size(); ++b)
+        {
+            float value = SILENCE_DB;
+            for (int k = bandBins[b].first; k <= bandBins[b].second; ++k)
+                value = std::max(value, working.spectrumDb[k]);
+            working.bandsDb[b] = value;
+        }
+        hasNewSpectrum = true;
+    }
+
+    void publish() {
+        AnalysisFrame frame;
+        {
+            std::unique_lock lock(mtxAnalysis);
+            if (!hasNewSpectrum && waveformSamples.empty())
+                return;
+            hasNewSpectrum = false;
+            for (int c = 0; c < channels; ++c)
+            {
+                const double rms = levelFrames ? std::sqrt(channelSquares[c] / levelFrames) : 0.0;
+                working.rmsDb[c] = rms > 1e-6 ? static_cast<float>(20.0 * std::log10(rms)) : SILENCE_DB;
+                working.peakDb[c] = channelPeaks[c] > 1e-6f ? 20.0f * std::log10(channelPeaks[c]) : SILENCE_DB;
+                channelSquares[c] = 0.0;
+                channelPeaks[c] = 0.0f;
+            }
+            levelFrames = 0;
+            // 每个点取对应区间的最小值与最大值，数据不足一点时重复
+            const size_t points = working.waveformMin.size();
+            const size_t count = waveformSamples.size();
+            for (size_t p = 0; p < points; ++p)
+            {
+                const size_t first = count * p / points;
+                const size_t last = std::max(count * (p + 1) / points, first + 1);
+                float lo = 0.0f, hi = 0.0f;
+                if (first < count)
+                {
+                    lo = hi = waveformSamples[first];
+                    for (size_t i = first + 1; i < last && i < count; ++i)
+                    {
+                        lo = std::min(lo, waveformSamples[i]);
+                        hi = std::max(hi, waveformSamples[i]);
+                    }
+                }
+                working.waveformMin[p] = lo;
+                working.waveformMax[p] = hi;
+            }
+            waveformSamples.clear();
+            ++working.sequence;
+            frame = working;
+        }
+        {
+            std::unique_lock lock(mtxLatest);
+            latest = frame;
+        }
+        // 监听器使用分析线程自己的副本，不持有mtxLatest，监听器中也可以调用getLatestFrame
+        std::unique_lock lock(mtxListener);
+        if (listener)
+            listener(frame);
+    }
+};
@@ -0,0 +1,244 @@
+#pragma once
+#include "PlayerPredefine.h"
+#include <array>
+
+// 音频缓冲的自适应控制：音频回调中记录回调间隔与抖动、下溢次数以及PCM环形缓冲区的填充量
+// 发生下溢后立即增大目标缓冲时长，长时间稳定后再缓慢减小，始终限制在可配置的延迟范围内
+// 回调中只读写原子变量，不加锁、不分配内存；解码线程按目标缓冲量决定何时暂停与唤醒
+class AudioBufferController : public PlayerTypes {
+public:
+    static constexpr double DEFAULT_MIN_LATENCY_MS = 40.0;
+    static constexpr double DEFAULT_MAX_LATENCY_MS = 500.0;
+    static constexpr double DEFAULT_TARGET_LATENCY_MS = 100.0; // 约为48kHz下5块1024帧
+    static constexpr double GROW_FACTOR = 1.5; // 下溢后目标时长的增长倍数
+    static constexpr double SHRINK_FACTOR = 0.9; // 稳定后每次减小的倍数
+    static constexpr double STABLE_SECONDS_BEFORE_SHRINK = 10.0; // 连续多长时间没有下溢才减小
+    static constexpr double LOW_WATERMARK_RATIO = 0.6; // 填充量低于目标的该比例时唤醒解码线程
+    static constexpr double INTERVAL_SMOOTHING = 1.0 / 32.0; // 平均间隔与抖动的指数平滑系数
+    static constexpr int HISTOGRAM_BUCKETS = 24;
+    static constexpr double HISTOGRAM_BUCKET_MS = 2.0; // 回调间隔直方图每格的宽度，最后一格包含所有更大的值
+
+    struct Statistics {
+        uint64_t callbacks{ 0 };
+        uint64_t underruns{ 0 }; // 回调时环形缓冲区中的数据不足
+        uint64_t deviceUnderflows{ 0 }; // 后端报告的OutputUnderflow
+        uint64_t targetIncreases{ 0 };
+        uint64_t targetDecreases{ 0 };
+        double targetLatencyMs{ 0.0 };
+        double minLatencyMs{ 0.0 };
+        double maxLatencyMs{ 0.0 };
+        double fillMs{ 0.0 }; // 最近一次回调时的填充量
+        double minFillMs{ 0.0 }; // 自上次重置统计以来的最低填充量（不含预充阶段）
+        double averageIntervalMs{ 0.0 };
+        double expectedIntervalMs{ 0.0 }; // 按回调帧数与采样率计算的名义周期的平滑值
+        double jitterMs{ 0.0 }; // 实际间隔与按帧数计算的期望间隔之差的平滑值
+        double minIntervalMs{ 0.0 };
+        double maxIntervalMs{ 0.0 };
+        unsigned int maxCallbackFrames{ 0 }; // 观察到的最大回调帧数
+        double histogramBucketMs{ HISTOGRAM_BUCKET_MS };
+        std::vector<uint64_t> intervalHistogram;
+    };
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // 由任意线程写入
+    AtomicDouble minLatencyMs{ DEFAULT_MIN_LATENCY_MS };
+    AtomicDouble maxLatencyMs{ DEFAULT_MAX_LATENCY_MS };
+    AtomicDouble targetLatencyMs{ DEFAULT_TARGET_LATENCY_MS };
+    AtomicBool priming{ true }; // 开始播放、seek或下溢后缓冲区重新填充的阶段，不统计下溢
+
+    // 打开输出流时写入
+    Atomic<int> sampleRate{ 0 };
+    Atomic<uint64_t> capacityFrames{ 0 };
+
+    // 回调线程写入，任意线程读取
+    Atomic<unsigned int> maxCallbackFrames{ 0 };
+    Atomic<uint64_t> callbacks{ 0 };
+    Atomic<uint64_t> underruns{ 0 };
+    Atomic<uint64_t> deviceUnderflows{ 0 };
+    Atomic<uint64_t> targetIncreases{ 0 };
+    Atomic<uint64_t> targetDecreases{ 0 };
+    AtomicDouble fillMs{ 0.0 };
+    AtomicDouble minFillMs{ -1.0 };
+    AtomicDouble averageIntervalMs{ 0.0 };
+    AtomicDouble expectedIntervalMs{ 0.0 };
+    AtomicDouble jitterMs{ 0.0 };
+    AtomicDouble minIntervalMs{ -1.0 };
+    AtomicDouble maxIntervalMs{ 0.0 };
+    std::array<Atomic<uint64_t>, HISTOGRAM_BUCKETS> histogram{};
+
+    // 只在回调线程访问
+    Clock::time_point lastCallback{};
+    bool hasLastCallback{ false };
+    Clock::time_point lastAdjustment{};
+
+public:
+    AudioBufferController() = default;
+    AudioBufferController(const AudioBufferController&) = delete;
+    AudioBufferController& operator=(const AudioBufferController&) = delete;
+
+    // 打开输出流时调用，目标缓冲量不会超过环形缓冲区容量的一半
+    void prepare(int sampleRate, uint64_t capacityFrames) {
+        this->sampleRate.store(sampleRate);
+        this->capacityFrames.store(capacityFrames);
+        maxCallbackFrames.store(0);
+        hasLastCallback = false;
+        lastAdjustment = Clock::now();
+        priming.store(true);
+    }
+    // seek或清空缓冲区后调用，重新预充期间的数据不足不视为下溢
+    void restart() {
+        priming.store(true);
+    }
+
+    // 延迟范围，单位：毫秒，目标时长随之截断
+    void setLatencyBounds(double minMs, double maxMs) {
+        minMs = std::max(minMs, 1.0);
+        maxMs = std::max(maxMs, minMs);
+        minLatencyMs.store(minMs);
+        maxLatencyMs.store(maxMs);
+        targetLatencyMs.store(std::clamp(targetLatencyMs.load(), minMs, maxMs));
+    }
+    void setTargetLatency(double ms) { targetLatencyMs.store(std::clamp(ms, minLatencyMs.load(), maxLatencyMs.load())); }
+    double getTargetLatency() const { return targetLatencyMs.load(); }
+    double getMinLatency() const { return minLatencyMs.load(); }
+    double getMaxLatency() const { return maxLatencyMs.load(); }
+    // 按最大延迟需要的环形缓冲区容量，单位：帧
+    uint64_t requiredCapacityFrames(int rate) const { return static_cast<uint64_t>(maxLatencyMs.load() * 0.001 * rate) * 2; }
+
+    // 解码线程缓冲到该帧数后暂停，至少为两次回调的帧数
+    uint64_t targetFrames() const {
+        uint64_t frames = msToFrames(targetLatencyMs.load());
+        frames = std::max<uint64_t>(frames, static_cast<uint64_t>(maxCallbackFrames.load(std::memory_order_relaxed)) * 2);
+        const uint64_t capacity = capacityFrames.load(std::memory_order_relaxed);
+        return capacity ? std::min(frames, capacity / 2) : frames;
+    }
+    // 填充量低于该帧数时唤醒解码线程
+    uint64_t lowWatermarkFrames() const {
+        return std::max<uint64_t>(static_cast<uint64_t>(targetFrames() * LOW_WATERMARK_RATIO), maxCallbackFrames.load(std::memory_order_relaxed));
+    }
+
+    // 在音频回调中、读取数据之前调用
+    // \param framesRequested 本次回调请求的帧数
+    // \param framesAvailable 环形缓冲区中可读的帧数
+    // \param deviceUnderflow 后端是否报告了输出下溢
+    void onCallback(unsigned int framesRequested, uint64_t framesAvailable, bool deviceUnderflow) {
+        const Clock::time_point now = Clock::now();
+        const int rate = sampleRate.load(std::memory_order_relaxed);
+        if (framesRequested > maxCallbackFrames.load(std::memory_order_relaxed))
+            maxCallbackFrames.store(framesRequested);
+        callbacks.fetch_add(1, std::memory_order_relaxed);
+        if (hasLastCallback && rate > 0)
+        {
+            const double interval = std::chrono::duration<double, std::milli>(now - lastCallback).count();
+            const double expected = 1000.0 * framesRequested / rate;
+            const int bucket = std::clamp(static_cast<int>(interval / HISTOGRAM_BUCKET_MS), 0, HISTOGRAM_BUCKETS - 1);
+            histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+            const double average = averageIntervalMs.load(std::memory_order_relaxed);
+            averageIntervalMs.store(average == 0.0 ? interval : average + (interval - average) * INTERVAL_SMOOTHING, std::memory_order_relaxed);
+            const double expectedAverage = expectedIntervalMs.load(std::memory_order_relaxed);
+            expectedIntervalMs.store(expectedAverage == 0.0 ? expected : expectedAverage + (expected - expectedAverage) * INTERVAL_SMOOTHING, std::memory_order_relaxed);
+            const double jitter = jitterMs.load(std::memory_order_relaxed);
+            jitterMs.store(jitter + (std::abs(interval - expected) - jitter) * INTERVAL_SMOOTHING, std::memory_order_relaxed);
+            const double minInterval = minIntervalMs.load(std::memory_order_relaxed);
+            if (minInterval < 0.0 || interval < minInterval)
+                minIntervalMs.store(interval, std::memory_order_relaxed);
+            if (interval > maxIntervalMs.load(std::memory_order_relaxed))
+                maxIntervalMs.store(interval, std::memory_order_relaxed);
+        }
+        lastCallback = now;
+        hasLastCallback = true;
+
+        const double fill = framesToMs(framesAvailable);
+        fillMs.store(fill, std::memory_order_relaxed);
+        if (priming.load(std::memory_order_relaxed))
+        {
+            // 预充完成后才开始统计
+            if (framesAvailable >= lowWatermarkFrames())
+            {
+                priming.store(false);
+                lastAdjustment = now;
+            }
+            return;
+        }
+        const double minFill = minFillMs.load(std::memory_order_relaxed);
+        if (minFill < 0.0 || fill < minFill)
+            minFillMs.store(fill, std::memory_order_relaxed);
+
+        const bool underrun = framesAvailable < framesRequested;
+        if (underrun)
+            underruns.fetch_add(1, std::memory_order_relaxed);
+        if (deviceUnderflow)
+            deviceUnderflows.fetch_add(1, std::memory_order_relaxed);
+        if (underrun || deviceUnderflow)
+        {
+            adjustTarget(GROW_FACTOR, targetIncreases);
+            lastAdjustment = now;
+            priming.store(true); // 重新填充期间连续的数据不足只算一次
+        }
+        else if (std::chrono::duration<double>(now - lastAdjustment).count() >= STABLE_SECONDS_BEFORE_SHRINK)
+        {
+            adjustTarget(SHRINK_FACTOR, targetDecreases);
+            lastAdjustment = now;
+        }
+    }
+
+    Statistics getStatistics() const {
+        Statistics s;
+        s.callbacks = callbacks.load();
+        s.underruns = underruns.load();
+        s.deviceUnderflows = deviceUnderflows.load();
+        s.targetIncreases = targetIncreases.load();
+        s.targetDecreases = targetDecreases.load();
+        s.targetLatencyMs = framesToMs(targetFrames());
+        s.minLatencyMs = minLatencyMs.load();
+        s.maxLatencyMs = maxLatencyMs.load();
+        s.fillMs = fillMs.load();
+        s.minFillMs = std::max(minFillMs.load(), 0.0);
+        s.averageIntervalMs = averageIntervalMs.load();
+        s.expectedIntervalMs = expectedIntervalMs.load();
+        s.jitterMs = jitterMs.load();
+        s.minIntervalMs = std::max(minIntervalMs.load(), 0.0);
+        s.maxIntervalMs = maxIntervalMs.load();
+        s.maxCallbackFrames = maxCallbackFrames.load();
+        s.intervalHistogram.reserve(HISTOGRAM_BUCKETS);
+        for (const auto& count : histogram)
+            s.intervalHistogram.push_back(count.load());
+        return s;
+    }
+    // 清零统计数据，不影响当前目标时长
+    void resetStatistics() {
+        callbacks.store(0);
+        underruns.store(0);
+        deviceUnderflows.store(0);
+        targetIncreases.store(0);
+        targetDecreases.store(0);
+        minFillMs.store(-1.0);
+        averageIntervalMs.store(0.0);
+        expectedIntervalMs.store(0.0);
+        jitterMs.store(0.0);
+        minIntervalMs.store(-1.0);
+        maxIntervalMs.store(0.0);
+        for (auto& count : histogram)
+            count.store(0);
+    }
+
+private:
+    uint64_t msToFrames(double ms) const {
+        return static_cast<uint64_t>(std::max(ms, 0.0) * 0.001 * sampleRate.load(std::memory_order_relaxed));
+    }
+    double framesToMs(uint64_t frames) const {
+        const int rate = sampleRate.load(std::memory_order_relaxed);
+        return rate > 0 ? 1000.0 * frames / rate : 0.0;
+    }
+    void adjustTarget(double factor, Atomic<uint64_t>& counter) {
+        const double current = targetLatencyMs.load(std::memory_order_relaxed);
+        const double next = std::clamp(current * factor, minLatencyMs.load(std::memory_order_relaxed), maxLatencyMs.load(std::memory_order_relaxed));
+        if (next != current)
+        {
+            targetLatencyMs.store(next, std::memory_order_relaxed);
+            counter.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+};
@@ -0,0 +1,221 @@
+#pragma once
+#include "PlayerPredefine.h"
+#include <array>
+#include <numbers>
+#include <type_traits>
+
+// 采样率相同时代替swr完成float/floatp与16/32位整数（交错或平面）到交错float的转换与声道重映射
+// 整数按2的幂缩放（与swr相同），转换是精确的，输出为同位数的整数时可以无损还原
+// 布局相同时只做格式转换与解交错，否则按矩阵混音：同名声道直接映射，5.1/7.1等缺少的声道按ITU-R BS.775系数下混到左右（或中置），LFE丢弃
+// 矩阵按最大行和归一化，保证下混后不会比原信号更容易越界
+class AudioChannelMixer : public PlayerTypes {
+public:
+    static constexpr int MAX_CHANNELS = 16;
+    static constexpr float CENTER_MIX_LEVEL = std::numbers::sqrt2_v<float> * 0.5f; // -3dB
+    static constexpr float SURROUND_MIX_LEVEL = std::numbers::sqrt2_v<float> * 0.5f;
+
+private:
+    AVChannelLayout inputLayout{};
+    AVChannelLayout outputLayout{};
+    int inputChannels{ 0 };
+    int outputChannels{ 0 };
+    bool identity{ false };
+    bool prepared{ false };
+    alignas(32) std::array<std::array<float, MAX_CHANNELS>, MAX_CHANNELS> matrix{}; // [输出][输入]
+
+public:
+    AudioChannelMixer() = default;
+    AudioChannelMixer(const AudioChannelMixer&) = delete;
+    AudioChannelMixer& operator=(const AudioChannelMixer&) = delete;
+    ~AudioChannelMixer() {
+        av_channel_layout_uninit(&inputLayout);
+        av_channel_layout_uninit(&outputLayout);
+    }
+
+    static bool canProcess(AVSampleFormat fmt) {
+        switch (av_get_packed_sample_fmt(fmt))
+        {
+        case AV_SAMPLE_FMT_FLT:
+        case AV_SAMPLE_FMT_S16:
+        case AV_SAMPLE_FMT_S32:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // 布局不变时直接返回，声道数超出MAX_CHANNELS时返回false，此时应使用swr
+    bool prepare(const AVChannelLayout& in, const AVChannelLayout& out) {
+        if (prepared && av_channel_layout_compare(&in, &inputLayout) == 0 && av_channel_layout_compare(&out, &outputLayout) == 0)
+            return true;
+        prepared = false;
+        if (in.nb_channels <= 0 || out.nb_channels <= 0 || in.nb_channels > MAX_CHANNELS || out.nb_channels > MAX_CHANNELS)
+            return false;
+        if (av_channel_layout_copy(&inputLayout, &in) < 0 || av_channel_layout_copy(&outputLayout, &out) < 0)
+            return false;
+        inputChannels = in.nb_channels;
+        outputChannels = out.nb_channels;
+        identity = av_channel_layout_compare(&in, &out) == 0;
+        buildMatrix();
+        prepared = true;
+        return true;
+    }
+    bool isPrepared() const { return prepared; }
+    // 布局相同，交错输入可以直接使用
+    bool isIdentity() const { return prepared && identity; }
+    int numberOfOutputChannels() const { return outputChannels; }
+
+    // 输入为frame->data，format为canProcess接受的格式，out至少需要frames * numberOfOutputChannels()个元素
+    void process(const uint8_t* const* data, AVSampleFormat format, int frames, float* __restrict out) const {
+        if (!prepared || !data || !out || frames <= 0)
+            return;
+        const bool planar = av_sample_fmt_is_planar(format);
+        switch (av_get_packed_sample_fmt(format))
+        {
+        case AV_SAMPLE_FMT_FLT:
+            processSamples<float>(data, planar, frames, out, 1.0f);
+            break;
+        case AV_SAMPLE_FMT_S16:
+            processSamples<int16_t>(data, planar, frames, out, 1.0f / 32768.0f);
+            break;
+        case AV_SAMPLE_FMT_S32:
+            processSamples<int32_t>(data, planar, frames, out, 1.0f / 2147483648.0f);
+            break;
+        default:
+            break;
+        }
+    }
+
+private:
+    template <typename T>
+    void processSamples(const uint8_t* const* data, bool planar, int frames, float* __restrict out, float scale) const {
+        const int ic = inputChannels;
+        const int oc = outputChannels;
+        if (identity)
+        {
+            if (!planar)
+            {
+                const T* __restrict src = reinterpret_cast<const T*>(data[0]);
+                const size_t count = static_cast<size_t>(frames) * oc;
+                if constexpr (std::is_same_v<T, float>)
+                    std::copy_n(src, count, out);
+                else
+                    for (size_t i = 0; i < count; ++i)
+                        out[i] = static_cast<float>(src[i]) * scale;
+                return;
+            }
+            for (int c = 0; c < oc; ++c)
+            {
+                const T* __restrict src = reinterpret_cast<const T*>(data[c]);
+                for (int f = 0; f < frames; ++f)
+                    out[static_cast<size_t>(f) * oc + c] = static_cast<float>(src[f]) * scale;
+            }
+            return;
+        }
+        std::fill_n(out, static_cast<size_t>(frames) * oc, 0.0f);
+        // 按输入声道累加，只计算矩阵中非0的系数；交错数据的读写都带步长，这里是标量循环
+        for (int i = 0; i < ic; ++i)
+        {
+            const T* __restrict src = planar ? reinterpret_cast<const T*>(data[i]) : reinterpret_cast<const T*>(data[0]) + i;
+            const size_t srcStride = planar ? 1 : static_cast<size_t>(ic);
+            for (int o = 0; o < oc; ++o)
+            {
+                const float k = matrix[o][i] * scale;
+                if (k == 0.0f)
+                    continue;
+                float* __restrict dst = out + o;
+                for (int f = 0; f < frames; ++f)
+                    dst[static_cast<size_t>(f) * oc] += k * static_cast<float>(src[f * srcStride]);
+            }
+        }
+    }
+
+    int outputIndex(AVChannel channel) const {
+        return av_channel_layout_index_from_channel(&outputLayout, channel);
+    }
+    void addToMatrix(AVChannel target, int input, float level) {
+        int o = outputIndex(target);
+        if (o >= 0)
+            matrix[o][input] += level;
+    }
+    void buildMatrix() {
+        for (auto& row : matrix)
+            row.fill(0.0f);
+        const bool hasLeftRight = outputIndex(AV_CHAN_FRONT_LEFT) >= 0 && outputIndex(AV_CHAN_FRONT_RIGHT) >= 0;
+        const bool hasCenter = outputIndex(AV_CHAN_FRONT_CENTER) >= 0;
+        // 下混到左右，输出只有中置时合并为单声道
+        auto mixToSides = [&](int input, float leftLevel, float rightLevel) {
+            if (hasLeftRight)
+            {
+                addToMatrix(AV_CHAN_FRONT_LEFT, input, leftLevel);
+                addToMatrix(AV_CHAN_FRONT_RIGHT, input, rightLevel);
+            }
+            else if (hasCenter)
+                addToMatrix(AV_CHAN_FRONT_CENTER, input, (leftLevel + rightLevel) * 0.5f);
+            else
+                matrix[0][input] += (leftLevel + rightLevel) * 0.5f;
+            };
+        for (int i = 0; i < inputChannels; ++i)
+        {
+            AVChannel channel = av_channel_layout_channel_from_index(&inputLayout, i);
+            if (outputIndex(channel) >= 0)
+            {
+                addToMatrix(channel, i, 1.0f);
+                continue;
+            }
+            switch (channel)
+            {
+            case AV_CHAN_FRONT_LEFT:
+            case AV_CHAN_FRONT_LEFT_OF_CENTER:
+            case AV_CHAN_WIDE_LEFT:
+                mixToSides(i, 1.0f, 0.0f);
+                break;
+            case AV_CHAN_FRONT_RIGHT:
+            case AV_CHAN_FRONT_RIGHT_OF_CENTER:
+            case AV_CHAN_WIDE_RIGHT:
+                mixToSides(i, 0.0f, 1.0f);
+                break;
+            case AV_CHAN_FRONT_CENTER:
+                mixToSides(i, CENTER_MIX_LEVEL, CENTER_MIX_LEVEL);
+                break;
+            case AV_CHAN_SIDE_LEFT:
+            case AV_CHAN_BACK_LEFT:
+            case AV_CHAN_SURROUND_DIRECT_LEFT:
+                mixToSides(i, SURROUND_MIX_LEVEL, 0.0f);
+                break;
+            case AV_CHAN_SIDE_RIGHT:
+            case AV_CHAN_BACK_RIGHT:
+            case AV_CHAN_SURROUND_DIRECT_RIGHT:
+                mixToSides(i, 0.0f, SURROUND_MIX_LEVEL);
+                break;
+            case AV_CHAN_BACK_CENTER:
+                mixToSides(i, SURROUND_MIX_LEVEL * CENTER_MIX_LEVEL, SURROUND_MIX_LEVEL * CENTER_MIX_LEVEL);
+                break;
+            case AV_CHAN_LOW_FREQUENCY:
+            case AV_CHAN_LOW_FREQUENCY_2:
+                break;
+            default:
+                mixToSides(i, 0.5f, 0.5f);
+                break;
+            }
+        }
+        // 单声道源输出到左右两个声道
+        if (inputChannels == 1 && hasLeftRight && outputIndex(av_channel_layout_channel_from_index(&inputLayout, 0)) < 0)
+        {
+            matrix[outputIndex(AV_CHAN_FRONT_LEFT)][0] = 1.0f;
+            matrix[outputIndex(AV_CHAN_FRONT_RIGHT)][0] = 1.0f;
+        }
+        float maxRowSum = 0.0f;
+        for (int o = 0; o < outputChannels; ++o)
+        {
+            float sum = 0.0f;
+            for (int i = 0; i < inputChannels; ++i)
+                sum += std::abs(matrix[o][i]);
+            maxRowSum = std::max(maxRowSum, sum);
+        }
+        if (maxRowSum > 1.0f)
+            for (int o = 0; o < outputChannels; ++o)
+                for (int i = 0; i < inputChannels; ++i)
+                    matrix[o][i] /= maxRowSum;
+    }
+};
@@ -0,0 +1,171 @@
+#pragma once
+#include "AudioRingBuffer.h"
+#include <cmath>
+#include <deque>
+#include <numbers>
+
+// 曲目切换时的两路混音，位于解码线程中、环形缓冲区之前
+// 下一项就绪后暂存当前曲目最后holdFrames帧，切换时把暂存的尾部作为淡出的一路，新曲目开头的数据作为淡入的一路，按等功率曲线混合后输出
+// 不暂存时数据原样输出，即无缝衔接
+// 输出函数签名：void(const AudioRingBuffer::PtsMarker* marker, const float* samples, uint64_t frames)，marker非空时需在写入这段数据前记录
+class AudioCrossfader {
+public:
+    using SampleType = AudioRingBuffer::SampleType;
+    using PtsMarker = AudioRingBuffer::PtsMarker;
+
+private:
+    int channels{ 0 };
+    uint64_t capacity{ 0 }; // 单位：帧
+    // 暂存的尾部，环形存放，位置为单调递增的帧序号
+    std::vector<SampleType> tail;
+    uint64_t tailStart{ 0 };
+    uint64_t tailEnd{ 0 };
+    uint64_t holdFrames{ 0 };
+    std::deque<std::pair<uint64_t, PtsMarker>> tailMarkers; // 暂存数据中的时间戳标记
+    // 正在淡出的尾部，线性存放
+    std::vector<SampleType> fadeTail;
+    uint64_t fadeFrames{ 0 };
+    uint64_t fadePosition{ 0 };
+    std::vector<SampleType> mixed;
+
+public:
+    // 设置声道数与最长的淡化时长，缓冲区在第一次需要暂存时按最长时长分配，不能与push并发
+    void prepare(int numberOfChannels, uint64_t maxHoldFrames) {
+        channels = std::max(numberOfChannels, 0);
+        capacity = maxHoldFrames;
+        tail.clear();
+        fadeTail.clear();
+        holdFrames = 0;
+        reset();
+    }
+    // 丢弃暂存的数据与进行中的淡化（seek），暂存长度不变
+    void reset() {
+        tailStart = tailEnd = 0;
+        tailMarkers.clear();
+        fadeFrames = fadePosition = 0;
+    }
+
+    uint64_t heldFrames() const { return tailEnd - tailStart; }
+    uint64_t maxHoldFrames() const { return capacity; }
+    bool isFading() const { return fadePosition < fadeFrames; }
+
+    // 设置暂存长度，缩短时多出的部分按顺序输出
+    template<typename Output>
+    void setHoldFrames(uint64_t frames, Output&& out) {
+        holdFrames = std::min(frames, capacity);
+        if (holdFrames && tail.empty())
+        {
+            tail.assign(static_cast<size_t>(capacity) * channels, SampleType{ 0 });
+            fadeTail.assign(static_cast<size_t>(capacity) * channels, SampleType{ 0 });
+        }
+        if (heldFrames() > holdFrames)
+            release(heldFrames() - holdFrames, out);
+    }
+    // 输出全部暂存的数据（没有下一项时）
+    template<typename Output>
+    void flush(Output&& out) {
+        release(heldFrames(), out);
+    }
+    // 切换曲目时调用：暂存的尾部转为淡出的一路，之后push的数据与之混合，没有暂存数据时即为无缝衔接
+    void beginFade() {
+        const uint64_t frames = heldFrames();
+        for (uint64_t copied = 0; copied < frames;)
+        {
+            const uint64_t index = (tailStart + copied) % capacity;
+            const uint64_t n = std::min(frames - copied, capacity - index);
+            std::copy_n(tail.data() + index * channels, n * channels, fadeTail.data() + copied * channels);
+            copied += n;
+        }
+        fadeFrames = frames;
+        fadePosition = 0;
+        tailStart = tailEnd = 0;
+        tailMarkers.clear(); // 淡化期间音频时钟跟随新曲目
+    }
+
+    // 写入数据：淡化期间先与淡出的尾部混合，其余按暂存长度保留最新的部分，更早的数据输出
+    template<typename Output>
+    void push(const PtsMarker* marker, const SampleType* samples, uint64_t frames, Output&& out) {
+        if (!samples || frames == 0 || channels <= 0)
+            return;
+        if (isFading())
+        {
+            const uint64_t n = std::min(frames, fadeFrames - fadePosition);
+            mixed.resize(static_cast<size_t>(n) * channels); // 容量只增不减
+            constexpr double halfPi = std::numbers::pi / 2.0;
+            for (uint64_t i = 0; i < n; ++i)
+            {
+                const double t = (fadePosition + i + 0.5) / static_cast<double>(fadeFrames);
+                const SampleType gainIn = static_cast<SampleType>(std::sin(t * halfPi));
+                const SampleType gainOut = static_cast<SampleType>(std::cos(t * halfPi));
+                const SampleType* in = samples + i * channels;
+                const SampleType* old = fadeTail.data() + (fadePosition + i) * channels;
+                SampleType* dst = mixed.data() + i * channels;
+                for (int c = 0; c < channels; ++c)
+                    dst[c] = in[c] * gainIn + old[c] * gainOut;
+            }
+            out(marker, mixed.data(), n);
+            marker = nullptr; // 剩余部分紧接其后，沿用同一标记插值
+            samples += n * channels;
+            frames -= n;
+            fadePosition += n;
+            if (fadePosition >= fadeFrames)
+                fadeFrames = fadePosition = 0;
+            if (frames == 0)
+                return;
+        }
+        const uint64_t held = heldFrames();
+        if (holdFrames == 0 && held == 0)
+        {
+            out(marker, samples, frames);
+            return;
+        }
+        // 超出暂存长度的部分：先输出最早的暂存数据，仍不够时直接输出本次数据的开头
+        const uint64_t excess = held + frames > holdFrames ? held + frames - holdFrames : 0;
+        const uint64_t fromTail = std::min(excess, held);
+        release(fromTail, out);
+        const uint64_t direct = excess - fromTail;
+        if (direct)
+        {
+            out(marker, samples, direct);
+            marker = nullptr;
+            samples += direct * channels;
+            frames -= direct;
+        }
+        if (marker && frames)
+            tailMarkers.emplace_back(tailEnd, *marker);
+        for (uint64_t written = 0; written < frames;)
+        {
+            const uint64_t index = tailEnd % capacity;
+            const uint64_t n = std::min(frames - written, capacity - index);
+            std::copy_n(samples + written * channels, n * channels, tail.data() + index * channels);
+            tailEnd += n;
+            written += n;
+        }
+    }
+
+private:
+    // 按顺序输出最早的frames帧暂存数据，在回绕与标记处分段
+    template<typename Output>
+    void release(uint64_t frames, Output& out) {
+        frames = std::min(frames, heldFrames());
+        while (frames > 0)
+        {
+            PtsMarker marker;
+            bool hasMarker = false;
+            while (!tailMarkers.empty() && tailMarkers.front().first <= tailStart)
+            {
+                marker = tailMarkers.front().second;
+                hasMarker = true;
+                tailMarkers.pop_front();
+            }
+            uint64_t n = frames;
+            if (!tailMarkers.empty())
+                n = std::min(n, tailMarkers.front().first - tailStart);
+            const uint64_t index = tailStart % capacity;
+            n = std::min(n, capacity - index);
+            out(hasMarker ? &marker : nullptr, tail.data() + index * channels, n);
+            tailStart += n;
+            frames -= n;
+        }
+    }
+};
@@ -0,0 +1,184 @@
+#pragma once
+#include "AudioDspChain.h"
+#include "AudioTimeStretcher.h"
+#include <random>
+
+// 原生DSP链与libavfilter（volume + firequalizer）处理同样数据的耗时对比，以及变速器在各倍率下的耗时
+class AudioDspBenchmark : public PlayerTypes {
+public:
+    struct BenchmarkCase {
+        int sampleRate{ 48000 };
+        int channels{ 2 };
+        unsigned int framesPerBlock{ 1024 }; // 每次处理的帧数，对应音频回调的缓冲区大小
+    };
+    struct BenchmarkResult {
+        BenchmarkCase benchmarkCase;
+        int iterations{ 0 };
+        double nativeAverageUs{ 0.0 }; // 每块平均耗时，单位：微秒
+        double filterAverageUs{ 0.0 };
+        double nativeRealtimeFactor{ 0.0 }; // 块时长/处理耗时
+        double filterRealtimeFactor{ 0.0 };
+    };
+    struct TimeStretchResult {
+        double ratio{ 1.0 };
+        double inputSeconds{ 0.0 }; // 处理的输入时长，单位：秒
+        double outputSeconds{ 0.0 };
+        double processingMs{ 0.0 }; // 总耗时，单位：毫秒
+        double cpuPercent{ 0.0 }; // 处理耗时占输出播放时长的百分比，即实时播放时的单核占用
+    };
+
+    static std::vector<BenchmarkCase> defaultCases() {
+        return {
+            { 44100, 2, 512 },
+            { 48000, 2, 1024 },
+            { 48000, 6, 1024 },
+            { 96000, 2, 2048 },
+        };
+    }
+    // 用于测试的均衡器增益，单位：dB
+    static std::vector<AudioDspChain::BandInfo> defaultBands() {
+        auto bands = FFmpegFrameAudio10BandEqualizerFilter::defaultBandGains();
+        const double gains[] = { 6.0, 4.0, 2.0, 0.0, -2.0, -3.0, 1.0, 3.0, 4.0, 5.0 };
+        for (size_t i = 0; i < bands.size() && i < std::size(gains); ++i)
+            bands[i].gain = gains[i];
+        return bands;
+    }
+
+    static std::vector<BenchmarkResult> run(const std::vector<BenchmarkCase>& cases, double gain = 0.8, int iterations = 500, Logger* logger = nullptr) {
+        std::vector<BenchmarkResult> results;
+        if (iterations <= 0)
+            return results;
+        auto bands = defaultBands();
+        for (const auto& benchmarkCase : cases)
+        {
+            const size_t count = static_cast<size_t>(benchmarkCase.framesPerBlock) * benchmarkCase.channels;
+            std::vector<float> source(count);
+            std::mt19937 rng{ 1234 };
+            std::uniform_real_distribution<float> dist(-0.5f, 0.5f);
+            for (auto& sample : source)
+                sample = dist(rng);
+            const double blockUs = 1e6 * benchmarkCase.framesPerBlock / benchmarkCase.sampleRate;
+
+            BenchmarkResult result{ benchmarkCase, iterations };
+            // 原生DSP链
+            AudioDspChain dsp;
+            dsp.setGain(gain);
+            dsp.setEqualizerBands(bands);
+            dsp.setEqualizerEnabled(true);
+            dsp.prepare(benchmarkCase.sampleRate, benchmarkCase.channels);
+            std::vector<float> buffer(count);
+            double totalUs = 0.0;
+            for (int i = 0; i <= iterations; ++i)
+            {
+                std::copy(source.begin(), source.end(), buffer.begin());
+                auto begin = std::chrono::steady_clock::now();
+                dsp.process(buffer.data(), benchmarkCase.framesPerBlock, benchmarkCase.channels);
+                if (i > 0) // 第一次用于预热
+                    totalUs += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count();
+            }
+            result.nativeAverageUs = totalUs / iterations;
+            // libavfilter
+            result.filterAverageUs = runFilterGraph(benchmarkCase, source, gain, bands, iterations, logger);
+            result.nativeRealtimeFactor = result.nativeAverageUs > 0.0 ? blockUs / result.nativeAverageUs : 0.0;
+            result.filterRealtimeFactor = result.filterAverageUs > 0.0 ? blockUs / result.filterAverageUs : 0.0;
+            if (logger) logger->info("Benchmark: {} Hz, {} ch, {} frames, native: {} us ({}x realtime), libavfilter: {} us ({}x realtime)",
+                benchmarkCase.sampleRate, benchmarkCase.channels, benchmarkCase.framesPerBlock,
+                result.nativeAverageUs, result.nativeRealtimeFactor, result.filterAverageUs, result.filterRealtimeFactor);
+            results.push_back(result);
+        }
+        return results;
+    }
+
+    static std::vector<double> defaultStretchRatios() {
+        return { 0.25, 0.5, 0.75, 1.0, 1.25, 1.5, 2.0, 3.0, 4.0 };
+    }
+    // 以混合正弦信号测试变速器，按音频解码线程的方式分块送入
+    static std::vector<TimeStretchResult> runTimeStretch(const std::vector<double>& ratios, int sampleRate = 48000, int channels = 2, double inputSeconds = 10.0, int framesPerBlock = 1024, Logger* logger = nullptr) {
+        std::vector<TimeStretchResult> results;
+        if (sampleRate <= 0 || channels <= 0 || framesPerBlock <= 0 || inputSeconds <= 0.0)
+            return results;
+        const int64_t totalFrames = static_cast<int64_t>(inputSeconds * sampleRate);
+        std::vector<float> source(static_cast<size_t>(totalFrames) * channels);
+        for (int64_t f = 0; f < totalFrames; ++f)
+        {
+            const double t = static_cast<double>(f) / sampleRate;
+            const double value = 0.2 * std::sin(2.0 * std::numbers::pi * 220.0 * t) + 0.1 * std::sin(2.0 * std::numbers::pi * 1375.0 * t);
+            for (int c = 0; c < channels; ++c)
+                source[static_cast<size_t>(f) * channels + c] = static_cast<float>(value);
+        }
+        for (double ratio : ratios)
+        {
+            AudioTimeStretcher stretcher;
+            stretcher.prepare(sampleRate, channels);
+            stretcher.setRatio(ratio);
+            std::vector<float> output;
+            output.reserve(static_cast<size_t>(framesPerBlock / AudioTimeStretcher::MIN_RATIO + stretcher.latencyFrames()) * channels);
+            int64_t outputFrames = 0;
+            auto begin = std::chrono::steady_clock::now();
+            for (int64_t f = 0; f < totalFrames; f += framesPerBlock)
+            {
+                const int frames = static_cast<int>(std::min<int64_t>(framesPerBlock, totalFrames - f));
+                stretcher.process(source.data() + static_cast<size_t>(f) * channels, frames, output);
+                outputFrames += static_cast<int64_t>(output.size()) / channels;
+            }
+            TimeStretchResult result;
+            result.ratio = stretcher.getRatio();
+            result.inputSeconds = static_cast<double>(totalFrames) / sampleRate;
+            result.outputSeconds = static_cast<double>(outputFrames) / sampleRate;
+            result.processingMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+            result.cpuPercent = result.outputSeconds > 0.0 ? result.processingMs / (result.outputSeconds * 10.0) : 0.0;
+            if (logger) logger->info("Benchmark: time stretch {}x, {} Hz, {} ch, input: {} s, output: {} s, processing: {} ms ({}% cpu)",
+                result.ratio, sampleRate, channels, result.inputSeconds, result.outputSeconds, result.processingMs, result.cpuPercent);
+            results.push_back(result);
+        }
+        return results;
+    }
+
+private:
+    // \return 每块平均耗时，单位：微秒，失败时返回0
+    static double runFilterGraph(const BenchmarkCase& benchmarkCase, const std::vector<float>& source, double gain, const std::vector<AudioDspChain::BandInfo>& bands, int iterations, Logger* logger) {
+        UniquePtr<AVFilterGraph> graph{ avfilter_graph_alloc(), constDeleterAVFilterGraph };
+        if (!graph)
+            return 0.0;
+        AVChannelLayout layout;
+        av_channel_layout_default(&layout, benchmarkCase.channels);
+        std::string srcArgs = LoggerFormatNS::format("sample_rate={}:sample_fmt=flt:channel_layout=0x{:X}", benchmarkCase.sampleRate, layout.u.mask);
+        FFmpegFrameVolumeFilter volumeFilter{ StreamType::STAudio, nullptr, nullptr, -1, gain };
+        FFmpegFrameAudio10BandEqualizerFilter equalizerFilter{ StreamType::STAudio, nullptr, nullptr, -1 };
+        equalizerFilter.setBandGains(bands);
+        AVFilterContext* srcCtx = IFFmpegFrameFilter::createFilterContext(graph.get(), "abuffer", "in", srcArgs, logger);
+        AVFilterContext* volumeCtx = IFFmpegFrameFilter::createFilterContext(graph.get(), IFrameFilter::AudioVolumeFilter, "volume", volumeFilter.getFilterArguments(), logger);
+        AVFilterContext* equalizerCtx = IFFmpegFrameFilter::createFilterContext(graph.get(), IFrameFilter::Audio10BandEqualizerFilter, "equalizer", equalizerFilter.getFilterArguments(), logger);
+        AVFilterContext* sinkCtx = IFFmpegFrameFilter::createFilterContext(graph.get(), "abuffersink", "out", "", logger);
+        if (!srcCtx || !volumeCtx || !equalizerCtx || !sinkCtx
+            || avfilter_link(srcCtx, 0, equalizerCtx, 0) < 0 || avfilter_link(equalizerCtx, 0, volumeCtx, 0) < 0 || avfilter_link(volumeCtx, 0, sinkCtx, 0) < 0
+            || avfilter_graph_config(graph.get(), nullptr) < 0)
+        {
+            if (logger) logger->error("Benchmark: could not configure libavfilter graph");
+            return 0.0;
+        }
+        double totalUs = 0.0;
+        int64_t pts = 0;
+        for (int i = 0; i <= iterations; ++i)
+        {
+            SharedPtr<AVFrame> frame{ makeSharedFrame() };
+            frame->format = AV_SAMPLE_FMT_FLT;
+            frame->sample_rate = benchmarkCase.sampleRate;
+            frame->nb_samples = static_cast<int>(benchmarkCase.framesPerBlock);
+            av_channel_layout_copy(&frame->ch_layout, &layout);
+            if (av_frame_get_buffer(frame.get(), 0) < 0)
+                return 0.0;
+            std::copy(source.begin(), source.end(), reinterpret_cast<float*>(frame->data[0]));
+            frame->pts = pts;
+            pts += frame->nb_samples;
+            auto begin = std::chrono::steady_clock::now();
+            IFFmpegFrameFilter::addFrameWithFlags(srcCtx, frame.get());
+            bool needMore = false;
+            while (IFFmpegFrameFilter::getOutputFrame(sinkCtx, needMore))
+                ;
+            if (i > 0)
+                totalUs += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - begin).count();
+        }
+        return totalUs / iterations;
+    }
+};
@@ -0,0 +1,327 @@
+#pragma once
+#include "PlayerPredefine.h"
+#include <array>
+#include <cmath>
+#include <numbers>
+
+// 音频输出前的原生DSP链：级联双二阶峰值均衡器 + 平滑增益（音量 × 响度归一化增益）+ 可选的峰值限幅器
+// 原地处理交错float缓冲区，不截断，由输出转换统一处理越界
+// 参数可在任意线程设置，只写原子变量并递增版本号，音频回调检测到版本变化时重新计算系数，音频回调不加锁
+// 滤镜状态按[频段][通道]连续存放，每帧内沿通道依次计算；递推沿时间方向有依赖，不能跨帧向量化，通道数少时基本是标量运算
+// 超过MAX_CHANNELS的通道布局跳过均衡器，音量、静音、响度增益与限幅器照常处理
+class AudioDspChain : public PlayerTypes {
+public:
+    using BandInfo = IFFmpegFrameAudioEqualizerFilter::BandInfo;
+
+    static constexpr int MAX_CHANNELS = 8; // 均衡器支持的最大通道数
+    static constexpr int MAX_BANDS = 18;
+    static constexpr double DEFAULT_GAIN_SMOOTHING_MS = 20.0; // 增益平滑的时间常数，单位：毫秒
+    static constexpr double DEFAULT_BAND_Q = 1.41; // 约一个倍频程的带宽
+    static constexpr double FLAT_GAIN_THRESHOLD_DB = 0.01; // 增益绝对值小于该值的频段视为平直，跳过计算
+    static constexpr float DENORMAL_THRESHOLD = 1e-15f; // 静音时滤镜状态衰减到该值以下直接清零，避免非规格化数拖慢运算
+    static constexpr double DEFAULT_LIMITER_THRESHOLD = 0.966; // 约-0.3 dBFS
+    static constexpr double LIMITER_RELEASE_MS = 80.0; // 限幅器增益恢复的时间常数，单位：毫秒
+
+private:
+    struct Coefficients {
+        float b0{ 1.0f };
+        float b1{ 0.0f };
+        float b2{ 0.0f };
+        float a1{ 0.0f };
+        float a2{ 0.0f };
+    };
+
+    // 由任意线程写入
+    AtomicDouble targetGain{ 1.0 };
+    AtomicDouble normalizationGain{ 1.0 };
+    AtomicDouble normalizationTransitionSeconds{ 0.0 };
+    Atomic<uint64_t> normalizationVersion{ 0 };
+    AtomicBool limiterEnabled{ false };
+    AtomicDouble limiterThreshold{ DEFAULT_LIMITER_THRESHOLD };
+    AtomicBool equalizerEnabled{ false };
+    std::array<AtomicDouble, MAX_BANDS> bandFrequencies{};
+    std::array<AtomicDouble, MAX_BANDS> bandGainsDb{};
+    AtomicInt bandCount{ 0 };
+    // 频段写入序号，写入过程中为奇数，音频回调读到奇数或前后不一致时保留旧系数，下次回调再读
+    Atomic<uint64_t> bandSequence{ 0 };
+    Mutex mtxBandWriters; // 只在设置线程之间互斥，音频回调不使用
+    Atomic<uint64_t> paramVersion{ 1 };
+    AtomicBool fadeInRequested{ false };
+
+    // 只在音频回调线程访问
+    uint64_t appliedVersion{ 0 };
+    int sampleRate{ 0 };
+    int channels{ 0 };
+    float currentGain{ 1.0f };
+    float gainSmoothingCoef{ 1.0f };
+    // 响度归一化增益的线性过渡，按回调块推进，块内由增益平滑插值
+    uint64_t appliedNormalizationVersion{ 0 };
+    double currentNormalization{ 1.0 };
+    double normalizationStep{ 0.0 };
+    uint64_t normalizationRemainingFrames{ 0 };
+    float limiterGain{ 1.0f };
+    float limiterReleaseCoef{ 1.0f };
+    std::array<Coefficients, MAX_BANDS> coefficients{};
+    std::array<int, MAX_BANDS> activeBands{}; // 非平直频段的索引
+    int activeBandCount{ 0 };
+    std::array<bool, MAX_BANDS> bandActive{};
+    alignas(32) std::array<std::array<float, MAX_CHANNELS>, MAX_BANDS> state1{};
+    alignas(32) std::array<std::array<float, MAX_CHANNELS>, MAX_BANDS> state2{};
+
+public:
+    AudioDspChain() = default;
+    AudioDspChain(const AudioDspChain&) = delete;
+    AudioDspChain& operator=(const AudioDspChain&) = delete;
+
+    // 打开输出流时调用，不能与process并发
+    void prepare(int sampleRate, int numberOfChannels) {
+        this->sampleRate = sampleRate;
+        channels = std::max(numberOfChannels, 0);
+        gainSmoothingCoef = sampleRate > 0 ? static_cast<float>(1.0 - std::exp(-1.0 / (DEFAULT_GAIN_SMOOTHING_MS * 0.001 * sampleRate))) : 1.0f;
+        limiterReleaseCoef = sampleRate > 0 ? static_cast<float>(1.0 - std::exp(-1.0 / (LIMITER_RELEASE_MS * 0.001 * sampleRate))) : 1.0f;
+        appliedNormalizationVersion = normalizationVersion.load();
+        currentNormalization = normalizationGain.load();
+        normalizationRemainingFrames = 0;
+        currentGain = static_cast<float>(targetGain.load() * currentNormalization);
+        limiterGain = 1.0f;
+        resetState();
+        appliedVersion = 0; // 强制重新计算系数
+    }
+
+    // 线性增益，变化时按时间常数平滑过渡，不会产生爆音
+    void setGain(double gain) { targetGain.store(std::max(gain, 0.0)); }
+    double gain() const { return targetGain.load(); }
+    // 下一次处理时增益从0开始按平滑时间常数上升，用于重新打开输出流后淡入
+    void requestFadeIn() { fadeInRequested.store(true); }
+    // 响度归一化的线性增益，与音量相乘，同样平滑过渡
+    // \param transitionSeconds 大于0时从当前值线性过渡到新值，用于交叉淡化期间两首曲目的增益交接
+    void setNormalizationGain(double gain, double transitionSeconds = 0.0) {
+        normalizationTransitionSeconds.store(std::max(transitionSeconds, 0.0));
+        normalizationGain.store(std::max(gain, 0.0));
+        ++normalizationVersion;
+    }
+    double getNormalizationGain() const { return normalizationGain.load(); }
+    // 峰值限幅器：瞬时起控、指数恢复，保证输出不超过阈值，用于增益提升后的防削波
+    void setLimiterEnabled(bool enabled) { limiterEnabled.store(enabled); }
+    bool isLimiterEnabled() const { return limiterEnabled.load(); }
+    void setLimiterThreshold(double threshold) { limiterThreshold.store(std::clamp(threshold, 0.01, 1.0)); }
+    double getLimiterThreshold() const { return limiterThreshold.load(); }
+
+    void setEqualizerEnabled(bool enabled) {
+        if (equalizerEnabled.exchange(enabled) != enabled)
+            ++paramVersion;
+    }
+    bool isEqualizerEnabled() const { return equalizerEnabled.load(); }
+    // 设置均衡器频段，增益单位：dB，超出MAX_BANDS的频段忽略
+    void setEqualizerBands(const std::vector<BandInfo>& bands) {
+        std::lock_guard lock(mtxBandWriters);
+        int count = static_cast<int>(std::min<size_t>(bands.size(), MAX_BANDS));
+        bool changed = count != bandCount.load();
+        for (int i = 0; i < count && !changed; ++i)
+            changed = bandFrequencies[i].load() != bands[i].frequency || bandGainsDb[i].load() != bands[i].gain;
+        if (!changed)
+            return;
+        ++bandSequence;
+        for (int i = 0; i < count; ++i)
+        {
+            bandFrequencies[i].store(bands[i].frequency);
+            bandGainsDb[i].store(bands[i].gain);
+        }
+        bandCount.store(count);
+        ++bandSequence;
+        ++paramVersion;
+    }
+    // 18段均衡器（superequalizer）的增益单位为倍，转换为dB
+    static std::vector<BandInfo> multiplierBandsToDb(std::vector<BandInfo> bands) {
+        for (auto& band : bands)
+            band.gain = 20.0 * std::log10(std::max(band.gain, 1e-5));
+        return bands;
+    }
+
+    // 原地处理交错float缓冲区，在音频回调线程调用
+    void process(float* samples, unsigned int frames, int numberOfChannels) {
+        if (!samples || frames == 0 || numberOfChannels <= 0)
+            return;
+        if (numberOfChannels != channels)
+        {
+            channels = numberOfChannels;
+            resetState();
+            appliedVersion = 0; // 通道数决定均衡器是否可用
+        }
+        uint64_t version = paramVersion.load();
+        if (version != appliedVersion && updateCoefficients())
+            appliedVersion = version;
+        if (fadeInRequested.exchange(false, std::memory_order_relaxed))
+            currentGain = 0.0f;
+        const float target = static_cast<float>(targetGain.load(std::memory_order_relaxed) * advanceNormalization(frames));
+        const bool gainSteady = std::abs(currentGain - target) < 1e-4f;
+        if (gainSteady)
+            currentGain = target;
+        const size_t count = static_cast<size_t>(frames) * channels;
+        const bool limiter = limiterEnabled.load(std::memory_order_relaxed);
+        if (!limiter)
+            limiterGain = 1.0f;
+        if (activeBandCount == 0 && gainSteady && !limiter)
+        {
+            if (target == 1.0f)
+                return; // 直通
+            if (target == 0.0f)
+            {
+                std::fill_n(samples, count, 0.0f);
+                return;
+            }
+        }
+        float* __restrict buffer = samples;
+        // 系数更新被推迟时activeBandCount可能仍是切换通道数之前的值
+        if (channels <= MAX_CHANNELS)
+            for (int i = 0; i < activeBandCount; ++i)
+                runBiquad(buffer, frames, activeBands[i]);
+        if (gainSteady)
+        {
+            for (size_t i = 0; i < count; ++i)
+                buffer[i] *= target;
+        }
+        else
+        {
+            float g = currentGain;
+            const float coef = gainSmoothingCoef;
+            for (unsigned int f = 0; f < frames; ++f)
+            {
+                g += (target - g) * coef;
+                float* __restrict frame = buffer + static_cast<size_t>(f) * channels;
+                for (int c = 0; c < channels; ++c)
+                    frame[c] *= g;
+            }
+            currentGain = g;
+        }
+        if (limiter)
+            runLimiter(buffer, frames);
+    }
+
+private:
+    // 返回本块使用的响度归一化增益
+    double advanceNormalization(unsigned int frames) {
+        const uint64_t version = normalizationVersion.load();
+        if (version != appliedNormalizationVersion)
+        {
+            appliedNormalizationVersion = version;
+            const double target = normalizationGain.load();
+            normalizationRemainingFrames = sampleRate > 0 ? static_cast<uint64_t>(normalizationTransitionSeconds.load() * sampleRate) : 0;
+            if (normalizationRemainingFrames == 0)
+                currentNormalization = target;
+            else
+                normalizationStep = (target - currentNormalization) / static_cast<double>(normalizationRemainingFrames);
+        }
+        if (normalizationRemainingFrames > 0)
+        {
+            const uint64_t step = std::min<uint64_t>(frames, normalizationRemainingFrames);
+            normalizationRemainingFrames -= step;
+            currentNormalization = normalizationRemainingFrames > 0 ? currentNormalization + normalizationStep * static_cast<double>(step) : normalizationGain.load();
+        }
+        return currentNormalization;
+    }
+
+    void resetState() {
+        for (auto& s : state1)
+            s.fill(0.0f);
+        for (auto& s : state2)
+            s.fill(0.0f);
+    }
+
+    // RBJ Audio EQ Cookbook峰值滤波器
+    // 频段正在被写入时返回false，保留旧系数
+    bool updateCoefficients() {
+        std::array<double, MAX_BANDS> frequencies{};
+        std::array<double, MAX_BANDS> gainsDb{};
+        const uint64_t sequence = bandSequence.load();
+        if (sequence & 1)
+            return false;
+        const int count = bandCount.load();
+        for (int b = 0; b < count; ++b)
+        {
+            frequencies[b] = bandFrequencies[b].load();
+            gainsDb[b] = bandGainsDb[b].load();
+        }
+        if (bandSequence.load() != sequence)
+            return false;
+        activeBandCount = 0;
+        const bool enabled = equalizerEnabled.load() && channels <= MAX_CHANNELS;
+        for (int b = 0; b < MAX_BANDS; ++b)
+        {
+            const double frequency = frequencies[b];
+            const double gainDb = gainsDb[b];
+            const bool active = enabled && sampleRate > 0 && std::abs(gainDb) >= FLAT_GAIN_THRESHOLD_DB && frequency > 0.0 && frequency < sampleRate * 0.5;
+            if (!active)
+            {
+                bandActive[b] = false;
+                continue;
+            }
+            if (!bandActive[b])
+            {
+                // 新启用的频段从零状态开始
+                state1[b].fill(0.0f);
+                state2[b].fill(0.0f);
+                bandActive[b] = true;
+            }
+            const double a = std::pow(10.0, gainDb / 40.0);
+            const double w0 = 2.0 * std::numbers::pi * frequency / sampleRate;
+            const double alpha = std::sin(w0) / (2.0 * DEFAULT_BAND_Q);
+            const double cosW0 = std::cos(w0);
+            const double a0 = 1.0 + alpha / a;
+            auto& k = coefficients[b];
+            k.b0 = static_cast<float>((1.0 + alpha * a) / a0);
+            k.b1 = static_cast<float>(-2.0 * cosW0 / a0);
+            k.b2 = static_cast<float>((1.0 - alpha * a) / a0);
+            k.a1 = k.b1;
+            k.a2 = static_cast<float>((1.0 - alpha / a) / a0);
+            activeBands[activeBandCount++] = b;
+        }
+        return true;
+    }
+
+    // 按帧取各通道的最大绝对值（通道联动），所需增益低于当前增益时立即降低，否则按时间常数恢复
+    void runLimiter(float* __restrict buffer, unsigned int frames) {
+        const float threshold = static_cast<float>(limiterThreshold.load(std::memory_order_relaxed));
+        const float release = limiterReleaseCoef;
+        const int ch = channels;
+        float g = limiterGain;
+        for (unsigned int f = 0; f < frames; ++f)
+        {
+            float* __restrict x = buffer + static_cast<size_t>(f) * ch;
+            float peak = 0.0f;
+            for (int c = 0; c < ch; ++c)
+                peak = std::max(peak, std::abs(x[c]));
+            const float required = peak > threshold ? threshold / peak : 1.0f;
+            g = std::min(g + (1.0f - g) * release, required);
+            if (g < 1.0f)
+                for (int c = 0; c < ch; ++c)
+                    x[c] *= g;
+        }
+        limiterGain = g;
+    }
+
+    // 转置直接II型，逐帧处理，每帧内沿通道计算
+    void runBiquad(float* __restrict buffer, unsigned int frames, int band) {
+        const Coefficients k = coefficients[band];
+        float* __restrict s1 = state1[band].data();
+        float* __restrict s2 = state2[band].data();
+        const int ch = channels;
+        for (unsigned int f = 0; f < frames; ++f)
+        {
+            float* __restrict x = buffer + static_cast<size_t>(f) * ch;
+            for (int c = 0; c < ch; ++c)
+            {
+                const float in = x[c];
+                const float out = k.b0 * in + s1[c];
+                s1[c] = k.b1 * in - k.a1 * out + s2[c];
+                s2[c] = k.b2 * in - k.a2 * out;
+                x[c] = out;
+            }
+        }
+        for (int c = 0; c < ch; ++c)
+        {
+            if (std::abs(s1[c]) < DENORMAL_THRESHOLD) s1[c] = 0.0f;
+            if (std::abs(s2[c]) < DENORMAL_THRESHOLD) s2[c] = 0.0f;
+        }
+    }
+};
@@ -0,0 +1,144 @@
+#pragma once
+#include "PlayerPredefine.h"
+#include <AudioAdapter.h>
+#include <cstring>
+
+// 输出设备参数的协商，以及内部交错float数据到设备格式的转换（在音频回调线程调用）
+// 设备原生支持float时直接在设备缓冲区中处理，不需要转换；整数格式才截断，按2的幂缩放（与swr相同）
+// 16位输出在需要重新量化时加入TPDF抖动，缓冲区中的采样都已是16位整数值（如1倍增益播放16位源、静音）时不加抖动，输出与源逐位一致
+class AudioOutputConverter : public PlayerTypes {
+public:
+    // 协商时的优先级，设备不支持首选格式时依次尝试
+    static constexpr AVSampleFormat FALLBACK_FORMATS[] = { AV_SAMPLE_FMT_FLT, AV_SAMPLE_FMT_S32, AV_SAMPLE_FMT_S16 };
+
+private:
+    AVSampleFormat format{ AV_SAMPLE_FMT_FLT };
+    int channels{ 0 };
+    std::vector<float> scratch; // 非float输出时的处理缓冲区
+    uint32_t ditherState{ 0x9E3779B9u };
+
+public:
+    AudioOutputConverter() = default;
+    AudioOutputConverter(const AudioOutputConverter&) = delete;
+    AudioOutputConverter& operator=(const AudioOutputConverter&) = delete;
+
+    static bool isSupportedFormat(AVSampleFormat fmt) {
+        return fmt == AV_SAMPLE_FMT_FLT || fmt == AV_SAMPLE_FMT_S32 || fmt == AV_SAMPLE_FMT_S16;
+    }
+    // 按设备的原生格式协商输出格式，原生格式未知时使用首选格式，由音频后端自行转换
+    static AVSampleFormat negotiate(AudioAdapter::AudioFormats nativeFormats, AVSampleFormat preferred = AV_SAMPLE_FMT_FLT) {
+        auto supported = [&nativeFormats](AVSampleFormat fmt) {
+            return nativeFormats.testFlag(AudioAdapter::avSampleFormatToTargetAudioFormat(fmt));
+            };
+        if (!isSupportedFormat(preferred))
+            preferred = AV_SAMPLE_FMT_FLT;
+        if (nativeFormats == AudioAdapter::AudioFormat{ 0 } || supported(preferred))
+            return preferred;
+        for (auto fmt : FALLBACK_FORMATS)
+            if (supported(fmt))
+                return fmt;
+        return preferred;
+    }
+    // 设备支持源采样率（或支持列表未知）时直接使用，避免重采样；否则取不低于源的最小采样率，都低于源时取最高的
+    static int negotiateSampleRate(const AudioAdapter::AudioDeviceInfo& deviceInfo, int sourceSampleRate) {
+        const auto& rates = deviceInfo.sampleRates;
+        if (sourceSampleRate <= 0)
+            return deviceInfo.preferredSampleRate ? static_cast<int>(deviceInfo.preferredSampleRate) : 48000;
+        if (rates.empty() || std::find(rates.begin(), rates.end(), static_cast<unsigned int>(sourceSampleRate)) != rates.end())
+            return sourceSampleRate;
+        unsigned int higher = 0;
+        unsigned int highest = 0;
+        for (auto rate : rates)
+        {
+            if (rate >= static_cast<unsigned int>(sourceSampleRate) && (higher == 0 || rate < higher))
+                higher = rate;
+            highest = std::max(highest, rate);
+        }
+        return static_cast<int>(higher ? higher : highest);
+    }
+    // 设备通道数足够（或未知）时保留源布局，否则使用设备通道数的默认布局，由混音矩阵下混
+    static void negotiateChannelLayout(const AudioAdapter::AudioDeviceInfo& deviceInfo, const AVChannelLayout& sourceLayout, AVChannelLayout& outLayout) {
+        av_channel_layout_uninit(&outLayout);
+        const int maxChannels = static_cast<int>(deviceInfo.outputChannels);
+        if (sourceLayout.nb_channels > 0 && (maxChannels == 0 || sourceLayout.nb_channels <= maxChannels)
+            && av_channel_layout_copy(&outLayout, &sourceLayout) >= 0)
+            return;
+        av_channel_layout_default(&outLayout, std::clamp(maxChannels, 1, 2));
+    }
+
+    // 打开输出流时调用，不能与回调并发
+    // \param maxFrames 预计的最大回调帧数，用于预先分配缓冲区，避免在回调中分配内存
+    void prepare(AVSampleFormat outputFormat, int numberOfChannels, unsigned int maxFrames) {
+        format = isSupportedFormat(outputFormat) ? outputFormat : AV_SAMPLE_FMT_FLT;
+        channels = std::max(numberOfChannels, 0);
+        scratch.assign(isPassthrough() ? 0 : static_cast<size_t>(maxFrames) * channels, 0.0f);
+    }
+
+    AVSampleFormat outputFormat() const { return format; }
+    int bytesPerSample() const { return av_get_bytes_per_sample(format); }
+    // float输出直接在设备缓冲区中处理
+    bool isPassthrough() const { return format == AV_SAMPLE_FMT_FLT; }
+
+    // 返回用于读取与处理的float缓冲区，float输出时即为设备缓冲区
+    float* processBuffer(void* deviceBuffer, unsigned int frames) {
+        if (isPassthrough())
+            return static_cast<float*>(deviceBuffer);
+        const size_t count = static_cast<size_t>(frames) * channels;
+        if (scratch.size() < count)
+            scratch.resize(count); // 回调帧数超过prepare时的预估才会分配
+        return scratch.data();
+    }
+    // 将processBuffer中处理完的数据写入设备缓冲区
+    void convert(const float* samples, void* deviceBuffer, unsigned int frames) {
+        if (isPassthrough() || !samples || !deviceBuffer)
+            return;
+        const size_t count = static_cast<size_t>(frames) * channels;
+        if (format == AV_SAMPLE_FMT_S32)
+        {
+            int32_t* __restrict dst = static_cast<int32_t*>(deviceBuffer);
+            for (size_t i = 0; i < count; ++i)
+                dst[i] = static_cast<int32_t>(std::clamp(std::llrint(static_cast<double>(samples[i]) * 2147483648.0), -2147483648LL, 2147483647LL));
+        }
+        else if (format == AV_SAMPLE_FMT_S16)
+        {
+            int16_t* __restrict dst = static_cast<int16_t*>(deviceBuffer);
+            if (isExactS16(samples, count))
+            {
+                for (size_t i = 0; i < count; ++i)
+                    dst[i] = static_cast<int16_t>(std::clamp(samples[i] * 32768.0f, -32768.0f, 32767.0f));
+                return;
+            }
+            uint32_t state = ditherState;
+            for (size_t i = 0; i < count; ++i)
+            {
+                // 两个均匀分布相加得到三角分布，幅度为±1 LSB
+                const float dither = nextUniform(state) + nextUniform(state);
+                dst[i] = static_cast<int16_t>(std::lrintf(std::clamp(samples[i] * 32768.0f + dither, -32768.0f, 32767.0f)));
+            }
+            ditherState = state;
+        }
+    }
+    void silence(void* deviceBuffer, unsigned int frames) const {
+        if (deviceBuffer)
+            std::memset(deviceBuffer, 0, static_cast<size_t>(frames) * channels * bytesPerSample());
+    }
+
+private:
+    // 所有采样乘以32768后都是整数，截断不会引入量化误差，遇到第一个非整数即返回
+    static bool isExactS16(const float* samples, size_t count) {
+        for (size_t i = 0; i < count; ++i)
+        {
+            const float v = samples[i] * 32768.0f;
+            if (v != std::nearbyint(v))
+                return false;
+        }
+        return true;
+    }
+    // xorshift32，返回[-0.5, 0.5)
+    static float nextUniform(uint32_t& state) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return static_cast<float>(state) * (1.0f / 4294967296.0f) - 0.5f;
+    }
+};
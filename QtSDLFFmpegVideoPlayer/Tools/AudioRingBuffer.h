@@ -0,0 +1,195 @@
+#pragma once
+#include "PlayerPredefine.h"
+#include <array>
+#include <bit>
+
+// 解码线程与音频回调之间的单生产者单消费者PCM环形缓冲区，容量以帧为单位，存放交错float数据
+// 读写位置是单调递增的帧计数，各自只由一方修改，另一方只读取，全程无锁、无等待、不分配内存
+// 另有一个固定容量的时间戳标记环，记录某个写入位置对应的媒体时间，回调读取时据此更新音频时钟
+// 清空由消费者完成：reset只记录当时的写入位置并递增代数，消费者下一次读取时把读取位置移过去，读取位置始终只由消费者修改
+class AudioRingBuffer : public PlayerTypes {
+public:
+    using SampleType = float;
+    static constexpr size_t MAX_MARKERS = 256; // 标记环容量，满时丢弃新标记，只影响时钟更新的粒度
+
+    struct PtsMarker {
+        uint64_t position{ 0 }; // 该标记对应的写入位置，单位：帧
+        uint64_t pts{ 0 }; // Presentation Time Stamp
+        AVRational timeBase{ 1, AV_TIME_BASE }; // 时间基
+        double frameTime{ 0.0 }; // 对应的媒体时间，单位s
+        double secondsPerFrame{ 0.0 }; // 之后每输出一帧前进的媒体时间，用于在两个标记之间插值，单位s
+    };
+
+private:
+    // 打开输出流时分配，之后只读
+    std::vector<SampleType> buffer;
+    uint64_t capacity{ 0 }; // 2的幂，单位：帧
+    uint64_t mask{ 0 };
+    int channels{ 0 };
+
+    alignas(64) Atomic<uint64_t> writePos{ 0 }; // 只由生产者修改
+    alignas(64) Atomic<uint64_t> readPos{ 0 }; // 只由消费者修改
+
+    std::array<PtsMarker, MAX_MARKERS> markers{};
+    alignas(64) Atomic<uint64_t> markerWrite{ 0 };
+    alignas(64) Atomic<uint64_t> markerRead{ 0 };
+    // 清空请求：之前写入的数据与标记都要丢弃，代数变化后消费者才读取两个位置
+    alignas(64) Atomic<uint64_t> resetGeneration{ 0 };
+    Atomic<uint64_t> discardFramesBefore{ 0 };
+    Atomic<uint64_t> discardMarkersBefore{ 0 };
+    // 只在消费者线程访问
+    uint64_t appliedResetGeneration{ 0 };
+    PtsMarker currentMarker{};
+    bool hasCurrentMarker{ false };
+
+public:
+    AudioRingBuffer() = default;
+    AudioRingBuffer(const AudioRingBuffer&) = delete;
+    AudioRingBuffer& operator=(const AudioRingBuffer&) = delete;
+
+    // 打开输出流时调用，容量向上取整到2的幂，不能与读写并发
+    void prepare(uint64_t capacityFrames, int numberOfChannels) {
+        channels = std::max(numberOfChannels, 0);
+        capacity = capacityFrames ? std::bit_ceil(capacityFrames) : 0;
+        mask = capacity ? capacity - 1 : 0;
+        buffer.assign(static_cast<size_t>(capacity) * channels, SampleType{ 0 });
+        writePos.store(0);
+        readPos.store(0);
+        markerWrite.store(0);
+        markerRead.store(0);
+        discardFramesBefore.store(0);
+        discardMarkersBefore.store(0);
+        appliedResetGeneration = resetGeneration.load();
+        hasCurrentMarker = false;
+    }
+    // 请求清空此前写入的数据与标记，可与回调并发，调用期间生产者不能写入（seek时解码线程已暂停）
+    // 消费者在下一次读取时丢弃，之后写入的数据不受影响
+    void reset() {
+        discardFramesBefore.store(writePos.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        discardMarkersBefore.store(markerWrite.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        resetGeneration.fetch_add(1, std::memory_order_release);
+    }
+
+    bool isPrepared() const { return capacity > 0 && channels > 0; }
+    int numberOfChannels() const { return channels; }
+    uint64_t capacityFrames() const { return capacity; }
+    // 可读帧数，不含已请求丢弃的数据，任意线程调用时为近似值
+    uint64_t readableFrames() const {
+        const uint64_t w = writePos.load(std::memory_order_acquire);
+        const uint64_t r = std::max(readPos.load(std::memory_order_acquire), discardFramesBefore.load(std::memory_order_relaxed));
+        return w > r ? w - r : 0;
+    }
+    // 可写帧数，待丢弃的数据在消费者执行清空前仍占用空间
+    uint64_t writableFrames() const { return capacity - (writePos.load(std::memory_order_acquire) - readPos.load(std::memory_order_acquire)); }
+    // 下一次写入的位置，用于生成标记
+    uint64_t writePosition() const { return writePos.load(std::memory_order_relaxed); }
+    // 下一次读取的位置（已请求丢弃的数据之后），任意线程调用时为近似值
+    uint64_t readPosition() const { return std::max(readPos.load(std::memory_order_acquire), discardFramesBefore.load(std::memory_order_relaxed)); }
+
+    // 生产者：写入最多frames帧，返回实际写入的帧数
+    uint64_t write(const SampleType* samples, uint64_t frames) {
+        if (!isPrepared() || !samples)
+            return 0;
+        const uint64_t w = writePos.load(std::memory_order_relaxed);
+        const uint64_t r = readPos.load(std::memory_order_acquire);
+        const uint64_t count = std::min(frames, capacity - (w - r));
+        if (count == 0)
+            return 0;
+        const uint64_t index = w & mask;
+        const uint64_t first = std::min(count, capacity - index);
+        std::copy_n(samples, first * channels, buffer.data() + index * channels);
+        std::copy_n(samples + first * channels, (count - first) * channels, buffer.data());
+        writePos.store(w + count, std::memory_order_release);
+        return count;
+    }
+    // 生产者：在写入数据前调用，标记环已满时返回false
+    bool pushMarker(const PtsMarker& marker) {
+        const uint64_t w = markerWrite.load(std::memory_order_relaxed);
+        if (w - markerRead.load(std::memory_order_acquire) >= MAX_MARKERS)
+            return false;
+        markers[w % MAX_MARKERS] = marker;
+        markerWrite.store(w + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 消费者：读取最多frames帧，返回实际读取的帧数，不足部分由调用者处理
+    uint64_t read(SampleType* out, uint64_t frames) {
+        if (!isPrepared() || !out)
+            return 0;
+        applyPendingReset();
+        const uint64_t r = readPos.load(std::memory_order_relaxed);
+        const uint64_t w = writePos.load(std::memory_order_acquire);
+        const uint64_t count = std::min(frames, w - r);
+        if (count == 0)
+            return 0;
+        const uint64_t index = r & mask;
+        const uint64_t first = std::min(count, capacity - index);
+        std::copy_n(buffer.data() + index * channels, first * channels, out);
+        std::copy_n(buffer.data(), (count - first) * channels, out + first * channels);
+        readPos.store(r + count, std::memory_order_release);
+        return count;
+    }
+    // 消费者：取得下一次读取起点所对应的标记，offsetFrames为起点相对标记位置的帧数
+    // 起点之前的标记会被弹出，还没有任何标记时返回false
+    bool currentPtsMarker(PtsMarker& marker, uint64_t& offsetFrames) {
+        applyPendingReset();
+        const uint64_t r = readPos.load(std::memory_order_relaxed);
+        uint64_t m = markerRead.load(std::memory_order_relaxed);
+        const uint64_t end = markerWrite.load(std::memory_order_acquire);
+        while (m != end && markers[m % MAX_MARKERS].position <= r)
+        {
+            currentMarker = markers[m % MAX_MARKERS];
+            hasCurrentMarker = true;
+            ++m;
+        }
+        markerRead.store(m, std::memory_order_release);
+        if (!hasCurrentMarker)
+            return false;
+        marker = currentMarker;
+        offsetFrames = r - currentMarker.position;
+        return true;
+    }
+    // 消费者：取出剩余的全部数据与标记，标记的位置改为相对于取出数据起点的帧数，当前标记移到起点
+    // 用于输出格式改变时转换缓冲的数据，需在回调停止后调用，会分配内存
+    uint64_t drain(std::vector<SampleType>& out, std::vector<PtsMarker>& outMarkers) {
+        outMarkers.clear();
+        applyPendingReset();
+        const uint64_t r = readPos.load(std::memory_order_relaxed);
+        const uint64_t frames = readableFrames();
+        PtsMarker marker;
+        uint64_t offsetFrames = 0;
+        if (currentPtsMarker(marker, offsetFrames))
+        {
+            marker.frameTime += offsetFrames * marker.secondsPerFrame;
+            marker.position = 0;
+            outMarkers.push_back(marker);
+        }
+        uint64_t m = markerRead.load(std::memory_order_relaxed);
+        const uint64_t end = markerWrite.load(std::memory_order_acquire);
+        for (; m != end; ++m)
+        {
+            marker = markers[m % MAX_MARKERS];
+            marker.position = marker.position > r ? marker.position - r : 0;
+            outMarkers.push_back(marker);
+        }
+        markerRead.store(m, std::memory_order_release);
+        out.resize(static_cast<size_t>(frames) * channels);
+        return read(out.data(), frames);
+    }
+
+private:
+    // 消费者：执行生产者一侧请求的清空，读取位置与标记读取位置只前移
+    void applyPendingReset() {
+        const uint64_t generation = resetGeneration.load(std::memory_order_acquire);
+        if (generation == appliedResetGeneration)
+            return;
+        appliedResetGeneration = generation;
+        const uint64_t frames = discardFramesBefore.load(std::memory_order_relaxed);
+        const uint64_t markerPos = discardMarkersBefore.load(std::memory_order_relaxed);
+        if (readPos.load(std::memory_order_relaxed) < frames)
+            readPos.store(frames, std::memory_order_release);
+        if (markerRead.load(std::memory_order_relaxed) < markerPos)
+            markerRead.store(markerPos, std::memory_order_release);
+        hasCurrentMarker = false;
+    }
+};
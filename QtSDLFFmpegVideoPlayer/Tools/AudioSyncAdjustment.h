@@ -0,0 +1,19 @@
+#pragma once
+#include "AudioRingBuffer.h"
+
+// 解码阶段的时钟同步调整，单位：帧；正值为需要插入的静音，负值为需要从即将写入的数据中丢弃的帧数
+class AudioSyncAdjustment {
+public:
+    // 音频落后时从数据头部丢弃最多-adjustment帧，标记的媒体时间随之后移；adjustment不小于0时不做处理
+    // \return 本次数据不够丢弃、需要留到下一段数据的调整量，不大于0
+    template<typename T>
+    static int64_t dropFrames(int64_t adjustment, const T*& data, uint64_t& frames, int channels, AudioRingBuffer::PtsMarker& marker) {
+        if (adjustment >= 0 || channels <= 0)
+            return 0;
+        const uint64_t dropped = std::min(static_cast<uint64_t>(-adjustment), frames);
+        data += dropped * channels;
+        frames -= dropped;
+        marker.frameTime += dropped * marker.secondsPerFrame;
+        return adjustment + static_cast<int64_t>(dropped);
+    }
+};
@@ -0,0 +1,239 @@
+#pragma once
+#include "PlayerPredefine.h"
+#include <cmath>
+#include <numbers>
+
+// 变速不变调：WSOLA（波形相似重叠相加）
+// 每一步固定输出hop帧，输入的名义位置按hop*倍率前进，在名义位置附近搜索与上一段自然延续最相似的位置，再用汉宁窗重叠相加
+// 倍率每一步读取一次，播放中可以连续调整，不需要重新初始化；1倍速时不搜索，输出与输入逐样本一致（只有固定的窗长延迟）
+// 每次输出的第一帧对应的输入位置早于本次输入的第一帧，调用方用lastOutputLagFrames修正时间戳
+class AudioTimeStretcher : public PlayerTypes {
+public:
+    static constexpr double MIN_RATIO = 0.25;
+    static constexpr double MAX_RATIO = 4.0;
+    static constexpr double WINDOW_MS = 30.0; // 重叠相加的窗长，单位：毫秒，步长为窗长的一半
+    static constexpr double SEEK_MS = 8.0; // 相似度搜索范围（单侧），单位：毫秒
+    static constexpr int COARSE_SEEK_STEP = 4; // 粗搜索的偏移步长，之后在最优位置附近逐点细化
+    static constexpr int CORRELATION_STRIDE = 2; // 计算相似度时的采样间隔
+
+private:
+    AtomicDouble ratio{ 1.0 }; // 由任意线程写入
+
+    // 只在处理线程访问
+    int sampleRate{ 0 };
+    int channels{ 0 };
+    int64_t hop{ 0 }; // 步长，单位：帧
+    int64_t seek{ 0 };
+    std::vector<float> window; // 长度为2*hop的汉宁窗，步长为一半时各段窗函数之和恒为1
+    std::vector<float> input; // 交错
+    std::vector<float> mono; // 输入的单声道混合，用于相似度计算
+    int64_t inputFrames{ 0 }; // input中的帧数，包括开头已消费的部分
+    int64_t consumedFrames{ 0 }; // input开头之后不再需要的帧数，积累到不少于剩余部分时才一次性移除
+    int64_t bufferOrigin{ 0 }; // input开头在reset之后全部输入中的位置，单位：帧
+    double analysisPos{ 0.0 }; // 下一段的名义起点，相对input开头，单位：帧
+    int64_t prevStart{ 0 }; // 上一段的起点，相对input开头，移除输入后可能为负
+    double lastOutputLag{ 0.0 };
+    bool started{ false }; // 是否已经输出过
+    std::vector<float> overlap; // 上一段后半部分加窗后的数据，等待与下一段前半部分相加
+
+public:
+    AudioTimeStretcher() = default;
+    AudioTimeStretcher(const AudioTimeStretcher&) = delete;
+    AudioTimeStretcher& operator=(const AudioTimeStretcher&) = delete;
+
+    // 输出格式确定后调用，参数不变时不会清空状态
+    void prepare(int sampleRate, int numberOfChannels) {
+        if (sampleRate == this->sampleRate && numberOfChannels == channels && hop > 0)
+            return;
+        this->sampleRate = sampleRate;
+        channels = std::max(numberOfChannels, 0);
+        hop = sampleRate > 0 ? std::max<int64_t>(static_cast<int64_t>(sampleRate * WINDOW_MS * 0.0005), 16) : 0;
+        seek = sampleRate > 0 ? static_cast<int64_t>(sampleRate * SEEK_MS * 0.001) : 0;
+        window.resize(static_cast<size_t>(hop) * 2);
+        for (size_t i = 0; i < window.size(); ++i)
+            window[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * std::numbers::pi * static_cast<double>(i) / static_cast<double>(window.size())));
+        reset();
+    }
+    // seek或切换文件后调用，丢弃缓存的输入，下一段从淡入开始
+    void reset() {
+        input.clear();
+        mono.clear();
+        inputFrames = 0;
+        consumedFrames = 0;
+        bufferOrigin = 0;
+        lastOutputLag = 0.0;
+        analysisPos = 0.0;
+        prevStart = 0;
+        started = false;
+        overlap.assign(static_cast<size_t>(hop) * channels, 0.0f);
+    }
+
+    // 播放倍率，超出[MIN_RATIO, MAX_RATIO]时截断
+    void setRatio(double r) { ratio.store(std::clamp(r, MIN_RATIO, MAX_RATIO)); }
+    double getRatio() const { return ratio.load(); }
+    bool isPrepared() const { return hop > 0 && channels > 0; }
+    // 输入到输出的最大延迟，单位：帧
+    int64_t latencyFrames() const { return hop * 2; }
+    // 最近一次有输出的process中，输出的第一帧对应的输入位置比本次输入的第一帧早多少帧（按输入计，即媒体时间）
+    // 包含窗长延迟与变速造成的输入积压，输出的时间戳 = 本次输入的时间戳 - lastOutputLagFrames / 采样率
+    double lastOutputLagFrames() const { return lastOutputLag; }
+
+    // 处理交错float数据，输出覆盖写入out（可能为空，也可能多于输入）
+    void process(const float* samples, int frames, std::vector<float>& out) {
+        out.clear();
+        if (!isPrepared() || !samples || frames <= 0)
+            return;
+        const double callStart = static_cast<double>(bufferOrigin + inputFrames); // 本次输入的第一帧
+        bool firstSegment = true;
+        const size_t base = static_cast<size_t>(inputFrames);
+        input.resize((base + frames) * channels);
+        mono.resize(base + frames);
+        const float monoScale = 1.0f / channels;
+        for (int f = 0; f < frames; ++f)
+        {
+            const float* src = samples + static_cast<size_t>(f) * channels;
+            float* dst = input.data() + (base + f) * channels;
+            float sum = 0.0f;
+            for (int c = 0; c < channels; ++c)
+            {
+                dst[c] = src[c];
+                sum += src[c];
+            }
+            mono[base + f] = sum * monoScale;
+        }
+        inputFrames += frames;
+
+        const int64_t length = hop * 2;
+        while (true)
+        {
+            const double r = ratio.load(std::memory_order_relaxed);
+            int64_t start = 0;
+            if (!started)
+            {
+                start = std::max<int64_t>(std::llround(analysisPos), 0);
+                if (start + length > inputFrames)
+                    break;
+            }
+            else if (r == 1.0)
+            {
+                // 自然延续，各段窗函数相加为1，完全重建原信号
+                start = prevStart + hop;
+                if (start + length > inputFrames)
+                    break;
+            }
+            else
+            {
+                const int64_t nominal = std::max<int64_t>(std::llround(analysisPos), 0);
+                if (std::max(nominal + seek + length, prevStart + length) > inputFrames)
+                    break;
+                start = findBestStart(nominal);
+            }
+            if (firstSegment)
+            {
+                // 各段对应名义起点（1倍速与首段时即为start），不受相似度搜索的偏移影响，时间戳保持平滑
+                lastOutputLag = callStart - (static_cast<double>(bufferOrigin) + (started && r != 1.0 ? analysisPos : static_cast<double>(start)));
+                firstSegment = false;
+            }
+            emitSegment(start, out);
+            analysisPos = (!started || r == 1.0) ? static_cast<double>(start + hop) : analysisPos + hop * r;
+            prevStart = start;
+            started = true;
+        }
+        discardConsumedInput();
+    }
+
+private:
+    // 在[nominal - seek, nominal + seek]中寻找与上一段自然延续最相似的起点
+    int64_t findBestStart(int64_t nominal) const {
+        const int64_t reference = prevStart + hop;
+        const int64_t low = std::max<int64_t>(nominal - seek, 0);
+        const int64_t high = nominal + seek;
+        int64_t best = nominal;
+        float bestScore = -std::numeric_limits<float>::infinity();
+        for (int64_t candidate = low; candidate <= high; candidate += COARSE_SEEK_STEP)
+        {
+            float score = similarity(candidate, reference);
+            if (score > bestScore)
+            {
+                bestScore = score;
+                best = candidate;
+            }
+        }
+        const int64_t refineLow = std::max(best - COARSE_SEEK_STEP + 1, low);
+        const int64_t refineHigh = std::min(best + COARSE_SEEK_STEP - 1, high);
+        for (int64_t candidate = refineLow; candidate <= refineHigh; ++candidate)
+        {
+            float score = similarity(candidate, reference);
+            if (score > bestScore)
+            {
+                bestScore = score;
+                best = candidate;
+            }
+        }
+        return best;
+    }
+    // 以候选段能量归一化的互相关，隔CORRELATION_STRIDE点取样使计算量减半，4个独立累加器缩短浮点加法的依赖链
+    float similarity(int64_t candidate, int64_t reference) const {
+        const float* __restrict a = mono.data() + candidate;
+        const float* __restrict b = mono.data() + reference;
+        float cross[4]{};
+        float energy[4]{};
+        const int64_t step = CORRELATION_STRIDE * 4;
+        int64_t i = 0;
+        for (; i + step <= hop; i += step)
+        {
+            for (int k = 0; k < 4; ++k)
+            {
+                const float x = a[i + k * CORRELATION_STRIDE];
+                cross[k] += x * b[i + k * CORRELATION_STRIDE];
+                energy[k] += x * x;
+            }
+        }
+        for (; i < hop; i += CORRELATION_STRIDE)
+        {
+            cross[0] += a[i] * b[i];
+            energy[0] += a[i] * a[i];
+        }
+        const float c = cross[0] + cross[1] + cross[2] + cross[3];
+        const float e = energy[0] + energy[1] + energy[2] + energy[3];
+        return c / std::sqrt(e + 1e-9f); // 只防止除以0，不能影响小信号（e远小于1）的归一化
+    }
+    // 输出hop帧：上一段的后半部分加本段的前半部分，并保存本段加窗后的后半部分
+    void emitSegment(int64_t start, std::vector<float>& out) {
+        const size_t ch = static_cast<size_t>(channels);
+        const size_t offset = out.size();
+        out.resize(offset + static_cast<size_t>(hop) * ch);
+        float* __restrict dst = out.data() + offset;
+        const float* __restrict head = input.data() + static_cast<size_t>(start) * ch;
+        const float* __restrict tail = head + static_cast<size_t>(hop) * ch;
+        float* __restrict ov = overlap.data();
+        for (int64_t f = 0; f < hop; ++f)
+        {
+            const float wHead = window[f];
+            const float wTail = window[f + hop];
+            for (size_t c = 0; c < ch; ++c)
+            {
+                const size_t i = static_cast<size_t>(f) * ch + c;
+                dst[i] = ov[i] + head[i] * wHead;
+                ov[i] = tail[i] * wTail;
+            }
+        }
+    }
+    // 记录之后不会再用到的输入，已消费的部分不少于剩余部分时才移动数据，每帧平均只被移动常数次
+    void discardConsumedInput() {
+        int64_t keepFrom = static_cast<int64_t>(std::floor(analysisPos)) - seek;
+        if (started)
+            keepFrom = std::min(keepFrom, prevStart + hop);
+        consumedFrames = std::clamp<int64_t>(keepFrom, consumedFrames, inputFrames);
+        if (consumedFrames == 0 || consumedFrames < inputFrames - consumedFrames)
+            return;
+        const int64_t n = consumedFrames;
+        input.erase(input.begin(), input.begin() + n * channels);
+        mono.erase(mono.begin(), mono.begin() + n);
+        inputFrames -= n;
+        analysisPos -= static_cast<double>(n);
+        prevStart -= n;
+        bufferOrigin += n;
+        consumedFrames = 0;
+    }
+};
@@ -0,0 +1,188 @@
+#pragma once
+#include "PlayerPredefine.h"
+#include <deque>
+
+// 播放列表下一项的预打开与预解码
+// 后台线程中打开文件、选择音频流、打开解码器并解码开头的一段，切换曲目时解码线程直接接管解复用器、解码器与已解码的帧
+// 解复用器的读取位置与解码器状态都原样移交，衔接处不丢失也不重复样本
+class AudioTrackPreloader : public PlayerTypes {
+public:
+    struct PreloadedTrack {
+        std::string filePath;
+        SharedPtr<SingleDemuxer> demuxer{ nullptr }; // 已打开文件并选择了音频流，读取线程尚未启动
+        UniquePtr<AVCodecContext> codecCtx{ nullptr, constDeleterAVCodecContext };
+        std::deque<UniquePtr<AVFrame>> frames; // 预解码的帧，按解码顺序
+        bool decoderDrained{ false }; // 预解码时已读到文件结尾并冲洗了解码器（很短的文件）
+    };
+    enum class TakeResult {
+        Taken,
+        Failed, // 预加载失败或没有预加载，结果已清除
+        NotReady, // 尚未完成或正在预加载的不是指定的文件，结果保留
+    };
+
+private:
+    const std::string loggerName{ "AudioTrackPreloader" };
+    DefinePlayerLoggerSinks(loggerSinks, loggerName);
+    Logger logger{ loggerName, loggerSinks };
+
+    const std::string demuxerLoggerNameSuffix;
+    std::thread worker;
+    AtomicBool cancelled{ false };
+    Mutex mtxWorker; // 串行化preload与cancel，等待后台线程结束时只持有此锁
+    Mutex mtx;
+    ConditionVariable cvFinished;
+    std::string filePath; // 正在或已经预加载的文件，没有时为空
+    bool finished{ true };
+    bool succeeded{ false };
+    PreloadedTrack track;
+
+public:
+    // \param demuxerLoggerNameSuffix 预加载创建的解复用器的日志名称后缀，与接管它的播放器一致
+    explicit AudioTrackPreloader(const std::string& demuxerLoggerNameSuffix)
+        : demuxerLoggerNameSuffix(demuxerLoggerNameSuffix) {}
+    AudioTrackPreloader(const AudioTrackPreloader&) = delete;
+    AudioTrackPreloader& operator=(const AudioTrackPreloader&) = delete;
+    ~AudioTrackPreloader() {
+        cancel();
+    }
+
+    // 在后台线程中预加载，之前未取走的结果被丢弃
+    // 需要等待之前的后台线程结束，打开文件与读取通过中断回调尽快返回，调用方不应持有解码线程需要的锁
+    // \param preDecodeSeconds 预先解码的时长，单位：秒
+    void preload(const std::string& path, const StreamIndexSelector& selector, double preDecodeSeconds) {
+        std::unique_lock lockWorker(mtxWorker);
+        cancelWorker();
+        {
+            std::unique_lock lock(mtx);
+            filePath = path;
+            finished = false;
+        }
+        cancelled.store(false);
+        worker = std::thread(&AudioTrackPreloader::run, this, path, selector, preDecodeSeconds);
+    }
+    // 取消预加载并丢弃结果
+    void cancel() {
+        std::unique_lock lockWorker(mtxWorker);
+        cancelWorker();
+    }
+    std::string getFilePath() {
+        std::unique_lock lock(mtx);
+        return filePath;
+    }
+    bool isFinished() {
+        std::unique_lock lock(mtx);
+        return finished;
+    }
+    // 等待预加载完成（成功或失败），超时返回false
+    bool waitFinished(uint64_t timeoutMs) {
+        std::unique_lock lock(mtx);
+        return cvFinished.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] { return finished; });
+    }
+    // 取走path的预加载结果，失败的结果同样被清除
+    // 尚未完成或预加载的是其他文件（新的下一项还未开始预加载）时返回NotReady，不改变状态
+    TakeResult take(const std::string& path, PreloadedTrack& out) {
+        std::unique_lock lock(mtx);
+        if (!finished || filePath != path)
+            return TakeResult::NotReady;
+        if (filePath.empty())
+            return TakeResult::Failed;
+        const bool ok = succeeded;
+        if (ok)
+        {
+            // 移交后不再受取消标志影响
+            track.demuxer->getFormatContext()->interrupt_callback = AVIOInterruptCB{ nullptr, nullptr };
+            out = std::move(track);
+        }
+        track = PreloadedTrack{};
+        filePath.clear();
+        succeeded = false;
+        return ok ? TakeResult::Taken : TakeResult::Failed;
+    }
+
+private:
+    // 需持有mtxWorker
+    void cancelWorker() {
+        cancelled.store(true);
+        if (worker.joinable())
+            worker.join();
+        std::unique_lock lock(mtx);
+        filePath.clear();
+        finished = true;
+        succeeded = false;
+        track = PreloadedTrack{};
+    }
+    // 格式上下文的中断回调：取消后打开文件、查找流信息与读取包的阻塞调用立即返回
+    static int interruptCallback(void* opaque) {
+        return static_cast<AudioTrackPreloader*>(opaque)->cancelled.load() ? 1 : 0;
+    }
+
+    void finish(bool ok, PreloadedTrack&& result) {
+        std::unique_lock lock(mtx);
+        if (ok && !cancelled.load())
+            track = std::move(result);
+        succeeded = ok && !cancelled.load();
+        finished = true;
+        cvFinished.notify_all();
+    }
+
+    void run(std::string path, StreamIndexSelector selector, double preDecodeSeconds) {
+        PreloadedTrack result;
+        result.filePath = path;
+        result.demuxer = std::make_shared<SingleDemuxer>(demuxerLoggerNameSuffix, StreamType::STAudio);
+        result.demuxer->setInterruptCallback(AVIOInterruptCB{ &AudioTrackPreloader::interruptCallback, this });
+        try {
+            result.demuxer->openAndSelectStreams(path, StreamType::STAudio, selector);
+        }
+        catch (const std::runtime_error& e) {
+            logger.error("Failed to preload {}: {}", path, e.what());
+            finish(false, std::move(result));
+            return;
+        }
+        AVFormatContext* formatCtx = result.demuxer->getFormatContext();
+        const StreamIndexType streamIndex = result.demuxer->getStreamIndex(StreamType::STAudio);
+        if (streamIndex < 0 || !MediaDecodeUtils::findAndOpenAudioDecoder(&logger, formatCtx, streamIndex, result.codecCtx))
+        {
+            logger.error("No audio stream can be decoded in {}", path);
+            finish(false, std::move(result));
+            return;
+        }
+        // 预解码：直接读取格式上下文，读到的包全部送入解码器，解复用器的包队列保持为空
+        double decodedSeconds = 0.0;
+        while (decodedSeconds < preDecodeSeconds && !cancelled.load() && !result.decoderDrained)
+        {
+            AVPacket* pkt = nullptr;
+            bool isEof = false;
+            if (MediaDecodeUtils::readFrame(&logger, formatCtx, pkt, true, &isEof))
+            {
+                UniquePtr<AVPacket> pktPtr{ pkt, constDeleterAVPacket };
+                if (pkt->stream_index != streamIndex)
+                    continue;
+                int ret = avcodec_send_packet(result.codecCtx.get(), pkt);
+                if (ret < 0 && ret != AVERROR(EAGAIN))
+                    continue;
+            }
+            else if (isEof)
+            {
+                avcodec_send_packet(result.codecCtx.get(), nullptr); // 冲洗解码器，取出最后的帧
+                result.decoderDrained = true;
+            }
+            else
+                break; // 读取出错，交给接管后的解复用器处理
+            UniquePtr<AVFrame> frame = makeUniqueFrame();
+            while (avcodec_receive_frame(result.codecCtx.get(), frame.get()) == 0)
+            {
+                if (frame->sample_rate > 0)
+                    decodedSeconds += static_cast<double>(frame->nb_samples) / frame->sample_rate;
+                result.frames.push_back(std::move(frame));
+                frame = makeUniqueFrame();
+            }
+        }
+        if (cancelled.load())
+        {
+            finish(false, std::move(result));
+            return;
+        }
+        logger.info("Preloaded {}: {} s decoded", path, decodedSeconds);
+        finish(true, std::move(result));
+    }
+};
@@ -1,5 +1,6 @@
 #pragma once
 #include "MediaPlayer.h"
+#include "HdrToneMapper.h"
 
 class FrameProcessor : protected PlayerTypes {
 protected:
@@ -9,6 +10,13 @@ public:
     FrameProcessor(Logger& logger) : logger(logger) {}
     
     SharedPtr<AVFrame> filterFrame(AVFrame* frame, IFrameFilterGraph* filterGraph, bool& needMoreFrame) {
+        // 恒等滤镜图只引用输入帧，不需要先复制一份引用
+        if (filterGraph->isIdentity())
+        {
+            if (!filterGraph->addFrame(frame, IFrameFilter::SrcFlagKeepReference))
+                logger.error("Error add frame to filter graph.");
+            return filterGraph->getOutputFrame(&needMoreFrame, IFrameFilter::SinkFlagNone);
+        }
         AVFrame* ref = av_frame_alloc();
         int refRst = av_frame_ref(ref, frame);
         if (refRst < 0)
@@ -32,6 +40,7 @@ class VideoFrameProcessor : FrameProcessor {
     SharedPtr<SwsContext> swsCtx{ nullptr };
     SharedPtr<SwsContext> scaleSwsCtx{ nullptr };
     SharedPtr<AVFrame> tempSwsFrame{ nullptr };
+    SharedPtr<AVFrame> tempHdrFrame{ nullptr }; // HDR源先转为YUV420P10LE，再色调映射到tempSwsFrame
     SharedPtr<AVFrame> scaledFrame{ nullptr };
     SharedPtr<FFmpegFrameVideoHueFilter> hueFilter{ nullptr };
     std::array<float, 4> prevColorParams{ 0.0f, 1.0f, 1.0f, 0.0f }; // brightness, contrast, saturation, hue
@@ -42,6 +51,20 @@ class VideoFrameProcessor : FrameProcessor {
     Atomic<float>& hue;
 
     SizeI scaledFrameSize;
+    // 初始化时的源帧参数，去隔行开关切换等情况下源帧格式会变化，需要重新初始化
+    bool initHardwareDecoded{ false };
+    AVPixelFormat initSrcPixFmt{ AV_PIX_FMT_NONE };
+    SizeI initSrcSize;
+    AVColorSpace initSrcColorSpace{ AVCOL_SPC_UNSPECIFIED }; // 与像素格式一起决定swsCtx的转换系数
+    AVColorRange initSrcColorRange{ AVCOL_RANGE_UNSPECIFIED };
+
+    // HDR色调映射
+    HdrToneMapper toneMapper;
+    bool toneMappingEnabled{ true };
+    bool isHdrSource{ false };
+
+    // 字幕，在缩放到输出尺寸后混合，字幕边缘不会被缩放模糊
+    SubtitlePlayer* subtitlePlayer{ nullptr };
 
 public:
     VideoFrameProcessor(Logger& logger,
@@ -55,7 +78,9 @@ public:
         auto rawFrame = frameCtx.filteredFrame;
         if (!rawFrame) return nullptr;
         SharedPtr<AVFrame> swFrame{ makeSharedFrame() };
-        if (!filterGraph) init(frameCtx);
+        if (!filterGraph || isSourceChanged(frameCtx)) init(frameCtx);
+        if (frameCtx.isDiscontinuity)
+            toneMapper.reset(); // seek后不沿用之前画面的峰值
         updateFilterParams();
         if (frameCtx.isHardwareDecoded)
         {
@@ -72,7 +97,19 @@ public:
             else
                 logger.error("Error getting the data transfer format from GPU memory");
         }
-        if (!VideoPlayer::swsScaleFrame(swsCtx.get(), frameCtx.isHardwareDecoded ? swFrame.get() : rawFrame, tempSwsFrame.get(), &logger))
+        AVFrame* srcFrame = frameCtx.isHardwareDecoded ? swFrame.get() : rawFrame;
+        if (isHdrSource)
+        {
+            if (!VideoPlayer::swsScaleFrame(swsCtx.get(), srcFrame, tempHdrFrame.get(), &logger))
+                return nullptr;
+            av_frame_copy_props(tempSwsFrame.get(), tempHdrFrame.get());
+            if (!toneMapper.process(tempHdrFrame.get(), tempSwsFrame.get()))
+            {
+                logger.error("Error tone mapping the HDR frame to SDR");
+                return nullptr;
+            }
+        }
+        else if (!VideoPlayer::swsScaleFrame(swsCtx.get(), srcFrame, tempSwsFrame.get(), &logger))
             return nullptr;
         bool needMore = false;
         auto fltdFrame = filterFrame(tempSwsFrame.get(), filterGraph.get(), needMore);
@@ -81,13 +118,45 @@ public:
             updateSwsScaleFrameSize(frameCtx);
         if (!VideoPlayer::swsScaleFrame(scaleSwsCtx.get(), fltdFrame.get(), scaledFrame.get(), &logger))
             return nullptr;
+        if (subtitlePlayer)
+        {
+            int64_t pts = (frameCtx.rawFrame->pts != AV_NOPTS_VALUE ? frameCtx.rawFrame->pts : frameCtx.rawFrame->best_effort_timestamp);
+            if (pts != AV_NOPTS_VALUE && frameCtx.streamIndex >= 0)
+                subtitlePlayer->composite(scaledFrame.get(), pts * av_q2d(frameCtx.formatCtx->streams[frameCtx.streamIndex]->time_base), SizeI{ frameCtx.rawFrame->width, frameCtx.rawFrame->height });
+        }
         return scaledFrame;
     }
 
     void setProcessedFrameSize(SizeI size) {
         scaledFrameSize = size;
     }
+
+    // 是否对HDR(PQ/HLG)源做色调映射，在第一帧处理前设置有效
+    void setToneMappingEnabled(bool enabled) {
+        toneMappingEnabled = enabled;
+    }
+    void setToneMappingOperator(HdrToneMapper::Operator op) {
+        toneMapper.setOperator(op);
+    }
+    void setToneMappingPeakDetectionEnabled(bool enabled) {
+        toneMapper.setPeakDetectionEnabled(enabled);
+    }
+
+    // 设置后按视频帧时间将当前字幕混合到输出帧，nullptr表示不显示字幕
+    void setSubtitlePlayer(SubtitlePlayer* player) {
+        subtitlePlayer = player;
+    }
 private:
+    bool isSourceChanged(const VideoPlayer::DecodedFrameContext& frameCtx) const {
+        if (frameCtx.isHardwareDecoded != initHardwareDecoded)
+            return true;
+        if (!frameCtx.isHardwareDecoded && frameCtx.filteredFrame->format != initSrcPixFmt)
+            return true;
+        if (frameCtx.filteredFrame->colorspace != initSrcColorSpace || frameCtx.filteredFrame->color_range != initSrcColorRange)
+            return true;
+        return !(SizeI{ frameCtx.rawFrame->width, frameCtx.rawFrame->height } == initSrcSize);
+    }
+
     void init(const VideoPlayer::DecodedFrameContext& frameCtx) {
         auto& rawFrame = frameCtx.filteredFrame;
         auto& formatCtx = frameCtx.formatCtx;
@@ -98,12 +167,31 @@ private:
         hueFilter = std::make_shared<FFmpegFrameVideoHueFilter>(StreamType::STVideo, formatCtx, codecCtx, streamIndex);
         filterGraph->addFilter(hueFilter);
         filterGraph->configureFilterGraph();
+        prevColorParams = { 0.0f, 1.0f, 1.0f, 0.0f }; // 新建的hue滤镜为默认参数，需重新下发
+        initHardwareDecoded = frameCtx.isHardwareDecoded;
+        initSrcPixFmt = static_cast<AVPixelFormat>(rawFrame->format);
+        initSrcSize = SizeI{ frameCtx.rawFrame->width, frameCtx.rawFrame->height };
+        initSrcColorSpace = rawFrame->colorspace;
+        initSrcColorRange = rawFrame->color_range;
         tempSwsFrame = makeSharedFrame();
         tempSwsFrame->width = frameCtx.rawFrame->width;
         tempSwsFrame->height = frameCtx.rawFrame->height;
         tempSwsFrame->format = AV_PIX_FMT_YUV420P;
         if (av_frame_get_buffer(tempSwsFrame.get(), 0) < 0) return;
-        swsCtx = VideoPlayer::createSwsContext(tempSwsFrame.get(), static_cast<AVPixelFormat>(frameCtx.isHardwareDecoded ? fmt : frameCtx.rawFrame->format), SizeI{ frameCtx.rawFrame->width, frameCtx.rawFrame->height }, &logger);
+        auto srcPixFmt = static_cast<AVPixelFormat>(frameCtx.isHardwareDecoded ? fmt : frameCtx.rawFrame->format);
+        isHdrSource = toneMappingEnabled && HdrToneMapper::isHdrFrame(rawFrame, srcPixFmt);
+        if (isHdrSource)
+        {
+            // 10bit源仅由sws重排为YUV420P10LE，位深转换与色调映射由toneMapper完成
+            tempHdrFrame = makeSharedFrame();
+            tempHdrFrame->width = frameCtx.rawFrame->width;
+            tempHdrFrame->height = frameCtx.rawFrame->height;
+            tempHdrFrame->format = AV_PIX_FMT_YUV420P10LE;
+            swsCtx = VideoPlayer::createSwsContext(tempHdrFrame.get(), srcPixFmt, SizeI{ frameCtx.rawFrame->width, frameCtx.rawFrame->height }, &logger, -1, rawFrame->colorspace, rawFrame->color_range);
+            logger.info("HDR source detected (transfer: {}), tone mapping to SDR", av_color_transfer_name(rawFrame->color_trc));
+        }
+        else
+            swsCtx = VideoPlayer::createSwsContext(tempSwsFrame.get(), srcPixFmt, SizeI{ frameCtx.rawFrame->width, frameCtx.rawFrame->height }, &logger, -1, rawFrame->colorspace, rawFrame->color_range);
         updateSwsScaleFrameSize(frameCtx);
     }
 
@@ -140,6 +228,7 @@ private:
         scaledFrame->height = scaledFrameSize.height();
         scaledFrame->format = AV_PIX_FMT_YUV420P;
         if (av_frame_get_buffer(scaledFrame.get(), 0) < 0) return;
+        scaleSwsCtx.reset(); // 先归还旧的swsCtx，窗口尺寸来回变化时可以直接从缓存中取回
         scaleSwsCtx = VideoPlayer::createSwsContext(scaledFrame.get(), AV_PIX_FMT_YUV420P, SizeI{ frameCtx.rawFrame->width, frameCtx.rawFrame->height }, &logger);
     }
 };
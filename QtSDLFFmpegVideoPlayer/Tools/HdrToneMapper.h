@@ -0,0 +1,462 @@
+#pragma once
+#include "PlayerPredefine.h"
+#include "ControlExecutor.h"
+#include "SimdFloat4.h"
+#include <cmath>
+#include <cstring>
+#include <array>
+
+extern "C"
+{
+#include <libavutil/pixdesc.h>
+#include <libavutil/mastering_display_metadata.h>
+}
+
+// HDR(PQ/HLG, BT.2020, 10bit)到SDR(BT.709, 8bit)的CPU色调映射
+// 输入为AV_PIX_FMT_YUV420P10LE（P010等格式先由sws重排为该格式），输出为AV_PIX_FMT_YUV420P
+// 传递函数、HLG OOTF、色调曲线与BT.709 OETF均查表；YUV->RGB、色域矩阵、色调映射的增益与RGB->YUV由SimdFloat4按4像素并行计算（SSE2/NEON）
+// 查表本身是按像素索引的读取（SSE2/NEON没有gather），在两个SIMD阶段之间逐个读取；帧按行切片在多个线程上并行处理
+// 奇数宽高的最后一列/行按复制边缘像素处理
+class HdrToneMapper : public PlayerTypes {
+public:
+    enum class Operator {
+        Clip = 0, // 直接截断
+        Reinhard = 1,
+        Hable = 2, // 电影胶片曲线(Uncharted 2)
+        BT2390 = 3, // ITU-R BT.2390 EETF，在PQ域内做高光滚降
+    };
+
+    static constexpr float SDR_REFERENCE_WHITE_NITS = 203.0f; // BT.2408 HDR参考白，映射为SDR的1.0
+    static constexpr float DEFAULT_SOURCE_PEAK_NITS = 1000.0f; // 无元数据时假定的母版峰值亮度
+    static constexpr float PQ_MAX_NITS = 10000.0f;
+    static constexpr float HLG_DISPLAY_PEAK_NITS = 1000.0f; // HLG OOTF使用的显示峰值
+    static constexpr int SIGNAL_LUT_SIZE = 4096; // 非线性信号->线性光
+    static constexpr int CURVE_LUT_SIZE = 4096; // 色调曲线，以sqrt(线性光/峰值)为索引
+    static constexpr int OETF_LUT_SIZE = 4096; // 线性光->BT.709非线性，以sqrt(线性光)为索引
+    static constexpr int OOTF_LUT_SIZE = 4096; // HLG OOTF增益，以sqrt(场景亮度)为索引
+    static constexpr int MAX_SLICE_THREADS = 8; // 自动线程数的上限
+    static constexpr int MIN_ROW_PAIRS_PER_SLICE = 32; // 每个切片至少处理的行对数，行数太少时不拆分
+    static constexpr int CHUNK_CHROMA = 64; // 行内每次处理的色度样本数，对应两行各128个像素，中间结果约11KB
+    static constexpr float PEAK_SMOOTHING_ALPHA = 0.9f; // 峰值检测的低通滤波系数，越高越平滑
+    static constexpr float SCENE_CHANGE_THRESHOLD = 0.5f; // 帧平均亮度(log2)变化超过该值视为切换场景，峰值不再平滑
+
+    static bool isHdrTransfer(AVColorTransferCharacteristic trc) {
+        return trc == AVCOL_TRC_SMPTE2084 || trc == AVCOL_TRC_ARIB_STD_B67;
+    }
+    // 帧是否需要色调映射：PQ/HLG传递函数且位深大于8
+    static bool isHdrFrame(const AVFrame* frame, AVPixelFormat swPixFmt) {
+        if (!frame || !isHdrTransfer(frame->color_trc))
+            return false;
+        auto* desc = av_pix_fmt_desc_get(swPixFmt);
+        return desc && !(desc->flags & AV_PIX_FMT_FLAG_RGB) && desc->comp[0].depth > 8;
+    }
+
+private:
+    Operator op{ Operator::Hable };
+    bool peakDetectionEnabled{ true };
+    AVColorTransferCharacteristic transfer{ AVCOL_TRC_UNSPECIFIED };
+    float metadataPeakNits{ DEFAULT_SOURCE_PEAK_NITS };
+    float detectedPeak{ 0.0f }; // 平滑后的峰值，单位：参考白的倍数
+    float lastAvgLog{ 0.0f };
+    bool hasPeakHistory{ false };
+    float curvePeak{ -1.0f }; // 当前色调曲线LUT对应的峰值
+    Operator curveOp{ Operator::Clip };
+
+    std::array<float, SIGNAL_LUT_SIZE> signalToLinear{};
+    std::array<float, CURVE_LUT_SIZE> curveLut{}; // 输出/输入的增益
+    std::array<uint16_t, OETF_LUT_SIZE> linearToSdr{}; // 放大了(1<<12)的BT.709非线性值
+    std::array<float, OOTF_LUT_SIZE> hlgOotfGain{};
+    std::vector<float> rowMax; // 每行的最大亮度，用于峰值检测
+
+    // 切片线程
+    int threadCount{ 0 }; // 0表示自动
+    ControlExecutor sliceExecutor;
+
+public:
+    HdrToneMapper() {
+        buildOetfLut();
+        buildOotfLut();
+    }
+
+    void setOperator(Operator o) { op = o; }
+    Operator getOperator() const { return op; }
+    void setPeakDetectionEnabled(bool enabled) { peakDetectionEnabled = enabled; hasPeakHistory = false; }
+    bool getPeakDetectionEnabled() const { return peakDetectionEnabled; }
+    // 切片线程数，0表示自动（CPU核心数，最多MAX_SLICE_THREADS），1表示在调用线程中处理
+    void setThreadCount(int count) { threadCount = std::max(count, 0); }
+    int getThreadCount() const { return threadCount; }
+    // 当前使用的源峰值亮度，单位：nits
+    float currentPeakNits() const { return sourcePeak() * SDR_REFERENCE_WHITE_NITS; }
+
+    // seek后调用，清除峰值检测历史，避免新画面沿用seek前的平滑峰值；元数据峰值与查找表保留
+    void reset() {
+        hasPeakHistory = false;
+        detectedPeak = 0.0f;
+    }
+
+    // \param src AV_PIX_FMT_YUV420P10LE，BT.2020非恒定亮度，限制范围
+    // \param dst AV_PIX_FMT_YUV420P，需已分配缓冲区且尺寸与src相同
+    bool process(const AVFrame* src, AVFrame* dst) {
+        if (!src || !dst || src->format != AV_PIX_FMT_YUV420P10LE || dst->format != AV_PIX_FMT_YUV420P
+            || src->width != dst->width || src->height != dst->height)
+            return false;
+        auto trc = src->color_trc;
+        if (trc != transfer)
+        {
+            transfer = trc;
+            buildSignalLut();
+            curvePeak = -1.0f;
+        }
+        updateMetadataPeak(src);
+        float peak = sourcePeak();
+        if (peak != curvePeak || op != curveOp)
+            buildCurveLut(peak);
+
+        const int rowPairs = (src->height + 1) / 2;
+        rowMax.assign(rowPairs, 0.0f);
+        int slices = std::clamp(rowPairs / MIN_ROW_PAIRS_PER_SLICE, 1, effectiveThreadCount());
+        auto processSlice = [this, src, dst, peak, rowPairs, slices](int slice) {
+            const int begin = rowPairs * slice / slices;
+            const int end = rowPairs * (slice + 1) / slices;
+            for (int pair = begin; pair < end; ++pair)
+                rowMax[pair] = processRowPair(src, dst, pair * 2, peak);
+            };
+        // 第一个切片在调用线程中处理，其余交给切片线程，各切片写入不同的行
+        std::vector<std::future<void>> futures;
+        futures.reserve(slices - 1);
+        for (int slice = 1; slice < slices; ++slice)
+            futures.push_back(sliceExecutor.submit([&processSlice, slice] { processSlice(slice); }));
+        processSlice(0);
+        for (auto& future : futures)
+            future.get();
+        updateDetectedPeak(rowPairs);
+
+        dst->color_trc = AVCOL_TRC_BT709;
+        dst->color_primaries = AVCOL_PRI_BT709;
+        dst->colorspace = AVCOL_SPC_BT709;
+        dst->color_range = AVCOL_RANGE_MPEG;
+        return true;
+    }
+
+private:
+    int effectiveThreadCount() const {
+        if (threadCount > 0)
+            return threadCount;
+        return std::clamp(static_cast<int>(std::thread::hardware_concurrency()), 1, MAX_SLICE_THREADS);
+    }
+
+    float sourcePeak() const {
+        float peak = metadataPeakNits / SDR_REFERENCE_WHITE_NITS;
+        if (peakDetectionEnabled && hasPeakHistory)
+            peak = std::min(peak, std::max(detectedPeak, 1.0f));
+        // 量化到1/32，避免平滑后的峰值每帧都触发曲线LUT重建
+        return std::max(std::round(peak * 32.0f) / 32.0f, 1.0f);
+    }
+
+    // PQ EOTF，返回nits
+    static float pqToNits(float e) {
+        constexpr float m1 = 2610.0f / 16384.0f;
+        constexpr float m2 = 2523.0f / 4096.0f * 128.0f;
+        constexpr float c1 = 3424.0f / 4096.0f;
+        constexpr float c2 = 2413.0f / 4096.0f * 32.0f;
+        constexpr float c3 = 2392.0f / 4096.0f * 32.0f;
+        float p = std::pow(std::max(e, 0.0f), 1.0f / m2);
+        return PQ_MAX_NITS * std::pow(std::max(p - c1, 0.0f) / (c2 - c3 * p), 1.0f / m1);
+    }
+    static float nitsToPq(float nits) {
+        constexpr float m1 = 2610.0f / 16384.0f;
+        constexpr float m2 = 2523.0f / 4096.0f * 128.0f;
+        constexpr float c1 = 3424.0f / 4096.0f;
+        constexpr float c2 = 2413.0f / 4096.0f * 32.0f;
+        constexpr float c3 = 2392.0f / 4096.0f * 32.0f;
+        float y = std::pow(std::clamp(nits / PQ_MAX_NITS, 0.0f, 1.0f), m1);
+        return std::pow((c1 + c2 * y) / (1.0f + c3 * y), m2);
+    }
+    // HLG逆OETF，返回场景线性光[0,1]
+    static float hlgToScene(float e) {
+        constexpr float a = 0.17883277f;
+        constexpr float b = 0.28466892f;
+        constexpr float c = 0.55991073f;
+        e = std::max(e, 0.0f);
+        return e <= 0.5f ? e * e / 3.0f : (std::exp((e - c) / a) + b) / 12.0f;
+    }
+    static float bt709Oetf(float l) {
+        l = std::clamp(l, 0.0f, 1.0f);
+        return l < 0.018f ? 4.5f * l : 1.099f * std::pow(l, 0.45f) - 0.099f;
+    }
+
+    void buildSignalLut() {
+        for (int i = 0; i < SIGNAL_LUT_SIZE; ++i)
+        {
+            float e = i / float(SIGNAL_LUT_SIZE - 1);
+            if (transfer == AVCOL_TRC_ARIB_STD_B67)
+                signalToLinear[i] = hlgToScene(e); // OOTF依赖三通道亮度，在processRowPair中处理
+            else
+                signalToLinear[i] = pqToNits(e) / SDR_REFERENCE_WHITE_NITS;
+        }
+        metadataPeakNits = (transfer == AVCOL_TRC_ARIB_STD_B67 ? HLG_DISPLAY_PEAK_NITS : DEFAULT_SOURCE_PEAK_NITS);
+    }
+
+    // HLG OOTF：显示亮度 = 峰值 * 场景亮度^1.2，即三通道乘以 峰值 * Ys^0.2
+    void buildOotfLut() {
+        for (int i = 0; i < OOTF_LUT_SIZE; ++i)
+        {
+            float s = i / float(OOTF_LUT_SIZE - 1);
+            hlgOotfGain[i] = HLG_DISPLAY_PEAK_NITS / SDR_REFERENCE_WHITE_NITS * std::pow(std::max(s * s, 1e-6f), 0.2f);
+        }
+    }
+
+    void buildOetfLut() {
+        for (int i = 0; i < OETF_LUT_SIZE; ++i)
+        {
+            float s = i / float(OETF_LUT_SIZE - 1);
+            linearToSdr[i] = static_cast<uint16_t>(std::lround(bt709Oetf(s * s) * 4096.0f));
+        }
+    }
+
+    float curve(float x, float peak) const {
+        switch (op)
+        {
+        case Operator::Reinhard:
+        {
+            // 扩展Reinhard，保证peak映射到1.0
+            return x * (1.0f + x / (peak * peak)) / (1.0f + x);
+        }
+        case Operator::Hable:
+        {
+            auto hable = [](float v) {
+                constexpr float A = 0.15f, B = 0.50f, C = 0.10f, D = 0.20f, E = 0.02f, F = 0.30f;
+                return ((v * (A * v + C * B) + D * E) / (v * (A * v + B) + D * F)) - E / F;
+                };
+            return hable(x) / hable(peak);
+        }
+        case Operator::BT2390:
+        {
+            // 在PQ域内归一化到源峰值，KS以上部分做Hermite样条滚降
+            float srcPq = nitsToPq(peak * SDR_REFERENCE_WHITE_NITS);
+            float dstPq = nitsToPq(SDR_REFERENCE_WHITE_NITS);
+            float e = nitsToPq(x * SDR_REFERENCE_WHITE_NITS) / srcPq;
+            float maxLum = dstPq / srcPq;
+            float ks = 1.5f * maxLum - 0.5f;
+            if (e > ks)
+            {
+                float t = (e - ks) / (1.0f - ks);
+                float t2 = t * t, t3 = t2 * t;
+                e = (2 * t3 - 3 * t2 + 1) * ks + (t3 - 2 * t2 + t) * (1.0f - ks) + (-2 * t3 + 3 * t2) * maxLum;
+            }
+            return pqToNits(e * srcPq) / SDR_REFERENCE_WHITE_NITS;
+        }
+        case Operator::Clip:
+        default:
+            return std::min(x, 1.0f);
+        }
+    }
+
+    void buildCurveLut(float peak) {
+        for (int i = 0; i < CURVE_LUT_SIZE; ++i)
+        {
+            float s = i / float(CURVE_LUT_SIZE - 1);
+            float x = s * s * peak;
+            curveLut[i] = (x > 0.0f ? std::min(curve(x, peak), 1.0f) / x : 1.0f);
+        }
+        curvePeak = peak;
+        curveOp = op;
+    }
+
+    void updateMetadataPeak(const AVFrame* frame) {
+        if (transfer == AVCOL_TRC_ARIB_STD_B67)
+            return;
+        float nits = 0.0f;
+        if (auto* sd = av_frame_get_side_data(frame, AV_FRAME_DATA_CONTENT_LIGHT_LEVEL))
+            nits = static_cast<float>(reinterpret_cast<const AVContentLightMetadata*>(sd->data)->MaxCLL);
+        if (nits <= 0.0f)
+            if (auto* sd = av_frame_get_side_data(frame, AV_FRAME_DATA_MASTERING_DISPLAY_METADATA))
+            {
+                auto* md = reinterpret_cast<const AVMasteringDisplayMetadata*>(sd->data);
+                if (md->has_luminance)
+                    nits = static_cast<float>(av_q2d(md->max_luminance));
+            }
+        if (nits > 0.0f)
+            metadataPeakNits = std::min(nits, PQ_MAX_NITS);
+    }
+
+    // 以行最大亮度的最大值作为帧峰值，平均值(log2)用于检测场景切换
+    void updateDetectedPeak(int rows) {
+        if (!peakDetectionEnabled || rows <= 0)
+            return;
+        float framePeak = 0.0f;
+        float sumLog = 0.0f;
+        for (int i = 0; i < rows; ++i)
+        {
+            framePeak = std::max(framePeak, rowMax[i]);
+            sumLog += std::log2(std::max(rowMax[i], 1e-4f));
+        }
+        float avgLog = sumLog / rows;
+        if (!hasPeakHistory || std::abs(avgLog - lastAvgLog) > SCENE_CHANGE_THRESHOLD)
+            detectedPeak = framePeak;
+        else
+            detectedPeak = detectedPeak * PEAK_SMOOTHING_ALPHA + framePeak * (1.0f - PEAK_SMOOTHING_ALPHA);
+        lastAvgLog = avgLog;
+        hasPeakHistory = true;
+    }
+
+    // 处理两行亮度及其共用的一行色度，返回这两行中最大的线性亮度（参考白的倍数）
+    // 奇数高度的最后一行与自身成对，奇数宽度的最后一列与自身成对，只写入宽度以内的像素
+    // 每次处理CHUNK_CHROMA个色度样本：各阶段的运算以SimdFloat4按4像素并行，阶段之间的查表为逐像素读取，中间结果在栈上
+    float processRowPair(const AVFrame* src, AVFrame* dst, int y, float peak) const {
+        using F4 = SimdFloat4;
+        const int width = src->width;
+        const int chromaWidth = (width + 1) / 2;
+        const int y1 = std::min(y + 1, src->height - 1);
+        const uint16_t* srcY[2] = {
+            reinterpret_cast<const uint16_t*>(src->data[0] + y * src->linesize[0]),
+            reinterpret_cast<const uint16_t*>(src->data[0] + y1 * src->linesize[0])
+        };
+        const uint16_t* srcU = reinterpret_cast<const uint16_t*>(src->data[1] + (y / 2) * src->linesize[1]);
+        const uint16_t* srcV = reinterpret_cast<const uint16_t*>(src->data[2] + (y / 2) * src->linesize[2]);
+        uint8_t* dstY[2] = { dst->data[0] + y * dst->linesize[0], dst->data[0] + y1 * dst->linesize[0] };
+        uint8_t* dstU = dst->data[1] + (y / 2) * dst->linesize[1];
+        uint8_t* dstV = dst->data[2] + (y / 2) * dst->linesize[2];
+
+        const bool isHlg = (transfer == AVCOL_TRC_ARIB_STD_B67);
+        const bool fullRange = (src->color_range == AVCOL_RANGE_JPEG);
+        // 10bit -> [0,1]的归一化系数
+        const float yScale = fullRange ? 1.0f / 1023.0f : 1.0f / 876.0f;
+        const float yOffset = fullRange ? 0.0f : 64.0f;
+        const float cScale = fullRange ? 1.0f / 1023.0f : 1.0f / 896.0f;
+        const float invPeak = 1.0f / peak;
+        F4 maxLum = F4::set1(0.0f);
+
+        constexpr int MAX_PIXELS = CHUNK_CHROMA * 2; // 每行的像素数
+        float cb[CHUNK_CHROMA], cr[CHUNK_CHROMA];
+        float dr[MAX_PIXELS], dg[MAX_PIXELS], db[MAX_PIXELS]; // 按像素展开的色差
+        float luma[2 * MAX_PIXELS];
+        float r[2 * MAX_PIXELS], g[2 * MAX_PIXELS], b[2 * MAX_PIXELS]; // 两行连续存放
+        float gain[2 * MAX_PIXELS];
+        int32_t ir[2 * MAX_PIXELS], ig[2 * MAX_PIXELS], ib[2 * MAX_PIXELS];
+        uint8_t outY[2 * MAX_PIXELS], outU[CHUNK_CHROMA], outV[CHUNK_CHROMA];
+
+        for (int c0 = 0; c0 < chromaWidth; c0 += CHUNK_CHROMA)
+        {
+            const int n = std::min(CHUNK_CHROMA, chromaWidth - c0);
+            const int paddedN = (n + 3) & ~3; // 补齐到4的倍数，补齐部分重复边缘样本，不写回
+            const int pixels = paddedN * 2;
+            const int total = pixels * 2;
+            const int x0 = c0 * 2;
+            loadSamples(srcU, c0, paddedN, chromaWidth, cb);
+            loadSamples(srcV, c0, paddedN, chromaWidth, cr);
+            loadSamples(srcY[0], x0, pixels, width, luma);
+            loadSamples(srcY[1], x0, pixels, width, luma + pixels);
+            // BT.2020 NCL，每个色度样本对应水平相邻的两个像素
+            for (int i = 0; i < paddedN; i += 4)
+            {
+                const F4 u = (F4::load(cb + i) - 512.0f) * cScale;
+                const F4 v = (F4::load(cr + i) - 512.0f) * cScale;
+                const F4 vr = v * 1.4746f;
+                const F4 vg = u * -0.16455f - v * 0.57135f;
+                const F4 vb = u * 1.8814f;
+                F4::duplicateLow(vr).store(dr + i * 2);
+                F4::duplicateHigh(vr).store(dr + i * 2 + 4);
+                F4::duplicateLow(vg).store(dg + i * 2);
+                F4::duplicateHigh(vg).store(dg + i * 2 + 4);
+                F4::duplicateLow(vb).store(db + i * 2);
+                F4::duplicateHigh(vb).store(db + i * 2 + 4);
+            }
+            // 非线性R'G'B' -> 线性光
+            for (int i = 0; i < total; i += 4)
+            {
+                const int k = i < pixels ? i : i - pixels;
+                const F4 l = (F4::load(luma + i) - yOffset) * yScale;
+                lutIndex(F4::clamp(l + F4::load(dr + k), 0.0f, 1.0f), SIGNAL_LUT_SIZE).storeIndex(ir + i);
+                lutIndex(F4::clamp(l + F4::load(dg + k), 0.0f, 1.0f), SIGNAL_LUT_SIZE).storeIndex(ig + i);
+                lutIndex(F4::clamp(l + F4::load(db + k), 0.0f, 1.0f), SIGNAL_LUT_SIZE).storeIndex(ib + i);
+            }
+            lookup(signalToLinear, ir, r, total);
+            lookup(signalToLinear, ig, g, total);
+            lookup(signalToLinear, ib, b, total);
+            if (isHlg) // HLG OOTF，系统伽马1.2
+            {
+                for (int i = 0; i < total; i += 4)
+                {
+                    const F4 ys = F4::load(r + i) * 0.2627f + F4::load(g + i) * 0.6780f + F4::load(b + i) * 0.0593f;
+                    lutIndex(F4::sqrt(F4::clamp(ys, 0.0f, 1.0f)), OOTF_LUT_SIZE).storeIndex(ir + i);
+                }
+                lookup(hlgOotfGain, ir, gain, total);
+                for (int i = 0; i < total; i += 4)
+                {
+                    const F4 k = F4::load(gain + i);
+                    (F4::load(r + i) * k).store(r + i);
+                    (F4::load(g + i) * k).store(g + i);
+                    (F4::load(b + i) * k).store(b + i);
+                }
+            }
+            // 以max(R,G,B)做色调映射，保持色相
+            for (int i = 0; i < total; i += 4)
+            {
+                const F4 m = F4::max(F4::load(r + i), F4::max(F4::load(g + i), F4::load(b + i)));
+                maxLum = F4::max(maxLum, m);
+                lutIndex(F4::sqrt(F4::clamp(m * invPeak, 0.0f, 1.0f)), CURVE_LUT_SIZE).storeIndex(ir + i);
+            }
+            lookup(curveLut, ir, gain, total);
+            // BT.2020 -> BT.709 色域，再转换为BT.709非线性
+            for (int i = 0; i < total; i += 4)
+            {
+                const F4 k = F4::load(gain + i);
+                const F4 vr = F4::load(r + i) * k;
+                const F4 vg = F4::load(g + i) * k;
+                const F4 vb = F4::load(b + i) * k;
+                const F4 r709 = vr * 1.6605f - vg * 0.5876f - vb * 0.0728f;
+                const F4 g709 = vr * -0.1246f + vg * 1.1329f - vb * 0.0083f;
+                const F4 b709 = vr * -0.0182f - vg * 0.1006f + vb * 1.1187f;
+                lutIndex(F4::sqrt(F4::clamp(r709, 0.0f, 1.0f)), OETF_LUT_SIZE).storeIndex(ir + i);
+                lutIndex(F4::sqrt(F4::clamp(g709, 0.0f, 1.0f)), OETF_LUT_SIZE).storeIndex(ig + i);
+                lutIndex(F4::sqrt(F4::clamp(b709, 0.0f, 1.0f)), OETF_LUT_SIZE).storeIndex(ib + i);
+            }
+            lookup(linearToSdr, ir, r, total, 1.0f / 4096.0f);
+            lookup(linearToSdr, ig, g, total, 1.0f / 4096.0f);
+            lookup(linearToSdr, ib, b, total, 1.0f / 4096.0f);
+            for (int i = 0; i < total; i += 4)
+            {
+                const F4 y709 = F4::load(r + i) * 0.2126f + F4::load(g + i) * 0.7152f + F4::load(b + i) * 0.0722f;
+                (F4::set1(16.0f) + y709 * 219.0f + 0.5f).storeU8(outY + i);
+            }
+            // 2x2平均后的色度：两行相加，再把水平相邻的两个像素相加
+            for (int i = 0; i < paddedN; i += 4)
+            {
+                const int p = i * 2;
+                auto average = [p, pixels](const float* c) {
+                    return F4::pairwiseAdd(F4::load(c + p) + F4::load(c + pixels + p), F4::load(c + p + 4) + F4::load(c + pixels + p + 4)) * 0.25f;
+                    };
+                const F4 avgR = average(r);
+                const F4 avgB = average(b);
+                const F4 yAvg = avgR * 0.2126f + average(g) * 0.7152f + avgB * 0.0722f;
+                F4::clamp(F4::set1(128.0f) + (avgB - yAvg) * (224.0f / 1.8556f) + 0.5f, 16.0f, 240.0f).storeU8(outU + i);
+                F4::clamp(F4::set1(128.0f) + (avgR - yAvg) * (224.0f / 1.5748f) + 0.5f, 16.0f, 240.0f).storeU8(outV + i);
+            }
+            const int validPixels = std::min(pixels, width - x0);
+            std::memcpy(dstY[0] + x0, outY, validPixels);
+            std::memcpy(dstY[1] + x0, outY + pixels, validPixels);
+            std::memcpy(dstU + c0, outU, n);
+            std::memcpy(dstV + c0, outV, n);
+        }
+        return maxLum.horizontalMax();
+    }
+
+    // 从第begin个样本起读取count个并转换为float，limit及之后的位置重复最后一个样本
+    static void loadSamples(const uint16_t* row, int begin, int count, int limit, float* out) {
+        int i = 0;
+        for (; i + 4 <= count && begin + i + 4 <= limit; i += 4)
+            SimdFloat4::loadU16(row + begin + i).store(out + i);
+        for (; i < count; ++i)
+            out[i] = row[std::min(begin + i, limit - 1)];
+    }
+    // [0,1]的值对应到查找表的下标（四舍五入），由storeIndex截断为整数
+    static SimdFloat4 lutIndex(SimdFloat4 s, int size) {
+        return s * static_cast<float>(size - 1) + 0.5f;
+    }
+    template<typename T, size_t N>
+    static void lookup(const std::array<T, N>& table, const int32_t* index, float* out, int count, float scale = 1.0f) {
+        for (int i = 0; i < count; ++i)
+            out[i] = table[index[i]] * scale;
+    }
+};
@@ -0,0 +1,335 @@
+#pragma once
+#include "PlayerPredefine.h"
+#include <cmath>
+#include <limits>
+#include <numbers>
+
+// ITU-R BS.1770-4 / EBU R128响度测量：K计权，400ms门限块的综合响度，3s短期响度的响度范围（LRA），过采样真峰值
+// 门限块与短期响度按0.1 LU的直方图累计，内存占用与时长无关，多个曲目的直方图相加即可得到专辑响度
+// 输入为交错float数据，只在扫描线程中使用，不需要线程安全
+class LoudnessMeter : public PlayerTypes {
+public:
+    static constexpr double ABSOLUTE_GATE_LUFS = -70.0;
+    static constexpr double RELATIVE_GATE_LU = -10.0; // 综合响度的相对门限
+    static constexpr double LRA_RELATIVE_GATE_LU = -20.0; // 响度范围的相对门限
+    static constexpr double LRA_LOW_PERCENTILE = 0.10;
+    static constexpr double LRA_HIGH_PERCENTILE = 0.95;
+    static constexpr double HISTOGRAM_STEP_LU = 0.1;
+    static constexpr int HISTOGRAM_BINS = 750; // 覆盖-70 ~ +5 LUFS，更大的值计入最后一格
+    static constexpr int SUBBLOCK_MS = 100; // 门限块的步长，即75%重叠
+    static constexpr int GATING_BLOCK_SUBBLOCKS = 4; // 400ms
+    static constexpr int SHORT_TERM_SUBBLOCKS = 30; // 3s
+    static constexpr int TRUE_PEAK_TAPS_PER_PHASE = 12;
+    static constexpr double SURROUND_WEIGHT = 1.41; // 环绕声道的权重，LFE不计入
+
+    using Histogram = std::vector<uint64_t>;
+
+    struct Result {
+        double integratedLufs{ -std::numeric_limits<double>::infinity() }; // 没有超过门限的块时为负无穷
+        double loudnessRangeLu{ 0.0 };
+        double truePeak{ 0.0 }; // 线性值
+        double samplePeak{ 0.0 };
+        uint64_t frames{ 0 };
+        Histogram blockHistogram; // 门限块直方图，用于合并计算专辑响度
+        bool isValid() const { return std::isfinite(integratedLufs); }
+    };
+
+private:
+    struct Biquad {
+        double b0{ 1.0 }, b1{ 0.0 }, b2{ 0.0 }, a1{ 0.0 }, a2{ 0.0 };
+    };
+
+    int sampleRate{ 0 };
+    int channels{ 0 };
+    std::vector<double> weights;
+    Biquad shelf; // K计权第一级：高频搁架
+    Biquad highPass; // 第二级：RLB高通
+    std::vector<double> filterState; // 每个通道4个状态
+    std::vector<double> channelEnergy; // 当前子块内每个通道的平方和
+
+    uint64_t subblockFrames{ 0 };
+    uint64_t subblockPosition{ 0 };
+    std::vector<double> subblockEnergies; // 最近SHORT_TERM_SUBBLOCKS个子块的加权能量，环形存放
+    uint64_t subblockCount{ 0 };
+    Histogram blockHistogram;
+    Histogram shortTermHistogram;
+
+    int oversampling{ 1 };
+    std::vector<float> peakTaps; // [相位][抽头]
+    std::vector<float> peakHistory; // 每个通道2 * TAPS_PER_PHASE，双倍存放避免取模
+    int historyPosition{ 0 };
+    double truePeak{ 0.0 };
+    double samplePeak{ 0.0 };
+    uint64_t frames{ 0 };
+
+public:
+    LoudnessMeter() = default;
+
+    // 声道数为0时返回false
+    bool prepare(int sampleRate, const AVChannelLayout& layout) {
+        if (sampleRate <= 0 || layout.nb_channels <= 0)
+            return false;
+        this->sampleRate = sampleRate;
+        channels = layout.nb_channels;
+        weights.assign(channels, 1.0);
+        for (int c = 0; c < channels; ++c)
+            weights[c] = channelWeight(av_channel_layout_channel_from_index(&layout, c));
+        designKWeighting();
+        filterState.assign(static_cast<size_t>(channels) * 4, 0.0);
+        channelEnergy.assign(channels, 0.0);
+        subblockFrames = std::max<uint64_t>(static_cast<uint64_t>(sampleRate) * SUBBLOCK_MS / 1000, 1);
+        subblockPosition = 0;
+        subblockEnergies.assign(SHORT_TERM_SUBBLOCKS, 0.0);
+        subblockCount = 0;
+        blockHistogram.assign(HISTOGRAM_BINS, 0);
+        shortTermHistogram.assign(HISTOGRAM_BINS, 0);
+        // 96kHz以下4倍、192kHz以下2倍过采样，满足BS.1770附录2的真峰值精度要求
+        oversampling = sampleRate < 96000 ? 4 : sampleRate < 192000 ? 2 : 1;
+        designTruePeakFilter();
+        peakHistory.assign(static_cast<size_t>(channels) * TRUE_PEAK_TAPS_PER_PHASE * 2, 0.0f);
+        historyPosition = 0;
+        truePeak = 0.0;
+        samplePeak = 0.0;
+        frames = 0;
+        return true;
+    }
+
+    int getSampleRate() const { return sampleRate; }
+    int numberOfChannels() const { return channels; }
+
+    void process(const float* samples, size_t count) {
+        if (!samples || channels <= 0)
+            return;
+        for (size_t f = 0; f < count; ++f)
+        {
+            const float* frame = samples + f * channels;
+            measurePeaks(frame);
+            for (int c = 0; c < channels; ++c)
+            {
+                double* s = filterState.data() + static_cast<size_t>(c) * 4;
+                const double x = frame[c];
+                const double y1 = shelf.b0 * x + s[0];
+                s[0] = shelf.b1 * x - shelf.a1 * y1 + s[1];
+                s[1] = shelf.b2 * x - shelf.a2 * y1;
+                const double y2 = highPass.b0 * y1 + s[2];
+                s[2] = highPass.b1 * y1 - highPass.a1 * y2 + s[3];
+                s[3] = highPass.b2 * y1 - highPass.a2 * y2;
+                channelEnergy[c] += y2 * y2;
+            }
+            if (++subblockPosition == subblockFrames)
+                finishSubblock();
+        }
+        frames += count;
+    }
+
+    Result result() const {
+        Result r;
+        r.integratedLufs = integratedLoudness(blockHistogram);
+        r.loudnessRangeLu = loudnessRange(shortTermHistogram);
+        r.samplePeak = samplePeak;
+        r.truePeak = std::max(truePeak, samplePeak);
+        r.frames = frames;
+        r.blockHistogram = blockHistogram;
+        return r;
+    }
+
+    static double binLoudness(int bin) { return ABSOLUTE_GATE_LUFS + (bin + 0.5) * HISTOGRAM_STEP_LU; }
+    static double loudnessToEnergy(double lufs) { return std::pow(10.0, (lufs + 0.691) / 10.0); }
+    static double energyToLoudness(double energy) { return -0.691 + 10.0 * std::log10(energy); }
+    // 按门限计算综合响度，直方图为空时返回负无穷
+    static double integratedLoudness(const Histogram& histogram) {
+        double gate = 0.0;
+        if (!relativeGate(histogram, RELATIVE_GATE_LU, gate))
+            return -std::numeric_limits<double>::infinity();
+        double energy = 0.0;
+        uint64_t count = 0;
+        for (int b = firstBinAbove(gate); b < static_cast<int>(histogram.size()); ++b)
+        {
+            energy += loudnessToEnergy(binLoudness(b)) * histogram[b];
+            count += histogram[b];
+        }
+        return count ? energyToLoudness(energy / count) : -std::numeric_limits<double>::infinity();
+    }
+    // EBU Tech 3342：相对门限之上短期响度分布的10%到95%分位之差
+    static double loudnessRange(const Histogram& histogram) {
+        double gate = 0.0;
+        if (!relativeGate(histogram, LRA_RELATIVE_GATE_LU, gate))
+            return 0.0;
+        const int first = firstBinAbove(gate);
+        uint64_t total = 0;
+        for (int b = first; b < static_cast<int>(histogram.size()); ++b)
+            total += histogram[b];
+        if (total == 0)
+            return 0.0;
+        const uint64_t lowRank = static_cast<uint64_t>((total - 1) * LRA_LOW_PERCENTILE);
+        const uint64_t highRank = static_cast<uint64_t>((total - 1) * LRA_HIGH_PERCENTILE);
+        double low = 0.0, high = 0.0;
+        uint64_t cumulative = 0;
+        for (int b = first; b < static_cast<int>(histogram.size()); ++b)
+        {
+            if (cumulative <= lowRank && lowRank < cumulative + histogram[b])
+                low = binLoudness(b);
+            if (cumulative <= highRank && highRank < cumulative + histogram[b])
+            {
+                high = binLoudness(b);
+                break;
+            }
+            cumulative += histogram[b];
+        }
+        return std::max(high - low, 0.0);
+    }
+    static void accumulate(Histogram& target, const Histogram& source) {
+        if (target.size() < source.size())
+            target.resize(source.size(), 0);
+        for (size_t b = 0; b < source.size(); ++b)
+            target[b] += source[b];
+    }
+
+private:
+    static double channelWeight(AVChannel channel) {
+        switch (channel)
+        {
+        case AV_CHAN_LOW_FREQUENCY:
+        case AV_CHAN_LOW_FREQUENCY_2:
+            return 0.0;
+        case AV_CHAN_SIDE_LEFT:
+        case AV_CHAN_SIDE_RIGHT:
+        case AV_CHAN_BACK_LEFT:
+        case AV_CHAN_BACK_RIGHT:
+        case AV_CHAN_SURROUND_DIRECT_LEFT:
+        case AV_CHAN_SURROUND_DIRECT_RIGHT:
+            return SURROUND_WEIGHT;
+        default:
+            return 1.0;
+        }
+    }
+
+    // 按采样率重新计算BS.1770中48kHz给出的两级滤波器
+    void designKWeighting() {
+        const double rate = static_cast<double>(sampleRate);
+        {
+            const double f0 = 1681.974450955533;
+            const double gainDb = 3.999843853973347;
+            const double q = 0.7071752369554196;
+            const double k = std::tan(std::numbers::pi * f0 / rate);
+            const double vh = std::pow(10.0, gainDb / 20.0);
+            const double vb = std::pow(vh, 0.4996667741545416);
+            const double a0 = 1.0 + k / q + k * k;
+            shelf.b0 = (vh + vb * k / q + k * k) / a0;
+            shelf.b1 = 2.0 * (k * k - vh) / a0;
+            shelf.b2 = (vh - vb * k / q + k * k) / a0;
+            shelf.a1 = 2.0 * (k * k - 1.0) / a0;
+            shelf.a2 = (1.0 - k / q + k * k) / a0;
+        }
+        {
+            const double f0 = 38.13547087602444;
+            const double q = 0.5003270373238773;
+            const double k = std::tan(std::numbers::pi * f0 / rate);
+            const double a0 = 1.0 + k / q + k * k;
+            highPass.b0 = 1.0;
+            highPass.b1 = -2.0;
+            highPass.b2 = 1.0;
+            highPass.a1 = 2.0 * (k * k - 1.0) / a0;
+            highPass.a2 = (1.0 - k / q + k * k) / a0;
+        }
+    }
+
+    // 加窗sinc插值滤波器，按相位拆分，每个相位归一化为单位直流增益
+    void designTruePeakFilter() {
+        const int length = oversampling * TRUE_PEAK_TAPS_PER_PHASE;
+        peakTaps.assign(length, 0.0f);
+        if (oversampling <= 1)
+            return;
+        std::vector<double> h(length);
+        for (int n = 0; n < length; ++n)
+        {
+            const double t = (n - (length - 1) * 0.5) / oversampling;
+            const double sinc = t == 0.0 ? 1.0 : std::sin(std::numbers::pi * t) / (std::numbers::pi * t);
+            const double window = 0.5 - 0.5 * std::cos(2.0 * std::numbers::pi * (n + 1) / (length + 1));
+            h[n] = sinc * window;
+        }
+        for (int p = 0; p < oversampling; ++p)
+        {
+            double sum = 0.0;
+            for (int k = 0; k < TRUE_PEAK_TAPS_PER_PHASE; ++k)
+                sum += h[static_cast<size_t>(k) * oversampling + p];
+            for (int k = 0; k < TRUE_PEAK_TAPS_PER_PHASE; ++k)
+                peakTaps[static_cast<size_t>(p) * TRUE_PEAK_TAPS_PER_PHASE + k] = static_cast<float>(sum != 0.0 ? h[static_cast<size_t>(k) * oversampling + p] / sum : 0.0);
+        }
+    }
+
+    void measurePeaks(const float* frame) {
+        constexpr int taps = TRUE_PEAK_TAPS_PER_PHASE;
+        historyPosition = historyPosition == 0 ? taps - 1 : historyPosition - 1;
+        for (int c = 0; c < channels; ++c)
+        {
+            const float x = frame[c];
+            samplePeak = std::max(samplePeak, static_cast<double>(std::abs(x)));
+            if (oversampling <= 1)
+                continue;
+            // 最新的样本在historyPosition，向后依次为更早的样本
+            float* history = peakHistory.data() + static_cast<size_t>(c) * taps * 2;
+            history[historyPosition] = x;
+            history[historyPosition + taps] = x;
+            const float* recent = history + historyPosition;
+            for (int p = 0; p < oversampling; ++p)
+            {
+                const float* k = peakTaps.data() + static_cast<size_t>(p) * taps;
+                float y = 0.0f;
+                for (int i = 0; i < taps; ++i)
+                    y += k[i] * recent[i];
+                truePeak = std::max(truePeak, static_cast<double>(std::abs(y)));
+            }
+        }
+    }
+
+    void finishSubblock() {
+        double energy = 0.0;
+        for (int c = 0; c < channels; ++c)
+        {
+            energy += weights[c] * channelEnergy[c];
+            channelEnergy[c] = 0.0;
+        }
+        subblockEnergies[subblockCount % SHORT_TERM_SUBBLOCKS] = energy;
+        ++subblockCount;
+        subblockPosition = 0;
+        if (subblockCount >= GATING_BLOCK_SUBBLOCKS)
+            addToHistogram(blockHistogram, windowEnergy(GATING_BLOCK_SUBBLOCKS));
+        if (subblockCount >= SHORT_TERM_SUBBLOCKS)
+            addToHistogram(shortTermHistogram, windowEnergy(SHORT_TERM_SUBBLOCKS));
+    }
+    // 最近n个子块的均方值
+    double windowEnergy(int n) const {
+        double sum = 0.0;
+        for (int i = 1; i <= n; ++i)
+            sum += subblockEnergies[(subblockCount - i) % SHORT_TERM_SUBBLOCKS];
+        return sum / (static_cast<double>(subblockFrames) * n);
+    }
+    static void addToHistogram(Histogram& histogram, double energy) {
+        if (energy <= 0.0)
+            return;
+        const double lufs = energyToLoudness(energy);
+        if (lufs < ABSOLUTE_GATE_LUFS)
+            return;
+        const int bin = std::min(static_cast<int>((lufs - ABSOLUTE_GATE_LUFS) / HISTOGRAM_STEP_LU), HISTOGRAM_BINS - 1);
+        ++histogram[bin];
+    }
+    // 绝对门限之上所有块的平均响度加上偏移
+    static bool relativeGate(const Histogram& histogram, double offsetLu, double& gate) {
+        double energy = 0.0;
+        uint64_t count = 0;
+        for (int b = 0; b < static_cast<int>(histogram.size()); ++b)
+        {
+            energy += loudnessToEnergy(binLoudness(b)) * histogram[b];
+            count += histogram[b];
+        }
+        if (count == 0)
+            return false;
+        gate = energyToLoudness(energy / count) + offsetLu;
+        return true;
+    }
+    static int firstBinAbove(double lufs) {
+        const int bin = static_cast<int>(std::ceil((lufs - ABSOLUTE_GATE_LUFS) / HISTOGRAM_STEP_LU - 0.5));
+        return std::clamp(bin, 0, HISTOGRAM_BINS);
+    }
+};
@@ -0,0 +1,511 @@
+#pragma once
+#include "PlayerPredefine.h"
+#include "LoudnessMeter.h"
+#include <array>
+#include <cctype>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <pthread.h>
+#include <sys/qos.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// EBU R128响度的后台扫描与缓存
+// 扫描线程为低优先级，不经过输出设备，以解码速度读取文件的音频流并测量，播放列表中的大量文件依次排队，不影响播放
+// 结果按 路径 + 文件大小 + 修改时间 缓存，可持久化到文本文件；同一目录下的音频文件视为一张专辑，专辑响度由各曲目的门限块直方图合并得到
+// 结果监听器在扫描线程中调用
+class LoudnessScanner : public PlayerTypes {
+public:
+    static constexpr size_t DEFAULT_MAX_WORKERS = 2;
+    static constexpr size_t CACHE_SAVE_INTERVAL = 32; // 每完成多少个文件自动保存一次缓存
+    static constexpr const char* CACHE_FILE_HEADER = "LoudnessCache 1";
+    // 视为专辑曲目的扩展名（小写），与播放列表支持的音频格式一致
+    static constexpr std::array<std::string_view, 11> ALBUM_TRACK_EXTENSIONS{ ".mp3", ".wav", ".flac", ".alac", ".apc", ".aac", ".ogg", ".wma", ".m4a", ".opus", ".ape" };
+
+    struct TrackLoudness {
+        std::string path;
+        uint64_t fileSize{ 0 };
+        int64_t modifiedTime{ 0 }; // 文件系统时钟的计数
+        bool valid{ false }; // 没有音频流或解码失败时为false，同样缓存，避免重复扫描
+        double integratedLufs{ 0.0 };
+        double loudnessRangeLu{ 0.0 };
+        double truePeak{ 0.0 }; // 线性值
+        double samplePeak{ 0.0 };
+        double durationSeconds{ 0.0 };
+        LoudnessMeter::Histogram blockHistogram;
+    };
+    struct AlbumLoudness {
+        double integratedLufs{ 0.0 };
+        double truePeak{ 0.0 };
+        size_t tracks{ 0 }; // 参与合并的有效曲目数
+        size_t albumTracks{ 0 }; // 目录中的曲目数
+        bool complete{ false }; // 目录中的曲目均已有结果（包括无效结果），此后专辑响度不再变化
+        bool valid{ false };
+    };
+    using ResultListener = std::function<void(const TrackLoudness&)>;
+
+private:
+    const std::string loggerName{ "LoudnessScanner" };
+    DefinePlayerLoggerSinks(loggerSinks, loggerName);
+    Logger logger{ loggerName, loggerSinks };
+
+    size_t maxWorkers{ DEFAULT_MAX_WORKERS };
+    std::vector<std::thread> workers;
+    Mutex mtxQueue;
+    ConditionVariable cvQueue;
+    std::deque<std::string> queue;
+    std::unordered_set<std::string> queued;
+    size_t activeScans{ 0 };
+    AtomicBool stopping{ false };
+
+    mutable Mutex mtxCache;
+    std::unordered_map<std::string, TrackLoudness> cache;
+    std::string cacheFilePath;
+    size_t unsavedResults{ 0 };
+
+    Mutex mtxListeners;
+    std::map<size_t, ResultListener> listeners;
+    size_t nextListenerId{ 1 };
+
+public:
+    // \param workerCount 扫描线程数，0表示按CPU核数的一半，且不超过DEFAULT_MAX_WORKERS
+    explicit LoudnessScanner(size_t workerCount = 0) {
+        const size_t hardware = std::max<size_t>(std::thread::hardware_concurrency() / 2, 1);
+        maxWorkers = workerCount ? workerCount : std::min(hardware, DEFAULT_MAX_WORKERS);
+    }
+    LoudnessScanner(const LoudnessScanner&) = delete;
+    LoudnessScanner& operator=(const LoudnessScanner&) = delete;
+    ~LoudnessScanner() {
+        stop();
+        saveCache();
+    }
+
+    // 设置并加载持久化缓存文件，已在内存中的结果保留
+    bool setCacheFile(const std::string& path) {
+        {
+            std::unique_lock lock(mtxCache);
+            cacheFilePath = path;
+        }
+        return loadCache();
+    }
+    bool saveCache() {
+        std::unique_lock lock(mtxCache);
+        if (cacheFilePath.empty())
+            return false;
+        const std::string tempPath = cacheFilePath + ".tmp";
+        {
+            std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+            if (!out)
+            {
+                logger.error("Cannot write loudness cache: {}", tempPath);
+                return false;
+            }
+            out.imbue(std::locale::classic());
+            out.precision(17);
+            out << CACHE_FILE_HEADER << '\n';
+            for (const auto& [path, t] : cache)
+            {
+                out << t.fileSize << '\t' << t.modifiedTime << '\t' << (t.valid ? 1 : 0) << '\t'
+                    << t.integratedLufs << '\t' << t.loudnessRangeLu << '\t' << t.truePeak << '\t' << t.samplePeak << '\t' << t.durationSeconds << '\t';
+                // 直方图稀疏存放为 下标:计数,下标:计数
+                bool first = true;
+                for (size_t b = 0; b < t.blockHistogram.size(); ++b)
+                {
+                    if (!t.blockHistogram[b])
+                        continue;
+                    out << (first ? "" : ",") << b << ':' << t.blockHistogram[b];
+                    first = false;
+                }
+                out << '\t' << path << '\n';
+            }
+            if (!out)
+                return false;
+        }
+        std::error_code ec;
+        std::filesystem::rename(tempPath, cacheFilePath, ec);
+        if (ec)
+        {
+            logger.error("Cannot replace loudness cache {}: {}", cacheFilePath, ec.message());
+            return false;
+        }
+        unsavedResults = 0;
+        return true;
+    }
+
+    // 加入扫描队列，已排队的文件忽略，缓存仍然有效的文件在扫描线程中跳过
+    void enqueue(const std::string& path) {
+        enqueue(std::vector<std::string>{ path });
+    }
+    void enqueue(const std::vector<std::string>& paths) {
+        std::unique_lock lock(mtxQueue);
+        for (const auto& path : paths)
+            if (!path.empty() && queued.insert(path).second)
+                queue.push_back(path);
+        startWorkers();
+        cvQueue.notify_all();
+    }
+    // 移到队首，用于即将播放的文件；同一目录中尚未排队的曲目紧随其后，使专辑响度尽快完整
+    void prioritize(const std::string& path) {
+        if (path.empty())
+            return;
+        const std::vector<std::string> siblings = albumTracks(path); // 在锁外列出目录
+        std::unique_lock lock(mtxQueue);
+        auto position = queue.begin();
+        if (!queued.insert(path).second)
+        {
+            auto it = std::find(queue.begin(), queue.end(), path);
+            if (it != queue.end()) // 不在队列中时正在扫描
+            {
+                queue.erase(it);
+                queue.push_front(path);
+                position = std::next(queue.begin());
+            }
+        }
+        else
+        {
+            queue.push_front(path);
+            position = std::next(queue.begin());
+        }
+        for (const auto& sibling : siblings)
+            if (queued.insert(sibling).second)
+                position = std::next(queue.insert(position, sibling));
+        startWorkers();
+        cvQueue.notify_all();
+    }
+    // 清空还未开始的扫描
+    void cancelPending() {
+        std::unique_lock lock(mtxQueue);
+        queue.clear();
+        queued.clear();
+    }
+    size_t pendingCount() {
+        std::unique_lock lock(mtxQueue);
+        return queue.size() + activeScans;
+    }
+    // 停止所有扫描线程，正在扫描的文件被放弃
+    void stop() {
+        {
+            std::unique_lock lock(mtxQueue);
+            stopping.store(true);
+            cvQueue.notify_all();
+        }
+        for (auto& worker : workers)
+            if (worker.joinable())
+                worker.join();
+        workers.clear();
+        std::unique_lock lock(mtxQueue);
+        queue.clear();
+        queued.clear();
+        stopping.store(false);
+    }
+
+    // 缓存中有结果且文件大小与修改时间没有变化时返回true
+    bool lookup(const std::string& path, TrackLoudness& result) const {
+        uint64_t size = 0;
+        int64_t modified = 0;
+        if (!fileSignature(path, size, modified))
+            return false;
+        std::unique_lock lock(mtxCache);
+        auto it = cache.find(path);
+        if (it == cache.end() || it->second.fileSize != size || it->second.modifiedTime != modified)
+            return false;
+        result = it->second;
+        return true;
+    }
+    // 同一目录下已扫描曲目的合并结果，complete为false时结果会随其余曲目的扫描继续变化
+    bool lookupAlbum(const std::string& path, AlbumLoudness& result) const {
+        std::vector<std::string> tracks = albumTracks(path);
+        if (std::find(tracks.begin(), tracks.end(), path) == tracks.end())
+            tracks.push_back(path); // 扩展名不在列表中的文件同样属于所在的专辑
+        LoudnessMeter::Histogram histogram;
+        AlbumLoudness r;
+        r.albumTracks = tracks.size();
+        size_t scanned = 0;
+        std::unique_lock lock(mtxCache);
+        for (const auto& trackPath : tracks)
+        {
+            auto it = cache.find(trackPath);
+            if (it == cache.end())
+                continue;
+            ++scanned;
+            const TrackLoudness& t = it->second;
+            if (!t.valid)
+                continue;
+            LoudnessMeter::accumulate(histogram, t.blockHistogram);
+            r.truePeak = std::max(r.truePeak, t.truePeak);
+            ++r.tracks;
+        }
+        lock.unlock();
+        r.complete = scanned == tracks.size();
+        r.integratedLufs = LoudnessMeter::integratedLoudness(histogram);
+        r.valid = r.tracks > 0 && std::isfinite(r.integratedLufs);
+        result = r; // 无效时同样返回扫描进度
+        return r.valid;
+    }
+
+    // 与path在同一目录中的音频文件（按扩展名判断），按路径排序，包括path本身
+    // 返回的路径沿用path中的目录部分，与播放器使用的路径写法一致，缓存与队列按字符串比较
+    static std::vector<std::string> albumTracks(const std::string& path) {
+        std::vector<std::string> tracks;
+        std::error_code ec;
+        const std::filesystem::path directory = std::filesystem::path(path).parent_path();
+        const std::string prefix = path.substr(0, path.size() - std::filesystem::path(path).filename().string().size());
+        for (std::filesystem::directory_iterator it(directory.empty() ? std::filesystem::path(".") : directory, ec), end; !ec && it != end; it.increment(ec))
+        {
+            if (!it->is_regular_file(ec))
+                continue;
+            std::string extension = it->path().extension().string();
+            std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            if (std::find(ALBUM_TRACK_EXTENSIONS.begin(), ALBUM_TRACK_EXTENSIONS.end(), extension) != ALBUM_TRACK_EXTENSIONS.end())
+                tracks.push_back(prefix + it->path().filename().string());
+        }
+        std::sort(tracks.begin(), tracks.end());
+        return tracks;
+    }
+
+    // 返回的id用于移除；移除时会等待正在执行的回调结束，因此不能在回调中移除
+    size_t addListener(ResultListener listener) {
+        std::unique_lock lock(mtxListeners);
+        listeners.emplace(nextListenerId, std::move(listener));
+        return nextListenerId++;
+    }
+    void removeListener(size_t id) {
+        std::unique_lock lock(mtxListeners);
+        listeners.erase(id);
+    }
+
+    // 同步扫描单个文件，在调用线程中执行
+    bool scanFile(const std::string& path, TrackLoudness& result) {
+        result = TrackLoudness{};
+        result.path = path;
+        if (!fileSignature(path, result.fileSize, result.modifiedTime))
+            return false;
+        UniquePtr<AVFormatContext> formatCtx{ nullptr, constDeleterAVFormatContext };
+        if (!MediaDecodeUtils::openFile(&logger, formatCtx, path) || !MediaDecodeUtils::findStreamInfo(&logger, formatCtx.get()))
+            return true; // 无法打开的文件也缓存为无效结果
+        const int streamIndex = av_find_best_stream(formatCtx.get(), AVMEDIA_TYPE_AUDIO, -1, -1, nullptr, 0);
+        if (streamIndex < 0)
+            return true;
+        // 只读取音频流的包，减少视频文件的解复用开销
+        for (unsigned int i = 0; i < formatCtx->nb_streams; ++i)
+            if (static_cast<int>(i) != streamIndex)
+                formatCtx->streams[i]->discard = AVDISCARD_ALL;
+        UniquePtr<AVCodecContext> codecCtx{ nullptr, constDeleterAVCodecContext };
+        if (!MediaDecodeUtils::findAndOpenAudioDecoder(&logger, formatCtx.get(), streamIndex, codecCtx))
+            return true;
+        LoudnessMeter meter;
+        if (!meter.prepare(codecCtx->sample_rate, codecCtx->ch_layout))
+            return true;
+
+        UniquePtr<SwrContext> swrCtx{ nullptr, [](auto* s) { if (s) swr_free(&s); } };
+        AVChannelLayout swrInputLayout{};
+        int swrInputFormat = -1;
+        int swrInputRate = 0;
+        std::vector<float> converted;
+        bool failed = false;
+        // 统一转换为与测量器一致的交错float，采样率或布局中途变化时重建转换器
+        auto measureFrame = [&](const AVFrame* frame) {
+            if (frame->nb_samples <= 0)
+                return;
+            if (frame->format == AV_SAMPLE_FMT_FLT && frame->sample_rate == meter.getSampleRate() && frame->ch_layout.nb_channels == meter.numberOfChannels())
+            {
+                meter.process(reinterpret_cast<const float*>(frame->data[0]), frame->nb_samples);
+                return;
+            }
+            if (!swrCtx || frame->format != swrInputFormat || frame->sample_rate != swrInputRate || av_channel_layout_compare(&frame->ch_layout, &swrInputLayout) != 0)
+            {
+                SwrContext* swr = nullptr;
+                if (swr_alloc_set_opts2(&swr, &codecCtx->ch_layout, AV_SAMPLE_FMT_FLT, meter.getSampleRate(),
+                    &frame->ch_layout, static_cast<AVSampleFormat>(frame->format), frame->sample_rate, 0, nullptr) < 0 || swr_init(swr) < 0)
+                {
+                    swr_free(&swr);
+                    failed = true;
+                    return;
+                }
+                swrCtx.reset(swr);
+                av_channel_layout_uninit(&swrInputLayout);
+                av_channel_layout_copy(&swrInputLayout, &frame->ch_layout);
+                swrInputFormat = frame->format;
+                swrInputRate = frame->sample_rate;
+            }
+            const int maxOut = swr_get_out_samples(swrCtx.get(), frame->nb_samples);
+            if (maxOut <= 0)
+                return;
+            converted.resize(static_cast<size_t>(maxOut) * meter.numberOfChannels());
+            uint8_t* out = reinterpret_cast<uint8_t*>(converted.data());
+            const int n = swr_convert(swrCtx.get(), &out, maxOut, frame->extended_data, frame->nb_samples);
+            if (n > 0)
+                meter.process(converted.data(), n);
+            };
+        UniquePtr<AVFrame> frame = makeUniqueFrame();
+        auto receiveFrames = [&]() {
+            while (!failed && avcodec_receive_frame(codecCtx.get(), frame.get()) >= 0)
+            {
+                measureFrame(frame.get());
+                av_frame_unref(frame.get());
+            }
+            };
+        AVPacket* pkt = nullptr;
+        while (!stopping.load() && !failed && MediaDecodeUtils::readFrame(&logger, formatCtx.get(), pkt, true))
+        {
+            if (pkt->stream_index == streamIndex && avcodec_send_packet(codecCtx.get(), pkt) >= 0)
+                receiveFrames();
+            av_packet_free(&pkt);
+        }
+        av_channel_layout_uninit(&swrInputLayout);
+        if (stopping.load())
+            return false;
+        avcodec_send_packet(codecCtx.get(), nullptr); // 取出解码器中剩余的帧
+        receiveFrames();
+
+        LoudnessMeter::Result measured = meter.result();
+        result.valid = !failed && measured.isValid();
+        result.integratedLufs = result.valid ? measured.integratedLufs : 0.0;
+        result.loudnessRangeLu = measured.loudnessRangeLu;
+        result.truePeak = measured.truePeak;
+        result.samplePeak = measured.samplePeak;
+        result.durationSeconds = static_cast<double>(measured.frames) / meter.getSampleRate();
+        result.blockHistogram = std::move(measured.blockHistogram);
+        return true;
+    }
+
+private:
+    static bool fileSignature(const std::string& path, uint64_t& size, int64_t& modified) {
+        std::error_code ec;
+        const std::filesystem::path p(path);
+        size = std::filesystem::file_size(p, ec);
+        if (ec)
+            return false;
+        auto time = std::filesystem::last_write_time(p, ec);
+        if (ec)
+            return false;
+        modified = static_cast<int64_t>(time.time_since_epoch().count());
+        return true;
+    }
+
+    // 调用时需持有mtxQueue
+    void startWorkers() {
+        while (workers.size() < maxWorkers && workers.size() < queue.size() + activeScans)
+            workers.emplace_back(&LoudnessScanner::workerLoop, this);
+    }
+
+    static void lowerCurrentThreadPriority() {
+#ifdef _WIN32
+        SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_LOWEST);
+#elif defined(__APPLE__)
+        pthread_set_qos_class_self_np(QOS_CLASS_BACKGROUND, 0);
+#else
+        setpriority(PRIO_PROCESS, 0, 19); // Linux下nice值是线程属性，只影响当前线程
+#endif
+    }
+
+    void workerLoop() {
+        lowerCurrentThreadPriority();
+        while (true)
+        {
+            std::string path;
+            {
+                std::unique_lock lock(mtxQueue);
+                cvQueue.wait(lock, [this] { return stopping.load() || !queue.empty(); });
+                if (stopping.load())
+                    return;
+                path = std::move(queue.front());
+                queue.pop_front();
+                ++activeScans;
+            }
+            TrackLoudness result;
+            bool scanned = false;
+            if (!lookup(path, result))
+            {
+                auto begin = std::chrono::steady_clock::now();
+                scanned = scanFile(path, result);
+                if (scanned)
+                    logger.trace("Loudness scanned in {} ms: {} LUFS, LRA {} LU, true peak {}, {}", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count(),
+                        result.integratedLufs, result.loudnessRangeLu, result.truePeak, path);
+            }
+            if (scanned)
+                storeResult(result);
+            {
+                std::unique_lock lock(mtxQueue);
+                queued.erase(path);
+                --activeScans;
+            }
+            if (scanned)
+            {
+                std::unique_lock lock(mtxListeners);
+                for (auto& [id, listener] : listeners)
+                    listener(result);
+            }
+        }
+    }
+
+    void storeResult(const TrackLoudness& result) {
+        bool save = false;
+        {
+            std::unique_lock lock(mtxCache);
+            cache[result.path] = result;
+            save = !cacheFilePath.empty() && ++unsavedResults >= CACHE_SAVE_INTERVAL;
+        }
+        if (save)
+            saveCache();
+    }
+
+    bool loadCache() {
+        std::unique_lock lock(mtxCache);
+        std::ifstream in(cacheFilePath, std::ios::binary);
+        if (!in)
+            return false;
+        in.imbue(std::locale::classic());
+        std::string line;
+        if (!std::getline(in, line) || line != CACHE_FILE_HEADER)
+        {
+            logger.warning("Unknown loudness cache format: {}", cacheFilePath);
+            return false;
+        }
+        size_t loaded = 0;
+        while (std::getline(in, line))
+        {
+            std::istringstream fields(line);
+            fields.imbue(std::locale::classic());
+            TrackLoudness t;
+            int valid = 0;
+            std::string histogram;
+            fields >> t.fileSize >> t.modifiedTime >> valid >> t.integratedLufs >> t.loudnessRangeLu >> t.truePeak >> t.samplePeak >> t.durationSeconds;
+            if (!fields || fields.get() != '\t' || !std::getline(fields, histogram, '\t') || !std::getline(fields, t.path) || t.path.empty())
+                continue;
+            t.valid = valid != 0;
+            t.blockHistogram.assign(LoudnessMeter::HISTOGRAM_BINS, 0);
+            std::istringstream bins(histogram);
+            size_t bin = 0;
+            uint64_t count = 0;
+            char colon = 0;
+            while (bins >> bin >> colon >> count)
+            {
+                if (colon == ':' && bin < t.blockHistogram.size())
+                    t.blockHistogram[bin] = count;
+                if (bins.peek() == ',')
+                    bins.get();
+            }
+            cache[t.path] = std::move(t);
+            ++loaded;
+        }
+        logger.info("Loaded {} loudness cache entries from {}", loaded, cacheFilePath);
+        return true;
+    }
+};
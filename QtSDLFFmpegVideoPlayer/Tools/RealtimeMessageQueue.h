@@ -0,0 +1,63 @@
+#pragma once
+#include "PlayerPredefine.h"
+#include <array>
+
+// 实时线程发往普通线程的单生产者单消费者消息队列，固定容量的槽位预先构造，收发都是原地读写
+// 生产者用beginPush取得空闲槽位、填写后commitPush，队列满时丢弃消息并计数，从不等待、不分配内存
+// 槽位内的缓冲区（如vector）可在开始收发前通过forEachSlot预先分配，之后只复用
+template<typename T, size_t Capacity>
+class RealtimeMessageQueue : public PlayerTypes {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+    static constexpr uint64_t MASK = Capacity - 1;
+
+    std::array<T, Capacity> slots{};
+    alignas(64) Atomic<uint64_t> head{ 0 }; // 只由生产者修改
+    alignas(64) Atomic<uint64_t> tail{ 0 }; // 只由消费者修改
+    Atomic<uint64_t> dropped{ 0 };
+
+public:
+    RealtimeMessageQueue() = default;
+    RealtimeMessageQueue(const RealtimeMessageQueue&) = delete;
+    RealtimeMessageQueue& operator=(const RealtimeMessageQueue&) = delete;
+
+    // 遍历所有槽位，用于预先分配，不能与收发并发
+    template<typename Func>
+    void forEachSlot(Func&& func) {
+        for (auto& slot : slots)
+            func(slot);
+    }
+
+    // 生产者：返回可写入的槽位，队列已满时返回nullptr
+    T* beginPush() {
+        const uint64_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) >= Capacity)
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        return &slots[h & MASK];
+    }
+    // 生产者：发布beginPush返回的槽位
+    void commitPush() {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // 消费者：返回最早的消息，队列为空时返回nullptr，处理完后调用pop
+    T* front() {
+        const uint64_t t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire))
+            return nullptr;
+        return &slots[t & MASK];
+    }
+    void pop() {
+        tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+    // 消费者：丢弃所有未处理的消息
+    void clear() {
+        tail.store(head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    size_t size() const { return static_cast<size_t>(head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire)); }
+    static constexpr size_t capacity() { return Capacity; }
+    uint64_t droppedCount() const { return dropped.load(std::memory_order_relaxed); }
+};
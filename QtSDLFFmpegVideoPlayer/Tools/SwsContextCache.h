@@ -0,0 +1,205 @@
+#pragma once
+#include "PlayerPredefine.h"
+
+// 全局共享的SwsContext LRU缓存，VideoPlayer/VideoFrameProcessor/预览缩略图共用
+// SwsContext不是线程安全的，acquire取得的swsCtx在使用期间由调用者独占，
+// 多个线程以相同的参数acquire时会各自得到不同的swsCtx，返回的SharedPtr析构时swsCtx归还缓存
+// 缓存本身由静态的SharedPtr持有，程序退出后才归还的swsCtx直接释放
+class SwsContextCache : public PlayerTypes, public std::enable_shared_from_this<SwsContextCache> {
+public:
+    static constexpr size_t DEFAULT_CAPACITY = 16; // 最多缓存的空闲swsCtx数量
+    static constexpr size_t DEFAULT_THREADED_CAPACITY = 2; // 其中多线程（threadCount不为1）的最多数量，空闲时其切片线程仍然存在
+
+    // 源的色彩空间与范围决定转换系数，创建时按它们设置（见VideoPlayer::createSwsContext），未指定时使用像素格式的默认值
+    struct Key {
+        SizeI srcSize;
+        AVPixelFormat srcFormat{ AV_PIX_FMT_NONE };
+        SizeI dstSize;
+        AVPixelFormat dstFormat{ AV_PIX_FMT_NONE };
+        int flags{ 0 };
+        int threadCount{ 0 };
+        AVColorSpace srcColorSpace{ AVCOL_SPC_UNSPECIFIED };
+        AVColorRange srcColorRange{ AVCOL_RANGE_UNSPECIFIED };
+
+        bool isThreaded() const { return threadCount != 1; } // 0为自动选择线程数
+        bool operator==(const Key& other) const {
+            return srcSize == other.srcSize && srcFormat == other.srcFormat
+                && dstSize == other.dstSize && dstFormat == other.dstFormat
+                && flags == other.flags && threadCount == other.threadCount
+                && srcColorSpace == other.srcColorSpace && srcColorRange == other.srcColorRange;
+        }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            size_t h = 0;
+            auto combine = [&h](uint64_t v) { h ^= std::hash<uint64_t>{}(v) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2); };
+            combine((static_cast<uint64_t>(key.srcSize.width()) << 32) | static_cast<uint32_t>(key.srcSize.height()));
+            combine((static_cast<uint64_t>(key.dstSize.width()) << 32) | static_cast<uint32_t>(key.dstSize.height()));
+            combine((static_cast<uint64_t>(key.srcFormat) << 32) | static_cast<uint32_t>(key.dstFormat));
+            combine((static_cast<uint64_t>(key.flags) << 32) | static_cast<uint32_t>(key.threadCount));
+            combine((static_cast<uint64_t>(key.srcColorSpace) << 32) | static_cast<uint32_t>(key.srcColorRange));
+            return h;
+        }
+    };
+    struct Statistics {
+        uint64_t hits{ 0 };
+        uint64_t misses{ 0 };
+        uint64_t evictions{ 0 };
+        size_t idleCount{ 0 }; // 缓存中空闲的swsCtx数量
+        size_t inUseCount{ 0 }; // 已借出的swsCtx数量
+    };
+    using SwsContextCreator = std::function<SwsContext* ()>;
+
+private:
+    struct Entry {
+        Key key;
+        SwsContext* ctx{ nullptr };
+    };
+    mutable Mutex mtx;
+    size_t capacity{ DEFAULT_CAPACITY };
+    size_t threadedCapacity{ DEFAULT_THREADED_CAPACITY };
+    size_t threadedIdleCount{ 0 };
+    std::list<Entry> lruList; // 空闲的swsCtx，头部为最近使用
+    std::unordered_multimap<Key, std::list<Entry>::iterator, KeyHash> idleEntries;
+    Statistics stats;
+
+    SwsContextCache() = default;
+
+public:
+    SwsContextCache(const SwsContextCache&) = delete;
+    SwsContextCache& operator=(const SwsContextCache&) = delete;
+    ~SwsContextCache() {
+        clear();
+    }
+
+    static SwsContextCache& instance() {
+        static SharedPtr<SwsContextCache> cache{ new SwsContextCache() };
+        return *cache;
+    }
+
+    // 取出一个与key匹配的空闲swsCtx，没有则调用creator创建
+    // \param creator 缓存未命中时用于创建swsCtx，返回nullptr表示创建失败
+    SharedPtr<SwsContext> acquire(const Key& key, const SwsContextCreator& creator) {
+        SwsContext* ctx = nullptr;
+        {
+            std::lock_guard lock(mtx);
+            auto it = idleEntries.find(key);
+            if (it != idleEntries.end())
+            {
+                ctx = it->second->ctx;
+                if (key.isThreaded())
+                    --threadedIdleCount;
+                lruList.erase(it->second);
+                idleEntries.erase(it);
+                ++stats.hits;
+            }
+            else
+                ++stats.misses;
+        }
+        if (!ctx && creator) // 在锁外创建，sws初始化耗时较长
+            ctx = creator();
+        if (!ctx)
+            return nullptr;
+        {
+            std::lock_guard lock(mtx);
+            ++stats.inUseCount;
+        }
+        return SharedPtr<SwsContext>{ ctx, [owner = weak_from_this(), key](SwsContext* p) {
+            if (auto cache = owner.lock())
+                cache->release(key, p);
+            else
+                sws_freeContext(p); // 缓存已随程序退出析构
+            } };
+    }
+
+    void setCapacity(size_t cap) {
+        std::lock_guard lock(mtx);
+        capacity = cap;
+        evictOverflow();
+    }
+    size_t getCapacity() const {
+        std::lock_guard lock(mtx);
+        return capacity;
+    }
+    // 多线程swsCtx的空闲上限，计入总容量
+    void setThreadedCapacity(size_t cap) {
+        std::lock_guard lock(mtx);
+        threadedCapacity = cap;
+        evictOverflow();
+    }
+    size_t getThreadedCapacity() const {
+        std::lock_guard lock(mtx);
+        return threadedCapacity;
+    }
+
+    Statistics statistics() const {
+        std::lock_guard lock(mtx);
+        Statistics s = stats;
+        s.idleCount = lruList.size();
+        return s;
+    }
+    void resetStatistics() {
+        std::lock_guard lock(mtx);
+        stats.hits = 0;
+        stats.misses = 0;
+        stats.evictions = 0;
+    }
+
+    // 释放所有空闲的swsCtx，已借出的swsCtx在归还时按容量处理
+    void clear() {
+        std::lock_guard lock(mtx);
+        for (auto& entry : lruList)
+            sws_freeContext(entry.ctx);
+        lruList.clear();
+        idleEntries.clear();
+        threadedIdleCount = 0;
+    }
+
+private:
+    void release(const Key& key, SwsContext* ctx) {
+        if (!ctx)
+            return;
+        std::lock_guard lock(mtx);
+        --stats.inUseCount;
+        if (capacity == 0 || (key.isThreaded() && threadedCapacity == 0))
+        {
+            sws_freeContext(ctx);
+            return;
+        }
+        lruList.push_front(Entry{ key, ctx });
+        idleEntries.emplace(key, lruList.begin());
+        if (key.isThreaded())
+            ++threadedIdleCount;
+        evictOverflow();
+    }
+
+    // 需要持有锁
+    void evictOverflow() {
+        while (lruList.size() > capacity)
+            evict(std::prev(lruList.end()));
+        // 多线程的超出上限时淘汰其中最久未使用的
+        for (auto it = lruList.end(); threadedIdleCount > threadedCapacity && it != lruList.begin();)
+        {
+            --it;
+            if (it->key.isThreaded())
+                it = evict(it);
+        }
+    }
+    // 需要持有锁，返回被淘汰项的下一项
+    std::list<Entry>::iterator evict(std::list<Entry>::iterator entry) {
+        auto range = idleEntries.equal_range(entry->key);
+        for (auto it = range.first; it != range.second; ++it)
+        {
+            if (it->second == entry)
+            {
+                idleEntries.erase(it);
+                break;
+            }
+        }
+        if (entry->key.isThreaded())
+            --threadedIdleCount;
+        sws_freeContext(entry->ctx);
+        ++stats.evictions;
+        return lruList.erase(entry);
+    }
+};
@@ -0,0 +1,82 @@
+#pragma once
+#include "VideoPlayer.h"
+
+// sws图像格式转换/缩放吞吐量测试，用于按分辨率和像素格式选择合适的sws线程数
+class SwsScaleBenchmark : public PlayerTypes {
+public:
+    struct ScaleCase {
+        SizeI srcSize;
+        AVPixelFormat srcFormat{ AV_PIX_FMT_NONE };
+        SizeI dstSize;
+        AVPixelFormat dstFormat{ AV_PIX_FMT_NONE };
+    };
+    struct ScaleResult {
+        ScaleCase scaleCase;
+        int threadCount{ 0 };
+        int iterations{ 0 };
+        double averageMs{ 0.0 }; // 单帧平均耗时，单位：毫秒
+        double minMs{ 0.0 }; // 单帧最小耗时，单位：毫秒
+        double framesPerSecond{ 0.0 };
+    };
+
+    static std::vector<ScaleCase> defaultCases() {
+        return {
+            { SizeI{ 3840, 2160 }, AV_PIX_FMT_YUV420P, SizeI{ 1920, 1080 }, AV_PIX_FMT_YUV420P },
+            { SizeI{ 3840, 2160 }, AV_PIX_FMT_NV12, SizeI{ 1920, 1080 }, AV_PIX_FMT_YUV420P },
+            { SizeI{ 3840, 2160 }, AV_PIX_FMT_P010LE, SizeI{ 1920, 1080 }, AV_PIX_FMT_YUV420P },
+            { SizeI{ 1920, 1080 }, AV_PIX_FMT_YUV420P, SizeI{ 1280, 720 }, AV_PIX_FMT_YUV420P },
+            { SizeI{ 1920, 1080 }, AV_PIX_FMT_NV12, SizeI{ 1920, 1080 }, AV_PIX_FMT_YUV420P },
+            { SizeI{ 1920, 1080 }, AV_PIX_FMT_YUV420P, SizeI{ 1920, 1080 }, AV_PIX_FMT_RGB24 },
+        };
+    }
+
+    // 对每个用例分别以threadCounts中的线程数执行iterations次转换，结果同时输出到logger
+    static std::vector<ScaleResult> run(const std::vector<ScaleCase>& cases, const std::vector<int>& threadCounts, int iterations = 100, Logger* logger = nullptr) {
+        std::vector<ScaleResult> results;
+        if (iterations <= 0)
+            return results;
+        for (const auto& scaleCase : cases)
+        {
+            SharedPtr<AVFrame> srcFrame{ makeSharedFrame() };
+            srcFrame->width = scaleCase.srcSize.width();
+            srcFrame->height = scaleCase.srcSize.height();
+            srcFrame->format = scaleCase.srcFormat;
+            if (av_frame_get_buffer(srcFrame.get(), 0) < 0)
+            {
+                if (logger) logger->error("Benchmark: could not allocate source frame {}x{} {}", srcFrame->width, srcFrame->height, av_get_pix_fmt_name(scaleCase.srcFormat));
+                continue;
+            }
+            ptrdiff_t linesizes[4]{ srcFrame->linesize[0], srcFrame->linesize[1], srcFrame->linesize[2], srcFrame->linesize[3] };
+            av_image_fill_black(srcFrame->data, linesizes, scaleCase.srcFormat, AVCOL_RANGE_MPEG, srcFrame->width, srcFrame->height);
+            for (int threadCount : threadCounts)
+            {
+                SharedPtr<AVFrame> dstFrame{ makeSharedFrame() };
+                dstFrame->width = scaleCase.dstSize.width();
+                dstFrame->height = scaleCase.dstSize.height();
+                dstFrame->format = scaleCase.dstFormat;
+                auto swsCtx = VideoPlayer::createSwsContext(dstFrame.get(), scaleCase.srcFormat, scaleCase.srcSize, logger, threadCount);
+                if (!swsCtx)
+                    continue;
+                VideoPlayer::swsScaleFrame(swsCtx.get(), srcFrame.get(), dstFrame.get(), logger); // 预热
+                double totalMs = 0.0;
+                double minMs = std::numeric_limits<double>::max();
+                for (int i = 0; i < iterations; ++i)
+                {
+                    auto begin = std::chrono::steady_clock::now();
+                    VideoPlayer::swsScaleFrame(swsCtx.get(), srcFrame.get(), dstFrame.get(), logger);
+                    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+                    totalMs += ms;
+                    minMs = std::min(minMs, ms);
+                }
+                ScaleResult result{ scaleCase, threadCount, iterations, totalMs / iterations, minMs, 0.0 };
+                result.framesPerSecond = (result.averageMs > 0.0 ? 1000.0 / result.averageMs : 0.0);
+                if (logger) logger->info("Benchmark: {}x{} {} -> {}x{} {}, threads: {}, avg: {} ms, min: {} ms, {} fps",
+                    scaleCase.srcSize.width(), scaleCase.srcSize.height(), av_get_pix_fmt_name(scaleCase.srcFormat),
+                    scaleCase.dstSize.width(), scaleCase.dstSize.height(), av_get_pix_fmt_name(scaleCase.dstFormat),
+                    threadCount, result.averageMs, result.minMs, result.framesPerSecond);
+                results.push_back(result);
+            }
+        }
+        return results;
+    }
+};
@@ -0,0 +1,276 @@
+#pragma once
+#include "PlayerPredefine.h"
+
+// 视频去隔行处理，位于解码与渲染之间，使用bwdif/yadif滤镜（切片多线程）
+// Auto模式下遇到带AV_FRAME_FLAG_INTERLACED标志的帧时自动启用，场序由帧标志决定，连续一段时间都是逐行帧后自动旁路
+// 输出帧的pts已换算回输入的时间基，场率输出时一帧隔行帧对应两帧输出（50i->50p）
+// 只接受软件帧，硬件帧需调用者先下载到内存
+class VideoDeinterlacer : public PlayerTypes {
+public:
+    using Algorithm = FFmpegFrameVideoDeinterlaceFilter::Algorithm;
+    enum class Mode {
+        Disabled = 0, // 不去隔行
+        Auto, // 按帧的隔行标志自动启用
+        Always, // 所有帧都当作隔行帧处理
+    };
+    static constexpr int PROGRESSIVE_FRAMES_BEFORE_BYPASS = 120; // Auto模式下连续n个逐行帧后关闭滤镜图
+    static constexpr int DEFAULT_THREAD_COUNT = 0; // 滤镜图切片线程数，0表示自动（按CPU核心数）
+    static constexpr uint64_t STATISTICS_LOG_INTERVAL = 500; // 每输入n帧输出一次耗时统计
+
+    struct Statistics {
+        bool active{ false }; // 滤镜图是否在工作
+        bool failed{ false }; // 滤镜图创建失败，修改设置后重试
+        Algorithm algorithm{ Algorithm::Bwdif };
+        bool fieldRateOutput{ false };
+        int threadCount{ 0 };
+        uint64_t framesIn{ 0 };
+        uint64_t framesOut{ 0 };
+        double lastMs{ 0.0 }; // 最近一帧的耗时，单位：毫秒
+        double averageMs{ 0.0 }; // 每输入帧平均耗时，单位：毫秒
+        double maxMs{ 0.0 };
+        double totalMs{ 0.0 };
+    };
+
+private:
+    Logger& logger;
+    Atomic<Mode> mode{ Mode::Auto };
+    Atomic<Algorithm> algorithm{ Algorithm::Bwdif };
+    AtomicBool fieldRateOutput{ true };
+    AtomicInt threadCount{ DEFAULT_THREAD_COUNT };
+    AtomicBool failed{ false }; // 滤镜图创建失败后不再逐帧重试，直到设置改变；不改动用户设置的mode
+
+    // 以下成员只在处理线程中访问
+    UniquePtr<AVFilterGraph> filterGraph{ nullptr, constDeleterAVFilterGraph };
+    SharedPtr<FFmpegFrameVideoDeinterlaceFilter> deinterlaceFilter{ nullptr };
+    AVFilterContext* srcFilterCtx{ nullptr }; // 内存交由滤镜图管理
+    AVFilterContext* sinkFilterCtx{ nullptr }; // 内存交由滤镜图管理
+    struct GraphParams {
+        int width{ 0 };
+        int height{ 0 };
+        AVPixelFormat format{ AV_PIX_FMT_NONE };
+        AVRational timeBase{ 0, 1 };
+        Mode mode{ Mode::Disabled };
+        Algorithm algorithm{ Algorithm::Bwdif };
+        bool fieldRateOutput{ false };
+        int threadCount{ 0 };
+        bool operator==(const GraphParams& o) const {
+            return width == o.width && height == o.height && format == o.format && av_cmp_q(timeBase, o.timeBase) == 0
+                && mode == o.mode && algorithm == o.algorithm && fieldRateOutput == o.fieldRateOutput && threadCount == o.threadCount;
+        }
+    } graphParams;
+    int progressiveFrameCount{ 0 };
+
+    mutable Mutex statsMtx;
+    Statistics stats;
+
+public:
+    VideoDeinterlacer(Logger& logger) : logger(logger) {}
+
+    void setMode(Mode m) { mode.store(m); failed.store(false); }
+    Mode getMode() const { return mode.load(); }
+    void setAlgorithm(Algorithm a) { algorithm.store(a); failed.store(false); }
+    Algorithm getAlgorithm() const { return algorithm.load(); }
+    // true: 每场输出一帧（50i->50p），false: 每帧输出一帧（50i->25p）
+    void setFieldRateOutput(bool b) { fieldRateOutput.store(b); failed.store(false); }
+    bool getFieldRateOutput() const { return fieldRateOutput.load(); }
+    // 0表示自动，1表示单线程，下次重建滤镜图时生效
+    void setThreadCount(int count) { threadCount.store(std::max(count, 0)); failed.store(false); }
+    int getThreadCount() const { return threadCount.load(); }
+    bool isFailed() const { return failed.load(); }
+    // 丢弃滤镜图及其中缓存的帧（seek后调用），只能在处理线程中调用
+    // 调用者需同时丢弃已由process输出但尚未显示的帧
+    void reset() {
+        destroyGraph();
+        progressiveFrameCount = 0;
+    }
+
+    Statistics statistics() const {
+        std::lock_guard lock(statsMtx);
+        Statistics s = stats;
+        s.failed = failed.load();
+        return s;
+    }
+    void resetStatistics() {
+        std::lock_guard lock(statsMtx);
+        Statistics s;
+        s.active = stats.active;
+        s.algorithm = stats.algorithm;
+        s.fieldRateOutput = stats.fieldRateOutput;
+        s.threadCount = stats.threadCount;
+        stats = s;
+    }
+
+    // 判断该帧是否需要进入去隔行滤镜图，调用者可据此决定是否需要先将硬件帧下载到内存
+    bool wants(const AVFrame* frame) const {
+        if (!frame) return false;
+        Mode m = mode.load();
+        if (m == Mode::Disabled || failed.load()) return false;
+        if (m == Mode::Always || filterGraph) return true;
+        return frame->flags & AV_FRAME_FLAG_INTERLACED;
+    }
+
+    // \param frame 软件帧
+    // \param timeBase frame->pts的时间基
+    // \param outFrames 输出帧追加到末尾，可能为空（滤镜需要后一帧作参考）
+    // \return false表示未处理，调用者应直接使用原帧；true表示帧已由去隔行处理，结果在outFrames中
+    bool process(AVFrame* frame, AVRational timeBase, std::deque<SharedPtr<AVFrame>>& outFrames) {
+        if (!frame || frame->hw_frames_ctx)
+            return false;
+        Mode m = mode.load();
+        if (m == Mode::Disabled || failed.load())
+        {
+            if (filterGraph)
+                destroyGraph();
+            return false;
+        }
+        bool interlaced = frame->flags & AV_FRAME_FLAG_INTERLACED;
+        if (m == Mode::Auto)
+        {
+            progressiveFrameCount = (interlaced ? 0 : progressiveFrameCount + 1);
+            if (!filterGraph && !interlaced)
+                return false;
+            if (filterGraph && progressiveFrameCount >= PROGRESSIVE_FRAMES_BEFORE_BYPASS)
+            {
+                // 先取出滤镜图中缓存的帧，保证帧序连续
+                logger.info("Deinterlace: {} progressive frames in a row, bypassing", progressiveFrameCount);
+                flushGraph(outFrames);
+                destroyGraph();
+                SharedPtr<AVFrame> ref{ makeSharedFrame() };
+                if (av_frame_ref(ref.get(), frame) < 0)
+                    return false;
+                outFrames.push_back(ref);
+                return true;
+            }
+        }
+        GraphParams params{ frame->width, frame->height, static_cast<AVPixelFormat>(frame->format), timeBase,
+            m, algorithm.load(), fieldRateOutput.load(), threadCount.load() };
+        if (!filterGraph || !(params == graphParams))
+        {
+            if (filterGraph)
+                flushGraph(outFrames);
+            if (!createGraph(frame, params))
+            {
+                destroyGraph();
+                failed.store(true); // 避免每帧重试
+                logger.error("Deinterlace: failed to create the {} filter graph, deinterlacing paused until the settings change", IFrameFilter::getFilterNameByType(deinterlaceFilterType(params.algorithm)));
+                return false;
+            }
+        }
+        auto begin = std::chrono::steady_clock::now();
+        if (!IFFmpegFrameFilter::addFrameWithFlags(srcFilterCtx, frame, IFrameFilter::SrcFlagKeepReference))
+        {
+            logger.error("Deinterlace: error adding frame to the filter graph");
+            destroyGraph();
+            return false;
+        }
+        uint64_t outCount = drainGraph(outFrames);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+        updateStatistics(ms, outCount);
+        return true;
+    }
+
+private:
+    static IFrameFilter::FilterType deinterlaceFilterType(Algorithm a) {
+        return a == Algorithm::Yadif ? IFrameFilter::VideoYadifDeinterlaceFilter : IFrameFilter::VideoBwdifDeinterlaceFilter;
+    }
+
+    bool createGraph(const AVFrame* frame, const GraphParams& params) {
+        destroyGraph();
+        filterGraph.reset(avfilter_graph_alloc());
+        if (!filterGraph)
+            return false;
+        filterGraph->nb_threads = params.threadCount; // bwdif/yadif支持切片线程，需在配置前设置
+        // 按实际帧参数创建buffer滤镜，硬件帧下载后的格式可能与解码器的sw_pix_fmt不同
+        srcFilterCtx = avfilter_graph_alloc_filter(filterGraph.get(), avfilter_get_by_name("buffer"), "in");
+        if (!srcFilterCtx)
+            return false;
+        UniquePtr<AVBufferSrcParameters> par{ av_buffersrc_parameters_alloc(), [](auto* p) { av_free(p); } };
+        par->format = params.format;
+        par->width = params.width;
+        par->height = params.height;
+        par->time_base = params.timeBase;
+        par->sample_aspect_ratio = (frame->sample_aspect_ratio.num > 0 ? frame->sample_aspect_ratio : AVRational{ 1, 1 });
+        par->color_space = frame->colorspace;
+        par->color_range = frame->color_range;
+        if (av_buffersrc_parameters_set(srcFilterCtx, par.get()) < 0 || avfilter_init_str(srcFilterCtx, nullptr) < 0)
+            return false;
+        if (avfilter_graph_create_filter(&sinkFilterCtx, avfilter_get_by_name("buffersink"), "out", nullptr, nullptr, filterGraph.get()) < 0)
+            return false;
+        using Filter = FFmpegFrameVideoDeinterlaceFilter;
+        deinterlaceFilter = std::make_shared<Filter>(StreamType::STVideo, nullptr, nullptr, -1, params.algorithm,
+            params.fieldRateOutput ? Filter::Mode::SendField : Filter::Mode::SendFrame, Filter::Parity::Auto,
+            params.mode == Mode::Always ? Filter::Deint::All : Filter::Deint::Interlaced);
+        if (!deinterlaceFilter->createFilterCtxForGraph(filterGraph.get(), "deinterlace"))
+            return false;
+        if (avfilter_link(srcFilterCtx, 0, deinterlaceFilter->getFilterCtx(), 0) < 0
+            || avfilter_link(deinterlaceFilter->getFilterCtx(), 0, sinkFilterCtx, 0) < 0)
+            return false;
+        if (avfilter_graph_config(filterGraph.get(), nullptr) < 0)
+            return false;
+        graphParams = params;
+        progressiveFrameCount = 0;
+        {
+            std::lock_guard lock(statsMtx);
+            stats.active = true;
+            stats.algorithm = params.algorithm;
+            stats.fieldRateOutput = params.fieldRateOutput;
+            stats.threadCount = params.threadCount;
+        }
+        logger.info("Deinterlace: {} enabled, {}x{} {}, {} output, threads: {}", IFrameFilter::getFilterNameByType(deinterlaceFilterType(params.algorithm)),
+            params.width, params.height, av_get_pix_fmt_name(params.format), params.fieldRateOutput ? "field rate" : "frame rate", params.threadCount);
+        return true;
+    }
+
+    void destroyGraph() {
+        if (deinterlaceFilter)
+            deinterlaceFilter->resetFilterCtxForGraph();
+        deinterlaceFilter.reset();
+        srcFilterCtx = nullptr;
+        sinkFilterCtx = nullptr;
+        filterGraph.reset();
+        graphParams = GraphParams{};
+        std::lock_guard lock(statsMtx);
+        stats.active = false;
+    }
+
+    // 送入EOF取出滤镜图中剩余的帧
+    void flushGraph(std::deque<SharedPtr<AVFrame>>& outFrames) {
+        if (!srcFilterCtx)
+            return;
+        if (av_buffersrc_add_frame_flags(srcFilterCtx, nullptr, 0) >= 0)
+            drainGraph(outFrames);
+    }
+
+    uint64_t drainGraph(std::deque<SharedPtr<AVFrame>>& outFrames) {
+        AVRational outTimeBase = av_buffersink_get_time_base(sinkFilterCtx);
+        uint64_t count = 0;
+        while (true)
+        {
+            bool needMore = false;
+            auto out = IFFmpegFrameFilter::getOutputFrame(sinkFilterCtx, needMore);
+            if (!out)
+                break;
+            // 场率输出时滤镜的时间基为输入的1/2，换算回输入时间基以便时钟计算
+            if (out->pts != AV_NOPTS_VALUE)
+                out->pts = av_rescale_q(out->pts, outTimeBase, graphParams.timeBase);
+            if (out->duration > 0)
+                out->duration = av_rescale_q(out->duration, outTimeBase, graphParams.timeBase);
+            outFrames.push_back(out);
+            ++count;
+        }
+        return count;
+    }
+
+    void updateStatistics(double ms, uint64_t outCount) {
+        std::lock_guard lock(statsMtx);
+        ++stats.framesIn;
+        stats.framesOut += outCount;
+        stats.lastMs = ms;
+        stats.totalMs += ms;
+        stats.maxMs = std::max(stats.maxMs, ms);
+        stats.averageMs = stats.totalMs / stats.framesIn;
+        if (stats.framesIn % STATISTICS_LOG_INTERVAL == 0)
+            logger.trace("Deinterlace: {} frames in, {} frames out, avg: {} ms, max: {} ms, last: {} ms",
+                stats.framesIn, stats.framesOut, stats.averageMs, stats.maxMs, stats.lastMs);
+    }
+};
@@ -0,0 +1,170 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 控制命令的常驻执行器：播放、暂停、恢复、停止、seek等需要同时通知多个子播放器的操作，以任务形式交给常驻线程执行
+// 线程在第一次需要时创建，之后空闲的线程被复用，不再为每个命令创建与回收线程
+// 所有线程都忙时才新建（play任务在整个播放期间占用线程），线程数即为同时进行的任务数的最大值，随执行器销毁
+// 可等待全部任务完成或在超时后返回，并统计从提交到完成的控制延迟
+class ControlExecutor {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Task = std::function<void()>;
+
+    static constexpr std::chrono::milliseconds NO_TIMEOUT{ 0 };
+
+    struct Result {
+        bool completed{ true }; // 超时返回时为false，任务仍在后台继续执行
+        double latencyMs{ 0.0 }; // 从提交到全部完成（或超时）的时间
+    };
+    struct Statistics {
+        uint64_t batches{ 0 };
+        uint64_t tasks{ 0 };
+        uint64_t timeouts{ 0 };
+        uint64_t threadsCreated{ 0 };
+        size_t idleThreads{ 0 };
+        double lastLatencyMs{ 0.0 };
+        double averageLatencyMs{ 0.0 };
+        double maxLatencyMs{ 0.0 };
+    };
+
+private:
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<std::packaged_task<void()>> queue;
+    std::vector<std::thread> workers;
+    size_t idleWorkers{ 0 };
+    bool stopping{ false };
+
+    // 统计
+    std::mutex mtxStatistics;
+    Statistics statistics;
+
+public:
+    ControlExecutor() = default;
+    ControlExecutor(const ControlExecutor&) = delete;
+    ControlExecutor& operator=(const ControlExecutor&) = delete;
+    // 执行完队列中剩余的任务后结束线程，正在执行的任务需已能返回（例如先停止播放）
+    ~ControlExecutor() {
+        {
+            std::unique_lock lock(mtx);
+            stopping = true;
+        }
+        cv.notify_all();
+        for (auto& worker : workers)
+            if (worker.joinable())
+                worker.join();
+    }
+
+    // 提交一个任务，没有空闲线程时新建
+    std::future<void> submit(Task task) {
+        std::packaged_task<void()> packaged(std::move(task));
+        std::future<void> future = packaged.get_future();
+        bool createWorker = false;
+        {
+            std::unique_lock lock(mtx);
+            queue.push_back(std::move(packaged));
+            createWorker = idleWorkers < queue.size();
+            if (createWorker)
+                workers.emplace_back(&ControlExecutor::workerLoop, this);
+        }
+        cv.notify_one();
+        if (createWorker)
+        {
+            std::unique_lock lock(mtxStatistics);
+            ++statistics.threadsCreated;
+        }
+        return future;
+    }
+
+    // 同时执行一组任务并等待，timeout为NO_TIMEOUT时一直等待
+    // 超时返回时任务仍在执行，任务中引用的对象需在此之后仍然有效；全部完成时任务抛出的第一个异常在此重新抛出
+    // 长时间运行的任务（如播放）不计入延迟统计
+    Result run(std::vector<Task> tasks, std::chrono::milliseconds timeout = NO_TIMEOUT, bool recordLatency = true) {
+        const Clock::time_point start = Clock::now();
+        std::vector<std::future<void>> futures;
+        futures.reserve(tasks.size());
+        for (auto& task : tasks)
+            futures.push_back(submit(std::move(task)));
+        Result result;
+        const Clock::time_point deadline = start + timeout;
+        for (auto& future : futures)
+        {
+            if (timeout == NO_TIMEOUT)
+                future.wait();
+            else if (future.wait_until(deadline) != std::future_status::ready)
+            {
+                result.completed = false;
+                break;
+            }
+        }
+        result.latencyMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        if (recordLatency)
+            record(result, futures.size());
+        if (result.completed)
+            for (auto& future : futures)
+                future.get();
+        return result;
+    }
+    // 提交一组任务，不等待
+    void post(std::vector<Task> tasks) {
+        for (auto& task : tasks)
+            submit(std::move(task));
+    }
+
+    Statistics getStatistics() {
+        Statistics s;
+        {
+            std::unique_lock lock(mtxStatistics);
+            s = statistics;
+        }
+        std::unique_lock lock(mtx);
+        s.idleThreads = idleWorkers;
+        return s;
+    }
+    void resetStatistics() {
+        std::unique_lock lock(mtxStatistics);
+        const uint64_t threadsCreated = statistics.threadsCreated;
+        statistics = Statistics{};
+        statistics.threadsCreated = threadsCreated;
+    }
+
+private:
+    void workerLoop() {
+        std::unique_lock lock(mtx);
+        while (true)
+        {
+            ++idleWorkers;
+            cv.wait(lock, [this] { return stopping || !queue.empty(); });
+            --idleWorkers;
+            if (queue.empty()) // 停止且没有剩余任务
+                return;
+            std::packaged_task<void()> task = std::move(queue.front());
+            queue.pop_front();
+            lock.unlock();
+            task(); // 异常保存在future中
+            lock.lock();
+        }
+    }
+
+    void record(const Result& result, size_t tasks) {
+        std::unique_lock lock(mtxStatistics);
+        auto& s = statistics;
+        ++s.batches;
+        s.tasks += tasks;
+        if (!result.completed)
+            ++s.timeouts;
+        s.lastLatencyMs = result.latencyMs;
+        s.averageLatencyMs += (result.latencyMs - s.averageLatencyMs) / static_cast<double>(s.batches);
+        s.maxLatencyMs = std::max(s.maxLatencyMs, result.latencyMs);
+    }
+};
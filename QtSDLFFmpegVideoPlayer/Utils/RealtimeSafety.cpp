@@ -0,0 +1,73 @@
+#include "RealtimeSafety.h"
+
+#if !defined(NDEBUG) && !defined(REALTIME_SAFETY_NO_ALLOCATION_CHECK)
+#include <cstdlib>
+#include <new>
+// 调试版本中替换全局的operator new/delete，在音频回调（RealtimeScope内）中分配或释放内存时计入违规；定义REALTIME_SAFETY_NO_ALLOCATION_CHECK可关闭
+// 替换对整个程序生效，回调之外只多一次线程局部变量的判断；包括对齐与nothrow版本，保证分配与释放成对经过同一实现
+namespace {
+    void* checkedAllocate(std::size_t size, std::size_t alignment, bool nothrow)
+    {
+        RealtimeSafety::check("allocation (operator new)");
+        if (size == 0)
+            size = 1;
+        while (true)
+        {
+            void* p = nullptr;
+            if (alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+                p = std::malloc(size);
+            else
+#ifdef _MSC_VER
+                p = _aligned_malloc(size, alignment);
+#else
+                p = std::aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment); // 大小需为对齐的整数倍
+#endif
+            if (p)
+                return p;
+            std::new_handler handler = std::get_new_handler();
+            if (!handler)
+            {
+                if (nothrow)
+                    return nullptr;
+                throw std::bad_alloc();
+            }
+            handler();
+        }
+    }
+    void checkedRelease(void* p, std::size_t alignment) noexcept
+    {
+        if (!p)
+            return;
+        RealtimeSafety::check("deallocation (operator delete)");
+#ifdef _MSC_VER
+        if (alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+        {
+            _aligned_free(p);
+            return;
+        }
+#endif
+        std::free(p);
+    }
+    std::size_t alignmentOf(std::align_val_t alignment) { return static_cast<std::size_t>(alignment); }
+}
+void* operator new(std::size_t size) { return checkedAllocate(size, 0, false); }
+void* operator new[](std::size_t size) { return checkedAllocate(size, 0, false); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return checkedAllocate(size, 0, true); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return checkedAllocate(size, 0, true); }
+void* operator new(std::size_t size, std::align_val_t alignment) { return checkedAllocate(size, alignmentOf(alignment), false); }
+void* operator new[](std::size_t size, std::align_val_t alignment) { return checkedAllocate(size, alignmentOf(alignment), false); }
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return checkedAllocate(size, alignmentOf(alignment), true); }
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return checkedAllocate(size, alignmentOf(alignment), true); }
+void operator delete(void* p) noexcept { checkedRelease(p, 0); }
+void operator delete[](void* p) noexcept { checkedRelease(p, 0); }
+void operator delete(void* p, std::size_t) noexcept { checkedRelease(p, 0); }
+void operator delete[](void* p, std::size_t) noexcept { checkedRelease(p, 0); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { checkedRelease(p, 0); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { checkedRelease(p, 0); }
+void operator delete(void* p, std::align_val_t alignment) noexcept { checkedRelease(p, alignmentOf(alignment)); }
+void operator delete[](void* p, std::align_val_t alignment) noexcept { checkedRelease(p, alignmentOf(alignment)); }
+void operator delete(void* p, std::size_t, std::align_val_t alignment) noexcept { checkedRelease(p, alignmentOf(alignment)); }
+void operator delete[](void* p, std::size_t, std::align_val_t alignment) noexcept { checkedRelease(p, alignmentOf(alignment)); }
+void operator delete(void* p, std::align_val_t alignment, const std::nothrow_t&) noexcept { checkedRelease(p, alignmentOf(alignment)); }
+void operator delete[](void* p, std::align_val_t alignment, const std::nothrow_t&) noexcept { checkedRelease(p, alignmentOf(alignment)); }
+#endif
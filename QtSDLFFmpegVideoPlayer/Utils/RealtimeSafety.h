@@ -0,0 +1,50 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+// 实时线程（音频回调）安全检查
+// 调试版本中由RealtimeScope标记当前线程正处于实时回调内，睡眠、加锁、内存分配等可能阻塞的位置调用check()，
+// 在实时回调内被调用即记为一次违规：只累加无锁计数并记下最后一次违规的描述，不做输出，不会中断播放
+// 报告由非实时线程完成：定期读取violationCount()与lastViolation()，计数变化时输出日志
+// 内存分配的检查见RealtimeSafety.cpp，替换了全局的operator new/delete
+// 发布版本（定义NDEBUG）中全部为空操作
+namespace RealtimeSafety {
+#ifndef NDEBUG
+    inline thread_local int realtimeDepth = 0;
+    inline std::atomic<uint64_t> violations{ 0 };
+    inline std::atomic<const char*> lastViolationWhat{ nullptr };
+
+    inline bool isRealtimeThread() { return realtimeDepth > 0; }
+    // \param what 违规操作的描述，需为字符串常量
+    inline void check(const char* what) {
+        if (realtimeDepth <= 0)
+            return;
+        lastViolationWhat.store(what, std::memory_order_relaxed);
+        violations.fetch_add(1, std::memory_order_release);
+    }
+    inline uint64_t violationCount() { return violations.load(std::memory_order_acquire); }
+    // 最后一次违规的描述，没有违规时为空字符串
+    inline const char* lastViolation() {
+        const char* what = lastViolationWhat.load(std::memory_order_relaxed);
+        return what ? what : "";
+    }
+#else
+    inline bool isRealtimeThread() { return false; }
+    inline void check(const char*) {}
+    inline uint64_t violationCount() { return 0; }
+    inline const char* lastViolation() { return ""; }
+#endif
+
+    // 在实时回调的入口处构造，离开作用域时恢复
+    class RealtimeScope {
+    public:
+#ifndef NDEBUG
+        RealtimeScope() { ++realtimeDepth; }
+        ~RealtimeScope() { --realtimeDepth; }
+#else
+        RealtimeScope() = default;
+#endif
+        RealtimeScope(const RealtimeScope&) = delete;
+        RealtimeScope& operator=(const RealtimeScope&) = delete;
+    };
+}
@@ -0,0 +1,187 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if !defined(SIMD_FLOAT4_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define SIMD_FLOAT4_SSE2 1
+#elif !defined(SIMD_FLOAT4_NO_SIMD) && (defined(__aarch64__) || defined(_M_ARM64))
+#include <arm_neon.h>
+#define SIMD_FLOAT4_NEON 1
+#endif
+
+// 4路float的SIMD封装：x86为SSE2，ARM64为NEON，均为各自架构的基线指令集，不需要运行时检测
+// 其他平台（或定义SIMD_FLOAT4_NO_SIMD时）退化为逐元素的标量实现，结果相同
+// 只包含逐像素运算用到的操作，读写均不要求对齐
+struct SimdFloat4 {
+#if defined(SIMD_FLOAT4_SSE2)
+    __m128 v;
+#elif defined(SIMD_FLOAT4_NEON)
+    float32x4_t v;
+#else
+    float v[4];
+#endif
+
+    static SimdFloat4 load(const float* p) {
+#if defined(SIMD_FLOAT4_SSE2)
+        return { _mm_loadu_ps(p) };
+#elif defined(SIMD_FLOAT4_NEON)
+        return { vld1q_f32(p) };
+#else
+        return { { p[0], p[1], p[2], p[3] } };
+#endif
+    }
+    // 4个无符号16位整数转换为float
+    static SimdFloat4 loadU16(const uint16_t* p) {
+#if defined(SIMD_FLOAT4_SSE2)
+        const __m128i x = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p));
+        return { _mm_cvtepi32_ps(_mm_unpacklo_epi16(x, _mm_setzero_si128())) };
+#elif defined(SIMD_FLOAT4_NEON)
+        return { vcvtq_f32_u32(vmovl_u16(vld1_u16(p))) };
+#else
+        return { { float(p[0]), float(p[1]), float(p[2]), float(p[3]) } };
+#endif
+    }
+    static SimdFloat4 set1(float x) {
+#if defined(SIMD_FLOAT4_SSE2)
+        return { _mm_set1_ps(x) };
+#elif defined(SIMD_FLOAT4_NEON)
+        return { vdupq_n_f32(x) };
+#else
+        return { { x, x, x, x } };
+#endif
+    }
+    void store(float* p) const {
+#if defined(SIMD_FLOAT4_SSE2)
+        _mm_storeu_ps(p, v);
+#elif defined(SIMD_FLOAT4_NEON)
+        vst1q_f32(p, v);
+#else
+        std::memcpy(p, v, sizeof(v));
+#endif
+    }
+    // 向零截断为32位整数，用于查表索引
+    void storeIndex(int32_t* p) const {
+#if defined(SIMD_FLOAT4_SSE2)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm_cvttps_epi32(v));
+#elif defined(SIMD_FLOAT4_NEON)
+        vst1q_s32(p, vcvtq_s32_f32(v));
+#else
+        for (int i = 0; i < 4; ++i)
+            p[i] = static_cast<int32_t>(v[i]);
+#endif
+    }
+    // 向零截断并饱和到[0, 255]
+    void storeU8(uint8_t* p) const {
+#if defined(SIMD_FLOAT4_SSE2)
+        const __m128i i32 = _mm_cvttps_epi32(v);
+        const __m128i i16 = _mm_packs_epi32(i32, i32);
+        const int32_t u8 = _mm_cvtsi128_si32(_mm_packus_epi16(i16, i16));
+        std::memcpy(p, &u8, 4);
+#elif defined(SIMD_FLOAT4_NEON)
+        const uint16x4_t u16 = vqmovun_s32(vcvtq_s32_f32(v));
+        const uint32_t u8 = vget_lane_u32(vreinterpret_u32_u8(vqmovn_u16(vcombine_u16(u16, u16))), 0);
+        std::memcpy(p, &u8, 4);
+#else
+        for (int i = 0; i < 4; ++i)
+            p[i] = static_cast<uint8_t>(std::clamp(static_cast<int32_t>(v[i]), 0, 255));
+#endif
+    }
+
+    friend SimdFloat4 operator+(SimdFloat4 a, SimdFloat4 b) {
+#if defined(SIMD_FLOAT4_SSE2)
+        return { _mm_add_ps(a.v, b.v) };
+#elif defined(SIMD_FLOAT4_NEON)
+        return { vaddq_f32(a.v, b.v) };
+#else
+        return { { a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3] } };
+#endif
+    }
+    friend SimdFloat4 operator-(SimdFloat4 a, SimdFloat4 b) {
+#if defined(SIMD_FLOAT4_SSE2)
+        return { _mm_sub_ps(a.v, b.v) };
+#elif defined(SIMD_FLOAT4_NEON)
+        return { vsubq_f32(a.v, b.v) };
+#else
+        return { { a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3] } };
+#endif
+    }
+    friend SimdFloat4 operator*(SimdFloat4 a, SimdFloat4 b) {
+#if defined(SIMD_FLOAT4_SSE2)
+        return { _mm_mul_ps(a.v, b.v) };
+#elif defined(SIMD_FLOAT4_NEON)
+        return { vmulq_f32(a.v, b.v) };
+#else
+        return { { a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3] } };
+#endif
+    }
+    friend SimdFloat4 operator+(SimdFloat4 a, float b) { return a + set1(b); }
+    friend SimdFloat4 operator-(SimdFloat4 a, float b) { return a - set1(b); }
+    friend SimdFloat4 operator*(SimdFloat4 a, float b) { return a * set1(b); }
+
+    static SimdFloat4 min(SimdFloat4 a, SimdFloat4 b) {
+#if defined(SIMD_FLOAT4_SSE2)
+        return { _mm_min_ps(a.v, b.v) };
+#elif defined(SIMD_FLOAT4_NEON)
+        return { vminq_f32(a.v, b.v) };
+#else
+        return { { std::min(a.v[0], b.v[0]), std::min(a.v[1], b.v[1]), std::min(a.v[2], b.v[2]), std::min(a.v[3], b.v[3]) } };
+#endif
+    }
+    static SimdFloat4 max(SimdFloat4 a, SimdFloat4 b) {
+#if defined(SIMD_FLOAT4_SSE2)
+        return { _mm_max_ps(a.v, b.v) };
+#elif defined(SIMD_FLOAT4_NEON)
+        return { vmaxq_f32(a.v, b.v) };
+#else
+        return { { std::max(a.v[0], b.v[0]), std::max(a.v[1], b.v[1]), std::max(a.v[2], b.v[2]), std::max(a.v[3], b.v[3]) } };
+#endif
+    }
+    static SimdFloat4 clamp(SimdFloat4 a, float lo, float hi) { return min(max(a, set1(lo)), set1(hi)); }
+    static SimdFloat4 sqrt(SimdFloat4 a) {
+#if defined(SIMD_FLOAT4_SSE2)
+        return { _mm_sqrt_ps(a.v) };
+#elif defined(SIMD_FLOAT4_NEON)
+        return { vsqrtq_f32(a.v) };
+#else
+        return { { std::sqrt(a.v[0]), std::sqrt(a.v[1]), std::sqrt(a.v[2]), std::sqrt(a.v[3]) } };
+#endif
+    }
+    // [a0, a0, a1, a1]
+    static SimdFloat4 duplicateLow(SimdFloat4 a) {
+#if defined(SIMD_FLOAT4_SSE2)
+        return { _mm_unpacklo_ps(a.v, a.v) };
+#elif defined(SIMD_FLOAT4_NEON)
+        return { vzip1q_f32(a.v, a.v) };
+#else
+        return { { a.v[0], a.v[0], a.v[1], a.v[1] } };
+#endif
+    }
+    // [a2, a2, a3, a3]
+    static SimdFloat4 duplicateHigh(SimdFloat4 a) {
+#if defined(SIMD_FLOAT4_SSE2)
+        return { _mm_unpackhi_ps(a.v, a.v) };
+#elif defined(SIMD_FLOAT4_NEON)
+        return { vzip2q_f32(a.v, a.v) };
+#else
+        return { { a.v[2], a.v[2], a.v[3], a.v[3] } };
+#endif
+    }
+    // 相邻两项求和：[a0 + a1, a2 + a3, b0 + b1, b2 + b3]
+    static SimdFloat4 pairwiseAdd(SimdFloat4 a, SimdFloat4 b) {
+#if defined(SIMD_FLOAT4_SSE2)
+        return { _mm_add_ps(_mm_shuffle_ps(a.v, b.v, _MM_SHUFFLE(2, 0, 2, 0)), _mm_shuffle_ps(a.v, b.v, _MM_SHUFFLE(3, 1, 3, 1))) };
+#elif defined(SIMD_FLOAT4_NEON)
+        return { vpaddq_f32(a.v, b.v) };
+#else
+        return { { a.v[0] + a.v[1], a.v[2] + a.v[3], b.v[0] + b.v[1], b.v[2] + b.v[3] } };
+#endif
+    }
+    float horizontalMax() const {
+        float lanes[4];
+        store(lanes);
+        return std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+    }
+};
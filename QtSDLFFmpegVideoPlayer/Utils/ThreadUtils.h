@@ -1,6 +1,7 @@
 #pragma once
 #include <chrono>
 #include <thread>
+#include "RealtimeSafety.h"
 
 
 
@@ -45,6 +46,7 @@
 template <class _Rep, class _Period>
 inline void SleepFor(const std::chrono::duration<_Rep, _Period>& duration)
 {
+    RealtimeSafety::check("sleep");
     std::this_thread::sleep_for(duration);
 }
 
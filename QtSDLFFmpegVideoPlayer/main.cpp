@@ -3,6 +3,9 @@
 #include <SDLApp.h>
 #include <SDL3/SDL_main.h>
 #include <Logger.h>
+#include <cstring>
+#include "SwsScaleBenchmark.h"
+#include "AudioDspBenchmark.h"
 
 class FFmpegInfo
 {
@@ -28,9 +31,27 @@ public:
     }
 };
 
+// 性能测试：以--benchmark启动时只运行sws转换与音频DSP的耗时测试，结果输出到日志后退出，不创建界面
+static bool runBenchmarks(int argc, char* argv[], Logger& logger)
+{
+    bool requested = false;
+    for (int i = 1; i < argc; ++i)
+        if (std::strcmp(argv[i], "--benchmark") == 0)
+            requested = true;
+    if (!requested)
+        return false;
+    // 线程数0表示由libswscale自动选择
+    SwsScaleBenchmark::run(SwsScaleBenchmark::defaultCases(), { 1, 2, 4, 0 }, 100, &logger);
+    AudioDspBenchmark::run(AudioDspBenchmark::defaultCases(), 0.8, 500, &logger);
+    AudioDspBenchmark::runTimeStretch(AudioDspBenchmark::defaultStretchRatios(), 48000, 2, 10.0, 1024, &logger);
+    return true;
+}
+
 int main(int argc, char *argv[])
 {
     Logger logger{ "main" };
+    if (runBenchmarks(argc, argv, logger))
+        return 0;
     SDLApp::init(argc, argv, SDL_INIT_VIDEO);
     QApplication a(argc, argv);
     FFmpegInfo filterInfo;
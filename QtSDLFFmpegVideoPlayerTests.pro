@@ -0,0 +1,47 @@
+# 工具类的单元测试，不依赖界面、SDL与音频设备：qmake QtSDLFFmpegVideoPlayerTests.pro，然后 make check
+QT -= gui
+QT += testlib
+
+CONFIG += c++20 console testcase
+CONFIG -= app_bundle
+
+TARGET = QtSDLFFmpegVideoPlayerTests
+
+INCLUDEPATH += ../Libraries/ConcurrentQueue
+INCLUDEPATH += ./QtSDLFFmpegVideoPlayer
+INCLUDEPATH += \
+    ./QtSDLFFmpegVideoPlayer/Utils \
+    ./QtSDLFFmpegVideoPlayer/Players \
+    ./QtSDLFFmpegVideoPlayer/Logger \
+    ./QtSDLFFmpegVideoPlayer/Tools
+
+SOURCES += \
+    QtSDLFFmpegVideoPlayer/Players/PlayerPredefine.cpp \
+    QtSDLFFmpegVideoPlayer/Tests/PlayerToolsTest.cpp
+
+HEADERS += \
+    QtSDLFFmpegVideoPlayer/Players/PlayerPredefine.h \
+    QtSDLFFmpegVideoPlayer/Tools/AudioRingBuffer.h \
+    QtSDLFFmpegVideoPlayer/Tools/AudioChannelMixer.h \
+    QtSDLFFmpegVideoPlayer/Tools/LoudnessMeter.h \
+    QtSDLFFmpegVideoPlayer/Tools/AudioCrossfader.h \
+    QtSDLFFmpegVideoPlayer/Tools/AudioSyncAdjustment.h \
+    QtSDLFFmpegVideoPlayer/Utils/ControlExecutor.h
+
+# 库，与QtSDLFFmpegVideoPlayer.pro相同
+
+win32:CONFIG(release, debug|release): LIBS += -L$$PWD/../Libraries/ffmpeg-shared/lib/  -lavcodec -lavdevice -lavfilter -lavformat -lavutil -lswresample -lswscale
+else:win32:CONFIG(debug, debug|release): LIBS += -L$$PWD/../Libraries/ffmpeg-shared/lib/  -lavcodec -lavdevice -lavfilter -lavformat -lavutil -lswresample -lswscale
+else:unix: LIBS += -L$$PWD/../Libraries/ffmpeg-shared/lib/linux/ -lavcodec -lavdevice -lavfilter -lavformat -lavutil -lswresample -lswscale
+
+INCLUDEPATH += $$PWD/../Libraries/ffmpeg-shared/include
+DEPENDPATH += $$PWD/../Libraries/ffmpeg-shared/include
+
+LIBS += -lpthread
+
+win32:CONFIG(release, debug|release): LIBS += -L$$PWD/../Libraries/Logger/build/MinGWx64/ -llibLogger
+else:win32:CONFIG(debug, debug|release): LIBS += -L$$PWD/../Libraries/Logger/build/MinGWx64/ -llibLogger_d
+else:unix: LIBS += -L$$PWD/../Libraries/Logger/build/MinGWx64/ -lLogger
+
+INCLUDEPATH += $$PWD/../Libraries/Logger/include
+DEPENDPATH += $$PWD/../Libraries/Logger/include